@@ -1,8 +1,12 @@
 package ctool;
 
 import com.sun.jna.Native;
+import com.sun.jna.Pointer;
+import com.sun.jna.ptr.PointerByReference;
 import com.sun.jna.win32.StdCallLibrary;
 
+import java.nio.ByteBuffer;
+
 /**
  * 使用 JNA 调用 C++ DLL 中的 StartFileMonitor / StopFileMonitor。
  * 对应 monitor_api.h 中的 __stdcall 函数。
@@ -13,8 +17,103 @@ public interface NativeMonitor extends StdCallLibrary {
     NativeMonitor INSTANCE = Native.load("bin\\file_monitor", NativeMonitor.class);
 
     // 对应: int __stdcall StartFileMonitor(const char* monitorPath, const char* dbPath);
+    // 返回 0 成功，1 已在监视，2 打开数据库失败，-1 其它错误（含数据库已被另一个实例使用）
     int StartFileMonitor(String monitorPath, String dbPath);
 
     // 对应: void __stdcall StopFileMonitor();
     void StopFileMonitor();
+
+    // 对应: int __stdcall AddMonitorRoot(const char* path);
+    int AddMonitorRoot(String path);
+
+    // 对应: int __stdcall RemoveMonitorRoot(const char* path);
+    int RemoveMonitorRoot(String path);
+
+    // 对应: int __stdcall SearchFiles(const char* query, char* buffer, int bufferSize, int maxResults);
+    // query 为以 0 结尾的 UTF-8 字节
+    int SearchFiles(byte[] query, byte[] buffer, int bufferSize, int maxResults);
+
+    // 对应: int __stdcall SearchFilesSorted(const char* query, int sortBy, char* buffer, int bufferSize, int maxResults);
+    int SearchFilesSorted(byte[] query, int sortBy, byte[] buffer, int bufferSize, int maxResults);
+
+    // 对应: int __stdcall SearchFilesBinary(const char* query, int sortBy, void* buffer, int bufferSize, int maxResults);
+    // buffer 须为 direct ByteBuffer，JNA 直接传递其地址，结果不经过 Java 堆复制
+    int SearchFilesBinary(byte[] query, int sortBy, ByteBuffer buffer, int bufferSize, int maxResults);
+
+    // 对应: int __stdcall FindDuplicates(const char* query, long long minSize, char* buffer, int bufferSize, int maxGroups);
+    int FindDuplicates(byte[] query, long minSize, byte[] buffer, int bufferSize, int maxGroups);
+
+    // 对应: void __stdcall CancelFindDuplicates();
+    void CancelFindDuplicates();
+
+    // 对应: int __stdcall GetDiskUsage(const char* root, int depth, int topN, char* buffer, int bufferSize);
+    int GetDiskUsage(byte[] root, int depth, int topN, byte[] buffer, int bufferSize);
+
+    // 对应: int __stdcall SetExclusionRules(const char* rules);
+    // rules 为以 0 结尾的 UTF-8 字节，每行一条规则
+    int SetExclusionRules(byte[] rules);
+
+    // 对应: int __stdcall GetMonitorStats(char* buffer, int bufferSize);
+    // 结果为 UTF-8 的 JSON；buffer 不够时返回所需大小的相反数
+    int GetMonitorStats(byte[] buffer, int bufferSize);
+
+    // 对应: void __stdcall SetMonitorStatsDump(const char* path, int intervalSeconds);
+    void SetMonitorStatsDump(String path, int intervalSeconds);
+
+    // 对应: typedef void (__stdcall *IndexChangeCallback)(int subscription, const void* delta, int size, void* context);
+    // 在 DLL 的后台线程上调用，delta 只在回调期间有效；实现对象需保持强引用直到取消订阅
+    interface ChangeCallback extends StdCallCallback {
+        void invoke(int subscription, Pointer delta, int size, Pointer context);
+    }
+
+    // 对应: int __stdcall SubscribeChanges(const char* query, IndexChangeCallback callback, void* context);
+    // callback 为 null 时用 PollChanges 取变化
+    int SubscribeChanges(byte[] query, ChangeCallback callback, Pointer context);
+
+    // 对应: int __stdcall PollChanges(int subscription, void* buffer, int bufferSize);
+    int PollChanges(int subscription, ByteBuffer buffer, int bufferSize);
+
+    // 对应: int __stdcall UnsubscribeChanges(int subscription);
+    int UnsubscribeChanges(int subscription);
+
+    // 以下为按句柄的多实例接口，句柄由 CreateFileIndex 写入，用 DestroyFileIndex 释放
+
+    // 对应: int __stdcall CreateFileIndex(const char* dbPath, MonitorHandle* handle);
+    int CreateFileIndex(String dbPath, PointerByReference handle);
+
+    // 对应: int __stdcall AttachMonitor(MonitorHandle handle, const char* monitorPath);
+    int AttachMonitor(Pointer handle, String monitorPath);
+
+    // 对应: void __stdcall DestroyFileIndex(MonitorHandle handle);
+    void DestroyFileIndex(Pointer handle);
+
+    // 对应: int __stdcall IndexAddRoot(MonitorHandle handle, const char* path);
+    int IndexAddRoot(Pointer handle, String path);
+
+    // 对应: int __stdcall IndexRemoveRoot(MonitorHandle handle, const char* path);
+    int IndexRemoveRoot(Pointer handle, String path);
+
+    // 对应: int __stdcall IndexSearch(MonitorHandle handle, const char* query, int sortBy, char* buffer, int bufferSize, int maxResults);
+    int IndexSearch(Pointer handle, byte[] query, int sortBy, byte[] buffer, int bufferSize, int maxResults);
+
+    // 对应: int __stdcall IndexSearchBinary(MonitorHandle handle, const char* query, int sortBy, void* buffer, int bufferSize, int maxResults);
+    int IndexSearchBinary(Pointer handle, byte[] query, int sortBy, ByteBuffer buffer, int bufferSize, int maxResults);
+
+    // 对应: int __stdcall IndexFindDuplicates(MonitorHandle handle, const char* query, long long minSize, char* buffer, int bufferSize, int maxGroups);
+    int IndexFindDuplicates(Pointer handle, byte[] query, long minSize, byte[] buffer, int bufferSize, int maxGroups);
+
+    // 对应: void __stdcall IndexCancelFindDuplicates(MonitorHandle handle);
+    void IndexCancelFindDuplicates(Pointer handle);
+
+    // 对应: int __stdcall IndexGetDiskUsage(MonitorHandle handle, const char* root, int depth, int topN, char* buffer, int bufferSize);
+    int IndexGetDiskUsage(Pointer handle, byte[] root, int depth, int topN, byte[] buffer, int bufferSize);
+
+    // 对应: int __stdcall IndexSubscribe(MonitorHandle handle, const char* query, IndexChangeCallback callback, void* context);
+    int IndexSubscribe(Pointer handle, byte[] query, ChangeCallback callback, Pointer context);
+
+    // 对应: int __stdcall IndexPollChanges(MonitorHandle handle, int subscription, void* buffer, int bufferSize);
+    int IndexPollChanges(Pointer handle, int subscription, ByteBuffer buffer, int bufferSize);
+
+    // 对应: int __stdcall IndexUnsubscribe(MonitorHandle handle, int subscription);
+    int IndexUnsubscribe(Pointer handle, int subscription);
 }
\ No newline at end of file
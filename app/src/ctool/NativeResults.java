@@ -0,0 +1,91 @@
+package ctool;
+
+import model.FileRecord;
+
+import java.nio.ByteBuffer;
+import java.nio.charset.StandardCharsets;
+import java.util.AbstractList;
+import java.util.function.Consumer;
+
+/**
+ * SearchFilesBinary 写入 direct buffer 的结果，按行惰性解码。
+ * 布局见 monitor_api.h：8 字节头部，之后每行 48 字节 {路径偏移, 路径长度, 大小, 创建, 访问, 修改, 编号, 变化}，
+ * 路径字节位于 buffer 尾部。JTable 只对可见行调用 get，其余行不会构造任何字符串。
+ * 不再使用时调用 close() 归还 buffer，之后不能再读取未解码的行。
+ */
+public class NativeResults extends AbstractList<FileRecord> implements AutoCloseable {
+
+    static final int HEADER_SIZE = 8;
+    static final int ROW_SIZE = 48;
+
+    private final ByteBuffer buffer;
+    private final int rows;
+    private final FileRecord[] decoded;
+    private final Consumer<ByteBuffer> recycler;
+    private boolean closed;
+
+    NativeResults(ByteBuffer buffer, int rows, Consumer<ByteBuffer> recycler) {
+        this.buffer = buffer;
+        this.rows = rows;
+        this.decoded = new FileRecord[rows];
+        this.recycler = recycler;
+    }
+
+    @Override
+    public int size() {
+        return rows;
+    }
+
+    @Override
+    public FileRecord get(int index) {
+        FileRecord r = decoded[index];
+        if (r == null) {
+            if (closed) throw new IllegalStateException("results already closed");
+            r = decode(index);
+            decoded[index] = r;
+        }
+        return r;
+    }
+
+    // 节点编号，不解码整行
+    public int idAt(int index) {
+        if (closed) throw new IllegalStateException("results already closed");
+        return buffer.getInt(HEADER_SIZE + index * ROW_SIZE + 40);
+    }
+
+    @Override
+    public FileRecord set(int index, FileRecord record) {
+        FileRecord old = get(index);
+        decoded[index] = record;
+        return old;
+    }
+
+    private FileRecord decode(int index) {
+        return decodeRow(buffer, HEADER_SIZE + index * ROW_SIZE);
+    }
+
+    static FileRecord decodeRow(ByteBuffer buffer, int at) {
+        int pathOffset = buffer.getInt(at);
+        int pathLength = buffer.getInt(at + 4);
+
+        byte[] path = new byte[pathLength];
+        buffer.get(pathOffset, path);
+
+        FileRecord r = new FileRecord(
+                new String(path, StandardCharsets.UTF_8),
+                buffer.getLong(at + 8),
+                FileRecord.formatEpochMillis(buffer.getLong(at + 16)),
+                FileRecord.formatEpochMillis(buffer.getLong(at + 24)),
+                FileRecord.formatEpochMillis(buffer.getLong(at + 32))
+        );
+        r.id = buffer.getInt(at + 40);
+        return r;
+    }
+
+    @Override
+    public synchronized void close() {
+        if (closed) return;
+        closed = true;
+        recycler.accept(buffer);
+    }
+}
@@ -0,0 +1,124 @@
+package ctool;
+
+import model.FileRecord;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.charset.StandardCharsets;
+import java.util.ArrayList;
+import java.util.List;
+import java.util.concurrent.CancellationException;
+import java.util.concurrent.ConcurrentLinkedQueue;
+
+/**
+ * 通过 DLL 中的 SearchFilesBinary 在内存索引里搜索。
+ * 索引未就绪或 DLL 不可用时返回 null，由调用方回退到 SQLite 查询。
+ */
+public class NativeSearcher {
+
+    // 排序方式，与 SearchFilesSorted 的 sortBy 一致
+    public static final int SORT_NONE = 0;
+    public static final int SORT_SIZE_DESC = 1;
+    public static final int SORT_SIZE_ASC = 2;
+    public static final int SORT_WRITE_DESC = 3;
+    public static final int SORT_WRITE_ASC = 4;
+
+    // 实时查询的变化种类，与 SearchResultRow.change 一致
+    public static final int CHANGE_ADDED = 1;
+    public static final int CHANGE_REMOVED = 2;
+    public static final int CHANGE_UPDATED = 3;
+
+    public static final int MAX_RESULTS = 1000;
+    private static final int BUFFER_SIZE = 512 * 1024;
+    private static final int CHANGE_DELTA_RESET = 1;
+
+    /** 一项变化；移出的项只有 record.id，路径为空 */
+    public record Change(int kind, FileRecord record) {}
+
+    /** 一次取到的变化；reset 为 true 时无法给出增量，应重新搜索 */
+    public record Changes(boolean reset, List<Change> items) {}
+
+    // 结果直接引用 direct buffer，由 NativeResults.close() 归还后复用
+    private final ConcurrentLinkedQueue<ByteBuffer> pool = new ConcurrentLinkedQueue<>();
+
+    private ByteBuffer acquire() {
+        ByteBuffer buffer = pool.poll();
+        if (buffer == null) {
+            buffer = ByteBuffer.allocateDirect(BUFFER_SIZE).order(ByteOrder.LITTLE_ENDIAN);
+        }
+        return buffer;
+    }
+
+    /**
+     * 返回的列表按需解码各行，使用完毕后应调用 {@link NativeResults#close()}。
+     * @throws CancellationException 本次查询已被更新的查询取代
+     */
+    public List<FileRecord> search(String keyword, int sortBy) {
+        byte[] query = (keyword + "\0").getBytes(StandardCharsets.UTF_8);
+        ByteBuffer buffer = acquire();
+
+        int n;
+        try {
+            n = NativeMonitor.INSTANCE.SearchFilesBinary(query, sortBy, buffer, buffer.capacity(), MAX_RESULTS);
+        } catch (Throwable e) {
+            pool.offer(buffer);
+            return null;
+        }
+        if (n < 0) pool.offer(buffer);
+        if (n == -1) throw new CancellationException();
+        if (n == -3) return List.of(); // 查询串不合法
+        if (n < 0) return null;
+
+        return new NativeResults(buffer, n, pool::offer);
+    }
+
+    /**
+     * 订阅 keyword 的结果变化，之后用 {@link #poll(int)} 取增量。
+     * @return 订阅号，索引未就绪、DLL 不可用或查询串不合法时为 0
+     */
+    public int subscribe(String keyword) {
+        byte[] query = (keyword + "\0").getBytes(StandardCharsets.UTF_8);
+        try {
+            int id = NativeMonitor.INSTANCE.SubscribeChanges(query, null, null);
+            return Math.max(id, 0);
+        } catch (Throwable e) {
+            return 0;
+        }
+    }
+
+    /**
+     * 取走订阅积累的全部变化，没有变化时 items 为空。
+     * @return 订阅已不存在（例如监控重启）时为 null
+     */
+    public Changes poll(int subscription) {
+        ByteBuffer buffer = acquire();
+        try {
+            boolean reset = false;
+            List<Change> items = new ArrayList<>();
+            // buffer 放不下的留在 DLL 中，取到没有为止
+            for (;;) {
+                int n = NativeMonitor.INSTANCE.PollChanges(subscription, buffer, buffer.capacity());
+                if (n < 0) return null;
+                reset |= (buffer.getInt(4) & CHANGE_DELTA_RESET) != 0;
+                if (n == 0) return new Changes(reset, items);
+                for (int i = 0; i < n; i++) {
+                    int at = NativeResults.HEADER_SIZE + i * NativeResults.ROW_SIZE;
+                    items.add(new Change(buffer.getInt(at + 44), NativeResults.decodeRow(buffer, at)));
+                }
+            }
+        } catch (Throwable e) {
+            return null;
+        } finally {
+            pool.offer(buffer);
+        }
+    }
+
+    public void unsubscribe(int subscription) {
+        if (subscription <= 0) return;
+        try {
+            NativeMonitor.INSTANCE.UnsubscribeChanges(subscription);
+        } catch (Throwable e) {
+            // DLL 不可用时没有可取消的订阅
+        }
+    }
+}
@@ -19,10 +19,22 @@ public class SQLiteAccessor {
     }
 
     public List<FileRecord> search(String keyword) {
+        return search(keyword, 0);
+    }
+
+    // sortBy 与 NativeSearcher 的 SORT_* 常量一致
+    public List<FileRecord> search(String keyword, int sortBy) {
         List<FileRecord> list = new ArrayList<>();
 
+        String order = switch (sortBy) {
+            case 1 -> "fileSize DESC";
+            case 2 -> "fileSize ASC";
+            case 3 -> "lastWriteTime DESC";
+            case 4 -> "lastWriteTime ASC";
+            default -> "id";
+        };
         String sql = "SELECT fullpath, fileSize, creationTime, lastAccessTime, lastWriteTime " +
-                "FROM files WHERE fullpath LIKE ? ORDER BY id LIMIT 1000";
+                "FROM files WHERE fullpath LIKE ? ORDER BY " + order + " LIMIT 1000";
 
         try (Connection conn = connect();
              PreparedStatement ps = conn.prepareStatement(sql)) {
@@ -69,14 +81,7 @@ public class SQLiteAccessor {
     }
 
     private String fileTime(long filetime) {
-        if (filetime == 0) return "";
-
-        long msSince1601 = filetime / 10000;
-        long epochDiff = 11644473600000L;
-        long ms = msSince1601 - epochDiff;
-
-        return new java.text.SimpleDateFormat("yyyy-MM-dd HH:mm:ss")
-                .format(new java.util.Date(ms));
+        return FileRecord.formatFileTime(filetime);
     }
 
     public FileRecord getByPath(String fullpath) {
@@ -6,6 +6,7 @@ public class FileRecord {
     public String creation;
     public String lastAccess;
     public String lastWrite;
+    public int id = -1;   // 原生索引中的节点编号，与实时查询的变化对应；来自 SQLite 时为 -1
 
     public FileRecord(String fullpath, long size,
                       String creation, String lastAccess, String lastWrite) {
@@ -15,4 +16,21 @@ public class FileRecord {
         this.lastAccess = lastAccess;
         this.lastWrite = lastWrite;
     }
+
+    // FILETIME（1601 年起的 100ns 计数）格式化为本地时间字符串
+    public static String formatFileTime(long filetime) {
+        if (filetime == 0) return "";
+
+        long msSince1601 = filetime / 10000;
+        long epochDiff = 11644473600000L;
+        return formatEpochMillis(msSince1601 - epochDiff);
+    }
+
+    // Unix 纪元毫秒格式化为本地时间字符串，0 表示未知
+    public static String formatEpochMillis(long ms) {
+        if (ms == 0) return "";
+
+        return new java.text.SimpleDateFormat("yyyy-MM-dd HH:mm:ss")
+                .format(new java.util.Date(ms));
+    }
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 package ui;
 
+import ctool.NativeResults;
+import ctool.NativeSearcher;
 import db.SQLiteAccessor;
 import model.FileRecord;
 import util.DeepSeekClient;
@@ -7,35 +9,54 @@ import util.DeepSeekClient;
 import javax.swing.*;
 import javax.swing.event.DocumentEvent;
 import javax.swing.event.DocumentListener;
-import javax.swing.table.DefaultTableModel;
+import javax.swing.table.AbstractTableModel;
 
 import java.awt.*;
 import java.awt.event.MouseAdapter;
 import java.awt.event.MouseEvent;
 
 import java.io.File;
+import java.util.ArrayList;
 import java.util.List;
+import java.util.concurrent.CancellationException;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Executors;
+import java.util.concurrent.atomic.AtomicLong;
 
 public class FileTable {
 
     private final SQLiteAccessor db;
+    private final NativeSearcher nativeSearcher = new NativeSearcher();
     private final JTable table;
-    private final DefaultTableModel model;
+    private final ResultModel model = new ResultModel();
+
+    // 搜索在后台线程执行；每次输入领取新序号，过期的结果直接丢弃
+    private final AtomicLong searchSeq = new AtomicLong();
+    private volatile String lastKeyword = "";
+    private volatile int sortBy = NativeSearcher.SORT_NONE;
+    private final ExecutorService searchExecutor = Executors.newCachedThreadPool(r -> {
+        Thread t = new Thread(r, "Search");
+        t.setDaemon(true);
+        return t;
+    });
+
+    // 当前显示结果对应的实时查询订阅（0 表示没有），只在 EDT 上读写；定时取增量修补可见行
+    private static final int CHANGE_POLL_MS = 500;
+    private int subscription;
+    private boolean polling;
+    private final Timer changeTimer = new Timer(CHANGE_POLL_MS, e -> pollChanges());
 
     public FileTable(SQLiteAccessor db) {
         this.db = db;
 
-        String[] cols = {"Path", "Size", "Created", "LastAccess", "LastWrite"};
-        model = new DefaultTableModel(cols, 0) {
-            public boolean isCellEditable(int r, int c) { return false; }
-        };
-
         table = new JTable(model);
         table.setFont(new Font("Microsoft YaHei", Font.PLAIN, 14));
         table.setRowHeight(22);
 
         installDoubleClick();
         installRightClickMenu();
+        installHeaderSort();
+        changeTimer.start();
     }
 
     public JTable getTable() {
@@ -46,8 +67,7 @@ public class FileTable {
     public DocumentListener createSearchListener(JTextField tf) {
         return new DocumentListener() {
             private void refresh() {
-                List<FileRecord> data = db.search(tf.getText());
-                FileTable.this.update(data);
+                runSearch(tf.getText());
             }
 
             public void insertUpdate(DocumentEvent e) { refresh(); }
@@ -56,14 +76,197 @@ public class FileTable {
         };
     }
 
+    private void runSearch(String keyword) {
+        lastKeyword = keyword;
+        int order = sortBy;
+        long seq = searchSeq.incrementAndGet();
+
+        searchExecutor.submit(() -> {
+            // 先订阅再搜索：两者之间的变化可能同时出现在结果与增量中，修补时按编号去重
+            int sub = nativeSearcher.subscribe(keyword);
+            List<FileRecord> data;
+            try {
+                data = search(keyword, order);
+            } catch (CancellationException e) {
+                nativeSearcher.unsubscribe(sub);
+                return; // 原生扫描已被更新的输入打断
+            }
+            if (!(data instanceof NativeResults)) {
+                nativeSearcher.unsubscribe(sub);
+                sub = 0;
+            }
+            int subscribed = sub;
+            SwingUtilities.invokeLater(() -> {
+                if (seq == searchSeq.get()) {
+                    update(data);
+                    replaceSubscription(subscribed);
+                } else {
+                    release(data);
+                    unsubscribeLater(subscribed);
+                }
+            });
+        });
+    }
+
+    private void replaceSubscription(int sub) {
+        unsubscribeLater(subscription);
+        subscription = sub;
+    }
+
+    private void unsubscribeLater(int sub) {
+        if (sub > 0) searchExecutor.submit(() -> nativeSearcher.unsubscribe(sub));
+    }
+
+    // --- 实时修补 ---
+    private void pollChanges() {
+        int sub = subscription;
+        if (sub == 0 || polling) return;
+        polling = true;
+        long seq = searchSeq.get();
+
+        searchExecutor.submit(() -> {
+            NativeSearcher.Changes changes = nativeSearcher.poll(sub);
+            SwingUtilities.invokeLater(() -> {
+                polling = false;
+                if (sub != subscription || seq != searchSeq.get()) return;
+                if (changes == null) {
+                    subscription = 0; // 订阅已随监控重启失效
+                    return;
+                }
+                if (changes.reset() || !model.applyChanges(changes.items(), sortBy == NativeSearcher.SORT_NONE)) {
+                    runSearch(lastKeyword);
+                }
+            });
+        });
+    }
+
+    // 优先使用原生内存索引，未就绪时回退到 SQLite
+    private List<FileRecord> search(String keyword, int order) {
+        List<FileRecord> data = nativeSearcher.search(keyword, order);
+        return data != null ? data : db.search(keyword, order);
+    }
+
     // --- 更新数据 ---
     public void update(List<FileRecord> list) {
-        model.setRowCount(0);
-        for (var r : list) {
-            model.addRow(new Object[]{
-                    r.fullpath, r.size, r.creation, r.lastAccess, r.lastWrite
-            });
+        model.setRows(list);
+    }
+
+    private static void release(List<FileRecord> list) {
+        if (list instanceof NativeResults results) results.close();
+    }
+
+    // ---------------------------------------------------------------
+    // 表格模型：直接引用搜索结果，JTable 只为可见行取值，原生结果因此只解码这些行
+    // ---------------------------------------------------------------
+    private static class ResultModel extends AbstractTableModel {
+        private static final String[] COLS = {"Path", "Size", "Created", "LastAccess", "LastWrite"};
+
+        private List<FileRecord> rows = List.of();
+
+        void setRows(List<FileRecord> list) {
+            List<FileRecord> old = rows;
+            rows = list;
+            fireTableDataChanged();
+            release(old);
+        }
+
+        void removeRow(int row) {
+            detach();
+            rows.remove(row);
+            fireTableRowsDeleted(row, row);
+        }
+
+        // 原生结果不支持增删，先转成普通列表（最多 1000 行）
+        private void detach() {
+            if (rows instanceof ArrayList) return;
+            List<FileRecord> old = rows;
+            rows = new ArrayList<>(old);
+            release(old);
+        }
+
+        private int indexOf(int id) {
+            if (id < 0) return -1;
+            for (int i = 0; i < rows.size(); i++) {
+                int rowId = rows instanceof NativeResults results ? results.idAt(i) : rows.get(i).id;
+                if (rowId == id) return i;
+            }
+            return -1;
         }
+
+        /**
+         * 按实时查询的增量修补：更新的行原地替换，移出的行删除，新增的行在不排序且未满时追加到末尾。
+         * 排序后的新增项位置未知、结果已满时新增项可能挤掉末尾的行，这两种情况返回 false，由调用方重新搜索。
+         * 排序列的值被更新时行不移动，下次搜索时恢复顺序
+         */
+        boolean applyChanges(List<NativeSearcher.Change> changes, boolean appendable) {
+            for (NativeSearcher.Change change : changes) {
+                if (change.kind() == NativeSearcher.CHANGE_ADDED && indexOf(change.record().id) < 0
+                        && (!appendable || rows.size() >= NativeSearcher.MAX_RESULTS)) {
+                    return false;
+                }
+            }
+
+            for (NativeSearcher.Change change : changes) {
+                FileRecord record = change.record();
+                int row = indexOf(record.id);
+                switch (change.kind()) {
+                    case NativeSearcher.CHANGE_REMOVED -> {
+                        if (row >= 0) removeRow(row);
+                    }
+                    case NativeSearcher.CHANGE_UPDATED, NativeSearcher.CHANGE_ADDED -> {
+                        if (row >= 0) {
+                            rows.set(row, record);
+                            fireTableRowsUpdated(row, row);
+                        } else if (change.kind() == NativeSearcher.CHANGE_ADDED) {
+                            detach();
+                            rows.add(record);
+                            fireTableRowsInserted(rows.size() - 1, rows.size() - 1);
+                        }
+                    }
+                    default -> { }
+                }
+            }
+            return true;
+        }
+
+        void setPath(int row, String path) {
+            rows.get(row).fullpath = path;
+            fireTableCellUpdated(row, 0);
+        }
+
+        public int getRowCount() { return rows.size(); }
+        public int getColumnCount() { return COLS.length; }
+        public String getColumnName(int c) { return COLS[c]; }
+
+        public Object getValueAt(int row, int col) {
+            FileRecord r = rows.get(row);
+            return switch (col) {
+                case 0 -> r.fullpath;
+                case 1 -> r.size;
+                case 2 -> r.creation;
+                case 3 -> r.lastAccess;
+                default -> r.lastWrite;
+            };
+        }
+    }
+
+    // ---------------------------------------------------------------
+    // 点击 Size / LastWrite 表头：按该列取前 1000 条，再次点击切换升降序
+    // ---------------------------------------------------------------
+    private void installHeaderSort() {
+        table.getTableHeader().addMouseListener(new MouseAdapter() {
+            public void mouseClicked(MouseEvent e) {
+                int col = table.columnAtPoint(e.getPoint());
+                sortBy = switch (col) {
+                    case 1 -> sortBy == NativeSearcher.SORT_SIZE_DESC
+                            ? NativeSearcher.SORT_SIZE_ASC : NativeSearcher.SORT_SIZE_DESC;
+                    case 4 -> sortBy == NativeSearcher.SORT_WRITE_DESC
+                            ? NativeSearcher.SORT_WRITE_ASC : NativeSearcher.SORT_WRITE_DESC;
+                    default -> NativeSearcher.SORT_NONE;
+                };
+                runSearch(lastKeyword);
+            }
+        });
     }
 
     // ---------------------------------------------------------------
@@ -199,7 +402,7 @@ public class FileTable {
         String newPath = newFile.getAbsolutePath();
         db.rename(old, newPath);
 
-        model.setValueAt(newPath, row, 0);
+        model.setPath(row, newPath);
     }
 
     private void openFile(String path) {
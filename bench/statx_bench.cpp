@@ -0,0 +1,70 @@
+// 全量扫描取文件信息的对比：io_uring 批量 statx、线程池逐个 statx，以及只取名称作为下限
+// 用法: statx_bench <目录> [线程数] [轮数]
+#ifdef __linux__
+#include "../include/tree_walker.h"
+#include "../include/statx_engine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+struct Result {
+    double best = 0;
+    double mean = 0;
+    size_t entries = 0;
+};
+
+Result run(const char* root, size_t threads, int rounds, bool metadata, bool preferPool) {
+    Result result;
+    std::vector<double> times;
+    for (int i = 0; i < rounds; ++i) {
+        TreeWalker walker(metadata, preferPool);
+        std::vector<WalkEntry> out;
+        auto start = std::chrono::steady_clock::now();
+        if (!walker.walk(root, out, threads)) std::exit(1);
+        times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        result.entries = out.size();
+    }
+    result.best = *std::min_element(times.begin(), times.end());
+    for (double t : times) result.mean += t / times.size();
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "用法: %s <目录> [线程数] [轮数]\n", argv[0]);
+        return 2;
+    }
+    const char* root = argv[1];
+    const size_t threads = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 0;
+    const int rounds = argc > 3 ? std::max(1, std::atoi(argv[3])) : 5;
+
+    const bool uring = StatxEngine::create()->kind() == StatxEngine::Kind::Uring;
+    if (!uring) std::printf("io_uring 不可用，uring 一行实际为线程池\n");
+
+    // 先走一遍预热目录缓存，之后各轮都是热缓存下的对比
+    run(root, threads, 1, false, true);
+
+    struct {
+        const char* label;
+        bool metadata;
+        bool preferPool;
+    } cases[] = {
+        {"names", false, true},
+        {"uring", true, false},
+        {"pool", true, true},
+    };
+    std::printf("%-8s %10s %10s %10s\n", "mode", "entries", "best(ms)", "mean(ms)");
+    for (auto& c : cases) {
+        Result r = run(root, threads, rounds, c.metadata, c.preferPool);
+        std::printf("%-8s %10zu %10.1f %10.1f\n", c.label, r.entries, r.best, r.mean);
+    }
+    return 0;
+}
+#endif
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 压缩位图（Roaring 布局）
+// 按高 16 位把 32 位整数分桶，每桶一个容器：元素不超过 4096 个时是有序 uint16 数组，
+// 否则是 65536 位的位集。位集之间的与/或按 SIMD 宽度整块计算。
+class RoaringBitmap {
+private:
+    static constexpr uint32_t ARRAY_LIMIT = 4096;
+    static constexpr uint32_t BITSET_WORDS = 1024;
+
+    struct Container {
+        uint16_t key = 0;
+        uint32_t cardinality = 0;
+        std::vector<uint16_t> array;   // 数组容器，升序
+        std::vector<uint64_t> bits;    // 位集容器，BITSET_WORDS 个字
+
+        bool isBitset() const { return !bits.empty(); }
+        bool contains(uint16_t low) const;
+        bool add(uint16_t low);
+        bool remove(uint16_t low);
+        void toBitset();
+        void toArray();
+    };
+
+    std::vector<Container> containers;   // 按 key 升序
+
+    Container* find(uint16_t key);
+    const Container* find(uint16_t key) const;
+
+    static Container andContainers(const Container& a, const Container& b);
+    static void orInto(Container& acc, const Container& other);
+
+public:
+    // 重复添加或删除不存在的元素时返回 false
+    bool add(uint32_t value);
+    bool remove(uint32_t value);
+    bool contains(uint32_t value) const;
+
+    bool empty() const { return containers.empty(); }
+    size_t cardinality() const;
+    // 占用的堆内存（字节），按容量计
+    size_t memoryUsage() const;
+    void clear() { containers.clear(); }
+
+    // 原地求交 / 求并
+    void andWith(const RoaringBitmap& other);
+    void orWith(const RoaringBitmap& other);
+
+    // 按升序追加到 out
+    void appendTo(std::vector<uint32_t>& out) const;
+
+    // 序列化格式：容器数，之后每个容器为 {key, 类型, 元素数, 数组或位集}
+    void serialize(std::string& out) const;
+    // 从 data 开始解析一个位图，成功时 used 为消耗的字节数
+    bool deserialize(const char* data, size_t size, size_t& used);
+};
@@ -0,0 +1,100 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// 合并后的一项变更
+struct NetChange {
+    enum Kind {
+        Upsert,   // 路径现在存在，需要取得文件信息后写入
+        Remove,
+        Rename,   // path -> newPath，不涉及文件信息
+    };
+    Kind kind;
+    std::string path;
+    std::string newPath;
+    uint64_t frn = 0;   // 未知时为 0
+};
+
+// 文件标识只在一个卷内唯一，配对移动时连同卷一起比较；任一为 0 表示未知
+struct FileKey {
+    uint64_t volume = 0;
+    uint64_t frn = 0;
+
+    bool known() const { return volume && frn; }
+    bool operator<(const FileKey& other) const {
+        return volume != other.volume ? volume < other.volume : frn < other.frn;
+    }
+};
+
+// 变更合并
+// 编辑器保存一次文件往往在几毫秒内产生多条添加、修改、重命名通知。每个路径（折叠大小写后）的通知先在
+// 时间轮中停留 DELAY，期间同一路径的新通知把到期时间向后推（但不超过首条通知后 MAX_DELAY），到期时
+// 只输出净效果：添加后又删除的路径什么也不输出，多次修改只输出一次 Upsert。取文件信息与数据库写入
+// 都推迟到输出之后。重命名立即输出，涉及的挂起项随之结算或改到新路径下；同一卷上一处删除、
+// 另一处添加且卷与文件标识都相同的，是跨目录或跨根目录的移动，同样按重命名输出
+class ChangeCoalescer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::chrono::milliseconds TICK{10};
+    static constexpr size_t SLOTS = 64;
+    static constexpr std::chrono::milliseconds DELAY{50};
+    static constexpr std::chrono::milliseconds MAX_DELAY{500};
+
+    enum Event {
+        Added,
+        Modified,
+        Removed,
+    };
+
+private:
+    struct Entry {
+        std::string path;
+        bool existedBefore = false;   // 窗口开始前路径已存在（已写入数据库）
+        bool existsNow = false;
+        Clock::time_point first;
+        uint64_t dueTick = 0;
+        FileKey file;
+        bool modified = false;            // 窗口内有过添加或修改
+        bool removedWithParent = false;   // 因上级目录被删除而标记为不存在
+    };
+
+    // 时间轮的一个槽中登记的项；项被推迟后旧的登记作废，到期时按 dueTick 识别
+    struct Filed {
+        std::string key;
+        uint64_t tick;
+    };
+
+    std::map<std::string, Entry> entries;   // 有序，目录下的项在键上连续
+    std::map<FileKey, std::string> movable;   // 文件 -> 最近一次删除或新建它的项的键
+    std::vector<std::vector<Filed>> slots;
+    Clock::time_point origin;
+    uint64_t current = 0;   // 已处理到的刻度
+
+    void schedule(const std::string& key, Entry& entry, Clock::time_point now);
+    static void settle(const Entry& entry, std::vector<NetChange>& out);
+    bool pairMove(Event event, const std::string& key, const std::string& path, const FileKey& file,
+                  Clock::time_point now, std::vector<NetChange>& out);
+
+public:
+    ChangeCoalescer();
+
+    // 与挂起的删除或添加配成移动时，重命名追加到 out
+    void push(Event event, const std::string& path, const FileKey& file, Clock::time_point now,
+              std::vector<NetChange>& out);
+    // 重命名以及在它之前必须写入的项追加到 out
+    void rename(const std::string& oldPath, const std::string& newPath, uint64_t frn, Clock::time_point now,
+                std::vector<NetChange>& out);
+
+    // 到期项的净效果按路径顺序追加到 out，上级目录在前
+    void expire(Clock::time_point now, std::vector<NetChange>& out);
+    // 不等到期，输出全部挂起项
+    void flush(std::vector<NetChange>& out);
+
+    bool empty() const { return entries.empty(); }
+    // 下一次需要调用 expire 的时间
+    Clock::time_point nextTick() const { return origin + TICK * (current + 1); }
+};
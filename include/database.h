@@ -1,10 +1,30 @@
 #pragma once
-#include "../include/volume.h"
+#include "../include/file_record.h"
 
 #include "sqlite3.h"
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+// 重复文件检测的 hash 缓存，大小或修改时间与当前不一致的条目视为失效
+struct FileHashEntry {
+    enum : uint8_t {
+        HEAD = 1,   // 首块
+        TAIL = 2,   // 尾块
+        FULL = 4,   // 全文
+    };
+
+    std::string fullpath;
+    ULONGLONG fileSize = 0;
+    ULONGLONG lastWriteTime = 0;
+    uint8_t known = 0;           // 以上哪些 hash 已算出
+    uint64_t headHash = 0;
+    uint64_t tailHash = 0;
+    uint64_t fullHash = 0;
+};
+
 // 数据库操作类
 class Database {
 private:
@@ -32,11 +52,25 @@ public:
 
     // 查询操作
     int getRecordCount();
+    bool forEachRecord(const std::function<void(const FileRecord&)>& fn);
 
     // 批量操作
-    bool addRecordsBatch(const std::vector<FileRecord>& records);
+    // replaceExisting 为 true 时，路径已存在的记录改写文件信息而不是跳过
+    bool addRecordsBatch(const std::vector<FileRecord>& records, bool replaceExisting = false);
     bool deleteRecordsBatch(const std::vector<std::string>& paths);
-    bool updatePathsOnDirectoryRename(const std::string& oldDir,const std::string& newDir);
+    // 重命名或移动一项，其下各项的路径随之更新，只改路径不重新取文件信息
+    // 旧路径没有记录时按 FRN 找（例如根目录的大小写与记录不同），FRN 为 0 表示未知
+    // 返回 1 表示已改名，0 表示数据库中没有这一项（需要按新路径添加），-1 表示出错
+    int renameRecord(DWORDLONG frn, const std::string& oldPath, const std::string& newPath);
+
+    // 文件信息延后补全：先写入只有路径与 FRN 的记录并标记为待补全，取得信息后再更新
+    bool addPendingRecords(const std::vector<FileRecord>& records);
+    bool updateMetadataBatch(const std::vector<FileRecord>& records);
+    bool loadPending(std::vector<FileRecord>& out);   // 上次退出时仍未补全的记录
+
+    // hash 缓存
+    bool loadFileHashes(std::unordered_map<std::string, FileHashEntry>& out);
+    bool saveFileHashes(const std::vector<FileHashEntry>& entries);
 
     // 获取数据库句柄（用于高级操作）
     sqlite3* getHandle() { return db; }
@@ -0,0 +1,45 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "database.h"
+#include "file_index.h"
+#include "search.h"
+
+// 内容相同的一组文件
+struct DuplicateGroup {
+    ULONGLONG fileSize = 0;
+    uint64_t hash = 0;                 // 内容的 hash64（不超过两块的小文件为首块 hash）
+    std::vector<std::string> paths;
+
+    // 只保留一份时可以释放的空间
+    ULONGLONG wastedBytes() const { return fileSize * (paths.size() - 1); }
+};
+
+// 重复文件检测
+// 先按大小分组，再依次比较首块、尾块和全文的 hash64，每一步只处理仍有同伴的文件，
+// 各步在多个线程上并行读取；全文以两块大缓冲交替重叠读取。算出的 hash 按
+// (路径, 大小, 修改时间) 缓存在数据库中，文件未变时再次检测不必重读。
+class DuplicateFinder {
+public:
+    static constexpr DWORD BLOCK_SIZE = 64 * 1024;   // 首块 / 尾块大小
+    static constexpr DWORD READ_CHUNK = 4 << 20;     // 全文读取时每次重叠 I/O 的大小
+
+private:
+    FileIndex& index;
+    Database* cache;   // 为空时不读写缓存
+    std::atomic<bool> cancelled{false};
+
+public:
+    DuplicateFinder(FileIndex& idx, Database* db) : index(idx), cache(db) {}
+
+    // query 为可选的过滤条件（语法同 Query::parse），小于 minSize 的文件不参与
+    // 结果按浪费的空间降序；查询串无法解析时 error 给出原因
+    SearchStatus find(const std::string& query, ULONGLONG minSize, std::vector<DuplicateGroup>& out,
+                      std::string* error = nullptr);
+
+    // 可从其他线程调用，正在读取的文件读完后退出
+    void cancel() { cancelled = true; }
+};
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 事件源给出的路径使用本平台的分隔符
+#ifdef _WIN32
+constexpr char PATH_SEP = '\\';
+#else
+constexpr char PATH_SEP = '/';
+#endif
+
+// 一条目录变更，与平台无关
+struct SourceEvent {
+    enum Action : uint8_t {
+        Added,
+        Removed,
+        Modified,
+        RenamedOld,   // 紧接着的 RenamedNew 是同一项的新路径
+        RenamedNew,
+    };
+    Action action = Added;
+    std::string path;
+    uint64_t fileId = 0;     // 卷内唯一的文件标识（NTFS 的 FRN，Linux 的 inode），未知时为 0
+    uint64_t volume = 0;     // fileId 所在的卷（Windows 的卷序列号，Linux 的设备号），未知时为 0
+    bool excluded = false;   // 只会出现在重命名上
+};
+
+// 一次读取得到的变更，只属于一个根目录
+struct SourceBatch {
+    uint32_t root = 0;
+    std::string rootPath;
+    bool overflow = false;   // 内核队列溢出，这段时间的变更已丢失
+    bool rootAdded = false;  // 根目录刚开始监控、没有日志可追赶此前的变化（Linux），需要重扫整个根目录
+    std::vector<SourceEvent> events;
+};
+
+// 监控的事件源
+// 平台相关的部分：打开根目录、读取内核通知、按排除规则过滤并转换为 SourceEvent。DirectoryMonitor 的
+// 合并、补全与写入只消费 SourceBatch，各平台共用
+class EventSource {
+public:
+    // 批次的序号从 0 起连续分配，每个序号恰好交付一次；可以乱序、从多个线程交付
+    using Deliver = std::function<void(uint64_t sequence, SourceBatch&&)>;
+
+    virtual ~EventSource() = default;
+
+    // 可在 run 之前或运行期间调用；与已有根目录重叠或无法监控时返回 false
+    virtual bool addRoot(const std::string& path) = 0;
+    // 不是当前的根目录时返回 false
+    virtual bool removeRoot(const std::string& path) = 0;
+
+    // 阻塞到 stop；返回时已分配序号的批次都已交付，之后不会再调用 deliver
+    virtual void run(const Deliver& deliver) = 0;
+    // 可从其他线程调用
+    virtual void stop() = 0;
+
+    // 本平台的事件源：Windows 为完成端口上的 ReadDirectoryChangesW，Linux 为 fanotify，
+    // 不支持的文件系统退回 inotify
+    static std::unique_ptr<EventSource> create();
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// 排除规则
+// 每行一条，空行与 # 开头的行忽略，均不区分大小写：
+//   node_modules     任意一级名称等于它的文件或目录
+//   *.tmp  ~$*       名称匹配通配符（* 任意个字符，? 一个字符）
+//   ext:obj;pdb      扩展名
+//   D:\build         路径前缀（含 \ / 或 : 的规则），只排除该目录本身及其下的项
+// 名称类规则合并编译为一个 DFA，路径前缀拆成逐级的前缀树。判断一个路径时从根起每级名称只走一遍
+// DFA 和前缀树；被排除的目录整棵子树都不再需要判断。
+class ExclusionRules {
+public:
+    // 逐级判断时在前缀树中的位置
+    struct Cursor {
+        uint32_t node = 0;
+    };
+    static constexpr uint32_t NO_PREFIX = UINT32_MAX;   // 已偏离所有路径前缀
+
+private:
+    struct PrefixNode {
+        std::unordered_map<std::string, uint32_t> children;   // 折叠后的名称
+        bool terminal = false;
+    };
+
+    // DFA：状态 0 为死状态，start 为初始状态
+    std::vector<uint32_t> transitions;   // state * classCount + byteClass
+    std::vector<bool> accepting;
+    uint8_t byteClass[256] = {};
+    uint32_t classCount = 1;
+    uint32_t start = 0;
+
+    std::vector<PrefixNode> prefixes{1};
+    size_t ruleCount = 0;
+
+    void compile(const std::vector<std::string>& globs);
+    bool matchesName(std::string_view name) const;
+    bool matchesName(std::wstring_view name) const;
+    bool stepPrefix(Cursor& cursor, const std::string& foldedName) const;
+
+public:
+    // 解析失败时 error 为出错的行
+    static bool parse(const std::string& text, ExclusionRules& out, std::string& error);
+    // 回收站与数据库的日志文件；数据库自身的写入不能再被监控到
+    static constexpr const char* DEFAULT_RULES = "$RECYCLE.BIN\nfile_index.db-journal\n";
+    static const ExclusionRules& defaults();
+
+    size_t size() const { return ruleCount; }
+    bool empty() const { return ruleCount == 0; }
+
+    // 走过一级名称，返回这一级是否被排除；cursor 初始为默认值，被排除后不应再继续
+    bool step(Cursor& cursor, std::string_view name) const;
+    bool step(Cursor& cursor, std::wstring_view name) const;
+
+    // 逐级走过 path 中的各级名称（\ 或 / 分隔），任何一级被排除即返回 true
+    bool walk(Cursor& cursor, std::string_view path) const;
+    bool excluded(std::string_view fullPath) const {
+        Cursor cursor;
+        return walk(cursor, fullPath);
+    }
+};
+
+// 监控、重扫与卷枚举共用的当前规则；替换后新开始的判断即使用新规则，已在索引中的项不受影响
+std::shared_ptr<const ExclusionRules> exclusionRules();
+void setExclusionRules(std::shared_ptr<const ExclusionRules> rules);
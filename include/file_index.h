@@ -0,0 +1,175 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "bitmap.h"
+#include "file_type.h"
+#include "file_record.h"
+
+using FileId = uint32_t;
+constexpr FileId INVALID_FILE_ID = 0xFFFFFFFFu;
+
+// 内存文件索引
+// 按目录树组织（与 Volume::frnMap 的父子关系一致），每个节点只保存自己的名称，
+// 名称打包存放在一块连续内存中，供原生搜索引擎顺序扫描。下标即 FileId。
+class FileIndex {
+    friend class IndexSnapshot;
+
+private:
+    enum : uint8_t {
+        FLAG_LISTED = 1,   // 对应数据库中的一条记录（隐式创建的上级目录没有此标记）
+    };
+
+    mutable std::shared_mutex mtx;
+
+    std::vector<FileId> parents;
+    std::vector<uint32_t> nameOffsets;
+    std::vector<uint16_t> nameLens;
+    std::vector<uint8_t> flags;
+    std::vector<ULONGLONG> sizes;
+    std::vector<FILETIME> creationTimes;
+    std::vector<FILETIME> lastAccessTimes;
+    std::vector<FILETIME> lastWriteTimes;
+
+    std::string names;         // 原始 UTF-8 名称
+    std::string foldedNames;   // ASCII 小写化后的名称，与 names 同偏移同长度
+
+    // 含汉字名称的拼音影子键（全拼与首字母，见 appendPinyinKeys），其他节点长度为 0
+    std::vector<uint32_t> pinyinOffsets;
+    std::vector<uint16_t> pinyinLens;
+    std::string pinyinKeys;
+
+    // (父目录 id, 小写名称) -> 子节点 id，用于按路径定位节点
+    // 从快照载入时不保存它，lookupReady 为 false，直到 buildLookup 或第一次写操作重建
+    std::unordered_map<std::string, FileId> children;
+    bool lookupReady = true;
+
+    // 扩展名 / 类型 -> 可见节点的位图，随写操作即时维护，总是与当前内容一致
+    std::unordered_map<std::string, RoaringBitmap> extensionBitmaps;
+    RoaringBitmap typeBitmaps[FILE_TYPE_COUNT];
+
+    // 目录树的欧拉序区间：子孙节点的 enter 都落在祖先的 (enter, exit] 内，目录范围条件因此
+    // 只是对 enter 这一列的区间比较。编号时区间之间留有空隙，新节点从父区间末尾的空闲部分分配；
+    // 空隙用尽或有子节点的目录被移动时整体作废，下一次范围查询前由 buildTour 重新编号
+    struct EulerTour {
+        std::vector<uint64_t> enter;
+        std::vector<uint64_t> exit;
+        std::vector<uint64_t> next;          // 区间内下一个可分配给新子节点的位置
+        std::vector<uint32_t> childCounts;
+        uint64_t unit = 0;                   // 编号时每个节点预留的空隙
+        uint64_t rootNext = 0;               // 卷根之间的下一个空闲位置
+    };
+    EulerTour tour;
+    bool tourReady = false;
+    uint64_t tourEpoch = 0;
+
+    // 各节点子树（含自身）中可见节点的大小合计与个数，供磁盘占用统计使用
+    // 第一次使用前由 buildTotals 自底向上汇总，之后写操作沿祖先链增量修正
+    struct SubtreeTotals {
+        std::vector<ULONGLONG> sizes;
+        std::vector<uint32_t> counts;
+    };
+    SubtreeTotals totals;
+    bool totalsReady = false;
+
+    std::atomic<uint64_t> version{0};
+
+    // 名称、大小、时间或可见性发生变化的节点，供二级索引做增量补充
+    // 超过上限时整体丢弃，落后于 changeLogBase 的二级索引需要重建
+    std::vector<FileId> changeLog;
+    uint64_t changeLogBase = 0;
+
+    static std::string childKey(FileId parent, std::string_view foldedName);
+    FileId findChild(FileId parent, std::string_view name) const;
+    FileId appendNode(FileId parent, std::string_view name);
+    void setName(FileId id, std::string_view name);
+    std::unordered_map<std::string, FileId> makeChildren() const;
+    void ensureLookup();
+    FileId resolve(const std::string& path, bool create);
+    void logChange(FileId id);
+    // 节点变为可见 / 不可见或改名前后调用，维护扩展名与类型位图
+    void track(FileId id);
+    void untrack(FileId id);
+    void rebuildTypeBitmaps();
+    void rebuildBitmaps();
+    void makeTour(EulerTour& out) const;
+    bool placeInTour(FileId id);
+    void dropTour();
+    void makeTotals(SubtreeTotals& out) const;
+    // 节点自身的大小或可见性变化后，把差值加到它和全部祖先上
+    void adjustTotals(FileId id, int64_t sizeDelta, int32_t countDelta);
+    void dropTotals();
+
+public:
+    // 写操作（内部加独占锁）
+    FileId upsert(const FileRecord& record);
+    // 只更新已可见节点的大小与时间，节点不存在或不可见时返回 false
+    bool update(const FileRecord& record);
+    bool remove(const std::string& path);
+    bool rename(const std::string& oldPath, const std::string& newPath);
+    void clear();
+    // 在共享锁下重建路径查找表，只在最后替换时短暂持有独占锁，期间搜索不受影响
+    void buildLookup();
+    // 同样的方式重新做欧拉序编号；编号仍有效时立即返回
+    void buildTour();
+    // 同样的方式汇总子树大小；已汇总时立即返回
+    void buildTotals();
+
+    // 每次写操作后递增，搜索引擎据此判断缓存的候选集是否仍然有效
+    uint64_t getVersion() const { return version.load(std::memory_order_acquire); }
+
+    // 读操作：以下接口要求调用方已持有 lockShared() 返回的锁
+    std::shared_lock<std::shared_mutex> lockShared() const { return std::shared_lock<std::shared_mutex>(mtx); }
+    size_t nodeCount() const { return parents.size(); }
+    bool isListed(FileId id) const { return flags[id] & FLAG_LISTED; }
+    std::string_view foldedName(FileId id) const {
+        return std::string_view(foldedNames.data() + nameOffsets[id], nameLens[id]);
+    }
+    std::string_view foldedExtension(FileId id) const;
+    // 按路径查找节点，不存在或查找表尚未建立时返回 INVALID_FILE_ID
+    FileId find(const std::string& path) const;
+    // 目录 folder 下全部子孙节点的欧拉序范围；编号或查找表未就绪时返回 false
+    // 目录不存在时返回空范围（low > high）
+    bool scopeOf(const std::string& folder, ULONGLONG& low, ULONGLONG& high) const;
+    // 仅在编号有效时可用；每次重新编号 tourEpoch 加一
+    uint64_t tourLabel(FileId id) const { return tour.enter[id]; }
+    uint64_t getTourEpoch() const { return tourEpoch; }
+    FileId parentOf(FileId id) const { return parents[id]; }
+    // 仅在 hasTotals() 时可用
+    bool hasTotals() const { return totalsReady; }
+    ULONGLONG subtreeSize(FileId id) const { return totals.sizes[id]; }
+    uint32_t subtreeCount(FileId id) const { return totals.counts[id]; }
+    // 没有可见节点使用该扩展名时返回空
+    const RoaringBitmap* extensionBitmap(const std::string& foldedExt) const;
+    const RoaringBitmap& typeBitmap(FileType type) const { return typeBitmaps[static_cast<size_t>(type)]; }
+    // 拼音影子键，各键之间以 '\0' 分隔；名称不含汉字时为空
+    std::string_view pinyin(FileId id) const {
+        return std::string_view(pinyinKeys.data() + pinyinOffsets[id], pinyinLens[id]);
+    }
+    ULONGLONG fileSize(FileId id) const { return sizes[id]; }
+    ULONGLONG creationTimeValue(FileId id) const { return toValue(creationTimes[id]); }
+    ULONGLONG lastWriteTimeValue(FileId id) const { return toValue(lastWriteTimes[id]); }
+
+    // 当前变更日志的末尾位置，二级索引构建时记下它
+    uint64_t changeMark() const { return changeLogBase + changeLog.size(); }
+    bool changeLogCovers(uint64_t mark) const { return mark >= changeLogBase; }
+    // 取出 mark 之后变化过的节点（升序去重）；日志已被截断时返回 false
+    bool changedSince(uint64_t mark, std::vector<FileId>& out) const;
+    std::string fullPath(FileId id) const;
+    FileRecord record(FileId id) const;
+    // 各列、名称、查找表、位图与区间编号占用的堆内存（字节），按容量估算
+    size_t memoryUsage() const;
+
+    // 搜索关键字与名称统一使用的大小写折叠（仅 ASCII，保持 UTF-8 多字节序列不变）
+    static std::string fold(std::string_view text);
+
+    static ULONGLONG toValue(const FILETIME& ft) {
+        return (static_cast<ULONGLONG>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+    }
+};
@@ -0,0 +1,29 @@
+#pragma once
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cstdint>
+
+// 其他平台沿用 Win32 的整数宽度与 FILETIME 布局，记录、索引、快照与数据库的格式各平台一致
+typedef uint32_t DWORD;
+typedef uint64_t ULONGLONG;
+typedef uint64_t DWORDLONG;
+
+struct FILETIME {
+    DWORD dwLowDateTime;
+    DWORD dwHighDateTime;
+};
+#endif
+#include <string>
+
+struct FileRecord{
+    std::string fullpath;
+    
+    ULONGLONG fileSize = 0;          // 文件大小
+
+    FILETIME creationTime{};         // 创建时间
+    FILETIME lastAccessTime{};       // 最近访问时间
+    FILETIME lastWriteTime{};        // 最近写入时间（修改时间）
+
+    DWORDLONG frn = 0;               // 卷内文件标识（NTFS 的 FRN，Linux 的 inode），未知时为 0
+};
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <string_view>
+
+// 按扩展名划分的文件类型，对应查询中的 type:video;image
+enum class FileType {
+    Audio,
+    Video,
+    Image,
+    Document,
+    Archive,
+    Executable,
+};
+constexpr size_t FILE_TYPE_COUNT = 6;
+
+// 小写扩展名（不含点）所属的类型；不属于任何类型时返回 false
+bool classifyExtension(std::string_view foldedExt, FileType& out);
+
+// 类型名（audio、video、image/pic、doc、zip/archive、exe）
+bool parseFileType(std::string_view name, FileType& out);
@@ -0,0 +1,57 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "file_record.h"
+
+// 监控到的新增与修改项的文件信息补全
+// 写入线程先写入只有路径的记录（数据库中标记为待补全），搜索立即可见；这里在后台按批取得大小与时间
+// （Linux 上同一目录的项经 StatxEngine 一次取完），
+// 每批之后暂停 PAUSE，限制每秒的次数。排队期间被删除的路径直接丢弃，被占用的隔 RETRY_DELAY 重试，
+// 被改名的随之改到新路径。取得的信息交给 deliver，由监控的写入线程批量写入
+class MetadataFiller {
+public:
+    using Deliver = std::function<void(std::vector<FileRecord>&&)>;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t BATCH = 128;
+    static constexpr std::chrono::milliseconds PAUSE{50};
+    static constexpr std::chrono::milliseconds RETRY_DELAY{1000};
+    static constexpr int MAX_ATTEMPTS = 5;
+
+    struct Item {
+        int attempts = 0;
+        Clock::time_point notBefore;
+    };
+
+    Deliver deliver;
+
+    std::mutex mtx;
+    std::condition_variable wake;
+    std::map<std::string, Item> queued;   // 有序，目录下的项在键上连续
+    std::set<std::string> inFlight;       // 正在取信息的一批
+    bool stopping = false;
+    std::thread worker;
+
+    void run();
+
+public:
+    explicit MetadataFiller(Deliver fn);
+    ~MetadataFiller();
+
+    // 以下可从任意线程调用
+    void enqueue(const std::string& path);
+    // 排队中与正在取信息的项（及其下的项）改到新路径
+    void rename(const std::string& oldPath, const std::string& newPath);
+    // 放弃排队中的项，返回后不会再调用 deliver
+    void stop();
+};
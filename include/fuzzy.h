@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// 近似匹配模式：Myers 位并行算法，求模式与名称中任一子串之间的最小编辑距离
+// 以 UTF-8 码点为单位比较，模式最多 64 个码点
+class FuzzyPattern {
+private:
+    int length = 0;
+    int maxDistance = 0;
+    uint64_t asciiMasks[128] = {};
+    std::vector<std::pair<uint32_t, uint64_t>> wideMasks;   // 非 ASCII 码点 -> 位掩码
+
+    uint64_t maskOf(uint32_t codePoint) const;
+
+public:
+    static constexpr int MAX_LENGTH = 64;
+
+    // pattern 需已小写化；maxDistance 为负时按模式长度自动选择
+    // 模式为空或超长时返回 false
+    bool compile(std::string_view pattern, int maxDistance);
+
+    int getLength() const { return length; }
+    int getMaxDistance() const { return maxDistance; }
+
+    // 返回最小编辑距离；超过 maxDistance 时返回 maxDistance + 1
+    int distance(std::string_view text) const;
+};
+
+// 解码一个 UTF-8 码点并前移 pos，非法字节按单字节处理
+uint32_t nextCodePoint(std::string_view text, size_t& pos);
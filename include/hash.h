@@ -0,0 +1,26 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// 64 位非加密哈希（XXH64 算法），用于快照校验和内容比对
+// 可以分多次 update，结果与一次性计算相同
+class Hash64 {
+private:
+    uint64_t lanes[4];
+    uint64_t seed;
+    uint64_t total = 0;
+    unsigned char tail[32];
+    size_t tailSize = 0;
+
+public:
+    explicit Hash64(uint64_t seed = 0);
+
+    void update(const void* data, size_t len);
+    uint64_t digest() const;
+};
+
+inline uint64_t hash64(const void* data, size_t len, uint64_t seed = 0) {
+    Hash64 h(seed);
+    h.update(data, len);
+    return h.digest();
+}
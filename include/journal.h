@@ -0,0 +1,15 @@
+#pragma once
+#include <string>
+
+#include "snapshot.h"
+
+class Database;
+class FileIndex;
+
+// 取得 root 所在卷当前的 USN 日志位置，写快照前调用
+bool currentJournalPosition(const std::string& root, SnapshotInfo& info);
+
+// 按 USN 日志把 info 之后发生的变更补进索引与数据库（只处理 root 之下的路径）
+// 日志已被截断、重建或卷无法打开时返回 false，调用方应改为全量载入
+// Linux 上没有日志可读，总是返回 true，变化由监控开始时的根目录重扫补上
+bool catchUpJournal(const SnapshotInfo& info, const std::string& root, FileIndex& index, Database* db);
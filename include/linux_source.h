@@ -0,0 +1,106 @@
+#pragma once
+#ifdef __linux__
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "event_source.h"
+#include "exclude.h"
+
+// Linux 的事件源
+// 根目录所在的文件系统支持时用 fanotify 标记整个文件系统：事件带有父目录的文件句柄与名称
+// （FAN_REPORT_DFID_NAME），由 open_by_handle_at 还原为路径，新建的子目录无需另外登记，重命名由一条
+// FAN_RENAME 同时给出新旧路径。fanotify 需要 CAP_SYS_ADMIN 与 5.17 以上的内核；不满足，或文件系统
+// 不提供文件句柄时该根目录退回 inotify，逐个目录登记监视，新建与移入的目录随即补上。两种根目录由同一个
+// 线程 poll，解码后按 SourceBatch 交付。现存的项以 inode 与设备号作为文件标识，删除的项标识未知；
+// 移动由内核的重命名事件配对（inotify 按 cookie），不依赖标识
+class LinuxEventSource : public EventSource {
+private:
+    static constexpr size_t BUFFER_SIZE = 64 * 1024;
+    static constexpr int MOVE_PAIR_MS = 10;   // 读取边界上的 IN_MOVED_FROM 等待配对的时间
+
+    struct Root {
+        uint32_t id = 0;
+        std::string path;      // 不带末尾的 /
+        bool fanotify = false;
+        int dirFd = -1;        // fanotify 的根目录，供 open_by_handle_at 使用
+        uint64_t fsid = 0;
+    };
+
+    // inotify 监视的一个目录
+    struct WatchedDir {
+        std::string path;
+        uint32_t root = 0;
+    };
+
+    // 一次读取中某个根目录的变更
+    struct Pending {
+        SourceBatch batch;
+        ExclusionRules::Cursor rootCursor;
+    };
+
+    // 读取末尾没有配对的 IN_MOVED_FROM
+    struct HalfMove {
+        std::string path;
+        uint32_t cookie = 0;
+        bool dir = false;
+    };
+
+    int fanFd = -1;
+    int inoFd = -1;
+    int wakeFd = -1;
+    std::atomic<bool> isRunning{false};
+    std::atomic<bool> stopRequested{false};
+
+    // addRoot / removeRoot 只登记请求并唤醒事件线程，根目录表与监视表只由事件线程访问
+    std::mutex rootsMtx;
+    std::vector<Root> addedRoots;
+    std::vector<std::string> removedRoots;
+    std::vector<std::string> rootPaths;   // 当前的根目录，供重叠检查与查找
+    uint32_t nextRootId = 1;
+
+    std::vector<Root> roots;
+    std::unordered_map<int, WatchedDir> dirs;   // inotify 监视描述符 -> 目录
+    HalfMove halfMove;
+    bool haveHalfMove = false;
+
+    const Deliver* deliver = nullptr;
+    uint64_t nextSequence = 0;
+    std::shared_ptr<const ExclusionRules> rules;   // 本次读取使用的规则
+    std::vector<Pending> pending;
+    std::vector<uint64_t> buffer;                  // 按 8 字节对齐
+
+    void wake();
+    void takeRootRequests();
+    void releaseRoot(const Root& root);
+    const Root* rootOf(const std::string& path) const;
+    Pending& batchFor(const Root& root);
+    bool excluded(const Root& root, const std::string& path);
+    void emit(const Root& root, SourceEvent::Action action, const std::string& path);
+    void renamed(const std::string& oldPath, const std::string& newPath, bool dir);
+    void overflow(bool fanotify);
+    void flush();
+
+    std::string resolve(const void* fid, std::unordered_map<std::string, std::string>& cache) const;
+    void readFanotify();
+
+    void watchTree(const Root& root, const std::string& path, bool reportAdded);
+    void unwatchTree(const std::string& path);
+    void moveTree(const std::string& oldPath, const std::string& newPath, const Root& to);
+    void readInotify();
+    void settleHalfMove();
+
+public:
+    LinuxEventSource();
+    ~LinuxEventSource() override;
+
+    bool addRoot(const std::string& path) override;
+    bool removeRoot(const std::string& path) override;
+    void run(const Deliver& deliver) override;
+    void stop() override;
+};
+#endif
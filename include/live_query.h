@@ -0,0 +1,101 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "bitmap.h"
+#include "file_index.h"
+#include "query.h"
+
+class QueryIndexes;
+
+// 订阅结果中的一项变化
+struct LiveChange {
+    enum Kind : uint8_t {
+        Added = 1,     // 新近匹配
+        Removed = 2,   // 不再匹配或已删除
+        Updated = 3,   // 仍然匹配，名称、路径、大小或时间变了
+    };
+    FileId id;
+    Kind kind;
+};
+
+// 实时查询
+// 订阅时求出查询当前的结果集（位图），之后后台线程每隔 INTERVAL 看一次索引版本，有写入时只对变更日志
+// 中的节点重新求值，与结果集比较得出新增、移出与更新。目录改名时日志只记目录本身，结果集中位于改名
+// 目录之下的项按更新报告；条件涉及完整路径（path:、in:）的订阅其结果可能整片变化，改为整体重新求值后
+// 与结果集求差。变更日志已被截断时无法知道哪些项更新过，报告 reset，由调用方重新查询。
+// 有回调的订阅在后台线程上直接收到每一轮的变化；没有回调的按节点合并，等 poll 取走，
+// 积累超过 MAX_PENDING 项时丢弃并报告 reset
+class LiveQueries {
+public:
+    using Deliver = std::function<void(uint32_t subscription, std::vector<LiveChange>&& changes, bool reset)>;
+
+    static constexpr std::chrono::milliseconds INTERVAL{200};
+    static constexpr size_t MAX_PENDING = 65536;
+
+private:
+    struct Subscription {
+        Query query;
+        bool pathDependent = false;
+        RoaringBitmap members;
+        uint64_t mark = 0;                 // 已处理到的变更日志位置
+        Deliver deliver;                   // 为空时等待 poll
+        std::atomic<bool> active{true};
+
+        // 以下由 mtx 保护
+        std::unordered_map<FileId, LiveChange::Kind> pending;
+        bool reset = false;
+    };
+
+    // 共享所有权：实例销毁与本对象的析构谁先发生都不会让后台线程访问已释放的索引
+    std::shared_ptr<FileIndex> indexOwner;
+    std::shared_ptr<QueryIndexes> indexesOwner;
+    FileIndex& index;
+    QueryIndexes& indexes;
+
+    std::mutex mtx;
+    std::condition_variable wake;
+    std::map<uint32_t, std::shared_ptr<Subscription>> subscriptions;
+    uint32_t nextId = 1;
+    bool stopping = false;
+
+    std::mutex deliverMtx;   // 回调期间持有，取消订阅据此等待进行中的回调结束
+    std::thread worker;
+
+    // 以下只由后台线程使用
+    uint64_t seenVersion = 0;
+    std::vector<uint8_t> ancestry;
+
+    void run();
+    // 要求持有 FileIndex 的共享锁，out 为升序
+    void evaluate(const Query& query, std::vector<FileId>& out);
+    void refresh(Subscription& sub, std::vector<LiveChange>& out, bool& reset);
+    void publish(uint32_t id, Subscription& sub, std::vector<LiveChange>&& changes, bool reset);
+    // members 中自身或某个上级目录在 changed 里的项
+    void underChanged(const std::vector<FileId>& changed, const std::vector<FileId>& members,
+                      std::vector<FileId>& out);
+
+public:
+    LiveQueries(std::shared_ptr<FileIndex> fileIndex, std::shared_ptr<QueryIndexes> queryIndexes);
+    ~LiveQueries();
+
+    // 返回订阅号，之后的变化相对于此刻的结果集；查询无法解析时返回 0 并给出原因
+    uint32_t subscribe(const std::string& text, Deliver deliver, std::string* error = nullptr);
+    // 返回后不会再有新的回调开始；在回调中调用时不等待
+    bool unsubscribe(uint32_t id);
+    // 依次把积累的变化交给 take，take 返回 false 时停止，已交出的从积累中去掉；订阅不存在时返回 false。
+    // 调用方需要在 take 中读取索引时，应在调用之前取得共享锁
+    bool poll(uint32_t id, const std::function<bool(const LiveChange&)>& take, bool& reset);
+
+    void stop();
+};
@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+// 异步日志
+// 每个线程写入自己的无锁环形缓冲区（单生产者单消费者），由后台线程定期收集、按时间排序后一次写出并刷新，
+// 调用线程不等待控制台。缓冲区满时丢弃并计数。每个调用点每秒最多输出 LogSite::LIMIT 条，多出的
+// 在窗口结束时汇总为一条。LOG_DEBUG 只在定义了 LOG_ENABLE_DEBUG 时编译进来。
+enum class LogLevel : uint8_t {
+    Debug,
+    Info,
+    Warn,
+    Error,
+};
+
+// 一个日志调用点，首次执行时登记，供后台线程按秒重置计数并汇总被限流的条数
+class LogSite {
+public:
+    static constexpr uint32_t LIMIT = 20;
+
+    const LogLevel level;
+    const char* const file;
+    const int line;
+
+    std::atomic<uint32_t> count{0};        // 本窗口已输出
+    std::atomic<uint32_t> suppressed{0};   // 本窗口被限流
+    LogSite* next = nullptr;
+
+    LogSite(LogLevel lvl, const char* f, int l);
+
+    bool admit() {
+        if (count.fetch_add(1, std::memory_order_relaxed) < LIMIT) return true;
+        suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+};
+
+// 低于该级别的日志直接丢弃，默认 Info
+void logSetLevel(LogLevel level);
+bool logEnabled(LogLevel level);
+
+void logWrite(LogLevel level, std::string&& message);
+
+// 阻塞到调用之前写入的日志全部输出，退出前或需要与控制台其他输出对齐时调用
+void logFlush();
+
+#define LOG_AT(lvl, ...)                                                   \
+    do {                                                                   \
+        if (!logEnabled(lvl)) break;                                       \
+        static LogSite logSite_(lvl, __FILE__, __LINE__);                  \
+        if (!logSite_.admit()) break;                                      \
+        std::ostringstream logStream_;                                     \
+        logStream_ << __VA_ARGS__;                                         \
+        logWrite(lvl, logStream_.str());                                   \
+    } while (0)
+
+#ifdef LOG_ENABLE_DEBUG
+#define LOG_DEBUG(...) LOG_AT(LogLevel::Debug, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do {} while (0)
+#endif
+#define LOG_INFO(...) LOG_AT(LogLevel::Info, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LogLevel::Warn, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LogLevel::Error, __VA_ARGS__)
@@ -0,0 +1,59 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// 运行指标
+// 计数与延迟直方图按线程分片：线程第一次记录时领取一个分片，之后只有它写这个分片，用 relaxed 的
+// 读改写，不加锁也不与其他线程争用缓存行；读取时把全部分片相加。线程退出后分片交还给后来的线程，
+// 已有的计数保留。直方图按 HDR 的方式分桶：每个 2 的幂区间再等分 16 份，相对误差不超过 1/16。
+// 指标是进程级的，多个索引实例的计数合在一起
+enum class Metric : uint8_t {
+    EventsReceived,    // 事件源交给写入线程的通知
+    EventsCoalesced,   // 合并时被同一路径的其他通知吸收、没有单独写入的通知
+    EventsDropped,     // 缓冲区溢出的次数；丢失的通知数未知，由重扫补齐
+    ChangesWritten,    // 合并后写入数据库与索引的净变更
+    COUNT,
+};
+
+enum class Gauge : uint8_t {
+    QueueDepth,   // 已读取、尚未被写入线程取走的批次
+    COUNT,
+};
+
+enum class Latency : uint8_t {
+    DbCommit,   // 一次批量写入事务，从 BEGIN 到 COMMIT
+    Stat,       // 取一个文件的大小与时间
+    Search,     // 一次搜索，不含结果的格式化
+    COUNT,
+};
+
+void metricsAdd(Metric metric, uint64_t n = 1);
+// 增减当前值，同时记下出现过的最大值
+void metricsAdjust(Gauge gauge, int64_t delta);
+void metricsRecord(Latency latency, std::chrono::steady_clock::duration elapsed);
+
+// 读取时才计算的量（例如索引占用的内存），同名的再次设置时替换
+void metricsSetProbe(const std::string& name, std::function<uint64_t()> probe);
+
+// 全部指标的 JSON 文本，延迟以微秒为单位
+std::string metricsJson();
+
+// 每隔 interval 把 metricsJson 写入 path（先写临时文件再替换），再次调用时替换之前的设置；
+// interval 为 0 时停止
+void metricsDump(const std::string& path, std::chrono::seconds interval);
+
+// 在作用域结束时记录经过的时间
+class LatencyTimer {
+private:
+    Latency latency;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit LatencyTimer(Latency which) : latency(which), start(std::chrono::steady_clock::now()) {}
+    ~LatencyTimer() { metricsRecord(latency, std::chrono::steady_clock::now() - start); }
+
+    LatencyTimer(const LatencyTimer&) = delete;
+    LatencyTimer& operator=(const LatencyTimer&) = delete;
+};
@@ -1,30 +1,78 @@
 #pragma once
-#include <windows.h>
 #include <string>
 #include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "coalescer.h"
+#include "event_source.h"
+#include "filler.h"
+#include "rescan.h"
+#include "file_record.h"
 
 // 前向声明
 class Database;
+class FileIndex;
 
 // 文件监控类
+// 可同时监控多个根目录，运行期间随时增减。变更由平台的 EventSource 读取并解码（Windows 为完成端口上的
+// ReadDirectoryChangesW，Linux 为 fanotify 或 inotify），各批按读取完成的顺序进入同一个写入队列，
+// 写入线程先按路径合并短时间内的重复变更，到期后批量写入数据库与内存索引。新增与修改的项先只写路径，
+// 文件信息由 MetadataFiller 在后台补全。事件源给出文件标识（FRN）时，重命名与移动据此配对，
+// 只改路径不取文件信息
 class DirectoryMonitor {
 private:
-    HANDLE dirHandle;
-    std::string monitorPath;
+    // 写入线程为每个根目录保存的状态
+    struct RootState {
+        std::string lastOldPath;               // 重命名的两条通知可能落在相邻的两次读取中
+        FileKey lastOldFile;
+        bool lastOldExcluded = false;
+        std::vector<std::string> recentDirs;   // 最近有变更的目录，溢出时优先重扫
+    };
+    static constexpr size_t RECENT_DIRS = 16;
+
+    std::unique_ptr<EventSource> source;
     std::atomic<bool> isRunning{false};
     Database* db;
+    FileIndex* index;   // 可选，变更同时写入内存索引
+
+    std::mutex resultMtx;
+    std::condition_variable resultReady;
+    std::map<uint64_t, SourceBatch> decoded;   // 按序号交给写入线程
+    std::vector<RescanResult> rescanned;       // 重扫得到的差异，也由写入线程写入
+    std::vector<FileRecord> filled;            // 补全的文件信息，同上
+    bool sourceDone = false;
+
+    std::unique_ptr<SubtreeRescanner> rescanner;
+    std::unique_ptr<MetadataFiller> filler;
+
+    void writeLoop();
+    void feed(const SourceEvent& event, RootState& state, ChangeCoalescer& coalescer, std::vector<NetChange>& out);
+    void apply(const std::vector<NetChange>& changes);
+    void applyRescan(const RescanResult& result);
+    void applyFill(const std::vector<FileRecord>& records);
+    void scheduleRescan(const SourceBatch& batch, RootState& state);
+    void updateRecentDirs(const SourceBatch& batch, RootState& state);
 
 public:
-    DirectoryMonitor(const std::string& path, Database* database);
+    DirectoryMonitor(Database* database, FileIndex* fileIndex = nullptr);
     ~DirectoryMonitor();
 
+    // 添加根目录，可在 start 之前或运行期间调用；与已有根目录重叠或无法打开时返回 false
+    bool addRoot(const std::string& path);
+    // 停止监控该根目录，已收到的变更仍会写入；不是当前的根目录时返回 false
+    bool removeRoot(const std::string& path);
+
     // 开始监控（阻塞调用）
     void start();
     
-    // 停止监控
-    void stop() { isRunning = false; }
+    // 停止监控，可从其他线程调用
+    void stop();
     
     // 检查是否正在运行
     bool running() const { return isRunning; }
 };
-
@@ -1,22 +1,183 @@
 #pragma once
-#include <windows.h>
+#include <stdint.h>
 
-#ifdef MONITOR_API_EXPORTS
-    #define MONITOR_API __declspec(dllexport)
+#ifdef _WIN32
+    #include <windows.h>
+    #ifdef MONITOR_API_EXPORTS
+        #define MONITOR_API __declspec(dllexport)
+    #else
+        #define MONITOR_API __declspec(dllimport)
+    #endif
 #else
-    #define MONITOR_API __declspec(dllimport)
+    // Linux 上编译为共享库，调用约定只有一种
+    #define MONITOR_API __attribute__((visibility("default")))
+    #define __stdcall
 #endif
 
 extern "C" {
 
+// 索引实例的句柄。每个实例有自己的数据库、内存索引与监控线程，实例之间互不影响，
+// 一个进程可以同时持有多个（例如每个卷或每个用户一个），各函数可在任意线程对不同或相同的实例调用。
+// 排除规则（SetExclusionRules）对所有实例生效。
+// 下面不带句柄的函数（StartFileMonitor、SearchFiles 等）作用于一个默认实例，与句柄接口出现之前的行为相同
+typedef struct MonitorContext* MonitorHandle;
+
+// 打开 dbPath 并创建一个空的实例，内存索引在 AttachMonitor 后从快照或数据库载入
+// 返回值：0表示成功并写入 *handle，1表示 dbPath 已被另一个实例使用，2表示打开数据库失败，-1表示有其它错误
+MONITOR_API int __stdcall CreateFileIndex(const char* dbPath, MonitorHandle* handle);
+
+// 载入实例的内存索引并开始监控 monitorPath（内部起线程，非阻塞）；monitorPath 是快照日志追赶的根目录
+// 返回值：0表示成功，1表示实例已经有监控，-4表示句柄无效，-1表示有其它错误
+MONITOR_API int __stdcall AttachMonitor(MonitorHandle handle, const char* monitorPath);
+
+// 停止监控、写入快照并释放实例；之后该句柄无效，其它线程上进行中的调用会被取消或正常完成
+MONITOR_API void __stdcall DestroyFileIndex(MonitorHandle handle);
+
+// 以下与同名的不带句柄函数（AddMonitorRoot、SearchFilesSorted、SearchFilesBinary、FindDuplicates、
+// CancelFindDuplicates、GetDiskUsage）参数与返回值相同，只作用于 handle 指定的实例；
+// 句柄无效时返回 -4（IndexAddRoot、IndexRemoveRoot 返回 1）
+MONITOR_API int __stdcall IndexAddRoot(MonitorHandle handle, const char* path);
+MONITOR_API int __stdcall IndexRemoveRoot(MonitorHandle handle, const char* path);
+MONITOR_API int __stdcall IndexSearch(MonitorHandle handle, const char* query, int sortBy, char* buffer,
+                                      int bufferSize, int maxResults);
+MONITOR_API int __stdcall IndexSearchBinary(MonitorHandle handle, const char* query, int sortBy, void* buffer,
+                                            int bufferSize, int maxResults);
+MONITOR_API int __stdcall IndexFindDuplicates(MonitorHandle handle, const char* query, long long minSize,
+                                              char* buffer, int bufferSize, int maxGroups);
+MONITOR_API void __stdcall IndexCancelFindDuplicates(MonitorHandle handle);
+MONITOR_API int __stdcall IndexGetDiskUsage(MonitorHandle handle, const char* root, int depth, int topN,
+                                            char* buffer, int bufferSize);
+
 // 初始化并启动目录监控（内部会起线程，非阻塞）
 // monitorPath: 要监控的目录路径（UTF-8/本地多字节字符串，例如 "D:\\test"）
 // dbPath: SQLite 数据库文件路径（例如 "file_index.db"）
-// 返回值：0表示成功，1表示已经有monitor在监视，2表示打开数据库失败，-1表示有其它错误
+// 返回值：0表示成功，1表示已经有monitor在监视，2表示打开数据库失败，
+//         -1表示有其它错误（包括 dbPath 已被 CreateFileIndex 创建的另一个实例使用）
 MONITOR_API int __stdcall StartFileMonitor(const char* monitorPath,
                                            const char* dbPath);
 
 // 请求停止监控并回收资源
 MONITOR_API void __stdcall StopFileMonitor();
 
+// 在运行中的监控上增减根目录，所有根目录共用一个事件线程与写入队列
+// StartFileMonitor 的 monitorPath 是第一个根目录；快照的日志追赶只覆盖它，后加的根目录不会被记住
+// 返回值：0表示成功，1表示监控未启动，2表示目录无法打开、与已有根目录重叠（添加）或不是根目录（移除）
+MONITOR_API int __stdcall AddMonitorRoot(const char* path);
+MONITOR_API int __stdcall RemoveMonitorRoot(const char* path);
+
+// 在内存索引中搜索，query 为 UTF-8 编码的 Everything 风格查询串，空格分隔的条件之间为 AND：
+//   report        名称包含 report（含 '\\' 时匹配完整路径）
+//   bgbf          汉字名称也可用全拼或拼音首字母匹配，例如 baogao、bgbf 都能找到"报告备份.docx"
+//   *.obj         通配符匹配整个名称
+//   ext:log;txt   扩展名
+//   type:video    文件类型：audio/video/image(pic)/doc/zip/exe，分号分隔取并集
+//   size:>100mb   大小，支持 > >= < <= = 与 a..b，以及 empty/tiny/small/medium/large/huge/gigantic
+//   dm:lastweek   修改时间（dc: 为创建时间），支持 today/yesterday/thisweek/lastweek/thismonth/
+//                 lastmonth/thisyear/lastyear 与 YYYY[-MM[-DD]]
+//   path:D:\build  完整路径包含（可含通配符）
+//   in:D:\projects 目录下的全部文件与子目录（按目录树编号做区间比较，不做路径字符串匹配）
+//   regex:^a\d+   名称正则
+//   fuzzy:reprot   名称近似包含（默认按长度容许 0~2 处编辑，fuzzy:1:reprot 指定），结果按编辑距离排序
+// 每条结果写成一行 "fullpath\tfileSize\tcreationTime\tlastAccessTime\tlastWriteTime\n"，
+// 时间为 FILETIME 的 64 位整数值；buffer 写满后多余的结果被丢弃
+// 返回值：写入的结果条数，-1表示被更新的查询取消，-2表示索引尚未就绪，-3表示查询串无法解析
+MONITOR_API int __stdcall SearchFiles(const char* query, char* buffer,
+                                      int bufferSize, int maxResults);
+
+// 与 SearchFiles 相同，但按指定键只取前 maxResults 条（各线程分别维护有界堆后归并）
+// sortBy：0 不排序，1 大小降序，2 大小升序，3 修改时间降序，4 修改时间升序
+MONITOR_API int __stdcall SearchFilesSorted(const char* query, int sortBy, char* buffer,
+                                            int bufferSize, int maxResults);
+
+// SearchFilesBinary 的结果布局（小端）：
+//   [0, 8)    int32 行数，int32 保留
+//   [8, ...)  行表，每行一个 SearchResultRow
+//   尾部      路径字节（UTF-8，无结尾 0），从 buffer 末尾向前存放，偏移相对于 buffer 起点
+// 调用方可以只解码实际显示的行，不必为每条结果构造字符串
+typedef struct SearchResultRow {
+    uint32_t pathOffset;
+    uint32_t pathLength;
+    int64_t fileSize;
+    int64_t creationTime;     // Unix 纪元毫秒，0 表示未知
+    int64_t lastAccessTime;
+    int64_t lastWriteTime;
+    uint32_t fileId;          // 节点编号，在实例的生命周期内不变，与订阅的变化对应
+    uint32_t change;          // 搜索结果为 0；订阅的变化为 1 新增、2 移出、3 更新
+} SearchResultRow;
+
+#define SEARCH_RESULT_HEADER_SIZE 8
+
+// 与 SearchFilesSorted 参数和返回值相同，但以上述二进制布局写入调用方提供的内存
+// （JNA 的 direct ByteBuffer 或共享内存），buffer 需 8 字节对齐
+MONITOR_API int __stdcall SearchFilesBinary(const char* query, int sortBy, void* buffer,
+                                            int bufferSize, int maxResults);
+
+// 实时查询：订阅一个查询串（语法同 SearchFiles），之后索引中的变化按批次报告相对于订阅时结果集的增量：
+//   新增（1）  新近匹配的项
+//   移出（2）  不再匹配或已删除的项，行中只有 fileId，路径为空
+//   更新（3）  仍然匹配、但名称、路径（含上级目录改名）、大小或时间变了的项
+// 后台线程每 200 毫秒检查一次，一次检查内的全部写入合成一批。增量的布局与 SearchFilesBinary 相同，
+// 各行的 change 标明种类，头部的保留字段为标志：CHANGE_DELTA_RESET 表示变化太多或日志已被截断而无法给出
+// 增量，调用方应重新搜索。订阅号只在所属实例内有效，实例销毁时全部订阅随之结束
+#define CHANGE_DELTA_RESET 1
+
+// 变化的回调，在后台线程上调用，delta 只在回调期间有效；回调中可以调用 IndexUnsubscribe，不能调用 DestroyFileIndex
+typedef void (__stdcall *IndexChangeCallback)(int subscription, const void* delta, int size, void* context);
+
+// callback 为空时变化按节点合并（先新增后移出的互相抵消），等 IndexPollChanges 取走
+// 返回值：订阅号（大于 0），-2表示索引尚未就绪，-3表示查询串无法解析，-4表示句柄无效
+MONITOR_API int __stdcall IndexSubscribe(MonitorHandle handle, const char* query, IndexChangeCallback callback,
+                                         void* context);
+
+// 把积累的变化写入 buffer（布局同上，需 8 字节对齐），放不下的留到下次
+// 返回值：写入的行数，-4表示句柄无效，-5表示订阅不存在
+MONITOR_API int __stdcall IndexPollChanges(MonitorHandle handle, int subscription, void* buffer, int bufferSize);
+
+// 返回后不会再有新的回调开始
+// 返回值：0表示成功，-4表示句柄无效，-5表示订阅不存在
+MONITOR_API int __stdcall IndexUnsubscribe(MonitorHandle handle, int subscription);
+
+// 作用于默认实例的同名接口，没有默认实例时返回 -2
+MONITOR_API int __stdcall SubscribeChanges(const char* query, IndexChangeCallback callback, void* context);
+MONITOR_API int __stdcall PollChanges(int subscription, void* buffer, int bufferSize);
+MONITOR_API int __stdcall UnsubscribeChanges(int subscription);
+
+// 查找内容重复的文件。query 与 SearchFiles 语法相同，用于限定范围（可为空），小于 minSize 字节的文件不参与；
+// 每组写成一行 "wastedBytes\tfileSize\tcount\tpath1\tpath2...\n"，按可释放的空间降序，
+// buffer 写满或达到 maxGroups 后多余的组被丢弃。hash 缓存在数据库中，文件未变时再次调用不必重读。
+// 返回值：写入的组数，-1表示被 CancelFindDuplicates 取消，-2表示索引尚未就绪，-3表示查询串无法解析
+MONITOR_API int __stdcall FindDuplicates(const char* query, long long minSize, char* buffer,
+                                         int bufferSize, int maxGroups);
+
+// 让进行中的 FindDuplicates 尽快返回
+MONITOR_API void __stdcall CancelFindDuplicates();
+
+// 磁盘占用统计：root（为空时为全部卷）下每层按大小取前 topN 个子项（topN <= 0 不限），其余合并为一项，
+// 共展开 depth 层。按先序每项写成一行 "depth\tsize\titems\tfolded\tpath\n"，size 为子树中文件大小之和，
+// items 为子树中的文件与目录数；folded 非 0 的行合并了 path 目录下 folded 个较小的子项。
+// 首次调用时汇总整个索引，之后随监控增量更新；buffer 写满后多余的行被丢弃
+// 返回值：写入的行数，-2表示索引尚未就绪，-3表示 root 不在索引中
+MONITOR_API int __stdcall GetDiskUsage(const char* root, int depth, int topN, char* buffer, int bufferSize);
+
+// 运行指标（进程级，所有实例合计）写成一个 JSON 对象：
+//   counters       events.received / events.coalesced / events.dropped（溢出次数）/ changes.written
+//   gauges         queue.depth：等待写入线程的批次，{"value", "max"}
+//   latencyMicros  db.commit / stat / search 的 {"count", "mean", "p50", "p90", "p99", "p999", "max"}，微秒
+//   probes         index.memoryBytes：内存索引估算占用的字节数
+// 计数按线程分片、relaxed 原子累加，可以一直开着
+// 返回值：写入的字节数（不含结尾 0）；buffer 放不下时不写入，返回所需大小（含结尾 0）的相反数
+MONITOR_API int __stdcall GetMonitorStats(char* buffer, int bufferSize);
+
+// 每隔 intervalSeconds 秒把同样的 JSON 写入 path（先写 path.tmp 再替换），再次调用时替换之前的设置；
+// path 为空或 intervalSeconds <= 0 时停止
+MONITOR_API void __stdcall SetMonitorStatsDump(const char* path, int intervalSeconds);
+
+// 设置排除规则（UTF-8，每行一条），回收站与数据库日志文件总是被排除：
+//   node_modules   任意一级名称等于它        *.tmp  ~$*   名称通配符
+//   ext:obj;pdb    扩展名                   D:\build     路径前缀
+// 被排除的目录整棵子树不进入索引，监控也不再处理其中的变更；可在 StartFileMonitor 之前或运行中调用，
+// 已在索引中的项在其所在目录下次重扫或重新载入时去掉
+// 返回值：生效的规则条数（含默认的两条），-3表示有无法解析的行
+MONITOR_API int __stdcall SetExclusionRules(const char* rules);
+
 } // extern "C"
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// 可用的工作线程数
+inline size_t workerCount() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? n : 4;
+}
+
+// 按数据量决定切分的块数，每块至少 minPerChunk 个元素
+inline size_t chunkCount(size_t count, size_t minPerChunk) {
+    size_t byData = minPerChunk ? count / minPerChunk : count;
+    return std::max<size_t>(1, std::min(workerCount(), byData));
+}
+
+// 将 [0, count) 均分为 chunks 块并行处理，fn(chunk, begin, end)
+// 第 0 块在调用线程上执行，函数返回时所有块都已完成
+template <typename Fn>
+void parallelFor(size_t count, size_t chunks, Fn&& fn) {
+    if (chunks <= 1 || count == 0) {
+        fn(size_t{0}, size_t{0}, count);
+        return;
+    }
+
+    size_t step = (count + chunks - 1) / chunks;
+    std::vector<std::thread> threads;
+    for (size_t c = 1; c < chunks; ++c) {
+        size_t begin = c * step;
+        if (begin >= count) break;
+        size_t end = std::min(count, begin + step);
+        threads.emplace_back([&fn, c, begin, end]() { fn(c, begin, end); });
+    }
+
+    fn(size_t{0}, size_t{0}, std::min(step, count));
+
+    for (auto& t : threads) t.join();
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// 拼音表覆盖的汉字范围（CJK 统一表意文字基本区）
+constexpr uint32_t PINYIN_FIRST = 0x4E00;
+constexpr uint32_t PINYIN_LAST = 0x9FA5;
+constexpr size_t PINYIN_SYLLABLE_COUNT = 412;
+
+// 定义在 pinyin_table.cpp（生成文件）
+extern const char* const PINYIN_SYLLABLES[PINYIN_SYLLABLE_COUNT];
+extern const uint16_t PINYIN_READINGS[PINYIN_LAST - PINYIN_FIRST + 1];
+
+// 全拼键、首字母键各自最多展开的个数（多音字组合超出时只保留靠前的读音组合）
+constexpr size_t PINYIN_MAX_KEYS = 8;
+
+// 名称中含有汉字时生成拼音影子键，追加到 out，各键之间以 '\0' 分隔
+// 例如 "报告备份.docx" 生成 "baogaobeifen.docx" 与 "bgbf.docx"；非汉字部分原样保留
+// foldedName 需已小写化；不含汉字时什么也不追加，返回生成的键个数
+size_t appendPinyinKeys(std::string_view foldedName, std::string& out);
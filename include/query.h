@@ -0,0 +1,87 @@
+#pragma once
+#include <memory>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "bitmap.h"
+#include "file_index.h"
+#include "file_type.h"
+#include "fuzzy.h"
+
+class QueryIndexes;
+
+// 条件类型，按求值代价从低到高排列
+enum class TermKind {
+    Size,           // size:>100mb  size:10kb..1mb  size:large
+    DateModified,   // dm:today  dm:lastweek  dm:>=2024-01-01
+    DateCreated,    // dc:thismonth
+    Extension,      // ext:log;txt
+    Type,           // type:video;image，按扩展名归类（见 file_type.h）
+    Scope,          // in:D:\projects，目录下的全部子孙节点
+    Name,           // 普通关键字，名称子串；汉字名称也可用全拼或首字母匹配（bgbf 命中"报告备份"）
+    Wildcard,       // *.obj，整个名称匹配
+    Fuzzy,          // fuzzy:reprot.docx 或 fuzzy:1:reprot，名称近似包含，按编辑距离排序
+    Path,           // path:D:\build 或含路径分隔符的关键字，匹配完整路径
+    Regex,          // regex:^report_\d+
+};
+
+struct QueryTerm {
+    TermKind kind = TermKind::Name;
+    std::string source;               // 原始写法
+    std::string text;                 // 小写化后的字面量或通配符模式
+    bool glob = false;                // Path 条件是否含通配符
+    bool pinyin = false;              // Name / Wildcard 条件是否也匹配拼音影子键（关键字为含字母的纯 ASCII）
+    bool bound = false;               // Scope 条件已换算为欧拉序区间 [low, high]，否则按完整路径前缀比较
+    std::vector<std::string> extensions;
+    std::vector<FileType> types;
+    ULONGLONG low = 0;                // Size / Date / Scope 条件的闭区间
+    ULONGLONG high = ~0ULL;
+    std::shared_ptr<const std::regex> regex;
+    std::shared_ptr<const FuzzyPattern> fuzzy;
+
+    bool matches(const FileIndex& index, FileId id) const;
+    // 满足本条件的节点是否一定满足 other
+    bool implies(const QueryTerm& other) const;
+};
+
+// 编译后的查询，各条件之间为 AND 关系
+class Query {
+private:
+    std::vector<QueryTerm> terms;   // 按求值代价升序
+
+public:
+    // 解析 Everything 风格的查询串；值不合法时返回 false 并给出原因，未知前缀按普通关键字处理
+    static bool parse(const std::string& text, Query& out, std::string& error);
+
+    bool empty() const { return terms.empty(); }
+    bool scoped() const;
+    // 在持有共享锁时把 Scope 条件换算为当前编号下的区间；编号不可用的条件保持按路径比较
+    void bind(const FileIndex& index);
+    const std::vector<QueryTerm>& getTerms() const { return terms; }
+
+    // 按代价顺序逐个求值，遇到不满足的条件立即返回
+    bool matches(const FileIndex& index, FileId id) const;
+
+    // 含近似条件时结果按编辑距离之和排序，score 越小越靠前
+    bool ranked() const;
+    int score(const FileIndex& index, FileId id) const;
+
+    // 本查询的结果是否一定是 older 结果的子集
+    bool refines(const Query& older) const;
+};
+
+// 查询计划：选出候选集最小的带索引条件作为驱动，其余条件在候选集上按代价顺序过滤
+// 扩展名与类型条件先在位图上求与/或得到 filter，它本身可作驱动，也可在其他驱动的候选集上先行过滤
+struct QueryPlan {
+    const QueryTerm* driver = nullptr;              // 为空且 filterDrives 为假时顺序扫描全部节点
+    std::shared_ptr<const RoaringBitmap> filter;    // 没有扩展名 / 类型条件时为空
+    bool filterDrives = false;
+    size_t estimate = 0;
+};
+
+// 以下两个函数要求调用方持有 FileIndex 的共享锁
+QueryPlan planQuery(const Query& query, const FileIndex& index, QueryIndexes& indexes);
+// 按计划生成升序去重的候选集（已并入构建索引之后改动过的节点）；需要全表扫描时返回 false
+bool collectCandidates(const QueryPlan& plan, const FileIndex& index, QueryIndexes& indexes,
+                       std::vector<FileId>& out);
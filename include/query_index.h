@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "file_index.h"
+
+// 按某个数值列排序的节点，keys 与 ids 一一对应，保存的是构建时刻的值
+// 扩展名与类型的位图由 FileIndex 自己维护，不在这里
+struct SortedColumn {
+    uint64_t mark = 0;    // 构建时 FileIndex 的变更日志位置
+    uint64_t epoch = 0;   // 欧拉序列构建时的编号轮次，重新编号后整体失效
+    std::vector<ULONGLONG> keys;
+    std::vector<FileId> ids;
+
+    size_t countInRange(ULONGLONG low, ULONGLONG high) const;
+    void collectRange(ULONGLONG low, ULONGLONG high, std::vector<FileId>& out) const;
+};
+
+// 名称三元组倒排表（CSR 布局）
+// 字节先映射到 64 个符号再组合，键空间只有 2^18，碰撞只会多出候选、不会漏掉结果
+struct TrigramPostings {
+    static constexpr uint32_t KEY_SPACE = 1u << 18;
+
+    uint64_t mark = 0;
+    size_t commonThreshold = 0;        // 出现次数超过该值的三元组不保存，视为没有选择性
+    std::vector<uint32_t> counts;      // 每个三元组出现的名称数（包括未保存的）
+    std::vector<uint32_t> offsets;     // KEY_SPACE + 1 项
+    std::vector<FileId> ids;
+
+    static uint32_t symbol(unsigned char c);
+    static void keysOf(std::string_view foldedText, std::vector<uint32_t>& out);
+    bool isStored(uint32_t key) const { return counts[key] <= commonThreshold; }
+    size_t postingSize(uint32_t key) const { return offsets[key + 1] - offsets[key]; }
+    const FileId* postingBegin(uint32_t key) const { return ids.data() + offsets[key]; }
+};
+
+// 查询规划用到的二级索引
+// 各部分在第一次被用到时按当时的快照批量构建，之后的改动通过 FileIndex 的变更日志补齐，
+// 改动积累过多时整体重建。所有接口都要求调用方持有 FileIndex 的共享锁。
+class QueryIndexes {
+    friend class IndexSnapshot;
+
+private:
+    const FileIndex& index;
+
+    std::mutex mtx;
+    std::shared_ptr<const SortedColumn> sizePart;
+    std::shared_ptr<const SortedColumn> writeTimePart;
+    std::shared_ptr<const TrigramPostings> trigramPart;
+    std::shared_ptr<const SortedColumn> tourPart;
+
+    bool isFresh(uint64_t mark) const;
+
+public:
+    explicit QueryIndexes(const FileIndex& idx) : index(idx) {}
+
+    std::shared_ptr<const SortedColumn> sizes();
+    std::shared_ptr<const SortedColumn> writeTimes();
+    std::shared_ptr<const TrigramPostings> trigrams();
+    // 按欧拉序编号排序的节点，要求 FileIndex 的编号有效（见 FileIndex::buildTour）
+    std::shared_ptr<const SortedColumn> tourLabels();
+
+    // 把已经构建过、但落后于当前变更位置的部分重建到最新（写快照前调用）
+    void settle();
+};
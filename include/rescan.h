@@ -0,0 +1,74 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "file_record.h"
+
+class FileIndex;
+class TreeWalker;
+
+// 一次子树重扫与索引对比得到的差异
+struct RescanResult {
+    std::string root;
+    std::vector<FileRecord> upserts;     // 新出现或大小、修改时间有变化的项
+    std::vector<std::string> removals;   // 索引中有而磁盘上已不存在的项
+};
+
+// 监控缓冲区溢出后的子树重扫
+// 请求按优先级排队，同一路径的重复请求合并；在最后一次请求之后静默 QUIET_PERIOD 才开始，
+// 同一路径两次重扫至少间隔 MIN_INTERVAL，枚举中每处理一批目录暂停片刻（Linux 上由 TreeWalker 以少量线程
+// 枚举），不与前台争抢磁盘。
+// 得到的差异交给 deliver，由监控的写入线程批量写入
+class SubtreeRescanner {
+public:
+    enum Priority {
+        LOW,    // 整个根目录
+        HIGH,   // 溢出前正在变化的目录，最可能丢失了变更
+    };
+    using Deliver = std::function<void(RescanResult&&)>;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::chrono::milliseconds QUIET_PERIOD{500};
+    static constexpr std::chrono::milliseconds MIN_INTERVAL{2000};
+    static constexpr size_t DIRS_PER_PAUSE = 256;
+    static constexpr std::chrono::milliseconds PAUSE{5};
+    static constexpr size_t WALK_THREADS = 2;
+
+    struct Request {
+        std::string path;
+        std::string key;   // 折叠后的路径
+        Priority priority;
+        Clock::time_point notBefore;
+    };
+
+    FileIndex* index;   // 为空时不做对比，磁盘上的项全部作为 upserts
+    Deliver deliver;
+
+    std::mutex mtx;
+    std::condition_variable wake;
+    std::vector<Request> pending;
+    std::unordered_map<std::string, Clock::time_point> lastRun;
+    bool stopping = false;
+    TreeWalker* walking = nullptr;   // 进行中的枚举，stop 时取消
+    std::thread worker;
+
+    void run();
+    bool scan(const std::string& root, RescanResult& out);
+
+public:
+    SubtreeRescanner(FileIndex* fileIndex, Deliver fn);
+    ~SubtreeRescanner();
+
+    // 可从任意线程调用
+    void schedule(const std::string& path, Priority priority);
+    // 放弃排队中和进行中的重扫，返回后不会再调用 deliver
+    void stop();
+};
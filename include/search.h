@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "file_index.h"
+#include "query.h"
+#include "query_index.h"
+
+enum class SearchStatus {
+    Ok,
+    Cancelled,      // 被更新的查询打断
+    InvalidQuery,   // 查询串无法解析
+};
+
+enum class SortKey {
+    None,            // FileId 顺序（含近似条件时按编辑距离）
+    Size,
+    LastWriteTime,
+};
+
+struct SearchOptions {
+    size_t maxResults = SIZE_MAX;
+    SortKey sortKey = SortKey::None;
+    bool descending = true;
+};
+
+// 原生搜索引擎：解析查询、选择执行计划，并多线程过滤 FileIndex 中的节点
+class SearchEngine {
+private:
+    FileIndex& index;
+    QueryIndexes queryIndexes;
+
+    // 每次查询领取一个递增的票号，扫描线程发现票号过期即放弃本次扫描
+    std::atomic<uint64_t> latestTicket{0};
+
+    // 上一次完整查询的全部匹配，新查询是旧查询的收窄时只需在其中继续过滤
+    std::mutex cacheMtx;
+    std::shared_ptr<const Query> cachedQuery;
+    uint64_t cachedVersion = 0;
+    std::shared_ptr<const std::vector<FileId>> cachedMatches;
+
+public:
+    explicit SearchEngine(FileIndex& idx) : index(idx), queryIndexes(idx) {}
+
+    // 查询语法见 Query::parse，不区分 ASCII 大小写；解析失败时 error 给出原因
+    // 指定排序键时每个扫描线程只保留自己的前 maxResults 条，最后归并，不物化全部匹配
+    SearchStatus search(const std::string& text, const SearchOptions& options, std::vector<FileId>& out,
+                        std::string* error = nullptr);
+
+    // 让正在进行的扫描尽快退出
+    void cancel() { latestTicket.fetch_add(1, std::memory_order_relaxed); }
+
+    FileIndex& getIndex() { return index; }
+    QueryIndexes& getQueryIndexes() { return queryIndexes; }
+};
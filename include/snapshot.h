@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include "file_index.h"
+#include "query_index.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+typedef long long USN;   // Linux 上没有 USN 日志，日志位置总是 0
+#endif
+
+// 快照写入时的 USN 日志位置，载入后从这里开始追赶
+struct SnapshotInfo {
+    char volume = 0;
+    DWORDLONG journalId = 0;
+    USN nextUsn = 0;
+};
+
+// 内存索引快照
+// 文件由头部、按 64 字节对齐的各段和段表组成，段内容即内存中各列的原始字节。
+// 载入时只读映射整个文件，校验版本与 hash64 校验和后逐段整块复制，不做逐条解析；
+// 扩展名位图与已构建的二级索引（大小/时间排序列、三元组）一并保存，载入后无需重建。
+class IndexSnapshot {
+public:
+    static constexpr uint32_t VERSION = 2;
+
+    // 先写临时文件再替换 path，中途失败不会破坏旧快照；derived 可为空
+    static bool save(const std::string& path, const FileIndex& index, QueryIndexes* derived, const SnapshotInfo& info);
+
+    // 文件缺失、版本不符或校验失败时返回 false，index 保持不变
+    // 成功后路径查找表尚未建立，可调用 FileIndex::buildLookup 在后台补上
+    static bool load(const std::string& path, FileIndex& index, QueryIndexes* derived, SnapshotInfo& info);
+};
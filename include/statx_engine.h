@@ -0,0 +1,33 @@
+#pragma once
+#ifdef __linux__
+#include <sys/stat.h>
+#include <memory>
+#include <vector>
+
+#include "tree_walker.h"
+
+// 按 statx 的结果填写类型、大小与时间；typeOnly 时只填类型
+void applyStatx(WalkEntry& entry, const struct statx& sx, bool typeOnly);
+
+// 批量取得文件信息
+// 同一目录下的一批项相对目录句柄取 statx，完成后写入 WalkEntry（与 FileRecord 的大小、时间对应）。
+// 优先用 io_uring：每个调用线程一个环，整批一次提交、最多 DEPTH 个在途，由内核的工作线程并发完成；
+// 内核没有 IORING_OP_STATX（5.6 以前）或 io_uring 被禁用时退回进程内共享的线程池，逐个 statx
+class StatxEngine {
+public:
+    enum class Kind {
+        Uring,
+        Pool,
+    };
+    static constexpr unsigned DEPTH = 256;
+
+    virtual ~StatxEngine() = default;
+
+    // 阻塞到整批完成；status[i] 为 0 或该项的错误码。名称相对 dirFd
+    virtual void fill(int dirFd, WalkEntry* entries, size_t count, bool typeOnly, std::vector<int>& status) = 0;
+    virtual Kind kind() const = 0;
+
+    // 供一个线程使用的引擎；prefer 为 Pool 时不尝试 io_uring
+    static std::unique_ptr<StatxEngine> create(Kind prefer = Kind::Uring);
+};
+#endif
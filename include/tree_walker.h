@@ -0,0 +1,106 @@
+#pragma once
+#ifdef __linux__
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "exclude.h"
+#include "file_record.h"
+
+// 全量扫描得到的一项，内容与 Windows 上 MFT 枚举（frnMap 的名称与上级）加 GetFileAttributesEx 相同
+struct WalkEntry {
+    uint64_t parent = 0;         // 上级目录在结果中的下标；根目录指向自己
+    uint64_t ino = 0;            // 对应 FRN，同一文件系统内唯一
+    std::string name;            // 根目录为完整路径
+    bool directory = false;
+    uint64_t size = 0;           // 目录为 0
+    uint64_t creationTime = 0;   // 以下与 FILETIME 相同，1601 年起的 100ns 计数；文件系统不提供时为 0
+    uint64_t lastAccessTime = 0;
+    uint64_t lastWriteTime = 0;
+};
+
+class StatxEngine;
+
+// Linux 的全量扫描
+// 工作线程各有一个目录队列，自己从队尾取（深度优先，打开的目录少），空闲时从其他线程的队首窃取
+// （靠近根的大子树）。目录用 openat 相对上级目录的句柄打开，getdents64 整块读取目录项，整个目录的项
+// 交给 StatxEngine 一次取文件信息；上级句柄在它的子目录都打开后关闭。不跨越挂载点，被排除的项及其
+// 子树不进入结果
+class TreeWalker {
+public:
+    struct Stats {
+        uint64_t directories = 0;
+        uint64_t files = 0;
+        uint64_t errors = 0;   // 无法打开或读取的目录，以及 statx 失败的项
+    };
+
+private:
+    static constexpr size_t DENTS_BUFFER = 64 * 1024;
+
+    struct DirHandle;
+
+    struct Task {
+        std::shared_ptr<DirHandle> parent;   // 为空时 path 为绝对路径
+        std::string path;                    // 完整路径，用于报告与句柄用尽时回退
+        uint64_t id = 0;                     // 该目录在所属线程结果中的编号
+        ExclusionRules::Cursor cursor;
+    };
+
+    struct Worker {
+        std::mutex mtx;
+        std::deque<Task> tasks;
+        std::vector<WalkEntry> out;
+        std::vector<uint64_t> dents;   // 按 8 字节对齐
+        std::unique_ptr<StatxEngine> statx;
+        std::vector<int> status;
+        Stats stats;
+        std::vector<std::string> unreadable;
+
+        ~Worker();
+    };
+
+    std::shared_ptr<const ExclusionRules> rules;
+    bool metadata;
+    bool preferPool;
+    uint64_t rootDevice = 0;
+    Stats total;
+    std::vector<std::string> failedDirs;
+    std::atomic<bool> cancelled{false};
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<size_t> outstanding{0};   // 已入队尚未处理完的目录
+    std::mutex idleMtx;
+    std::condition_variable idleWake;
+    std::atomic<size_t> sleepers{0};
+
+    void push(size_t self, Task&& task);
+    bool take(size_t self, Task& task);
+    void work(size_t self);
+    void scan(size_t self, Task& task);
+
+public:
+    // withMetadata 为 false 时只取名称与上级（对应只读 MFT 不取文件信息）；preferPool 时不使用 io_uring
+    explicit TreeWalker(bool withMetadata = true, bool preferPool = false);
+
+    // 扫描 root 下的全部项，out[0] 为 root 本身；root 无法打开或被 cancel 时返回 false
+    bool walk(const std::string& root, std::vector<WalkEntry>& out, size_t threads = 0);
+    // 可从其他线程调用，进行中与之后的 walk 尽快返回 false
+    void cancel() { cancelled = true; }
+
+    const Stats& stats() const { return total; }
+    // 上次 walk 中无法打开或读取的目录，其下的内容不在结果中
+    const std::vector<std::string>& unreadable() const { return failedDirs; }
+
+    // 由上级链拼出 entries[i] 的完整路径
+    static std::string path(const std::vector<WalkEntry>& entries, uint64_t i);
+    // 一项转为 FileRecord：大小、时间，inode 作为 frn
+    static FileRecord toRecord(const WalkEntry& entry, std::string fullPath);
+    // 扫描结果逐项转为 FileRecord 追加到 out，不含根目录本身；每个目录的路径只拼一次
+    static void toRecords(const std::vector<WalkEntry>& entries, std::vector<FileRecord>& out);
+};
+#endif
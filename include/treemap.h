@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "file_index.h"
+
+// 磁盘占用统计中的一项，按先序排列：每项之后紧跟它展开的子项
+struct TreemapEntry {
+    std::string path;
+    ULONGLONG size = 0;     // 子树中可见节点的大小合计
+    uint32_t items = 0;     // 子树中可见的文件与目录数（含自身）
+    uint32_t depth = 0;     // 相对起点的层数，起点为 0
+    uint32_t folded = 0;    // 非 0 时本项合并了同一目录下 folded 个较小的子项，path 为该目录
+};
+
+// 从内存索引生成分层的占用统计（类似 WizTree）：root 下（为空时从各卷根开始）每层按大小
+// 取前 topN 个子项，其余合并为一项，共展开 depth 层。子树合计由 FileIndex 增量维护，
+// 这里每层只需并行扫描一遍父节点数组找出被展开目录的子节点。root 不存在时返回 false
+bool buildTreemap(FileIndex& index, const std::string& root, uint32_t depth, size_t topN,
+                  std::vector<TreemapEntry>& out);
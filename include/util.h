@@ -1,9 +1,27 @@
 #pragma once
 #include <string>
-#include <windows.h>
-#include <volume.h>
+#include "file_record.h"
 
+#ifdef _WIN32
 // 字符编码转换
 std::string wide_to_utf8(const std::wstring& wstr);
 std::wstring string_to_wstring(const std::string& str);
-FileRecord makeRecord(const std::string& fullPath);
\ No newline at end of file
+std::wstring utf8_to_wide(const std::string& str);
+#endif
+FileRecord makeRecord(const std::string& fullPath);
+// 取得 record.fullpath 的大小与时间；失败时返回 false，lastError 给出原因
+bool fillRecord(FileRecord& record);
+
+// 上一次系统调用的错误码：Windows 为 GetLastError，其他平台为 errno
+long lastError();
+// 错误码表示路径已不存在（已被删除或改名）
+bool isNotFound(long err);
+
+// FILETIME 转为数据库中保存的 64 位整数
+ULONGLONG fileTimeToUInt64(const FILETIME& ft);
+
+// FILETIME 转为 Unix 纪元毫秒，全 0 的 FILETIME 转为 0
+long long fileTimeToEpochMillis(const FILETIME& ft);
+
+// Unix 纪元起的秒与纳秒转为 FILETIME
+FILETIME unixToFileTime(long long seconds, unsigned nanoseconds);
@@ -1,23 +1,26 @@
 #pragma once
 #include <windows.h>
+#include "file_record.h"
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 struct PfrnName{
     DWORDLONG pfrn=0;
     std::wstring filename;
 };
 
-struct FileRecord{
-    std::string fullpath;
-    
-    ULONGLONG fileSize = 0;          // 文件大小
-
-    FILETIME creationTime{};         // 创建时间
-    FILETIME lastAccessTime{};       // 最近访问时间
-    FILETIME lastWriteTime{};        // 最近写入时间（修改时间）
+// USN 日志中的一条变更
+struct UsnChange{
+    DWORDLONG frn=0;
+    DWORDLONG pfrn=0;
+    DWORD reason=0;
+    DWORD attributes=0;
+    std::wstring filename;
 };
 
+class ExclusionRules;
+
 class Volume{
 private:
     HANDLE hVol;//目标卷的句柄
@@ -33,8 +36,19 @@ public:
     bool createUSN();
     bool getUSNInfo();
     bool getUSNJournal();
+    // 从 frnMap 中去掉被排除的项及其整棵子树，在 getPath 之前调用，返回去掉的项数
+    size_t applyExclusions(const ExclusionRules& rules);
     bool deleteUSN();
     void getPath(DWORDLONG frn, std::wstring& path);
+
+    // 以下需先调用 getUSNInfo
+    DWORDLONG getJournalId() const { return ujd.UsnJournalID; }
+    USN getFirstUsn() const { return ujd.FirstUsn; }
+    USN getNextUsn() const { return ujd.NextUsn; }
+    // 读取 [startUsn, NextUsn) 之间的日志记录；日志已被截断或重建时返回 false
+    bool readJournal(USN startUsn, std::vector<UsnChange>& changes);
+    // 通过 FRN 打开文件并取得当前完整路径，不依赖 frnMap
+    bool getPathById(DWORDLONG frn, std::wstring& path);
     void closeHandle();
 };
 
@@ -0,0 +1,85 @@
+#pragma once
+#include <windows.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "event_source.h"
+
+// Windows 的事件源
+// 各目录句柄以重叠方式打开并关联到同一个完成端口，由一个事件线程驱动：每个目录始终保持若干个
+// ReadDirectoryChangesW 挂起，一个读取完成后先用空闲缓冲区重新挂起，再把填好的缓冲区交给解码线程
+// （转换路径），写入再慢也不会让内核缓冲区溢出。系统支持时读取带有 FRN 的扩展信息
+class Win32EventSource : public EventSource {
+private:
+    static constexpr DWORD BUFFER_SIZE = 64 * 1024;   // 网络共享上超过 64KB 会失败
+    static constexpr size_t BUFFER_COUNT = 4;         // 每个根目录轮转使用的缓冲区
+    static constexpr size_t READS_IN_FLIGHT = 2;      // 每个根目录同时挂起的读取
+    static constexpr size_t DECODE_THREADS = 2;
+
+    struct Watch;
+
+    // 一次读取使用的缓冲区；OVERLAPPED 放在首位，由完成包中的指针即可找回整个结构
+    struct WatchBuffer {
+        OVERLAPPED ov{};
+        Watch* watch = nullptr;
+        uint64_t sequence = 0;
+        DWORD bytes = 0;
+        bool extended = false;     // 内容为 FILE_NOTIFY_EXTENDED_INFORMATION
+        bool overflow = false;     // 内核缓冲区溢出，这段时间的变更已丢失
+        std::vector<DWORD> data;   // FILE_NOTIFY_INFORMATION 要求 DWORD 对齐
+    };
+
+    // 一个被监控的根目录，除 id、path 与 handle 外只由事件线程访问
+    struct Watch {
+        uint32_t id = 0;
+        std::string path;
+        HANDLE handle = INVALID_HANDLE_VALUE;
+        uint64_t volume = 0;   // 卷序列号，FRN 只在同一卷内唯一；取不到时为 0
+        std::vector<std::unique_ptr<WatchBuffer>> buffers;
+        std::vector<WatchBuffer*> freeBuffers;
+        size_t inFlight = 0;   // 挂起的读取
+        size_t decoding = 0;   // 交给解码线程尚未归还的缓冲区
+        bool extended = true;  // 读取扩展信息（含 FRN），旧系统、网络共享等不支持时退回普通通知
+        bool removing = false;
+    };
+
+    HANDLE port;
+    std::atomic<bool> isRunning{false};
+
+    // addRoot / removeRoot 只登记请求并唤醒事件线程，实际的挂起与释放都在事件线程中进行
+    std::mutex rootsMtx;
+    std::vector<std::unique_ptr<Watch>> addedRoots;
+    std::vector<std::string> removedRoots;
+    std::vector<std::string> rootPaths;   // 当前的根目录，供重叠检查与查找
+    uint32_t nextRootId = 1;
+
+    std::vector<std::unique_ptr<Watch>> watches;   // 仅事件线程访问
+    uint64_t nextSequence = 0;                     // 仅事件线程访问
+
+    std::mutex queueMtx;
+    std::condition_variable queueReady;
+    std::deque<WatchBuffer*> decodeQueue;
+    bool decodersStopping = false;
+
+    void takeRootRequests();
+    void arm(Watch& watch);
+    bool issueRead(Watch& watch);
+    void releaseIfIdle(Watch& watch);
+    void submit(WatchBuffer* buffer);
+    void decode(const WatchBuffer& buffer, std::vector<SourceEvent>& out) const;
+    void decodeLoop(const Deliver& deliver);
+
+public:
+    Win32EventSource();
+    ~Win32EventSource() override;
+
+    bool addRoot(const std::string& path) override;
+    bool removeRoot(const std::string& path) override;
+    void run(const Deliver& deliver) override;
+    void stop() override;
+};
@@ -0,0 +1,365 @@
+#include "../include/bitmap.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BITMAP_SSE2 1
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+inline uint32_t popcount64(uint64_t x) {
+#ifdef _MSC_VER
+    return static_cast<uint32_t>(__popcnt64(x));
+#else
+    return static_cast<uint32_t>(__builtin_popcountll(x));
+#endif
+}
+
+// 最低置位的下标，word 不为 0
+inline uint32_t lowestBit(uint64_t word) {
+    return popcount64((word & (~word + 1)) - 1);
+}
+
+// 位集整块运算，每次处理 256 位（AVX2）或 128 位（SSE2）
+void andWords(uint64_t* dst, const uint64_t* src, size_t words) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 4 <= words; i += 4) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_and_si256(a, b));
+    }
+#elif defined(BITMAP_SSE2)
+    for (; i + 2 <= words; i += 2) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_and_si128(a, b));
+    }
+#endif
+    for (; i < words; ++i) dst[i] &= src[i];
+}
+
+void orWords(uint64_t* dst, const uint64_t* src, size_t words) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 4 <= words; i += 4) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_or_si256(a, b));
+    }
+#elif defined(BITMAP_SSE2)
+    for (; i + 2 <= words; i += 2) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_or_si128(a, b));
+    }
+#endif
+    for (; i < words; ++i) dst[i] |= src[i];
+}
+
+uint32_t countWords(const uint64_t* words, size_t count) {
+    uint32_t total = 0;
+    for (size_t i = 0; i < count; ++i) total += popcount64(words[i]);
+    return total;
+}
+
+inline bool testBit(const std::vector<uint64_t>& bits, uint16_t low) {
+    return (bits[low >> 6] >> (low & 63)) & 1;
+}
+
+template <typename T>
+void appendRaw(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+} // namespace
+
+// ---------------------------------------------------------------
+// 容器
+// ---------------------------------------------------------------
+bool RoaringBitmap::Container::contains(uint16_t low) const {
+    if (isBitset()) return testBit(bits, low);
+    return std::binary_search(array.begin(), array.end(), low);
+}
+
+bool RoaringBitmap::Container::add(uint16_t low) {
+    if (isBitset()) {
+        uint64_t& word = bits[low >> 6];
+        uint64_t mask = 1ULL << (low & 63);
+        if (word & mask) return false;
+        word |= mask;
+        ++cardinality;
+        return true;
+    }
+
+    auto it = std::lower_bound(array.begin(), array.end(), low);
+    if (it != array.end() && *it == low) return false;
+    array.insert(it, low);
+    if (++cardinality > ARRAY_LIMIT) toBitset();
+    return true;
+}
+
+bool RoaringBitmap::Container::remove(uint16_t low) {
+    if (isBitset()) {
+        uint64_t& word = bits[low >> 6];
+        uint64_t mask = 1ULL << (low & 63);
+        if (!(word & mask)) return false;
+        word &= ~mask;
+        // 留出余量，避免在上限附近反复增删时来回转换
+        if (--cardinality <= ARRAY_LIMIT / 2) toArray();
+        return true;
+    }
+
+    auto it = std::lower_bound(array.begin(), array.end(), low);
+    if (it == array.end() || *it != low) return false;
+    array.erase(it);
+    --cardinality;
+    return true;
+}
+
+void RoaringBitmap::Container::toBitset() {
+    bits.assign(BITSET_WORDS, 0);
+    for (uint16_t low : array) bits[low >> 6] |= 1ULL << (low & 63);
+    std::vector<uint16_t>().swap(array);
+}
+
+void RoaringBitmap::Container::toArray() {
+    array.clear();
+    array.reserve(cardinality);
+    for (uint32_t w = 0; w < BITSET_WORDS; ++w) {
+        for (uint64_t word = bits[w]; word; word &= word - 1) {
+            array.push_back(static_cast<uint16_t>(w * 64 + lowestBit(word)));
+        }
+    }
+    std::vector<uint64_t>().swap(bits);
+}
+
+RoaringBitmap::Container* RoaringBitmap::find(uint16_t key) {
+    auto it = std::lower_bound(containers.begin(), containers.end(), key,
+                               [](const Container& c, uint16_t k) { return c.key < k; });
+    return it != containers.end() && it->key == key ? &*it : nullptr;
+}
+
+const RoaringBitmap::Container* RoaringBitmap::find(uint16_t key) const {
+    return const_cast<RoaringBitmap*>(this)->find(key);
+}
+
+// ---------------------------------------------------------------
+// 单个元素
+// ---------------------------------------------------------------
+bool RoaringBitmap::add(uint32_t value) {
+    const uint16_t key = static_cast<uint16_t>(value >> 16);
+    auto it = std::lower_bound(containers.begin(), containers.end(), key,
+                               [](const Container& c, uint16_t k) { return c.key < k; });
+    if (it == containers.end() || it->key != key) {
+        it = containers.insert(it, Container());
+        it->key = key;
+    }
+    return it->add(static_cast<uint16_t>(value));
+}
+
+bool RoaringBitmap::remove(uint32_t value) {
+    const uint16_t key = static_cast<uint16_t>(value >> 16);
+    Container* c = find(key);
+    if (!c || !c->remove(static_cast<uint16_t>(value))) return false;
+    if (c->cardinality == 0) containers.erase(containers.begin() + (c - containers.data()));
+    return true;
+}
+
+bool RoaringBitmap::contains(uint32_t value) const {
+    const Container* c = find(static_cast<uint16_t>(value >> 16));
+    return c && c->contains(static_cast<uint16_t>(value));
+}
+
+size_t RoaringBitmap::cardinality() const {
+    size_t total = 0;
+    for (const auto& c : containers) total += c.cardinality;
+    return total;
+}
+
+size_t RoaringBitmap::memoryUsage() const {
+    size_t bytes = containers.capacity() * sizeof(Container);
+    for (const auto& c : containers) {
+        bytes += c.array.capacity() * sizeof(uint16_t) + c.bits.capacity() * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+// ---------------------------------------------------------------
+// 集合运算
+// ---------------------------------------------------------------
+RoaringBitmap::Container RoaringBitmap::andContainers(const Container& a, const Container& b) {
+    Container out;
+    out.key = a.key;
+
+    if (a.isBitset() && b.isBitset()) {
+        out.bits = a.bits;
+        andWords(out.bits.data(), b.bits.data(), BITSET_WORDS);
+        out.cardinality = countWords(out.bits.data(), BITSET_WORDS);
+        if (out.cardinality <= ARRAY_LIMIT) out.toArray();
+        return out;
+    }
+
+    if (a.isBitset() || b.isBitset()) {
+        const Container& arr = a.isBitset() ? b : a;
+        const Container& set = a.isBitset() ? a : b;
+        for (uint16_t low : arr.array) {
+            if (testBit(set.bits, low)) out.array.push_back(low);
+        }
+    } else {
+        out.array.reserve(std::min(a.array.size(), b.array.size()));
+        std::set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                              std::back_inserter(out.array));
+    }
+    out.cardinality = static_cast<uint32_t>(out.array.size());
+    return out;
+}
+
+void RoaringBitmap::orInto(Container& acc, const Container& other) {
+    if (acc.isBitset() && other.isBitset()) {
+        orWords(acc.bits.data(), other.bits.data(), BITSET_WORDS);
+        acc.cardinality = countWords(acc.bits.data(), BITSET_WORDS);
+        return;
+    }
+
+    if (!acc.isBitset() && !other.isBitset() && acc.cardinality + other.cardinality <= ARRAY_LIMIT) {
+        std::vector<uint16_t> merged;
+        merged.reserve(acc.array.size() + other.array.size());
+        std::set_union(acc.array.begin(), acc.array.end(), other.array.begin(), other.array.end(),
+                       std::back_inserter(merged));
+        acc.array.swap(merged);
+        acc.cardinality = static_cast<uint32_t>(acc.array.size());
+        return;
+    }
+
+    // 结果可能超过数组上限，统一在位集上合并
+    if (!acc.isBitset()) acc.toBitset();
+    if (other.isBitset()) {
+        orWords(acc.bits.data(), other.bits.data(), BITSET_WORDS);
+    } else {
+        for (uint16_t low : other.array) acc.bits[low >> 6] |= 1ULL << (low & 63);
+    }
+    acc.cardinality = countWords(acc.bits.data(), BITSET_WORDS);
+    if (acc.cardinality <= ARRAY_LIMIT) acc.toArray();
+}
+
+void RoaringBitmap::andWith(const RoaringBitmap& other) {
+    std::vector<Container> result;
+    size_t i = 0, j = 0;
+    while (i < containers.size() && j < other.containers.size()) {
+        if (containers[i].key < other.containers[j].key) {
+            ++i;
+        } else if (containers[i].key > other.containers[j].key) {
+            ++j;
+        } else {
+            Container c = andContainers(containers[i++], other.containers[j++]);
+            if (c.cardinality > 0) result.push_back(std::move(c));
+        }
+    }
+    containers.swap(result);
+}
+
+void RoaringBitmap::orWith(const RoaringBitmap& other) {
+    std::vector<Container> result;
+    result.reserve(containers.size() + other.containers.size());
+    size_t i = 0, j = 0;
+    while (i < containers.size() || j < other.containers.size()) {
+        if (j == other.containers.size() ||
+            (i < containers.size() && containers[i].key < other.containers[j].key)) {
+            result.push_back(std::move(containers[i++]));
+        } else if (i == containers.size() || containers[i].key > other.containers[j].key) {
+            result.push_back(other.containers[j++]);
+        } else {
+            result.push_back(std::move(containers[i++]));
+            orInto(result.back(), other.containers[j++]);
+        }
+    }
+    containers.swap(result);
+}
+
+void RoaringBitmap::appendTo(std::vector<uint32_t>& out) const {
+    out.reserve(out.size() + cardinality());
+    for (const auto& c : containers) {
+        const uint32_t high = static_cast<uint32_t>(c.key) << 16;
+        if (!c.isBitset()) {
+            for (uint16_t low : c.array) out.push_back(high | low);
+            continue;
+        }
+        for (uint32_t w = 0; w < BITSET_WORDS; ++w) {
+            for (uint64_t word = c.bits[w]; word; word &= word - 1) {
+                out.push_back(high | (w * 64 + lowestBit(word)));
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------
+// 序列化
+// ---------------------------------------------------------------
+void RoaringBitmap::serialize(std::string& out) const {
+    appendRaw(out, static_cast<uint32_t>(containers.size()));
+    for (const auto& c : containers) {
+        appendRaw(out, c.key);
+        appendRaw(out, static_cast<uint16_t>(c.isBitset() ? 1 : 0));
+        appendRaw(out, c.cardinality);
+        if (c.isBitset()) {
+            out.append(reinterpret_cast<const char*>(c.bits.data()), BITSET_WORDS * sizeof(uint64_t));
+        } else {
+            out.append(reinterpret_cast<const char*>(c.array.data()), c.array.size() * sizeof(uint16_t));
+        }
+    }
+}
+
+bool RoaringBitmap::deserialize(const char* data, size_t size, size_t& used) {
+    size_t pos = 0;
+    auto take = [&](void* dst, size_t n) {
+        if (size - pos < n) return false;
+        memcpy(dst, data + pos, n);
+        pos += n;
+        return true;
+    };
+
+    uint32_t count;
+    if (!take(&count, sizeof(count))) return false;
+
+    std::vector<Container> parsed;
+    for (uint32_t i = 0; i < count; ++i) {
+        Container c;
+        uint16_t type;
+        if (!take(&c.key, sizeof(c.key)) || !take(&type, sizeof(type)) ||
+            !take(&c.cardinality, sizeof(c.cardinality))) {
+            return false;
+        }
+        if ((!parsed.empty() && c.key <= parsed.back().key) || c.cardinality == 0) return false;
+
+        if (type == 1) {
+            c.bits.resize(BITSET_WORDS);
+            if (!take(c.bits.data(), BITSET_WORDS * sizeof(uint64_t)) ||
+                countWords(c.bits.data(), BITSET_WORDS) != c.cardinality) {
+                return false;
+            }
+        } else {
+            if (type != 0 || c.cardinality > ARRAY_LIMIT) return false;
+            c.array.resize(c.cardinality);
+            if (!take(c.array.data(), c.cardinality * sizeof(uint16_t))) return false;
+            for (size_t k = 1; k < c.array.size(); ++k) {
+                if (c.array[k] <= c.array[k - 1]) return false;
+            }
+        }
+        parsed.push_back(std::move(c));
+    }
+
+    containers.swap(parsed);
+    used = pos;
+    return true;
+}
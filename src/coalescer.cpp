@@ -0,0 +1,216 @@
+#include "../include/coalescer.h"
+#include "../include/event_source.h"
+#include "../include/file_index.h"
+#include "../include/metrics.h"
+
+#include <algorithm>
+
+namespace {
+
+// 键在 prefix 目录之下的项的起点；这些项在有序表中连续
+template <typename Map>
+auto firstUnder(Map& entries, const std::string& prefix) {
+    return entries.lower_bound(prefix + PATH_SEP);
+}
+
+bool under(const std::string& key, const std::string& prefix) {
+    return key.size() > prefix.size() && key.compare(0, prefix.size(), prefix) == 0 && key[prefix.size()] == PATH_SEP;
+}
+
+} // namespace
+
+ChangeCoalescer::ChangeCoalescer() : slots(SLOTS), origin(Clock::now()) {}
+
+void ChangeCoalescer::schedule(const std::string& key, Entry& entry, Clock::time_point now) {
+    const Clock::time_point due = std::min(now + DELAY, entry.first + MAX_DELAY);
+    // 向上取整，到期前不会输出
+    uint64_t tick = static_cast<uint64_t>((due - origin + TICK - Clock::duration(1)) / TICK);
+    tick = std::max(tick, current + 1);
+    entry.dueTick = tick;
+    slots[tick % SLOTS].push_back({key, tick});
+}
+
+void ChangeCoalescer::settle(const Entry& entry, std::vector<NetChange>& out) {
+    if (entry.existsNow) {
+        out.push_back({NetChange::Upsert, entry.path, {}, entry.file.frn});
+    } else if (entry.existedBefore) {
+        out.push_back({NetChange::Remove, entry.path, {}, entry.file.frn});
+    } else {
+        // 窗口内新建又删除的路径不留痕迹
+        metricsAdd(Metric::EventsCoalesced);
+    }
+}
+
+bool ChangeCoalescer::pairMove(Event event, const std::string& key, const std::string& path, const FileKey& file,
+                               Clock::time_point now, std::vector<NetChange>& out) {
+    auto found = movable.find(file);
+    if (found == movable.end()) return false;
+    const std::string otherKey = std::move(found->second);
+    movable.erase(found);
+
+    auto other = entries.find(otherKey);
+    if (other == entries.end() || other->second.file.volume != file.volume || other->second.file.frn != file.frn ||
+        otherKey == key) {
+        return false;
+    }
+    Entry& entry = other->second;
+
+    if (event == Added && !entry.existsNow) {
+        // 先删除后添加：撤销删除（连同随它标记的子项），按重命名处理；删除前没有挂起的修改时
+        // 这一项本身就不必保留
+        for (auto child = firstUnder(entries, otherKey); child != entries.end() && under(child->first, otherKey);
+             ++child) {
+            if (!child->second.removedWithParent) continue;
+            child->second.existsNow = true;
+            child->second.removedWithParent = false;
+        }
+        const std::string oldPath = entry.path;
+        if (entry.modified) {
+            entry.existsNow = true;
+        } else {
+            entries.erase(other);
+        }
+        rename(oldPath, path, file.frn, now, out);
+        return true;
+    }
+    if (event == Removed && entry.existsNow && !entry.existedBefore) {
+        // 先添加后删除（两个根目录的通知先后不定）：新位置上挂起的添加改为重命名
+        const std::string newPath = entry.path;
+        entries.erase(other);
+        rename(path, newPath, file.frn, now, out);
+        return true;
+    }
+    return false;
+}
+
+void ChangeCoalescer::push(Event event, const std::string& path, const FileKey& file, Clock::time_point now,
+                           std::vector<NetChange>& out) {
+    const std::string key = FileIndex::fold(path);
+    if (file.known() && event != Modified && pairMove(event, key, path, file, now, out)) return;
+
+    auto [it, inserted] = entries.try_emplace(key);
+    Entry& entry = it->second;
+    if (inserted) {
+        entry.existedBefore = event != Added;
+        entry.first = now;
+    } else {
+        metricsAdd(Metric::EventsCoalesced);   // 并入同一路径挂起的项
+    }
+    entry.path = path;
+    entry.existsNow = event != Removed;
+    entry.modified = entry.modified || event != Removed;
+    entry.removedWithParent = false;
+    if (file.frn) entry.file = file;
+    if (file.known() && event != Modified) movable[file] = key;
+
+    // 目录被删除时其下挂起的项也随之消失
+    if (event == Removed) {
+        for (auto child = firstUnder(entries, key); child != entries.end() && under(child->first, key); ++child) {
+            if (!child->second.existsNow) continue;
+            child->second.existsNow = false;
+            child->second.removedWithParent = true;
+        }
+    }
+    schedule(key, entry, now);
+}
+
+void ChangeCoalescer::rename(const std::string& oldPath, const std::string& newPath, uint64_t frn,
+                             Clock::time_point now, std::vector<NetChange>& out) {
+    const std::string oldKey = FileIndex::fold(oldPath);
+    const std::string newKey = FileIndex::fold(newPath);
+
+    // 新路径上挂起的项是重命名之前的状态（例如先删除了同名文件），先结算
+    if (newKey != oldKey) {
+        auto it = entries.find(newKey);
+        if (it != entries.end()) {
+            settle(it->second, out);
+            entries.erase(it);
+        }
+        auto child = firstUnder(entries, newKey);
+        while (child != entries.end() && under(child->first, newKey)) {
+            settle(child->second, out);
+            child = entries.erase(child);
+        }
+    }
+
+    // 窗口内新建的路径还没有写入，改名只是换一个键；已写入的项只改路径，文件信息不变，
+    // 除非改名前已有挂起的修改
+    bool created = false;
+    bool pending = false;
+    Entry renamed;
+    auto it = entries.find(oldKey);
+    if (it != entries.end()) {
+        created = !it->second.existedBefore && it->second.existsNow;
+        pending = it->second.existsNow;
+        renamed = std::move(it->second);
+        entries.erase(it);
+    }
+    if (!created) {
+        out.push_back({NetChange::Rename, oldPath, newPath, frn});
+    }
+    if (pending) {
+        renamed.path = newPath;
+        if (frn) renamed.file.frn = frn;
+        schedule(newKey, entries[newKey] = std::move(renamed), now);
+    }
+
+    // 其下挂起的项换到新路径下，在重命名之后写入
+    std::vector<Entry> moved;
+    auto child = firstUnder(entries, oldKey);
+    while (child != entries.end() && under(child->first, oldKey)) {
+        moved.push_back(std::move(child->second));
+        child = entries.erase(child);
+    }
+    for (auto& entry : moved) {
+        entry.path = newPath + entry.path.substr(oldPath.size());
+        const std::string key = FileIndex::fold(entry.path);
+        schedule(key, entries[key] = std::move(entry), now);
+    }
+}
+
+void ChangeCoalescer::expire(Clock::time_point now, std::vector<NetChange>& out) {
+    const uint64_t nowTick = static_cast<uint64_t>((now - origin) / TICK);
+    if (nowTick <= current) return;
+    if (entries.empty()) {
+        for (auto& slot : slots) slot.clear();
+        movable.clear();
+        current = nowTick;
+        return;
+    }
+
+    // 落后超过一圈时每个槽都只需看一遍
+    std::vector<std::pair<std::string, Entry>> due;
+    const uint64_t steps = std::min<uint64_t>(nowTick - current, SLOTS);
+    for (uint64_t step = 1; step <= steps; ++step) {
+        auto& slot = slots[(current + step) % SLOTS];
+        size_t kept = 0;
+        for (size_t i = 0; i < slot.size(); ++i) {
+            Filed& filed = slot[i];
+            if (filed.tick > nowTick) {
+                if (kept != i) slot[kept] = std::move(filed);
+                ++kept;
+                continue;
+            }
+            auto it = entries.find(filed.key);
+            if (it != entries.end() && it->second.dueTick == filed.tick) {
+                // 一直没配上的删除或新建随项一起到期
+                auto move = movable.find(it->second.file);
+                if (move != movable.end() && move->second == it->first) movable.erase(move);
+                due.emplace_back(it->first, std::move(it->second));
+                entries.erase(it);
+            }
+        }
+        slot.resize(kept);
+    }
+    current = nowTick;
+
+    std::sort(due.begin(), due.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    for (const auto& item : due) settle(item.second, out);
+}
+
+void ChangeCoalescer::flush(std::vector<NetChange>& out) {
+    for (const auto& item : entries) settle(item.second, out);
+    entries.clear();
+    movable.clear();
+    for (auto& slot : slots) slot.clear();
+}
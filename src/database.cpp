@@ -1,9 +1,32 @@
 #include "../include/database.h"
-#include "../include/volume.h"
+#include "../include/event_source.h"
+#include "../include/log.h"
+#include "../include/metrics.h"
+#include "../include/file_record.h"
 
-#include <iostream>
 #include <vector>
 
+static FILETIME toFileTime(sqlite3_int64 value) {
+    FILETIME ft;
+    ft.dwLowDateTime = static_cast<DWORD>(value & 0xFFFFFFFF);
+    ft.dwHighDateTime = static_cast<DWORD>(static_cast<ULONGLONG>(value) >> 32);
+    return ft;
+}
+
+static bool hasColumn(sqlite3* db, const char* table, const char* column) {
+    sqlite3_stmt* stmt = nullptr;
+    std::string sql = std::string("PRAGMA table_info(") + table + ");";
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) return false;
+
+    bool found = false;
+    while (!found && sqlite3_step(stmt) == SQLITE_ROW) {
+        const unsigned char* name = sqlite3_column_text(stmt, 1);
+        found = name && std::string(reinterpret_cast<const char*>(name)) == column;
+    }
+    sqlite3_finalize(stmt);
+    return found;
+}
+
 Database::Database(const std::string& path) : db(nullptr), dbPath(path), isOpen(false) {
 }
 
@@ -17,10 +40,13 @@ bool Database::open() {
     }
 
     if (sqlite3_open(dbPath.c_str(), &db) != SQLITE_OK) {
-        std::cerr << "[ERROR] 无法打开数据库: " << sqlite3_errmsg(db) << std::endl;
+        LOG_ERROR("无法打开数据库: " << sqlite3_errmsg(db));
         return false;
     }
 
+    // 重复文件检测使用独立的连接，与监控线程的事务冲突时等待而不是立即失败
+    sqlite3_busy_timeout(db, 5000);
+
     isOpen = true;
     return true;
 }
@@ -31,7 +57,7 @@ bool Database::close() {
     }
 
     if (sqlite3_close(db) != SQLITE_OK) {
-        std::cerr << "[ERROR] 关闭数据库失败: " << sqlite3_errmsg(db) << std::endl;
+        LOG_ERROR("关闭数据库失败: " << sqlite3_errmsg(db));
         return false;
     }
 
@@ -42,7 +68,7 @@ bool Database::close() {
 
 bool Database::createTable() {
     if (!isOpen) {
-        std::cerr << "[ERROR] 数据库未打开" << std::endl;
+        LOG_ERROR("数据库未打开");
         return false;
     }
 
@@ -53,12 +79,46 @@ bool Database::createTable() {
         "fileSize INTEGER NOT NULL DEFAULT 0, "
         "creationTime INTEGER NOT NULL DEFAULT 0, "
         "lastAccessTime INTEGER NOT NULL DEFAULT 0, "
-        "lastWriteTime INTEGER NOT NULL DEFAULT 0"
+        "lastWriteTime INTEGER NOT NULL DEFAULT 0, "
+        "frn INTEGER NOT NULL DEFAULT 0, "
+        "pending INTEGER NOT NULL DEFAULT 0"
+        ");"
+        "CREATE TABLE IF NOT EXISTS file_hashes ("
+        "fullpath TEXT PRIMARY KEY, "
+        "fileSize INTEGER NOT NULL, "
+        "lastWriteTime INTEGER NOT NULL, "
+        "known INTEGER NOT NULL DEFAULT 0, "
+        "headHash INTEGER NOT NULL DEFAULT 0, "
+        "tailHash INTEGER NOT NULL DEFAULT 0, "
+        "fullHash INTEGER NOT NULL DEFAULT 0"
         ");";
 
     char* errMsg = nullptr;
     if (sqlite3_exec(db, createTableSQL, nullptr, nullptr, &errMsg) != SQLITE_OK) {
-        std::cerr << "[ERROR] SQL 错误: " << errMsg << std::endl;
+        LOG_ERROR("SQL 错误: " << errMsg);
+        sqlite3_free(errMsg);
+        return false;
+    }
+
+    // 旧版本建的表缺少后来增加的列；已有记录的 FRN 未知，随之后的变更逐步补上
+    const char* const addedColumns[][2] = {
+        {"frn", "ALTER TABLE files ADD COLUMN frn INTEGER NOT NULL DEFAULT 0;"},
+        {"pending", "ALTER TABLE files ADD COLUMN pending INTEGER NOT NULL DEFAULT 0;"},
+    };
+    for (const auto& column : addedColumns) {
+        if (hasColumn(db, "files", column[0])) continue;
+        if (sqlite3_exec(db, column[1], nullptr, nullptr, &errMsg) != SQLITE_OK) {
+            LOG_ERROR("SQL 错误: " << errMsg);
+            sqlite3_free(errMsg);
+            return false;
+        }
+    }
+
+    const char* createIndexSQL =
+        "CREATE INDEX IF NOT EXISTS files_frn ON files(frn);"
+        "CREATE INDEX IF NOT EXISTS files_pending ON files(pending) WHERE pending != 0;";
+    if (sqlite3_exec(db, createIndexSQL, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        LOG_ERROR("SQL 错误: " << errMsg);
         sqlite3_free(errMsg);
         return false;
     }
@@ -68,14 +128,14 @@ bool Database::createTable() {
 
 bool Database::dropTable() {
     if (!isOpen) {
-        std::cerr << "[ERROR] 数据库未打开" << std::endl;
+        LOG_ERROR("数据库未打开");
         return false;
     }
 
-    const char* dropTableSQL = "DROP TABLE IF EXISTS files;";
+    const char* dropTableSQL = "DROP TABLE IF EXISTS files; DROP TABLE IF EXISTS file_hashes;";
     char* errMsg = nullptr;
     if (sqlite3_exec(db, dropTableSQL, nullptr, nullptr, &errMsg) != SQLITE_OK) {
-        std::cerr << "[ERROR] SQL 错误: " << errMsg << std::endl;
+        LOG_ERROR("SQL 错误: " << errMsg);
         sqlite3_free(errMsg);
         return false;
     }
@@ -88,11 +148,11 @@ bool Database::addRecord(const FileRecord& record) {
 
     sqlite3_stmt* stmt = nullptr;
     const char* sql = 
-        "INSERT OR IGNORE INTO files(fullpath, fileSize, creationTime, lastAccessTime, lastWriteTime) "
-        "VALUES (?, ?, ?, ?, ?);";
+        "INSERT OR IGNORE INTO files(fullpath, fileSize, creationTime, lastAccessTime, lastWriteTime, frn) "
+        "VALUES (?, ?, ?, ?, ?, ?);";
 
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "[ERROR] 准备语句失败: " << sqlite3_errmsg(db) << std::endl;
+        LOG_ERROR("准备语句失败: " << sqlite3_errmsg(db));
         return false;
     }
 
@@ -101,6 +161,7 @@ bool Database::addRecord(const FileRecord& record) {
     sqlite3_bind_int64(stmt, 3, *reinterpret_cast<const sqlite3_int64*>(&record.creationTime));
     sqlite3_bind_int64(stmt, 4, *reinterpret_cast<const sqlite3_int64*>(&record.lastAccessTime));
     sqlite3_bind_int64(stmt, 5, *reinterpret_cast<const sqlite3_int64*>(&record.lastWriteTime));
+    sqlite3_bind_int64(stmt, 6, static_cast<sqlite3_int64>(record.frn));
 
     int result = sqlite3_step(stmt);
     sqlite3_finalize(stmt);
@@ -110,13 +171,13 @@ bool Database::addRecord(const FileRecord& record) {
 
 bool Database::deleteRecord(const std::string& path) {
     if (!isOpen) {
-        std::cerr << "[ERROR] 数据库未打开" << std::endl;
+        LOG_ERROR("数据库未打开");
         return false;
     }
 
     sqlite3_stmt* stmt = nullptr;
     if (sqlite3_prepare_v2(db, "DELETE FROM files WHERE fullpath = ?;", -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "[ERROR] 准备语句失败: " << sqlite3_errmsg(db) << std::endl;
+        LOG_ERROR("准备语句失败: " << sqlite3_errmsg(db));
         return false;
     }
 
@@ -125,7 +186,7 @@ bool Database::deleteRecord(const std::string& path) {
     sqlite3_finalize(stmt);
 
     if (result != SQLITE_DONE) {
-        std::cerr << "[ERROR] 删除记录失败: " << sqlite3_errmsg(db) << std::endl;
+        LOG_ERROR("删除记录失败: " << sqlite3_errmsg(db));
         return false;
     }
 
@@ -134,13 +195,13 @@ bool Database::deleteRecord(const std::string& path) {
 
 bool Database::recordExists(const std::string& path) {
     if (!isOpen) {
-        std::cerr << "[ERROR] 数据库未打开" << std::endl;
+        LOG_ERROR("数据库未打开");
         return false;
     }
 
     sqlite3_stmt* stmt = nullptr;
     if (sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM files WHERE fullpath = ?;", -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "[ERROR] 准备语句失败: " << sqlite3_errmsg(db) << std::endl;
+        LOG_ERROR("准备语句失败: " << sqlite3_errmsg(db));
         return false;
     }
 
@@ -156,13 +217,13 @@ bool Database::recordExists(const std::string& path) {
 
 int Database::getRecordCount() {
     if (!isOpen) {
-        std::cerr << "[ERROR] 数据库未打开" << std::endl;
+        LOG_ERROR("数据库未打开");
         return -1;
     }
 
     sqlite3_stmt* stmt = nullptr;
     if (sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM files;", -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "[ERROR] 准备语句失败: " << sqlite3_errmsg(db) << std::endl;
+        LOG_ERROR("准备语句失败: " << sqlite3_errmsg(db));
         return -1;
     }
 
@@ -175,21 +236,64 @@ int Database::getRecordCount() {
     return count;
 }
 
-bool Database::addRecordsBatch(const std::vector<FileRecord>& records) {
+bool Database::forEachRecord(const std::function<void(const FileRecord&)>& fn) {
+    if (!isOpen) {
+        LOG_ERROR("数据库未打开");
+        return false;
+    }
+
+    sqlite3_stmt* stmt = nullptr;
+    const char* sql =
+        "SELECT fullpath, fileSize, creationTime, lastAccessTime, lastWriteTime, frn "
+        "FROM files ORDER BY id;";
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        LOG_ERROR("准备语句失败: " << sqlite3_errmsg(db));
+        return false;
+    }
+
+    FileRecord record;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const unsigned char* path = sqlite3_column_text(stmt, 0);
+        record.fullpath = path ? reinterpret_cast<const char*>(path) : "";
+        record.fileSize = static_cast<ULONGLONG>(sqlite3_column_int64(stmt, 1));
+        record.creationTime = toFileTime(sqlite3_column_int64(stmt, 2));
+        record.lastAccessTime = toFileTime(sqlite3_column_int64(stmt, 3));
+        record.lastWriteTime = toFileTime(sqlite3_column_int64(stmt, 4));
+        record.frn = static_cast<DWORDLONG>(sqlite3_column_int64(stmt, 5));
+        fn(record);
+    }
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_DONE) {
+        LOG_ERROR("读取记录失败: " << sqlite3_errmsg(db));
+        return false;
+    }
+    return true;
+}
+
+bool Database::addRecordsBatch(const std::vector<FileRecord>& records, bool replaceExisting) {
     if (!isOpen) return false;
 
+    LatencyTimer timer(Latency::DbCommit);
     if (sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr) != SQLITE_OK) {
-        std::cerr << "[ERROR] 开始事务失败: " << sqlite3_errmsg(db) << std::endl;
+        LOG_ERROR("开始事务失败: " << sqlite3_errmsg(db));
         return false;
     }
 
     sqlite3_stmt* stmt = nullptr;
-    const char* sql = 
-        "INSERT OR IGNORE INTO files(fullpath, fileSize, creationTime, lastAccessTime, lastWriteTime) "
-        "VALUES (?, ?, ?, ?, ?);";
+    const char* sql = replaceExisting ?
+        "INSERT INTO files(fullpath, fileSize, creationTime, lastAccessTime, lastWriteTime, frn) "
+        "VALUES (?, ?, ?, ?, ?, ?) "
+        "ON CONFLICT(fullpath) DO UPDATE SET fileSize = excluded.fileSize, "
+        "creationTime = excluded.creationTime, lastAccessTime = excluded.lastAccessTime, "
+        "lastWriteTime = excluded.lastWriteTime, frn = excluded.frn, pending = 0;" :
+        "INSERT OR IGNORE INTO files(fullpath, fileSize, creationTime, lastAccessTime, lastWriteTime, frn) "
+        "VALUES (?, ?, ?, ?, ?, ?);";
 
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "[ERROR] 准备语句失败: " << sqlite3_errmsg(db) << std::endl;
+        LOG_ERROR("准备语句失败: " << sqlite3_errmsg(db));
         sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
         return false;
     }
@@ -200,9 +304,10 @@ bool Database::addRecordsBatch(const std::vector<FileRecord>& records) {
         sqlite3_bind_int64(stmt, 3, *reinterpret_cast<const sqlite3_int64*>(&record.creationTime));
         sqlite3_bind_int64(stmt, 4, *reinterpret_cast<const sqlite3_int64*>(&record.lastAccessTime));
         sqlite3_bind_int64(stmt, 5, *reinterpret_cast<const sqlite3_int64*>(&record.lastWriteTime));
+        sqlite3_bind_int64(stmt, 6, static_cast<sqlite3_int64>(record.frn));
 
         if (sqlite3_step(stmt) != SQLITE_DONE) {
-            std::cerr << "[ERROR] 批量插入失败: " << sqlite3_errmsg(db) << std::endl;
+            LOG_ERROR("批量插入失败: " << sqlite3_errmsg(db));
             sqlite3_finalize(stmt);
             sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
             return false;
@@ -213,7 +318,7 @@ bool Database::addRecordsBatch(const std::vector<FileRecord>& records) {
     sqlite3_finalize(stmt);
 
     if (sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK) {
-        std::cerr << "[ERROR] 提交事务失败: " << sqlite3_errmsg(db) << std::endl;
+        LOG_ERROR("提交事务失败: " << sqlite3_errmsg(db));
         sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
         return false;
     }
@@ -223,19 +328,20 @@ bool Database::addRecordsBatch(const std::vector<FileRecord>& records) {
 
 bool Database::deleteRecordsBatch(const std::vector<std::string>& paths) {
     if (!isOpen) {
-        std::cerr << "[ERROR] 数据库未打开" << std::endl;
+        LOG_ERROR("数据库未打开");
         return false;
     }
 
+    LatencyTimer timer(Latency::DbCommit);
     // 开始事务
     if (sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr) != SQLITE_OK) {
-        std::cerr << "[ERROR] 开始事务失败: " << sqlite3_errmsg(db) << std::endl;
+        LOG_ERROR("开始事务失败: " << sqlite3_errmsg(db));
         return false;
     }
 
     sqlite3_stmt* stmt = nullptr;
     if (sqlite3_prepare_v2(db, "DELETE FROM files WHERE fullpath = ?;", -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "[ERROR] 准备语句失败: " << sqlite3_errmsg(db) << std::endl;
+        LOG_ERROR("准备语句失败: " << sqlite3_errmsg(db));
         sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
         return false;
     }
@@ -243,7 +349,7 @@ bool Database::deleteRecordsBatch(const std::vector<std::string>& paths) {
     for (const auto& path : paths) {
         sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_TRANSIENT);
         if (sqlite3_step(stmt) != SQLITE_DONE) {
-            std::cerr << "[ERROR] 批量删除失败: " << sqlite3_errmsg(db) << std::endl;
+            LOG_ERROR("批量删除失败: " << sqlite3_errmsg(db));
             sqlite3_finalize(stmt);
             sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
             return false;
@@ -255,7 +361,108 @@ bool Database::deleteRecordsBatch(const std::vector<std::string>& paths) {
 
     // 提交事务
     if (sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK) {
-        std::cerr << "[ERROR] 提交事务失败: " << sqlite3_errmsg(db) << std::endl;
+        LOG_ERROR("提交事务失败: " << sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
+
+    return true;
+}
+
+int Database::renameRecord(DWORDLONG frn, const std::string& oldPath, const std::string& newPath) {
+    if (!isOpen) {
+        LOG_ERROR("数据库未打开");
+        return -1;
+    }
+
+    // self 是数据库中旧路径的写法：先按路径找，找不到再按 FRN 找。硬链接的多个名称共用一个 FRN，
+    // 只在 FRN 唯一时采用。其下的项按 self 的前缀区间 [self + 分隔符, self + 分隔符的下一个字符)
+    // 走路径索引改写（?4、?5），目标路径上已有的记录被替换
+    const char* sql =
+        "WITH self(path) AS (SELECT coalesce("
+        "    (SELECT fullpath FROM files WHERE fullpath = ?1),"
+        "    (SELECT fullpath FROM files WHERE frn = ?3 AND (SELECT COUNT(*) FROM files WHERE frn = ?3) = 1),"
+        "    ?1)) "
+        "UPDATE OR REPLACE files SET "
+        "fullpath = CASE WHEN fullpath = (SELECT path FROM self) THEN ?2 "
+        "           ELSE ?2 || substr(fullpath, length((SELECT path FROM self)) + 1) END, "
+        "frn = CASE WHEN fullpath = (SELECT path FROM self) THEN coalesce(?3, frn) ELSE frn END "
+        "WHERE fullpath = (SELECT path FROM self) "
+        "   OR (fullpath > (SELECT path FROM self) || ?4 AND fullpath < (SELECT path FROM self) || ?5) "
+        "RETURNING fullpath = ?2;";
+
+    LatencyTimer timer(Latency::DbCommit);   // 单条语句，自动提交
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        LOG_ERROR("准备语句失败: " << sqlite3_errmsg(db));
+        return -1;
+    }
+
+    sqlite3_bind_text(stmt, 1, oldPath.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, newPath.c_str(), -1, SQLITE_TRANSIENT);
+    if (frn) {
+        sqlite3_bind_int64(stmt, 3, static_cast<sqlite3_int64>(frn));
+    } else {
+        sqlite3_bind_null(stmt, 3);   // NULL 不等于任何 FRN
+    }
+    const char bounds[] = {PATH_SEP, static_cast<char>(PATH_SEP + 1)};
+    sqlite3_bind_text(stmt, 4, bounds, 1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 5, bounds + 1, 1, SQLITE_TRANSIENT);
+
+    bool found = false;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (sqlite3_column_int(stmt, 0)) found = true;
+    }
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_DONE) {
+        LOG_ERROR("重命名记录失败: " << sqlite3_errmsg(db));
+        return -1;
+    }
+    return found ? 1 : 0;
+}
+
+bool Database::addPendingRecords(const std::vector<FileRecord>& records) {
+    if (!isOpen) return false;
+    if (records.empty()) return true;
+
+    LatencyTimer timer(Latency::DbCommit);
+    if (sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        LOG_ERROR("开始事务失败: " << sqlite3_errmsg(db));
+        return false;
+    }
+
+    // 已有的记录保留原来的文件信息，补全之前仍可按大小、时间搜索
+    sqlite3_stmt* stmt = nullptr;
+    const char* sql =
+        "INSERT INTO files(fullpath, frn, pending) VALUES (?, ?, 1) "
+        "ON CONFLICT(fullpath) DO UPDATE SET pending = 1, "
+        "frn = CASE WHEN excluded.frn != 0 THEN excluded.frn ELSE files.frn END;";
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        LOG_ERROR("准备语句失败: " << sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
+
+    for (const auto& record : records) {
+        sqlite3_bind_text(stmt, 1, record.fullpath.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(record.frn));
+
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            LOG_ERROR("批量插入失败: " << sqlite3_errmsg(db));
+            sqlite3_finalize(stmt);
+            sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+            return false;
+        }
+        sqlite3_reset(stmt);
+    }
+
+    sqlite3_finalize(stmt);
+
+    if (sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        LOG_ERROR("提交事务失败: " << sqlite3_errmsg(db));
         sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
         return false;
     }
@@ -263,35 +470,172 @@ bool Database::deleteRecordsBatch(const std::vector<std::string>& paths) {
     return true;
 }
 
-bool Database::updatePathsOnDirectoryRename(
-    const std::string& oldDir,
-    const std::string& newDir)
-{
-    std::string oldPrefix = oldDir;
-    if (oldPrefix.back() != '\\') oldPrefix += "\\";
+bool Database::updateMetadataBatch(const std::vector<FileRecord>& records) {
+    if (!isOpen) return false;
+    if (records.empty()) return true;
+
+    LatencyTimer timer(Latency::DbCommit);
+    if (sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        LOG_ERROR("开始事务失败: " << sqlite3_errmsg(db));
+        return false;
+    }
+
+    // 期间已被删除的路径没有记录可改
+    sqlite3_stmt* stmt = nullptr;
+    const char* sql =
+        "UPDATE files SET fileSize = ?, creationTime = ?, lastAccessTime = ?, lastWriteTime = ?, pending = 0 "
+        "WHERE fullpath = ?;";
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        LOG_ERROR("准备语句失败: " << sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
+
+    for (const auto& record : records) {
+        sqlite3_bind_int64(stmt, 1, record.fileSize);
+        sqlite3_bind_int64(stmt, 2, *reinterpret_cast<const sqlite3_int64*>(&record.creationTime));
+        sqlite3_bind_int64(stmt, 3, *reinterpret_cast<const sqlite3_int64*>(&record.lastAccessTime));
+        sqlite3_bind_int64(stmt, 4, *reinterpret_cast<const sqlite3_int64*>(&record.lastWriteTime));
+        sqlite3_bind_text(stmt, 5, record.fullpath.c_str(), -1, SQLITE_TRANSIENT);
+
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            LOG_ERROR("批量更新失败: " << sqlite3_errmsg(db));
+            sqlite3_finalize(stmt);
+            sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+            return false;
+        }
+        sqlite3_reset(stmt);
+    }
+
+    sqlite3_finalize(stmt);
+
+    if (sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        LOG_ERROR("提交事务失败: " << sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
+
+    return true;
+}
+
+bool Database::loadPending(std::vector<FileRecord>& out) {
+    if (!isOpen) {
+        LOG_ERROR("数据库未打开");
+        return false;
+    }
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT fullpath, frn FROM files WHERE pending != 0;", -1, &stmt, nullptr) !=
+        SQLITE_OK) {
+        LOG_ERROR("准备语句失败: " << sqlite3_errmsg(db));
+        return false;
+    }
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const unsigned char* path = sqlite3_column_text(stmt, 0);
+        if (!path) continue;
+
+        FileRecord record{};
+        record.fullpath = reinterpret_cast<const char*>(path);
+        record.frn = static_cast<DWORDLONG>(sqlite3_column_int64(stmt, 1));
+        out.push_back(std::move(record));
+    }
+    sqlite3_finalize(stmt);
 
-    std::string newPrefix = newDir;
-    if (newPrefix.back() != '\\') newPrefix += "\\";
+    if (rc != SQLITE_DONE) {
+        LOG_ERROR("读取待补全记录失败: " << sqlite3_errmsg(db));
+        return false;
+    }
+    return true;
+}
+
+bool Database::loadFileHashes(std::unordered_map<std::string, FileHashEntry>& out) {
+    if (!isOpen) {
+        LOG_ERROR("数据库未打开");
+        return false;
+    }
 
     sqlite3_stmt* stmt = nullptr;
+    const char* sql =
+        "SELECT fullpath, fileSize, lastWriteTime, known, headHash, tailHash, fullHash FROM file_hashes;";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        LOG_ERROR("准备语句失败: " << sqlite3_errmsg(db));
+        return false;
+    }
 
-    std::string sql =
-        "UPDATE files SET fullpath = REPLACE(fullpath, ?, ?) "
-        "WHERE fullpath LIKE ?;";
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const unsigned char* path = sqlite3_column_text(stmt, 0);
+        if (!path) continue;
+
+        FileHashEntry entry;
+        entry.fullpath = reinterpret_cast<const char*>(path);
+        entry.fileSize = static_cast<ULONGLONG>(sqlite3_column_int64(stmt, 1));
+        entry.lastWriteTime = static_cast<ULONGLONG>(sqlite3_column_int64(stmt, 2));
+        entry.known = static_cast<uint8_t>(sqlite3_column_int(stmt, 3));
+        entry.headHash = static_cast<uint64_t>(sqlite3_column_int64(stmt, 4));
+        entry.tailHash = static_cast<uint64_t>(sqlite3_column_int64(stmt, 5));
+        entry.fullHash = static_cast<uint64_t>(sqlite3_column_int64(stmt, 6));
+        std::string key = entry.fullpath;
+        out[key] = std::move(entry);
+    }
+    sqlite3_finalize(stmt);
 
-    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK){
-        std::cout << "[ERROR] SQLite error: " << sqlite3_errmsg(db) << std::endl;
+    if (rc != SQLITE_DONE) {
+        LOG_ERROR("读取 hash 缓存失败: " << sqlite3_errmsg(db));
         return false;
     }
+    return true;
+}
 
-    std::string likePattern = oldPrefix + "%";
+bool Database::saveFileHashes(const std::vector<FileHashEntry>& entries) {
+    if (!isOpen) return false;
+    if (entries.empty()) return true;
 
-    sqlite3_bind_text(stmt, 1, oldPrefix.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 2, newPrefix.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 3, likePattern.c_str(), -1, SQLITE_TRANSIENT);
+    LatencyTimer timer(Latency::DbCommit);
+    if (sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        LOG_ERROR("开始事务失败: " << sqlite3_errmsg(db));
+        return false;
+    }
+
+    sqlite3_stmt* stmt = nullptr;
+    const char* sql =
+        "INSERT OR REPLACE INTO file_hashes(fullpath, fileSize, lastWriteTime, known, headHash, tailHash, fullHash) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?);";
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        LOG_ERROR("准备语句失败: " << sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
+
+    for (const auto& entry : entries) {
+        sqlite3_bind_text(stmt, 1, entry.fullpath.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(entry.fileSize));
+        sqlite3_bind_int64(stmt, 3, static_cast<sqlite3_int64>(entry.lastWriteTime));
+        sqlite3_bind_int(stmt, 4, entry.known);
+        sqlite3_bind_int64(stmt, 5, static_cast<sqlite3_int64>(entry.headHash));
+        sqlite3_bind_int64(stmt, 6, static_cast<sqlite3_int64>(entry.tailHash));
+        sqlite3_bind_int64(stmt, 7, static_cast<sqlite3_int64>(entry.fullHash));
+
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            LOG_ERROR("写入 hash 缓存失败: " << sqlite3_errmsg(db));
+            sqlite3_finalize(stmt);
+            sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+            return false;
+        }
+        sqlite3_reset(stmt);
+    }
 
-    bool success = (sqlite3_step(stmt) == SQLITE_DONE);
     sqlite3_finalize(stmt);
 
-    return success;
+    if (sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        LOG_ERROR("提交事务失败: " << sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
+
+    return true;
 }
\ No newline at end of file
@@ -0,0 +1,356 @@
+#include "../include/duplicates.h"
+#include "../include/hash.h"
+#include "../include/log.h"
+#include "../include/parallel.h"
+#include "../include/query.h"
+#include "../include/util.h"
+
+#include <algorithm>
+#include <tuple>
+#include <unordered_map>
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+struct Candidate {
+    FileHashEntry entry;
+    bool dirty = false;    // 本次算出了新的 hash，需要写回缓存
+    bool failed = false;   // 无法读取，不再参与比较
+};
+
+#ifdef _WIN32
+// 以重叠 I/O 打开的文件，最多同时有两个读取在进行
+class OverlappedFile {
+private:
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE events[2] = {nullptr, nullptr};
+    OVERLAPPED ov[2] = {};
+    bool pending[2] = {false, false};
+
+public:
+    ~OverlappedFile() {
+        for (int slot = 0; slot < 2; ++slot) {
+            // 缓冲区在返回后即被释放，未完成的读取必须先取消并等它结束
+            if (pending[slot]) {
+                DWORD ignored;
+                CancelIoEx(file, &ov[slot]);
+                GetOverlappedResult(file, &ov[slot], &ignored, TRUE);
+            }
+            if (events[slot]) CloseHandle(events[slot]);
+        }
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+    }
+
+    bool open(const std::string& path) {
+        file = CreateFileW(utf8_to_wide(path).c_str(), GENERIC_READ,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                           FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        for (auto& e : events) {
+            e = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+            if (!e) return false;
+        }
+        return true;
+    }
+
+    bool issue(int slot, ULONGLONG offset, void* buffer, DWORD length) {
+        ov[slot] = {};
+        ov[slot].Offset = static_cast<DWORD>(offset);
+        ov[slot].OffsetHigh = static_cast<DWORD>(offset >> 32);
+        ov[slot].hEvent = events[slot];
+        if (!ReadFile(file, buffer, length, nullptr, &ov[slot]) && GetLastError() != ERROR_IO_PENDING) {
+            return false;
+        }
+        pending[slot] = true;
+        return true;
+    }
+
+    bool wait(int slot, DWORD& got) {
+        pending[slot] = false;
+        return GetOverlappedResult(file, &ov[slot], &got, TRUE) != 0;
+    }
+
+    bool readAt(ULONGLONG offset, void* buffer, DWORD length) {
+        DWORD got = 0;
+        return issue(0, offset, buffer, length) && wait(0, got) && got == length;
+    }
+};
+#else
+// 接口与 Windows 上相同；issue 只记下请求并提示内核预读，读取在 wait 中以 pread 完成
+class OverlappedFile {
+private:
+    int fd = -1;
+    struct Request {
+        ULONGLONG offset = 0;
+        void* buffer = nullptr;
+        DWORD length = 0;
+    } requests[2];
+
+public:
+    ~OverlappedFile() {
+        if (fd >= 0) close(fd);
+    }
+
+    bool open(const std::string& path) {
+        fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        return true;
+    }
+
+    bool issue(int slot, ULONGLONG offset, void* buffer, DWORD length) {
+        requests[slot] = {offset, buffer, length};
+        posix_fadvise(fd, static_cast<off_t>(offset), length, POSIX_FADV_WILLNEED);
+        return true;
+    }
+
+    bool wait(int slot, DWORD& got) {
+        const Request& r = requests[slot];
+        got = 0;
+        while (got < r.length) {
+            ssize_t n = pread(fd, static_cast<char*>(r.buffer) + got, r.length - got,
+                              static_cast<off_t>(r.offset + got));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;   // 出错或读到文件尾，由调用方比较长度
+            got += static_cast<DWORD>(n);
+        }
+        return got > 0 || r.length == 0;
+    }
+
+    bool readAt(ULONGLONG offset, void* buffer, DWORD length) {
+        DWORD got = 0;
+        return issue(0, offset, buffer, length) && wait(0, got) && got == length;
+    }
+};
+#endif
+
+// 每个工作线程自己的读缓冲
+struct ReadBuffers {
+    std::vector<char> block;
+    std::vector<char> chunks[2];
+
+    ReadBuffers() : block(DuplicateFinder::BLOCK_SIZE) {}
+};
+
+bool stageApplies(uint8_t stage, ULONGLONG size) {
+    switch (stage) {
+    case FileHashEntry::HEAD: return true;
+    case FileHashEntry::TAIL: return size > DuplicateFinder::BLOCK_SIZE;
+    case FileHashEntry::FULL: return size > 2ULL * DuplicateFinder::BLOCK_SIZE;   // 更小的文件首尾两块已覆盖全文
+    default: return false;
+    }
+}
+
+// 全文 hash：一块在内核中读取的同时，另一块交给 hash
+bool hashFull(OverlappedFile& file, ULONGLONG size, ReadBuffers& buffers, const std::atomic<bool>& cancelled,
+              uint64_t& out) {
+    for (auto& chunk : buffers.chunks) {
+        if (chunk.empty()) chunk.resize(DuplicateFinder::READ_CHUNK);
+    }
+
+    Hash64 hash;
+    DWORD lengths[2] = {0, 0};
+    ULONGLONG issued = 0;
+    auto issueNext = [&](int slot) {
+        lengths[slot] = static_cast<DWORD>(std::min<ULONGLONG>(DuplicateFinder::READ_CHUNK, size - issued));
+        if (!file.issue(slot, issued, buffers.chunks[slot].data(), lengths[slot])) return false;
+        issued += lengths[slot];
+        return true;
+    };
+
+    if (!issueNext(0)) return false;
+    for (int slot = 0;; slot ^= 1) {
+        bool more = issued < size;
+        if (more && !issueNext(slot ^ 1)) return false;
+
+        DWORD got = 0;
+        if (!file.wait(slot, got) || got != lengths[slot]) return false;   // 读取期间文件被截短
+        hash.update(buffers.chunks[slot].data(), got);
+
+        if (!more) break;
+        if (cancelled.load(std::memory_order_relaxed)) return false;
+    }
+    out = hash.digest();
+    return true;
+}
+
+bool computeStage(Candidate& c, uint8_t stage, ReadBuffers& buffers, const std::atomic<bool>& cancelled) {
+    OverlappedFile file;
+    if (!file.open(c.entry.fullpath)) return false;
+
+    const ULONGLONG size = c.entry.fileSize;
+    switch (stage) {
+    case FileHashEntry::HEAD: {
+        DWORD length = static_cast<DWORD>(std::min<ULONGLONG>(size, DuplicateFinder::BLOCK_SIZE));
+        if (!file.readAt(0, buffers.block.data(), length)) return false;
+        c.entry.headHash = hash64(buffers.block.data(), length);
+        break;
+    }
+    case FileHashEntry::TAIL:
+        if (!file.readAt(size - DuplicateFinder::BLOCK_SIZE, buffers.block.data(), DuplicateFinder::BLOCK_SIZE)) {
+            return false;
+        }
+        c.entry.tailHash = hash64(buffers.block.data(), DuplicateFinder::BLOCK_SIZE);
+        break;
+    case FileHashEntry::FULL:
+        if (!hashFull(file, size, buffers, cancelled, c.entry.fullHash)) return false;
+        break;
+    default:
+        return false;
+    }
+
+    c.entry.known |= stage;
+    c.dirty = true;
+    return true;
+}
+
+// 比较键：大小与已经比较过的各阶段 hash
+std::tuple<ULONGLONG, uint64_t, uint64_t, uint64_t> keyOf(const Candidate& c, uint8_t compared) {
+    const FileHashEntry& e = c.entry;
+    return std::make_tuple(e.fileSize,
+                           (compared & FileHashEntry::HEAD) ? e.headHash : 0,
+                           (compared & FileHashEntry::TAIL) && stageApplies(FileHashEntry::TAIL, e.fileSize) ? e.tailHash : 0,
+                           (compared & FileHashEntry::FULL) && stageApplies(FileHashEntry::FULL, e.fileSize) ? e.fullHash : 0);
+}
+
+// 按比较键排序，去掉读取失败和没有同伴的文件；返回的 live 中同组文件相邻
+void regroup(const std::vector<Candidate>& all, std::vector<size_t>& live, uint8_t compared) {
+    live.erase(std::remove_if(live.begin(), live.end(), [&](size_t i) { return all[i].failed; }), live.end());
+    std::sort(live.begin(), live.end(), [&](size_t a, size_t b) {
+        auto ka = keyOf(all[a], compared), kb = keyOf(all[b], compared);
+        return ka != kb ? ka < kb : all[a].entry.fullpath < all[b].entry.fullpath;
+    });
+
+    std::vector<size_t> kept;
+    for (size_t begin = 0; begin < live.size();) {
+        size_t end = begin + 1;
+        while (end < live.size() && keyOf(all[live[end]], compared) == keyOf(all[live[begin]], compared)) ++end;
+        if (end - begin >= 2) kept.insert(kept.end(), live.begin() + begin, live.begin() + end);
+        begin = end;
+    }
+    live.swap(kept);
+}
+
+} // namespace
+
+SearchStatus DuplicateFinder::find(const std::string& text, ULONGLONG minSize, std::vector<DuplicateGroup>& out,
+                                   std::string* error) {
+    out.clear();
+    cancelled = false;
+
+    Query query;
+    std::string parseError;
+    if (!Query::parse(text, query, parseError)) {
+        if (error) *error = parseError;
+        return SearchStatus::InvalidQuery;
+    }
+    if (query.scoped()) index.buildTour();
+
+    // 目录的记录大小为 0，空文件也没有比较的意义
+    minSize = std::max<ULONGLONG>(minSize, 1);
+
+    // 先只按大小分组，只为有同伴的文件取完整路径
+    std::vector<Candidate> all;
+    {
+        auto lock = index.lockShared();
+        query.bind(index);
+
+        std::vector<std::pair<ULONGLONG, FileId>> bySize;
+        for (FileId id = 0; id < index.nodeCount(); ++id) {
+            if (!index.isListed(id) || index.fileSize(id) < minSize) continue;
+            if (!query.empty() && !query.matches(index, id)) continue;
+            bySize.emplace_back(index.fileSize(id), id);
+        }
+        std::sort(bySize.begin(), bySize.end());
+
+        for (size_t begin = 0; begin < bySize.size();) {
+            size_t end = begin + 1;
+            while (end < bySize.size() && bySize[end].first == bySize[begin].first) ++end;
+            for (size_t i = begin; end - begin >= 2 && i < end; ++i) {
+                Candidate c;
+                c.entry.fullpath = index.fullPath(bySize[i].second);
+                c.entry.fileSize = bySize[i].first;
+                c.entry.lastWriteTime = index.lastWriteTimeValue(bySize[i].second);
+                all.push_back(std::move(c));
+            }
+            begin = end;
+        }
+    }
+
+    // 大小与修改时间都没变的文件沿用缓存的 hash
+    if (cache) {
+        std::unordered_map<std::string, FileHashEntry> cached;
+        cache->loadFileHashes(cached);
+        for (auto& c : all) {
+            auto it = cached.find(c.entry.fullpath);
+            if (it != cached.end() && it->second.fileSize == c.entry.fileSize &&
+                it->second.lastWriteTime == c.entry.lastWriteTime) {
+                c.entry = it->second;
+            }
+        }
+    }
+
+    std::vector<size_t> live(all.size());
+    for (size_t i = 0; i < all.size(); ++i) live[i] = i;
+
+    uint8_t compared = 0;
+    size_t filesRead = 0;
+    for (uint8_t stage : {FileHashEntry::HEAD, FileHashEntry::TAIL, FileHashEntry::FULL}) {
+        std::vector<size_t> work;
+        for (size_t i : live) {
+            if (stageApplies(stage, all[i].entry.fileSize) && !(all[i].entry.known & stage)) work.push_back(i);
+        }
+
+        // 文件大小差异很大，按任务逐个领取而不是均分
+        std::atomic<size_t> nextWork{0};
+        parallelFor(work.size(), chunkCount(work.size(), 1), [&](size_t, size_t, size_t) {
+            ReadBuffers buffers;
+            for (size_t k; (k = nextWork.fetch_add(1)) < work.size();) {
+                if (cancelled.load(std::memory_order_relaxed)) return;
+                Candidate& c = all[work[k]];
+                if (!computeStage(c, stage, buffers, cancelled)) c.failed = true;
+            }
+        });
+        filesRead += work.size();
+
+        if (cancelled) break;
+        compared |= stage;
+        regroup(all, live, compared);
+    }
+
+    // 已经算出的 hash 即使被取消也写回，下次可以接着用
+    if (cache) {
+        std::vector<FileHashEntry> dirty;
+        for (const auto& c : all) {
+            if (c.dirty && !c.failed) dirty.push_back(c.entry);
+        }
+        cache->saveFileHashes(dirty);
+    }
+
+    if (cancelled) return SearchStatus::Cancelled;
+
+    for (size_t begin = 0; begin < live.size();) {
+        size_t end = begin + 1;
+        while (end < live.size() && keyOf(all[live[end]], compared) == keyOf(all[live[begin]], compared)) ++end;
+
+        const FileHashEntry& first = all[live[begin]].entry;
+        DuplicateGroup group;
+        group.fileSize = first.fileSize;
+        group.hash = stageApplies(FileHashEntry::FULL, first.fileSize) ? first.fullHash : first.headHash;
+        for (size_t i = begin; i < end; ++i) group.paths.push_back(all[live[i]].entry.fullpath);
+        out.push_back(std::move(group));
+        begin = end;
+    }
+    std::stable_sort(out.begin(), out.end(), [](const DuplicateGroup& a, const DuplicateGroup& b) {
+        return a.wastedBytes() > b.wastedBytes();
+    });
+
+    ULONGLONG wasted = 0;
+    for (const auto& g : out) wasted += g.wastedBytes();
+    LOG_INFO("重复文件检测完成: " << out.size() << " 组, 可释放 " << wasted << " 字节, 读取 " << filesRead << " 次。");
+    return SearchStatus::Ok;
+}
@@ -0,0 +1,343 @@
+#include "../include/exclude.h"
+
+#include <algorithm>
+#include <map>
+
+namespace {
+
+std::string foldAscii(std::string_view text) {
+    std::string out(text);
+    for (char& c : out) {
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+    }
+    return out;
+}
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r')) s.remove_suffix(1);
+    return s;
+}
+
+// UTF-16 名称逐个码元转为 UTF-8 字节，不分配内存
+template <typename Fn>
+bool forEachUtf8Byte(std::wstring_view name, Fn&& fn) {
+    for (size_t i = 0; i < name.size(); ++i) {
+        uint32_t cp = static_cast<uint16_t>(name[i]);
+        if (cp >= 0xD800 && cp < 0xDC00 && i + 1 < name.size()) {
+            uint32_t low = static_cast<uint16_t>(name[i + 1]);
+            if (low >= 0xDC00 && low < 0xE000) {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                ++i;
+            }
+        }
+        bool ok;
+        if (cp < 0x80) {
+            ok = fn(static_cast<uint8_t>(cp));
+        } else if (cp < 0x800) {
+            ok = fn(static_cast<uint8_t>(0xC0 | (cp >> 6))) && fn(static_cast<uint8_t>(0x80 | (cp & 0x3F)));
+        } else if (cp < 0x10000) {
+            ok = fn(static_cast<uint8_t>(0xE0 | (cp >> 12))) && fn(static_cast<uint8_t>(0x80 | ((cp >> 6) & 0x3F))) &&
+                 fn(static_cast<uint8_t>(0x80 | (cp & 0x3F)));
+        } else {
+            ok = fn(static_cast<uint8_t>(0xF0 | (cp >> 18))) && fn(static_cast<uint8_t>(0x80 | ((cp >> 12) & 0x3F))) &&
+                 fn(static_cast<uint8_t>(0x80 | ((cp >> 6) & 0x3F))) && fn(static_cast<uint8_t>(0x80 | (cp & 0x3F)));
+        }
+        if (!ok) return false;
+    }
+    return true;
+}
+
+std::string toUtf8(std::wstring_view name) {
+    std::string out;
+    forEachUtf8Byte(name, [&](uint8_t b) {
+        out.push_back(static_cast<char>(b));
+        return true;
+    });
+    return out;
+}
+
+// 通配符的 NFA：边为闭区间字节范围
+struct Nfa {
+    struct Edge {
+        uint8_t lo, hi;
+        uint32_t to;
+    };
+    struct State {
+        std::vector<Edge> edges;
+        std::vector<uint32_t> epsilon;
+        bool accept = false;
+    };
+    std::vector<State> states;
+    std::vector<uint32_t> starts;
+
+    uint32_t add() {
+        states.emplace_back();
+        return static_cast<uint32_t>(states.size() - 1);
+    }
+
+    // glob 已折叠为小写；? 匹配一个 UTF-8 字符
+    void addGlob(const std::string& glob) {
+        uint32_t at = add();
+        starts.push_back(at);
+        for (char ch : glob) {
+            const uint8_t b = static_cast<uint8_t>(ch);
+            if (ch == '*') {
+                uint32_t next = add();
+                states[at].edges.push_back({0x00, 0xFF, at});
+                states[at].epsilon.push_back(next);
+                at = next;
+            } else if (ch == '?') {
+                uint32_t next = add();
+                uint32_t cont = add();
+                states[at].edges.push_back({0x00, 0x7F, next});
+                states[at].edges.push_back({0xC0, 0xFF, cont});
+                states[cont].edges.push_back({0x80, 0xBF, cont});
+                states[cont].epsilon.push_back(next);
+                at = next;
+            } else {
+                uint32_t next = add();
+                states[at].edges.push_back({b, b, next});
+                at = next;
+            }
+        }
+        states[at].accept = true;
+    }
+
+    void close(std::vector<uint32_t>& set) const {
+        for (size_t i = 0; i < set.size(); ++i) {
+            for (uint32_t to : states[set[i]].epsilon) {
+                if (std::find(set.begin(), set.end(), to) == set.end()) set.push_back(to);
+            }
+        }
+        std::sort(set.begin(), set.end());
+    }
+};
+
+} // namespace
+
+void ExclusionRules::compile(const std::vector<std::string>& globs) {
+    transitions.clear();
+    accepting.clear();
+    classCount = 1;
+    start = 0;
+    std::fill(std::begin(byteClass), std::end(byteClass), 0);
+    if (globs.empty()) return;
+
+    Nfa nfa;
+    for (const auto& glob : globs) nfa.addGlob(glob);
+
+    // 对所有边都不可区分的字节归为一类，大写字母与对应的小写字母同类
+    std::map<std::vector<bool>, uint8_t> classes;
+    std::vector<uint8_t> representative;
+    for (int b = 0; b < 256; ++b) {
+        if (b >= 'A' && b <= 'Z') continue;
+        std::vector<bool> signature;
+        for (const auto& state : nfa.states) {
+            for (const auto& edge : state.edges) signature.push_back(b >= edge.lo && b <= edge.hi);
+        }
+        auto [it, inserted] = classes.emplace(std::move(signature), static_cast<uint8_t>(classes.size()));
+        if (inserted) representative.push_back(static_cast<uint8_t>(b));
+        byteClass[b] = it->second;
+    }
+    for (int b = 'A'; b <= 'Z'; ++b) byteClass[b] = byteClass[b - 'A' + 'a'];
+    classCount = static_cast<uint32_t>(representative.size());
+
+    // 子集构造
+    std::map<std::vector<uint32_t>, uint32_t> ids;
+    std::vector<std::vector<uint32_t>> sets;
+    auto idOf = [&](std::vector<uint32_t>&& set) {
+        auto [it, inserted] = ids.emplace(set, static_cast<uint32_t>(sets.size()));
+        if (inserted) {
+            bool accept = std::any_of(set.begin(), set.end(), [&](uint32_t s) { return nfa.states[s].accept; });
+            sets.push_back(std::move(set));
+            accepting.push_back(accept);
+            transitions.resize(sets.size() * classCount, 0);
+        }
+        return it->second;
+    };
+
+    idOf({});   // 死状态
+    std::vector<uint32_t> initial = nfa.starts;
+    nfa.close(initial);
+    start = idOf(std::move(initial));
+
+    for (uint32_t state = 1; state < sets.size(); ++state) {
+        for (uint32_t cls = 0; cls < classCount; ++cls) {
+            const uint8_t b = representative[cls];
+            std::vector<uint32_t> next;
+            for (uint32_t s : sets[state]) {
+                for (const auto& edge : nfa.states[s].edges) {
+                    if (b >= edge.lo && b <= edge.hi &&
+                        std::find(next.begin(), next.end(), edge.to) == next.end()) {
+                        next.push_back(edge.to);
+                    }
+                }
+            }
+            nfa.close(next);
+            const uint32_t to = idOf(std::move(next));
+            transitions[state * classCount + cls] = to;
+        }
+    }
+}
+
+bool ExclusionRules::matchesName(std::string_view name) const {
+    if (!start) return false;
+    uint32_t state = start;
+    for (char ch : name) {
+        state = transitions[state * classCount + byteClass[static_cast<uint8_t>(ch)]];
+        if (!state) return false;
+    }
+    return accepting[state];
+}
+
+bool ExclusionRules::matchesName(std::wstring_view name) const {
+    if (!start) return false;
+    uint32_t state = start;
+    bool alive = forEachUtf8Byte(name, [&](uint8_t b) {
+        state = transitions[state * classCount + byteClass[b]];
+        return state != 0;
+    });
+    return alive && accepting[state];
+}
+
+bool ExclusionRules::stepPrefix(Cursor& cursor, const std::string& foldedName) const {
+    const auto& children = prefixes[cursor.node].children;
+    auto it = children.find(foldedName);
+    if (it == children.end()) {
+        cursor.node = NO_PREFIX;
+        return false;
+    }
+    cursor.node = it->second;
+    return prefixes[cursor.node].terminal;
+}
+
+bool ExclusionRules::step(Cursor& cursor, std::string_view name) const {
+    if (matchesName(name)) return true;
+    if (cursor.node == NO_PREFIX) return false;
+    if (prefixes[cursor.node].children.empty()) {
+        cursor.node = NO_PREFIX;
+        return false;
+    }
+    return stepPrefix(cursor, foldAscii(name));
+}
+
+bool ExclusionRules::step(Cursor& cursor, std::wstring_view name) const {
+    if (matchesName(name)) return true;
+    if (cursor.node == NO_PREFIX) return false;
+    if (prefixes[cursor.node].children.empty()) {
+        cursor.node = NO_PREFIX;
+        return false;
+    }
+    return stepPrefix(cursor, foldAscii(toUtf8(name)));
+}
+
+bool ExclusionRules::walk(Cursor& cursor, std::string_view path) const {
+    size_t begin = 0;
+    while (begin < path.size()) {
+        size_t end = path.find_first_of("\\/", begin);
+        if (end == std::string_view::npos) end = path.size();
+        if (end > begin && step(cursor, path.substr(begin, end - begin))) return true;
+        begin = end + 1;
+    }
+    return false;
+}
+
+bool ExclusionRules::parse(const std::string& text, ExclusionRules& out, std::string& error) {
+    ExclusionRules rules;
+    std::vector<std::string> globs;
+
+    size_t begin = 0;
+    while (begin <= text.size()) {
+        size_t end = text.find('\n', begin);
+        if (end == std::string::npos) end = text.size();
+        std::string_view line = trim(std::string_view(text).substr(begin, end - begin));
+        begin = end + 1;
+        if (line.empty() || line.front() == '#') continue;
+
+        const std::string folded = foldAscii(line);
+        if (folded.compare(0, 4, "ext:") == 0) {
+            size_t added = 0;
+            std::string_view list = std::string_view(folded).substr(4);
+            while (!list.empty()) {
+                size_t sep = list.find(';');
+                std::string_view ext = trim(list.substr(0, sep));
+                list = sep == std::string_view::npos ? std::string_view() : list.substr(sep + 1);
+                if (!ext.empty() && ext.front() == '.') ext.remove_prefix(1);
+                if (ext.empty()) continue;
+                globs.push_back("*." + std::string(ext));
+                ++added;
+            }
+            if (!added) {
+                error = std::string(line);
+                return false;
+            }
+        } else if (folded.find_first_of("\\/:") != std::string::npos) {
+            // 前缀中的通配符无法逐级精确比较
+            if (folded.find_first_of("*?") != std::string::npos) {
+                error = std::string(line);
+                return false;
+            }
+            uint32_t node = 0;
+            size_t levels = 0;
+            size_t pos = 0;
+            while (pos < folded.size()) {
+                size_t next = folded.find_first_of("\\/", pos);
+                if (next == std::string::npos) next = folded.size();
+                if (next > pos) {
+                    std::string name = folded.substr(pos, next - pos);
+                    auto it = rules.prefixes[node].children.find(name);
+                    if (it == rules.prefixes[node].children.end()) {
+                        const uint32_t child = static_cast<uint32_t>(rules.prefixes.size());
+                        rules.prefixes[node].children.emplace(std::move(name), child);
+                        rules.prefixes.emplace_back();
+                        node = child;
+                    } else {
+                        node = it->second;
+                    }
+                    ++levels;
+                }
+                pos = next + 1;
+            }
+            if (!levels) {
+                error = std::string(line);
+                return false;
+            }
+            rules.prefixes[node].terminal = true;
+        } else {
+            globs.push_back(folded);
+        }
+        ++rules.ruleCount;
+    }
+
+    rules.compile(globs);
+    out = std::move(rules);
+    return true;
+}
+
+const ExclusionRules& ExclusionRules::defaults() {
+    static const ExclusionRules rules = [] {
+        ExclusionRules r;
+        std::string error;
+        parse(DEFAULT_RULES, r, error);
+        return r;
+    }();
+    return rules;
+}
+
+namespace {
+
+std::shared_ptr<const ExclusionRules>& currentRules() {
+    static std::shared_ptr<const ExclusionRules> rules = std::make_shared<ExclusionRules>(ExclusionRules::defaults());
+    return rules;
+}
+
+} // namespace
+
+std::shared_ptr<const ExclusionRules> exclusionRules() {
+    return std::atomic_load(&currentRules());
+}
+
+void setExclusionRules(std::shared_ptr<const ExclusionRules> rules) {
+    std::atomic_store(&currentRules(), std::move(rules));
+}
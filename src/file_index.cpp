@@ -0,0 +1,606 @@
+#include "../include/file_index.h"
+#include "../include/event_source.h"
+#include "../include/parallel.h"
+#include "../include/pinyin.h"
+
+#include <algorithm>
+
+std::string FileIndex::fold(std::string_view text) {
+    std::string out(text);
+    for (char& c : out) {
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+    }
+    return out;
+}
+
+std::string FileIndex::childKey(FileId parent, std::string_view foldedName) {
+    std::string key(reinterpret_cast<const char*>(&parent), sizeof(parent));
+    key.append(foldedName);
+    return key;
+}
+
+FileId FileIndex::findChild(FileId parent, std::string_view name) const {
+    auto it = children.find(childKey(parent, fold(name)));
+    return it == children.end() ? INVALID_FILE_ID : it->second;
+}
+
+FileId FileIndex::appendNode(FileId parent, std::string_view name) {
+    FileId id = static_cast<FileId>(parents.size());
+    parents.push_back(parent);
+    nameOffsets.push_back(0);
+    nameLens.push_back(0);
+    pinyinOffsets.push_back(0);
+    pinyinLens.push_back(0);
+    flags.push_back(0);
+    sizes.push_back(0);
+    creationTimes.push_back({});
+    lastAccessTimes.push_back({});
+    lastWriteTimes.push_back({});
+    setName(id, name);
+    children[childKey(parent, foldedName(id))] = id;
+    if (tourReady) {
+        tour.enter.push_back(0);
+        tour.exit.push_back(0);
+        tour.next.push_back(0);
+        tour.childCounts.push_back(0);
+        if (parent != INVALID_FILE_ID) tour.childCounts[parent]++;
+        placeInTour(id);
+    }
+    if (totalsReady) {
+        totals.sizes.push_back(0);
+        totals.counts.push_back(0);
+    }
+    return id;
+}
+
+void FileIndex::setName(FileId id, std::string_view name) {
+    // 名称只追加不回收，重命名留下的旧名称在下次全量重建时才会被清理
+    nameOffsets[id] = static_cast<uint32_t>(names.size());
+    nameLens[id] = static_cast<uint16_t>(std::min<size_t>(name.size(), 0xFFFF));
+    names.append(name.substr(0, nameLens[id]));
+    foldedNames.append(fold(name.substr(0, nameLens[id])));
+
+    // 拼音键同样只追加；超出长度上限时丢弃末尾放不下的键
+    size_t start = pinyinKeys.size();
+    appendPinyinKeys(foldedName(id), pinyinKeys);
+    size_t len = pinyinKeys.size() - start;
+    if (len > 0xFFFF) {
+        size_t cut = pinyinKeys.rfind('\0', start + 0xFFFF);
+        len = cut == std::string::npos || cut < start ? 0 : cut - start;
+        pinyinKeys.resize(start + len);
+    }
+    pinyinOffsets[id] = static_cast<uint32_t>(start);
+    pinyinLens[id] = static_cast<uint16_t>(len);
+}
+
+std::unordered_map<std::string, FileId> FileIndex::makeChildren() const {
+    std::unordered_map<std::string, FileId> map;
+    map.reserve(parents.size());
+    for (FileId id = 0; id < parents.size(); ++id) {
+        // 被重命名覆盖的旧节点仍在树中，同名时以可见的、较新的节点为准
+        auto [it, inserted] = map.emplace(childKey(parents[id], foldedName(id)), id);
+        if (!inserted && (isListed(id) || !isListed(it->second))) it->second = id;
+    }
+    return map;
+}
+
+void FileIndex::ensureLookup() {
+    if (lookupReady) return;
+    children = makeChildren();
+    lookupReady = true;
+}
+
+void FileIndex::buildLookup() {
+    uint64_t seen;
+    std::unordered_map<std::string, FileId> built;
+    {
+        auto lock = lockShared();
+        if (lookupReady) return;
+        seen = getVersion();
+        built = makeChildren();
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mtx);
+    if (lookupReady) return;
+    if (getVersion() != seen) built = makeChildren();
+    children.swap(built);
+    lookupReady = true;
+}
+
+FileId FileIndex::find(const std::string& path) const {
+    if (!lookupReady) return INVALID_FILE_ID;
+
+    FileId current = INVALID_FILE_ID;
+    size_t start = 0;
+    while (start <= path.size()) {
+        size_t end = path.find_first_of("\\/", start);
+        if (end == std::string::npos) end = path.size();
+        if (end > start) {
+            current = findChild(current, std::string_view(path.data() + start, end - start));
+            if (current == INVALID_FILE_ID) return current;
+        }
+        start = end + 1;
+    }
+    return current;
+}
+
+FileId FileIndex::resolve(const std::string& path, bool create) {
+    if (!create) return find(path);
+
+    FileId current = INVALID_FILE_ID;
+    size_t start = 0;
+
+    while (start <= path.size()) {
+        size_t end = path.find_first_of("\\/", start);
+        if (end == std::string::npos) end = path.size();
+
+        if (end > start) {
+            std::string_view component(path.data() + start, end - start);
+            FileId next = findChild(current, component);
+            if (next == INVALID_FILE_ID) next = appendNode(current, component);
+            current = next;
+        }
+        start = end + 1;
+    }
+    return current;
+}
+
+void FileIndex::logChange(FileId id) {
+    constexpr size_t MAX_CHANGE_LOG = 1 << 20;
+    if (changeLog.size() >= std::max(MAX_CHANGE_LOG, parents.size() / 8)) {
+        changeLogBase += changeLog.size();
+        changeLog.clear();
+    }
+    changeLog.push_back(id);
+}
+
+bool FileIndex::changedSince(uint64_t mark, std::vector<FileId>& out) const {
+    out.clear();
+    if (mark < changeLogBase) return false;
+
+    size_t from = static_cast<size_t>(mark - changeLogBase);
+    if (from < changeLog.size()) {
+        out.assign(changeLog.begin() + from, changeLog.end());
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+    }
+    return true;
+}
+
+std::string_view FileIndex::foldedExtension(FileId id) const {
+    std::string_view name = foldedName(id);
+    size_t dot = name.rfind('.');
+    return dot == std::string_view::npos ? std::string_view() : name.substr(dot + 1);
+}
+
+const RoaringBitmap* FileIndex::extensionBitmap(const std::string& foldedExt) const {
+    auto it = extensionBitmaps.find(foldedExt);
+    return it == extensionBitmaps.end() ? nullptr : &it->second;
+}
+
+void FileIndex::track(FileId id) {
+    std::string_view ext = foldedExtension(id);
+    extensionBitmaps[std::string(ext)].add(id);
+
+    FileType type;
+    if (classifyExtension(ext, type)) typeBitmaps[static_cast<size_t>(type)].add(id);
+}
+
+void FileIndex::untrack(FileId id) {
+    std::string_view ext = foldedExtension(id);
+    auto it = extensionBitmaps.find(std::string(ext));
+    if (it != extensionBitmaps.end()) {
+        it->second.remove(id);
+        if (it->second.empty()) extensionBitmaps.erase(it);
+    }
+
+    FileType type;
+    if (classifyExtension(ext, type)) typeBitmaps[static_cast<size_t>(type)].remove(id);
+}
+
+void FileIndex::rebuildTypeBitmaps() {
+    for (auto& bitmap : typeBitmaps) bitmap.clear();
+    for (const auto& [ext, bitmap] : extensionBitmaps) {
+        FileType type;
+        if (classifyExtension(ext, type)) typeBitmaps[static_cast<size_t>(type)].orWith(bitmap);
+    }
+}
+
+void FileIndex::rebuildBitmaps() {
+    extensionBitmaps.clear();
+    std::string ext;
+    RoaringBitmap* current = nullptr;
+    for (FileId id = 0; id < parents.size(); ++id) {
+        if (!isListed(id)) continue;
+
+        // 相邻节点常在同一目录下且扩展名相同，省去一次哈希查找
+        std::string_view e = foldedExtension(id);
+        if (!current || e != ext) {
+            ext.assign(e);
+            current = &extensionBitmaps[ext];
+        }
+        current->add(id);
+    }
+    rebuildTypeBitmaps();
+}
+
+void FileIndex::makeTour(EulerTour& out) const {
+    const size_t n = parents.size();
+    out = EulerTour();
+    out.enter.assign(n, 0);
+    out.exit.assign(n, 0);
+    out.next.assign(n, 0);
+    out.childCounts.assign(n, 0);
+
+    // 子节点列表（CSR），卷根挂在下标 n 的虚拟根下
+    std::vector<uint32_t> offsets(n + 2, 0);
+    for (FileId id = 0; id < n; ++id) {
+        FileId p = parents[id];
+        offsets[(p == INVALID_FILE_ID ? n : p) + 1]++;
+        if (p != INVALID_FILE_ID) out.childCounts[p]++;
+    }
+    for (size_t i = 1; i < offsets.size(); ++i) offsets[i] += offsets[i - 1];
+    std::vector<FileId> kids(n);
+    std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+    for (FileId id = 0; id < n; ++id) {
+        FileId p = parents[id];
+        kids[cursor[p == INVALID_FILE_ID ? n : p]++] = id;
+    }
+
+    // 广度优先序保证父节点在子节点之前，逆序累加即得各区间宽度
+    std::vector<FileId> order(kids.begin() + offsets[n], kids.begin() + offsets[n + 1]);
+    order.reserve(n);
+    for (size_t i = 0; i < order.size(); ++i) {
+        FileId v = order[i];
+        order.insert(order.end(), kids.begin() + offsets[v], kids.begin() + offsets[v + 1]);
+    }
+
+    // 每个节点占 unit，另为每个直接子节点预留 unit 的空隙，全树总宽不超过 2^63
+    out.unit = (1ULL << 62) / std::max<size_t>(n, 1);
+    std::vector<uint64_t> width(n, 0);
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        FileId v = *it;
+        width[v] += out.unit * (1 + out.childCounts[v]);
+        if (parents[v] != INVALID_FILE_ID) width[parents[v]] += width[v];
+    }
+
+    uint64_t rootCursor = 0;
+    for (FileId v : order) {
+        if (parents[v] == INVALID_FILE_ID) {
+            out.enter[v] = rootCursor;
+            rootCursor += width[v];
+        }
+        uint64_t child = out.enter[v] + 1;
+        for (uint32_t k = offsets[v]; k < offsets[v + 1]; ++k) {
+            out.enter[kids[k]] = child;
+            child += width[kids[k]];
+        }
+        out.next[v] = child;
+        out.exit[v] = out.enter[v] + width[v] - 1;
+    }
+    out.rootNext = rootCursor;
+}
+
+bool FileIndex::placeInTour(FileId id) {
+    FileId p = parents[id];
+    uint64_t& next = p == INVALID_FILE_ID ? tour.rootNext : tour.next[p];
+    const uint64_t last = p == INVALID_FILE_ID ? ~0ULL : tour.exit[p];
+    const uint64_t free = next <= last ? last - next + 1 : 0;
+
+    // 空隙充足时分配固定宽度，否则取剩余的一半；分不出来就等下一次整体编号
+    const uint64_t span = free >= 2 * tour.unit ? tour.unit : free / 2;
+    if (span == 0) {
+        dropTour();
+        return false;
+    }
+    tour.enter[id] = next;
+    tour.exit[id] = next + span - 1;
+    tour.next[id] = next + 1;
+    next += span;
+    return true;
+}
+
+void FileIndex::dropTour() {
+    tour = EulerTour();
+    tourReady = false;
+}
+
+void FileIndex::buildTour() {
+    uint64_t seen;
+    EulerTour built;
+    {
+        auto lock = lockShared();
+        if (tourReady) return;
+        seen = getVersion();
+        makeTour(built);
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mtx);
+    if (tourReady) return;
+    if (getVersion() != seen) makeTour(built);
+    tour = std::move(built);
+    tourReady = true;
+    ++tourEpoch;
+}
+
+void FileIndex::makeTotals(SubtreeTotals& out) const {
+    const size_t n = parents.size();
+    out.sizes.assign(n, 0);
+    out.counts.assign(n, 0);
+
+    // 新节点总在上级目录之后追加，按 id 从大到小累加时子节点先于父节点完成。
+    // 各块只把合计加到本块内的父节点上；父节点在块外或 id 更大（目录被移动过）的，
+    // 记下该节点已完成的合计，最后沿整条祖先链补上
+    struct Carry {
+        FileId parent;
+        ULONGLONG size;
+        uint32_t count;
+    };
+    const size_t chunks = chunkCount(n, 1 << 18);
+    std::vector<std::vector<Carry>> carries(chunks);
+    parallelFor(n, chunks, [&](size_t chunk, size_t begin, size_t end) {
+        for (size_t id = begin; id < end; ++id) {
+            if (!isListed(static_cast<FileId>(id))) continue;
+            out.sizes[id] = sizes[id];
+            out.counts[id] = 1;
+        }
+        std::vector<Carry>& pending = carries[chunk];
+        for (size_t id = end; id-- > begin;) {
+            FileId p = parents[id];
+            if (p == INVALID_FILE_ID || out.counts[id] == 0) continue;
+            if (p >= begin && p < id) {
+                out.sizes[p] += out.sizes[id];
+                out.counts[p] += out.counts[id];
+            } else if (!pending.empty() && pending.back().parent == p) {
+                // 同一目录下的节点多是连续的，合并后再沿祖先链传递
+                pending.back().size += out.sizes[id];
+                pending.back().count += out.counts[id];
+            } else {
+                pending.push_back({p, out.sizes[id], out.counts[id]});
+            }
+        }
+    });
+
+    for (const auto& pending : carries) {
+        for (const Carry& c : pending) {
+            for (FileId cur = c.parent; cur != INVALID_FILE_ID; cur = parents[cur]) {
+                out.sizes[cur] += c.size;
+                out.counts[cur] += c.count;
+            }
+        }
+    }
+}
+
+void FileIndex::adjustTotals(FileId id, int64_t sizeDelta, int32_t countDelta) {
+    if (!totalsReady || (sizeDelta == 0 && countDelta == 0)) return;
+    for (FileId cur = id; cur != INVALID_FILE_ID; cur = parents[cur]) {
+        totals.sizes[cur] += static_cast<ULONGLONG>(sizeDelta);
+        totals.counts[cur] += static_cast<uint32_t>(countDelta);
+    }
+}
+
+void FileIndex::dropTotals() {
+    totals = SubtreeTotals();
+    totalsReady = false;
+}
+
+void FileIndex::buildTotals() {
+    uint64_t seen;
+    SubtreeTotals built;
+    {
+        auto lock = lockShared();
+        if (totalsReady) return;
+        seen = getVersion();
+        makeTotals(built);
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mtx);
+    if (totalsReady) return;
+    if (getVersion() != seen) makeTotals(built);
+    totals = std::move(built);
+    totalsReady = true;
+}
+
+bool FileIndex::scopeOf(const std::string& folder, ULONGLONG& low, ULONGLONG& high) const {
+    if (!tourReady || !lookupReady) return false;
+
+    FileId id = find(folder);
+    if (id == INVALID_FILE_ID) {
+        low = 1;
+        high = 0;
+    } else {
+        low = tour.enter[id] + 1;
+        high = tour.exit[id];
+    }
+    return true;
+}
+
+FileId FileIndex::upsert(const FileRecord& record) {
+    std::unique_lock<std::shared_mutex> lock(mtx);
+    ensureLookup();
+
+    FileId id = resolve(record.fullpath, true);
+    if (id == INVALID_FILE_ID) return id;
+
+    const bool listed = flags[id] & FLAG_LISTED;
+    adjustTotals(id, static_cast<int64_t>(record.fileSize - (listed ? sizes[id] : 0)), listed ? 0 : 1);
+    sizes[id] = record.fileSize;
+    creationTimes[id] = record.creationTime;
+    lastAccessTimes[id] = record.lastAccessTime;
+    lastWriteTimes[id] = record.lastWriteTime;
+    if (!listed) track(id);
+    flags[id] |= FLAG_LISTED;
+    logChange(id);
+
+    version.fetch_add(1, std::memory_order_release);
+    return id;
+}
+
+bool FileIndex::update(const FileRecord& record) {
+    std::unique_lock<std::shared_mutex> lock(mtx);
+    ensureLookup();
+
+    FileId id = resolve(record.fullpath, false);
+    if (id == INVALID_FILE_ID || !(flags[id] & FLAG_LISTED)) return false;
+
+    adjustTotals(id, static_cast<int64_t>(record.fileSize - sizes[id]), 0);
+    sizes[id] = record.fileSize;
+    creationTimes[id] = record.creationTime;
+    lastAccessTimes[id] = record.lastAccessTime;
+    lastWriteTimes[id] = record.lastWriteTime;
+    logChange(id);
+
+    version.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+bool FileIndex::remove(const std::string& path) {
+    std::unique_lock<std::shared_mutex> lock(mtx);
+    ensureLookup();
+
+    FileId id = resolve(path, false);
+    if (id == INVALID_FILE_ID || !(flags[id] & FLAG_LISTED)) return false;
+
+    // 节点保留在树中（子节点可能仍有效），仅取消其在结果中的可见性
+    untrack(id);
+    adjustTotals(id, -static_cast<int64_t>(sizes[id]), -1);
+    flags[id] &= ~FLAG_LISTED;
+    logChange(id);
+    version.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+bool FileIndex::rename(const std::string& oldPath, const std::string& newPath) {
+    std::unique_lock<std::shared_mutex> lock(mtx);
+    ensureLookup();
+
+    FileId id = resolve(oldPath, false);
+    if (id == INVALID_FILE_ID) return false;
+
+    size_t sep = newPath.find_last_of("\\/");
+    std::string newName = sep == std::string::npos ? newPath : newPath.substr(sep + 1);
+    FileId newParent = sep == std::string::npos
+        ? INVALID_FILE_ID
+        : resolve(newPath.substr(0, sep), true);
+
+    // 目标路径上已有的节点被覆盖（仅大小写变化时 existing 就是自身）
+    FileId existing = findChild(newParent, newName);
+    if (existing != INVALID_FILE_ID && existing != id) {
+        if (flags[existing] & FLAG_LISTED) {
+            untrack(existing);
+            adjustTotals(existing, -static_cast<int64_t>(sizes[existing]), -1);
+        }
+        flags[existing] &= ~FLAG_LISTED;
+        logChange(existing);
+        children.erase(childKey(newParent, foldedName(existing)));
+    }
+
+    // 整个子树随节点一起移动，子节点无需任何改动
+    children.erase(childKey(parents[id], foldedName(id)));
+    const FileId oldParent = parents[id];
+    if (totalsReady && oldParent != newParent) {
+        adjustTotals(oldParent, -static_cast<int64_t>(totals.sizes[id]), -static_cast<int32_t>(totals.counts[id]));
+        adjustTotals(newParent, static_cast<int64_t>(totals.sizes[id]), static_cast<int32_t>(totals.counts[id]));
+    }
+    parents[id] = newParent;
+    if (tourReady && oldParent != newParent) {
+        if (oldParent != INVALID_FILE_ID) tour.childCounts[oldParent]--;
+        if (newParent != INVALID_FILE_ID) tour.childCounts[newParent]++;
+        // 叶子节点在新父目录的空隙中重新分配；带子树的目录移动后整体重新编号
+        if (tour.childCounts[id] == 0) placeInTour(id);
+        else dropTour();
+    }
+    const bool listed = flags[id] & FLAG_LISTED;
+    if (listed) untrack(id);
+    setName(id, newName);
+    if (listed) track(id);
+    children[childKey(newParent, foldedName(id))] = id;
+    logChange(id);
+
+    version.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+void FileIndex::clear() {
+    std::unique_lock<std::shared_mutex> lock(mtx);
+
+    parents.clear();
+    nameOffsets.clear();
+    nameLens.clear();
+    flags.clear();
+    sizes.clear();
+    creationTimes.clear();
+    lastAccessTimes.clear();
+    lastWriteTimes.clear();
+    names.clear();
+    foldedNames.clear();
+    pinyinOffsets.clear();
+    pinyinLens.clear();
+    pinyinKeys.clear();
+    children.clear();
+    dropTour();
+    dropTotals();
+    extensionBitmaps.clear();
+    for (auto& bitmap : typeBitmaps) bitmap.clear();
+    lookupReady = true;
+    changeLogBase += changeLog.size() + 1;   // 使所有已构建的二级索引失效
+    changeLog.clear();
+
+    version.fetch_add(1, std::memory_order_release);
+}
+
+std::string FileIndex::fullPath(FileId id) const {
+    std::vector<FileId> chain;
+    for (FileId cur = id; cur != INVALID_FILE_ID; cur = parents[cur]) {
+        chain.push_back(cur);
+    }
+
+    // Windows 的顶层节点是卷根 "D:"，Linux 的是 / 下的第一级目录
+    std::string path;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        if (!path.empty() || PATH_SEP == '/') path += PATH_SEP;
+        path.append(names, nameOffsets[*it], nameLens[*it]);
+    }
+    // 卷根 "D:" 本身需要带上分隔符
+    if (PATH_SEP == '\\' && chain.size() == 1) path += '\\';
+    return path;
+}
+
+template <typename T>
+static size_t capacityBytes(const std::vector<T>& v) {
+    return v.capacity() * sizeof(T);
+}
+
+size_t FileIndex::memoryUsage() const {
+    size_t bytes = capacityBytes(parents) + capacityBytes(nameOffsets) + capacityBytes(nameLens) +
+                   capacityBytes(flags) + capacityBytes(sizes) + capacityBytes(creationTimes) +
+                   capacityBytes(lastAccessTimes) + capacityBytes(lastWriteTimes) +
+                   capacityBytes(pinyinOffsets) + capacityBytes(pinyinLens) + capacityBytes(changeLog) +
+                   names.capacity() + foldedNames.capacity() + pinyinKeys.capacity();
+
+    // 哈希表每个节点另有两个指针与键的堆内存（短键在 std::string 内部）
+    const size_t nodeOverhead = 2 * sizeof(void*);
+    bytes += children.bucket_count() * sizeof(void*);
+    for (const auto& [key, id] : children) {
+        bytes += sizeof(key) + sizeof(id) + nodeOverhead + (key.capacity() > 15 ? key.capacity() + 1 : 0);
+    }
+    bytes += extensionBitmaps.bucket_count() * sizeof(void*);
+    for (const auto& [ext, bitmap] : extensionBitmaps) {
+        bytes += sizeof(ext) + sizeof(bitmap) + nodeOverhead + bitmap.memoryUsage();
+    }
+    for (const auto& bitmap : typeBitmaps) bytes += bitmap.memoryUsage();
+
+    bytes += capacityBytes(tour.enter) + capacityBytes(tour.exit) + capacityBytes(tour.next) +
+             capacityBytes(tour.childCounts) + capacityBytes(totals.sizes) + capacityBytes(totals.counts);
+    return bytes;
+}
+
+FileRecord FileIndex::record(FileId id) const {
+    FileRecord r{};
+    r.fullpath = fullPath(id);
+    r.fileSize = sizes[id];
+    r.creationTime = creationTimes[id];
+    r.lastAccessTime = lastAccessTimes[id];
+    r.lastWriteTime = lastWriteTimes[id];
+    return r;
+}
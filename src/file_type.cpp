@@ -0,0 +1,77 @@
+#include "../include/file_type.h"
+
+namespace {
+
+struct ExtensionClass {
+    const char* ext;
+    FileType type;
+};
+
+// 与 Everything 的 audio: / video: / pic: / doc: / zip: / exe: 宏大致一致
+const ExtensionClass EXTENSIONS[] = {
+    {"aac", FileType::Audio},  {"ac3", FileType::Audio},  {"aif", FileType::Audio},  {"aiff", FileType::Audio},
+    {"ape", FileType::Audio},  {"flac", FileType::Audio}, {"m4a", FileType::Audio},  {"mid", FileType::Audio},
+    {"midi", FileType::Audio}, {"mp3", FileType::Audio},  {"ogg", FileType::Audio},  {"opus", FileType::Audio},
+    {"wav", FileType::Audio},  {"wma", FileType::Audio},
+
+    {"3gp", FileType::Video},  {"avi", FileType::Video},  {"flv", FileType::Video},  {"m2ts", FileType::Video},
+    {"m4v", FileType::Video},  {"mkv", FileType::Video},  {"mov", FileType::Video},  {"mp4", FileType::Video},
+    {"mpeg", FileType::Video}, {"mpg", FileType::Video},  {"mts", FileType::Video},  {"rm", FileType::Video},
+    {"rmvb", FileType::Video}, {"ts", FileType::Video},   {"vob", FileType::Video},  {"webm", FileType::Video},
+    {"wmv", FileType::Video},
+
+    {"ani", FileType::Image},  {"bmp", FileType::Image},  {"cr2", FileType::Image},  {"dng", FileType::Image},
+    {"gif", FileType::Image},  {"heic", FileType::Image}, {"ico", FileType::Image},  {"jpeg", FileType::Image},
+    {"jpg", FileType::Image},  {"nef", FileType::Image},  {"png", FileType::Image},  {"psd", FileType::Image},
+    {"raw", FileType::Image},  {"svg", FileType::Image},  {"tga", FileType::Image},  {"tif", FileType::Image},
+    {"tiff", FileType::Image}, {"webp", FileType::Image},
+
+    {"csv", FileType::Document},  {"doc", FileType::Document}, {"docm", FileType::Document},
+    {"docx", FileType::Document}, {"dot", FileType::Document}, {"dotx", FileType::Document},
+    {"epub", FileType::Document}, {"htm", FileType::Document}, {"html", FileType::Document},
+    {"md", FileType::Document},   {"odp", FileType::Document}, {"ods", FileType::Document},
+    {"odt", FileType::Document},  {"pdf", FileType::Document}, {"ppt", FileType::Document},
+    {"pptx", FileType::Document}, {"rtf", FileType::Document}, {"txt", FileType::Document},
+    {"wps", FileType::Document},  {"xls", FileType::Document}, {"xlsm", FileType::Document},
+    {"xlsx", FileType::Document},
+
+    {"7z", FileType::Archive},  {"bz2", FileType::Archive}, {"cab", FileType::Archive}, {"gz", FileType::Archive},
+    {"iso", FileType::Archive}, {"lz", FileType::Archive},  {"lzma", FileType::Archive}, {"rar", FileType::Archive},
+    {"tar", FileType::Archive}, {"tgz", FileType::Archive}, {"xz", FileType::Archive},  {"z", FileType::Archive},
+    {"zip", FileType::Archive}, {"zst", FileType::Archive},
+
+    {"bat", FileType::Executable}, {"cmd", FileType::Executable}, {"com", FileType::Executable},
+    {"exe", FileType::Executable}, {"msi", FileType::Executable}, {"ps1", FileType::Executable},
+    {"scr", FileType::Executable},
+};
+
+} // namespace
+
+bool classifyExtension(std::string_view foldedExt, FileType& out) {
+    if (foldedExt.empty() || foldedExt.size() > 4) return false;
+    for (const auto& e : EXTENSIONS) {
+        if (foldedExt == e.ext) {
+            out = e.type;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parseFileType(std::string_view name, FileType& out) {
+    static const struct { const char* name; FileType type; } names[] = {
+        {"audio", FileType::Audio},        {"music", FileType::Audio},
+        {"video", FileType::Video},
+        {"image", FileType::Image},        {"pic", FileType::Image},       {"picture", FileType::Image},
+        {"doc", FileType::Document},       {"document", FileType::Document},
+        {"zip", FileType::Archive},        {"archive", FileType::Archive},
+        {"exe", FileType::Executable},     {"executable", FileType::Executable},
+    };
+    for (const auto& n : names) {
+        if (name == n.name) {
+            out = n.type;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,200 @@
+#include "../include/filler.h"
+#include "../include/event_source.h"
+#include "../include/log.h"
+#include "../include/metrics.h"
+#include "../include/util.h"
+#ifndef _WIN32
+#include "../include/statx_engine.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#include <algorithm>
+
+namespace {
+
+using Batch = std::vector<std::pair<std::string, int>>;   // 路径与已尝试的次数
+
+// path 等于 prefix 或位于其下
+bool under(const std::string& path, const std::string& prefix) {
+    return path.compare(0, prefix.size(), prefix) == 0 &&
+           (path.size() == prefix.size() || path[prefix.size()] == PATH_SEP);
+}
+
+#ifdef _WIN32
+// 逐项取文件信息；errors[i] 为 0 或 lastError 的错误码
+void fillBatch(const Batch& batch, std::vector<FileRecord>& records, std::vector<long>& errors) {
+    for (size_t i = 0; i < batch.size(); ++i) {
+        records[i].fullpath = batch[i].first;
+        errors[i] = fillRecord(records[i]) ? 0 : lastError();
+    }
+}
+#else
+// 按上级目录分组，每组相对目录句柄交给 StatxEngine 一次取完（与全量扫描相同的批量 statx）；
+// errors[i] 为 0 或 errno
+void fillBatch(StatxEngine& engine, const Batch& batch, std::vector<FileRecord>& records, std::vector<long>& errors) {
+    std::map<std::string, std::vector<size_t>> dirs;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        const std::string& path = batch[i].first;
+        const size_t sep = path.rfind('/');
+        dirs[sep == 0 || sep == std::string::npos ? "/" : path.substr(0, sep)].push_back(i);
+    }
+
+    std::vector<WalkEntry> entries;
+    std::vector<int> status;
+    for (const auto& [dir, items] : dirs) {
+        const int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) {
+            const int err = errno;
+            for (size_t i : items) {
+                records[i].fullpath = batch[i].first;
+                errors[i] = err;
+            }
+            continue;
+        }
+
+        entries.assign(items.size(), WalkEntry{});
+        for (size_t k = 0; k < items.size(); ++k) {
+            const std::string& path = batch[items[k]].first;
+            entries[k].name = path.substr(path.rfind('/') + 1);
+        }
+        {
+            LatencyTimer timer(Latency::Stat);
+            engine.fill(fd, entries.data(), entries.size(), false, status);
+        }
+        close(fd);
+
+        for (size_t k = 0; k < items.size(); ++k) {
+            const size_t i = items[k];
+            records[i] = TreeWalker::toRecord(entries[k], batch[i].first);
+            errors[i] = status[k];
+        }
+    }
+}
+#endif
+
+} // namespace
+
+MetadataFiller::MetadataFiller(Deliver fn) : deliver(std::move(fn)) {
+    worker = std::thread(&MetadataFiller::run, this);
+}
+
+MetadataFiller::~MetadataFiller() {
+    stop();
+}
+
+void MetadataFiller::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+        queued.clear();
+    }
+    wake.notify_all();
+    if (worker.joinable()) worker.join();
+}
+
+void MetadataFiller::enqueue(const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (stopping) return;
+        queued.try_emplace(path);
+    }
+    wake.notify_one();
+}
+
+void MetadataFiller::rename(const std::string& oldPath, const std::string& newPath) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (stopping) return;
+
+    std::vector<std::pair<std::string, Item>> moved;
+    for (auto it = queued.lower_bound(oldPath); it != queued.end() && under(it->first, oldPath);) {
+        moved.emplace_back(newPath + it->first.substr(oldPath.size()), it->second);
+        it = queued.erase(it);
+    }
+    // 正在取的旧路径多半会失败，新路径重新排队
+    for (auto it = inFlight.lower_bound(oldPath); it != inFlight.end() && under(*it, oldPath); ++it) {
+        moved.emplace_back(newPath + it->substr(oldPath.size()), Item{});
+    }
+    for (auto& [path, item] : moved) queued.emplace(std::move(path), item);
+    if (!moved.empty()) wake.notify_one();
+}
+
+void MetadataFiller::run() {
+#ifndef _WIN32
+    // io_uring 的环只供创建它的线程使用
+    const std::unique_ptr<StatxEngine> statx = StatxEngine::create();
+#endif
+    Batch batch;
+    for (;;) {
+        batch.clear();
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            for (;;) {
+                if (stopping) return;
+
+                // 等待重试的项留在队列中，到时间才取
+                const Clock::time_point now = Clock::now();
+                Clock::time_point earliest = Clock::time_point::max();
+                for (auto it = queued.begin(); it != queued.end() && batch.size() < BATCH;) {
+                    if (it->second.notBefore > now) {
+                        earliest = std::min(earliest, it->second.notBefore);
+                        ++it;
+                        continue;
+                    }
+                    batch.emplace_back(it->first, it->second.attempts);
+                    inFlight.insert(it->first);
+                    it = queued.erase(it);
+                }
+                if (!batch.empty()) break;
+
+                if (earliest == Clock::time_point::max()) {
+                    wake.wait(lock);
+                } else {
+                    wake.wait_until(lock, earliest);
+                }
+            }
+        }
+
+        std::vector<FileRecord> records(batch.size());
+        std::vector<long> errors(batch.size());
+#ifdef _WIN32
+        fillBatch(batch, records, errors);
+#else
+        fillBatch(*statx, batch, records, errors);
+#endif
+
+        std::vector<FileRecord> filled;
+        Batch retries;
+        for (size_t i = 0; i < batch.size(); ++i) {
+            const auto& [path, attempts] = batch[i];
+            const long err = errors[i];
+            if (!err) {
+                filled.push_back(std::move(records[i]));
+                continue;
+            }
+            // 已被删除或改名，之后的通知会处理
+            if (isNotFound(err)) continue;
+            if (attempts + 1 < MAX_ATTEMPTS) {
+                retries.emplace_back(path, attempts + 1);
+            } else {
+                LOG_WARN("无法取得文件信息: " << path << " 错误码: " << err);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            inFlight.clear();
+            const Clock::time_point notBefore = Clock::now() + RETRY_DELAY;
+            for (auto& [path, attempts] : retries) {
+                queued.try_emplace(std::move(path), Item{attempts, notBefore});
+            }
+        }
+        if (!filled.empty()) deliver(std::move(filled));
+
+        // 限制速率，也让出磁盘给前台
+        std::unique_lock<std::mutex> lock(mtx);
+        if (wake.wait_for(lock, PAUSE, [this] { return stopping; })) return;
+    }
+}
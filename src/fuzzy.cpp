@@ -0,0 +1,106 @@
+#include "../include/fuzzy.h"
+
+uint32_t nextCodePoint(std::string_view text, size_t& pos) {
+    unsigned char c = static_cast<unsigned char>(text[pos]);
+    size_t len = 1;
+    uint32_t cp = c;
+
+    if ((c & 0xE0) == 0xC0) { len = 2; cp = c & 0x1F; }
+    else if ((c & 0xF0) == 0xE0) { len = 3; cp = c & 0x0F; }
+    else if ((c & 0xF8) == 0xF0) { len = 4; cp = c & 0x07; }
+
+    if (len == 1 || pos + len > text.size()) {
+        ++pos;
+        return c;
+    }
+    for (size_t i = 1; i < len; ++i) {
+        cp = (cp << 6) | (static_cast<unsigned char>(text[pos + i]) & 0x3F);
+    }
+    pos += len;
+    return cp;
+}
+
+uint64_t FuzzyPattern::maskOf(uint32_t codePoint) const {
+    if (codePoint < 128) return asciiMasks[codePoint];
+    for (const auto& [cp, mask] : wideMasks) {
+        if (cp == codePoint) return mask;
+    }
+    return 0;
+}
+
+bool FuzzyPattern::compile(std::string_view pattern, int maxDist) {
+    length = 0;
+    wideMasks.clear();
+    for (auto& m : asciiMasks) m = 0;
+
+    size_t pos = 0;
+    while (pos < pattern.size()) {
+        if (length == MAX_LENGTH) return false;
+
+        uint32_t cp = nextCodePoint(pattern, pos);
+        uint64_t bit = 1ULL << length++;
+        if (cp < 128) {
+            asciiMasks[cp] |= bit;
+            continue;
+        }
+
+        bool found = false;
+        for (auto& entry : wideMasks) {
+            if (entry.first == cp) {
+                entry.second |= bit;
+                found = true;
+                break;
+            }
+        }
+        if (!found) wideMasks.emplace_back(cp, bit);
+    }
+    if (length == 0) return false;
+
+    // 短模式容错太多会匹配到几乎所有名称
+    if (maxDist < 0) maxDist = length <= 3 ? 0 : length <= 6 ? 1 : 2;
+    maxDistance = maxDist < length ? maxDist : length - 1;
+    return true;
+}
+
+int FuzzyPattern::distance(std::string_view text) const {
+    const uint64_t high = 1ULL << (length - 1);
+    uint64_t pv = ~0ULL;
+    uint64_t mv = 0;
+    int score = length;
+    int best = length;
+
+    size_t pos = 0;
+    while (pos < text.size()) {
+        // 每读入一个字符 score 最多减 1，剩余字节数不足以降到阈值内时提前结束
+        if (best > maxDistance && score - static_cast<int>(text.size() - pos) > maxDistance) break;
+
+        unsigned char c = static_cast<unsigned char>(text[pos]);
+        uint64_t eq;
+        if (c < 0x80) {
+            eq = asciiMasks[c];
+            ++pos;
+        } else {
+            eq = maskOf(nextCodePoint(text, pos));
+        }
+
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+
+        if (ph & high) ++score;
+        else if (mh & high) --score;
+
+        // 搜索模式：匹配可以从名称的任意位置开始，因此移位后不补 1
+        ph <<= 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+
+        if (score < best) {
+            best = score;
+            if (best == 0) break;
+        }
+    }
+    return best <= maxDistance ? best : maxDistance + 1;
+}
@@ -0,0 +1,112 @@
+#include "../include/hash.h"
+
+#include <cstring>
+
+static constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+static constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+static constexpr uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+static constexpr uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+static constexpr uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t read32(const unsigned char* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t mixRound(uint64_t acc, uint64_t input) {
+    acc += input * PRIME2;
+    acc = rotl(acc, 31);
+    return acc * PRIME1;
+}
+
+static inline uint64_t mergeRound(uint64_t acc, uint64_t lane) {
+    acc ^= mixRound(0, lane);
+    return acc * PRIME1 + PRIME4;
+}
+
+Hash64::Hash64(uint64_t s) : seed(s) {
+    lanes[0] = seed + PRIME1 + PRIME2;
+    lanes[1] = seed + PRIME2;
+    lanes[2] = seed;
+    lanes[3] = seed - PRIME1;
+}
+
+void Hash64::update(const void* data, size_t len) {
+    auto p = static_cast<const unsigned char*>(data);
+    total += len;
+
+    // 先补齐上次剩下的不足 32 字节的部分
+    if (tailSize + len < 32) {
+        memcpy(tail + tailSize, p, len);
+        tailSize += len;
+        return;
+    }
+    if (tailSize > 0) {
+        size_t fill = 32 - tailSize;
+        memcpy(tail + tailSize, p, fill);
+        for (int i = 0; i < 4; ++i) lanes[i] = mixRound(lanes[i], read64(tail + i * 8));
+        p += fill;
+        len -= fill;
+        tailSize = 0;
+    }
+
+    // 四条通道互不依赖，每轮处理 32 字节
+    const unsigned char* end = p + len;
+    while (end - p >= 32) {
+        lanes[0] = mixRound(lanes[0], read64(p));
+        lanes[1] = mixRound(lanes[1], read64(p + 8));
+        lanes[2] = mixRound(lanes[2], read64(p + 16));
+        lanes[3] = mixRound(lanes[3], read64(p + 24));
+        p += 32;
+    }
+
+    tailSize = static_cast<size_t>(end - p);
+    memcpy(tail, p, tailSize);
+}
+
+uint64_t Hash64::digest() const {
+    uint64_t h;
+    if (total >= 32) {
+        h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+        for (int i = 0; i < 4; ++i) h = mergeRound(h, lanes[i]);
+    } else {
+        h = seed + PRIME5;
+    }
+    h += total;
+
+    const unsigned char* p = tail;
+    const unsigned char* end = tail + tailSize;
+    while (end - p >= 8) {
+        h ^= mixRound(0, read64(p));
+        h = rotl(h, 27) * PRIME1 + PRIME4;
+        p += 8;
+    }
+    if (end - p >= 4) {
+        h ^= static_cast<uint64_t>(read32(p)) * PRIME1;
+        h = rotl(h, 23) * PRIME2 + PRIME3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (*p) * PRIME5;
+        h = rotl(h, 11) * PRIME1;
+        ++p;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    return h;
+}
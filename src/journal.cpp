@@ -0,0 +1,188 @@
+#include "../include/journal.h"
+
+#ifdef _WIN32
+#include "../include/database.h"
+#include "../include/exclude.h"
+#include "../include/file_index.h"
+#include "../include/log.h"
+#include "../include/util.h"
+#include "../include/volume.h"
+
+#include <algorithm>
+#include <cctype>
+#include <unordered_map>
+#include <vector>
+
+static char volumeOf(const std::string& root) {
+    if (root.size() < 2 || root[1] != ':') return 0;
+    return static_cast<char>(std::toupper(static_cast<unsigned char>(root[0])));
+}
+
+static bool underRoot(const std::string& path, const std::string& root) {
+    if (path.size() < root.size()) return false;
+    if (FileIndex::fold(path.substr(0, root.size())) != FileIndex::fold(root)) return false;
+    return path.size() == root.size() || root.back() == '\\' || path[root.size()] == '\\';
+}
+
+bool currentJournalPosition(const std::string& root, SnapshotInfo& info) {
+    info.volume = volumeOf(root);
+    if (!info.volume) return false;
+
+    Volume vol(info.volume);
+    bool ok = vol.getHandle() && vol.getUSNInfo();
+    if (ok) {
+        info.journalId = vol.getJournalId();
+        info.nextUsn = vol.getNextUsn();
+    }
+    vol.closeHandle();
+    return ok;
+}
+
+namespace {
+
+// 这些原因意味着大小或时间可能变了
+constexpr DWORD CONTENT_REASONS = USN_REASON_FILE_CREATE | USN_REASON_DATA_OVERWRITE | USN_REASON_DATA_EXTEND |
+                                  USN_REASON_DATA_TRUNCATION | USN_REASON_BASIC_INFO_CHANGE;
+
+// 同一个 FRN 在这段日志中的净变化
+struct NetChange {
+    size_t order = 0;                  // 第一次出现的位置
+    DWORD reasons = 0;                 // 所有记录的原因合集
+    DWORD attributes = 0;
+    bool renamed = false;
+    DWORDLONG oldParent = 0;           // 第一次改名前的位置
+    std::wstring oldName;
+    DWORDLONG lastParent = 0;          // 最后一条记录中的位置（用于已删除的文件）
+    std::wstring lastName;
+};
+
+} // namespace
+
+bool catchUpJournal(const SnapshotInfo& info, const std::string& root, FileIndex& index, Database* db) {
+    if (!info.volume || info.volume != volumeOf(root)) return false;
+
+    Volume vol(info.volume);
+    if (!vol.getHandle() || !vol.getUSNInfo()) {
+        vol.closeHandle();
+        return false;
+    }
+    if (vol.getJournalId() != info.journalId) {
+        LOG_WARN("USN 日志已被重建，快照之后的变更无法追赶。");
+        vol.closeHandle();
+        return false;
+    }
+
+    std::vector<UsnChange> records;
+    if (!vol.readJournal(info.nextUsn, records)) {
+        vol.closeHandle();
+        return false;
+    }
+
+    // 按 FRN 合并，多次修改只需处理一次
+    std::unordered_map<DWORDLONG, NetChange> net;
+    for (size_t i = 0; i < records.size(); ++i) {
+        const UsnChange& r = records[i];
+        auto [it, inserted] = net.try_emplace(r.frn);
+        NetChange& c = it->second;
+        if (inserted) c.order = i;
+        c.reasons |= r.reason;
+        c.attributes = r.attributes;
+        if ((r.reason & USN_REASON_RENAME_OLD_NAME) && !c.renamed) {
+            c.renamed = true;
+            c.oldParent = r.pfrn;
+            c.oldName = r.filename;
+        }
+        c.lastParent = r.pfrn;
+        c.lastName = r.filename;
+    }
+
+    // 目录先于文件处理，子项的旧路径才能基于已更新的目录路径求出
+    std::vector<std::pair<DWORDLONG, const NetChange*>> order;
+    order.reserve(net.size());
+    for (const auto& [frn, c] : net) order.emplace_back(frn, &c);
+    std::sort(order.begin(), order.end(), [](const auto& a, const auto& b) {
+        bool dirA = a.second->attributes & FILE_ATTRIBUTE_DIRECTORY;
+        bool dirB = b.second->attributes & FILE_ATTRIBUTE_DIRECTORY;
+        if (dirA != dirB) return dirA;
+        return a.second->order < b.second->order;
+    });
+
+    std::unordered_map<DWORDLONG, std::string> dirPaths;
+    auto pathIn = [&](DWORDLONG parent, const std::wstring& name, std::string& out) {
+        auto it = dirPaths.find(parent);
+        if (it == dirPaths.end()) {
+            std::wstring w;
+            if (!vol.getPathById(parent, w)) return false;   // 上级目录也已不存在
+            it = dirPaths.emplace(parent, wide_to_utf8(w)).first;
+        }
+        out = it->second;
+        if (!out.empty() && out.back() != '\\') out += '\\';
+        out += wide_to_utf8(name);
+        return true;
+    };
+    const bool useDb = db && db->isConnected();
+    const auto rules = exclusionRules();
+
+    size_t applied = 0;
+    for (const auto& [frn, c] : order) {
+        std::string oldPath;
+        if (c->reasons & USN_REASON_FILE_DELETE) {
+            const DWORDLONG parent = c->renamed ? c->oldParent : c->lastParent;
+            const std::wstring& name = c->renamed ? c->oldName : c->lastName;
+            if (!pathIn(parent, name, oldPath) || !underRoot(oldPath, root) || rules->excluded(oldPath)) continue;
+            if (useDb) db->deleteRecord(oldPath);
+            index.remove(oldPath);
+            ++applied;
+            continue;
+        }
+
+        std::wstring current;
+        if (!vol.getPathById(frn, current)) continue;
+        std::string path = wide_to_utf8(current);
+        const bool excluded = rules->excluded(path);
+
+        // dirPaths 缓存的是目录的当前路径，改名前的旧路径由当前的上级路径加旧名称得到
+        if (c->renamed && pathIn(c->oldParent, c->oldName, oldPath) && oldPath != path &&
+            underRoot(oldPath, root) && !rules->excluded(oldPath)) {
+            if (excluded) {
+                // 移入了排除的目录
+                if (useDb) db->deleteRecord(oldPath);
+                index.remove(oldPath);
+                ++applied;
+                continue;
+            }
+            // 只改了名称或位置的项不需要重新取文件信息
+            const bool inDb = !useDb || db->renameRecord(frn, oldPath, path) == 1;
+            const bool inIndex = index.rename(oldPath, path);
+            if (inDb && inIndex && underRoot(path, root) && !(c->reasons & CONTENT_REASONS)) {
+                ++applied;
+                continue;
+            }
+        }
+
+        if (excluded || !underRoot(path, root)) continue;
+        FileRecord record = makeRecord(path);
+        record.frn = frn;
+        if (useDb && ((c->reasons & USN_REASON_FILE_CREATE) || c->renamed)) db->addRecord(record);
+        index.upsert(record);
+        ++applied;
+    }
+
+    vol.closeHandle();
+    LOG_INFO("USN 日志追赶完毕: " << records.size() << " 条记录，应用 " << applied << " 项变更。");
+    return true;
+}
+
+#else
+// Linux 没有对应的变更日志。快照之后的变化由事件源开始监控根目录时安排的整体重扫补上
+// （SourceBatch::rootAdded），载入快照后无需在这里追赶
+
+bool currentJournalPosition(const std::string&, SnapshotInfo& info) {
+    info = SnapshotInfo();
+    return false;
+}
+
+bool catchUpJournal(const SnapshotInfo&, const std::string&, FileIndex&, Database*) {
+    return true;
+}
+#endif
@@ -0,0 +1,616 @@
+#ifdef __linux__
+#include "../include/linux_source.h"
+#include "../include/log.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/fanotify.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace {
+
+constexpr uint64_t FAN_MASK = FAN_CREATE | FAN_DELETE | FAN_MODIFY | FAN_RENAME | FAN_ONDIR;
+
+constexpr uint32_t INOTIFY_MASK = IN_CREATE | IN_DELETE | IN_MODIFY | IN_MOVED_FROM | IN_MOVED_TO |
+                                  IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+
+// 去掉末尾的 /，根目录本身保留
+std::string normalize(const std::string& path) {
+    std::string out = path;
+    while (out.size() > 1 && out.back() == '/') out.pop_back();
+    return out;
+}
+
+// path 等于 dir 或位于其下
+bool under(const std::string& path, const std::string& dir) {
+    if (dir == "/") return !path.empty() && path[0] == '/';
+    return path.compare(0, dir.size(), dir) == 0 && (path.size() == dir.size() || path[dir.size()] == '/');
+}
+
+bool overlaps(const std::string& a, const std::string& b) {
+    return under(a, b) || under(b, a);
+}
+
+std::string join(const std::string& dir, const char* name) {
+    return dir == "/" ? "/" + std::string(name) : dir + "/" + name;
+}
+
+std::string relativeTo(const std::string& path, const std::string& root) {
+    if (path.size() <= root.size()) return {};
+    return path.substr(root == "/" ? 1 : root.size() + 1);
+}
+
+// statfs 与 fanotify 中的 fsid 类型不同，内容一致
+template <typename Fsid>
+uint64_t fsidOf(const Fsid& fsid) {
+    uint64_t out = 0;
+    static_assert(sizeof(fsid) == sizeof(out), "fsid");
+    std::memcpy(&out, &fsid, sizeof(out));
+    return out;
+}
+
+// 现存项的 inode 与所在设备作为文件标识；已被删除的项无从取得，保持未知
+void identify(SourceEvent& event) {
+    struct stat st;
+    if (lstat(event.path.c_str(), &st) != 0) return;
+    event.fileId = st.st_ino;
+    event.volume = st.st_dev;
+}
+
+} // namespace
+
+LinuxEventSource::LinuxEventSource() : buffer(BUFFER_SIZE / sizeof(uint64_t)) {
+    fanFd = fanotify_init(FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK | FAN_REPORT_DFID_NAME,
+                          O_RDONLY | O_LARGEFILE);
+    if (fanFd < 0) {
+        LOG_INFO("fanotify 不可用，改用 inotify，错误码: " << errno);
+    }
+    inoFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inoFd < 0) {
+        LOG_ERROR("无法创建 inotify，错误码: " << errno);
+    }
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+LinuxEventSource::~LinuxEventSource() {
+    stop();
+    // run 返回时所有根目录都已释放，这里只剩从未开始监控的
+    for (const auto& root : addedRoots) {
+        if (root.dirFd >= 0) close(root.dirFd);
+    }
+    if (fanFd >= 0) close(fanFd);
+    if (inoFd >= 0) close(inoFd);
+    if (wakeFd >= 0) close(wakeFd);
+}
+
+void LinuxEventSource::wake() {
+    if (wakeFd < 0) return;
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t n = write(wakeFd, &one, sizeof(one));
+}
+
+void LinuxEventSource::stop() {
+    stopRequested = true;
+    wake();
+}
+
+bool LinuxEventSource::addRoot(const std::string& path) {
+    if (wakeFd < 0 || (fanFd < 0 && inoFd < 0)) {
+        LOG_ERROR("事件源未能初始化，无法监控: " << path);
+        return false;
+    }
+
+    Root root;
+    root.path = normalize(path);
+    {
+        std::lock_guard<std::mutex> lock(rootsMtx);
+        for (const auto& existing : rootPaths) {
+            if (overlaps(root.path, existing)) {
+                LOG_WARN("与已监控的目录重叠，忽略: " << path);
+                return false;
+            }
+        }
+    }
+
+    int dirFd = open(root.path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0) {
+        LOG_ERROR("无法打开目录: " << path << " 错误码: " << errno);
+        return false;
+    }
+
+    // fanotify 标记的是整个文件系统，同一文件系统上的其他根目录重复标记没有影响
+    struct statfs fs {};
+    if (fanFd >= 0 && fstatfs(dirFd, &fs) == 0 &&
+        fanotify_mark(fanFd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, FAN_MASK, dirFd, nullptr) == 0) {
+        root.fanotify = true;
+        root.dirFd = dirFd;
+        root.fsid = fsidOf(fs.f_fsid);
+    } else {
+        if (fanFd >= 0) {
+            LOG_INFO("文件系统不支持 fanotify，改用 inotify: " << path << " 错误码: " << errno);
+        }
+        close(dirFd);
+        if (inoFd < 0) return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(rootsMtx);
+        // 打开目录期间可能有另一个线程添加了重叠的根目录
+        for (const auto& existing : rootPaths) {
+            if (overlaps(root.path, existing)) {
+                LOG_WARN("与已监控的目录重叠，忽略: " << path);
+                if (root.dirFd >= 0) close(root.dirFd);
+                return false;
+            }
+        }
+        root.id = nextRootId++;
+        rootPaths.push_back(root.path);
+        addedRoots.push_back(std::move(root));
+    }
+    wake();
+    LOG_INFO("开始监控目录: " << path);
+    return true;
+}
+
+bool LinuxEventSource::removeRoot(const std::string& path) {
+    const std::string key = normalize(path);
+    {
+        std::lock_guard<std::mutex> lock(rootsMtx);
+        auto it = std::find(rootPaths.begin(), rootPaths.end(), key);
+        if (it == rootPaths.end()) return false;
+        rootPaths.erase(it);
+        removedRoots.push_back(key);
+    }
+    wake();
+    return true;
+}
+
+void LinuxEventSource::takeRootRequests() {
+    std::vector<Root> added;
+    std::vector<std::string> removed;
+    {
+        std::lock_guard<std::mutex> lock(rootsMtx);
+        added.swap(addedRoots);
+        removed.swap(removedRoots);
+    }
+
+    for (auto& root : added) {
+        roots.push_back(std::move(root));
+        if (!roots.back().fanotify) watchTree(roots.back(), roots.back().path, false);
+        // 未监控期间的变化无从得知，由写入线程重扫整个根目录补上
+        if (isRunning) batchFor(roots.back()).batch.rootAdded = true;
+    }
+    for (const auto& key : removed) {
+        auto it = std::find_if(roots.begin(), roots.end(), [&](const Root& r) { return r.path == key; });
+        if (it == roots.end()) continue;
+        Root root = std::move(*it);
+        roots.erase(it);
+        releaseRoot(root);
+    }
+}
+
+void LinuxEventSource::releaseRoot(const Root& root) {
+    if (root.fanotify) {
+        // 同一文件系统上还有其他根目录时保留标记
+        bool shared = std::any_of(roots.begin(), roots.end(), [&](const Root& r) {
+            return r.fanotify && r.fsid == root.fsid;
+        });
+        if (!shared) fanotify_mark(fanFd, FAN_MARK_REMOVE | FAN_MARK_FILESYSTEM, FAN_MASK, root.dirFd, nullptr);
+        close(root.dirFd);
+    } else {
+        unwatchTree(root.path);
+    }
+    LOG_INFO("停止监控目录: " << root.path);
+}
+
+const LinuxEventSource::Root* LinuxEventSource::rootOf(const std::string& path) const {
+    for (const auto& root : roots) {
+        if (under(path, root.path)) return &root;
+    }
+    return nullptr;
+}
+
+LinuxEventSource::Pending& LinuxEventSource::batchFor(const Root& root) {
+    for (auto& p : pending) {
+        if (p.batch.root == root.id) return p;
+    }
+    Pending& p = pending.emplace_back();
+    p.batch.root = root.id;
+    p.batch.rootPath = root.path;
+    // 根目录各级只判断一次，每条变更从根目录的位置继续判断相对路径
+    rules->walk(p.rootCursor, root.path);
+    return p;
+}
+
+bool LinuxEventSource::excluded(const Root& root, const std::string& path) {
+    ExclusionRules::Cursor cursor = batchFor(root).rootCursor;
+    return rules->walk(cursor, relativeTo(path, root.path));
+}
+
+void LinuxEventSource::emit(const Root& root, SourceEvent::Action action, const std::string& path) {
+    if (path == root.path || excluded(root, path)) return;
+    SourceEvent event;
+    event.action = action;
+    event.path = path;
+    if (action != SourceEvent::Removed) identify(event);
+    batchFor(root).batch.events.push_back(std::move(event));
+}
+
+void LinuxEventSource::renamed(const std::string& oldPath, const std::string& newPath, bool dir) {
+    const Root* from = rootOf(oldPath);
+    const Root* to = rootOf(newPath);
+
+    if (from && to) {
+        // 两条放在同一批中，跨根目录的移动也能配对；被排除的路径同样保留，由写入线程当作删除或添加
+        SourceEvent oldEvent;
+        oldEvent.action = SourceEvent::RenamedOld;
+        oldEvent.path = oldPath;
+        oldEvent.excluded = excluded(*from, oldPath);
+        SourceEvent newEvent;
+        newEvent.action = SourceEvent::RenamedNew;
+        newEvent.path = newPath;
+        newEvent.excluded = excluded(*to, newPath);
+        // 重命名不改变 inode，旧路径沿用新路径上取得的标识
+        identify(newEvent);
+        oldEvent.fileId = newEvent.fileId;
+        oldEvent.volume = newEvent.volume;
+        auto& events = batchFor(*from).batch.events;
+        events.push_back(std::move(oldEvent));
+        events.push_back(std::move(newEvent));
+    } else if (from) {
+        emit(*from, SourceEvent::Removed, oldPath);
+    } else if (to) {
+        emit(*to, SourceEvent::Added, newPath);
+    }
+
+    if (!dir) return;
+    // inotify 的监视随目录移动；移入排除范围或根目录之外的不再监视
+    if (to && !to->fanotify && !excluded(*to, newPath)) {
+        if (from && !from->fanotify) {
+            moveTree(oldPath, newPath, *to);
+        } else {
+            watchTree(*to, newPath, !from);
+        }
+    } else if (from && !from->fanotify) {
+        unwatchTree(oldPath);
+    }
+}
+
+void LinuxEventSource::overflow(bool fanotify) {
+    // 溢出前读到的变更先交付，溢出标记单独成批
+    flush();
+    for (const auto& root : roots) {
+        if (root.fanotify != fanotify) continue;
+        LOG_WARN("事件队列溢出: " << root.path);
+        batchFor(root).batch.overflow = true;
+        // 溢出期间新建的目录没有监视，重新登记一遍
+        if (!fanotify) watchTree(root, root.path, false);
+    }
+    flush();
+}
+
+void LinuxEventSource::flush() {
+    for (auto& p : pending) {
+        if (p.batch.events.empty() && !p.batch.overflow && !p.batch.rootAdded) continue;
+        (*deliver)(nextSequence++, std::move(p.batch));
+    }
+    pending.clear();
+}
+
+std::string LinuxEventSource::resolve(const void* info, std::unordered_map<std::string, std::string>& cache) const {
+    auto* fid = static_cast<const fanotify_event_info_fid*>(info);
+    auto* handle = reinterpret_cast<const file_handle*>(fid->handle);
+    const uint64_t fsid = fsidOf(fid->fsid);
+
+    std::string key(reinterpret_cast<const char*>(&fsid), sizeof(fsid));
+    key.append(reinterpret_cast<const char*>(handle), sizeof(file_handle) + handle->handle_bytes);
+    auto cached = cache.find(key);
+    if (cached != cache.end()) return cached->second;
+
+    std::string path;
+    auto root = std::find_if(roots.begin(), roots.end(), [&](const Root& r) {
+        return r.fanotify && r.fsid == fsid;
+    });
+    if (root != roots.end()) {
+        int fd = open_by_handle_at(root->dirFd, const_cast<file_handle*>(handle), O_PATH | O_CLOEXEC);
+        if (fd >= 0) {
+            char link[64];
+            char target[4096];
+            snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+            ssize_t len = readlink(link, target, sizeof(target));
+            close(fd);
+            // 目录已被删除时得不到路径
+            static constexpr char DELETED[] = " (deleted)";
+            if (len > 0 && static_cast<size_t>(len) < sizeof(target)) {
+                path.assign(target, static_cast<size_t>(len));
+                if (path.size() >= sizeof(DELETED) - 1 &&
+                    path.compare(path.size() - (sizeof(DELETED) - 1), std::string::npos, DELETED) == 0) {
+                    path.clear();
+                }
+            }
+        }
+    }
+    cache.emplace(std::move(key), path);
+    return path;
+}
+
+void LinuxEventSource::readFanotify() {
+    ssize_t len = read(fanFd, buffer.data(), BUFFER_SIZE);
+    if (len <= 0) {
+        if (len < 0 && errno != EAGAIN && errno != EINTR) LOG_WARN("fanotify 读取失败: " << errno);
+        return;
+    }
+
+    // 同一次读取中的父目录只还原一次；之间的重命名不影响已还原的结果，因为内核按发生顺序排队
+    std::unordered_map<std::string, std::string> cache;
+    auto* event = reinterpret_cast<const fanotify_event_metadata*>(buffer.data());
+    for (; FAN_EVENT_OK(event, len); event = FAN_EVENT_NEXT(event, len)) {
+        if (event->vers != FANOTIFY_METADATA_VERSION) {
+            LOG_ERROR("fanotify 版本不符: " << static_cast<int>(event->vers));
+            return;
+        }
+        if (event->fd >= 0) close(event->fd);
+        if (event->mask & FAN_Q_OVERFLOW) {
+            overflow(true);
+            continue;
+        }
+
+        std::string path, oldPath, newPath;
+        const char* base = reinterpret_cast<const char*>(event);
+        for (size_t offset = event->metadata_len; offset < event->event_len;) {
+            auto* header = reinterpret_cast<const fanotify_event_info_header*>(base + offset);
+            if (header->len == 0) break;
+            offset += header->len;
+            if (header->info_type != FAN_EVENT_INFO_TYPE_DFID_NAME &&
+                header->info_type != FAN_EVENT_INFO_TYPE_OLD_DFID_NAME &&
+                header->info_type != FAN_EVENT_INFO_TYPE_NEW_DFID_NAME) {
+                continue;
+            }
+            auto* fid = reinterpret_cast<const fanotify_event_info_fid*>(header);
+            auto* handle = reinterpret_cast<const file_handle*>(fid->handle);
+            const char* name = reinterpret_cast<const char*>(handle->f_handle + handle->handle_bytes);
+
+            std::string dir = resolve(fid, cache);
+            if (dir.empty()) continue;
+            std::string full = std::strcmp(name, ".") == 0 ? dir : join(dir, name);
+            switch (header->info_type) {
+            case FAN_EVENT_INFO_TYPE_OLD_DFID_NAME: oldPath = std::move(full); break;
+            case FAN_EVENT_INFO_TYPE_NEW_DFID_NAME: newPath = std::move(full); break;
+            default: path = std::move(full); break;
+            }
+        }
+
+        if (event->mask & FAN_RENAME) {
+            renamed(oldPath, newPath, event->mask & FAN_ONDIR);
+            continue;
+        }
+        const Root* root = path.empty() ? nullptr : rootOf(path);
+        if (!root || !root->fanotify) continue;
+
+        // 同一项的事件会被合并；同时有创建与删除时先后无从得知，以现在是否存在为准
+        const bool created = event->mask & FAN_CREATE;
+        const bool deleted = event->mask & FAN_DELETE;
+        if (created && deleted) {
+            struct stat st;
+            emit(*root, lstat(path.c_str(), &st) == 0 ? SourceEvent::Added : SourceEvent::Removed, path);
+            continue;
+        }
+        if (created) emit(*root, SourceEvent::Added, path);
+        if ((event->mask & FAN_MODIFY) && !(event->mask & FAN_ONDIR)) emit(*root, SourceEvent::Modified, path);
+        if (deleted) emit(*root, SourceEvent::Removed, path);
+    }
+}
+
+void LinuxEventSource::watchTree(const Root& root, const std::string& path, bool reportAdded) {
+    // 深度优先登记其下的全部目录；reportAdded 时把已有的项报告为新增，目录建好到登记监视之间
+    // 创建的项才不会漏掉
+    struct Level {
+        std::string path;
+        ExclusionRules::Cursor cursor;
+    };
+    std::vector<Level> stack;
+    Level top{path, batchFor(root).rootCursor};
+    if (rules->walk(top.cursor, relativeTo(path, root.path))) return;
+    stack.push_back(std::move(top));
+
+    while (!stack.empty()) {
+        Level level = std::move(stack.back());
+        stack.pop_back();
+
+        int wd = inotify_add_watch(inoFd, level.path.c_str(), INOTIFY_MASK);
+        if (wd < 0) {
+            if (errno == ENOSPC) {
+                LOG_WARN("inotify 监视数已达上限（fs.inotify.max_user_watches）: " << level.path);
+            }
+            continue;
+        }
+        dirs[wd] = {level.path, root.id};
+
+        DIR* dir = opendir(level.path.c_str());
+        if (!dir) continue;
+        while (dirent* entry = readdir(dir)) {
+            if (std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0) continue;
+            ExclusionRules::Cursor cursor = level.cursor;
+            if (rules->step(cursor, std::string_view(entry->d_name))) continue;
+
+            std::string child = join(level.path, entry->d_name);
+            bool isDir = entry->d_type == DT_DIR;
+            if (entry->d_type == DT_UNKNOWN) {
+                struct stat st;
+                isDir = lstat(child.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+            }
+            if (reportAdded) {
+                SourceEvent event;
+                event.action = SourceEvent::Added;
+                event.path = child;
+                identify(event);
+                batchFor(root).batch.events.push_back(std::move(event));
+            }
+            if (isDir) stack.push_back({std::move(child), cursor});
+        }
+        closedir(dir);
+    }
+}
+
+void LinuxEventSource::unwatchTree(const std::string& path) {
+    for (auto it = dirs.begin(); it != dirs.end();) {
+        if (under(it->second.path, path)) {
+            inotify_rm_watch(inoFd, it->first);
+            it = dirs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void LinuxEventSource::moveTree(const std::string& oldPath, const std::string& newPath, const Root& to) {
+    for (auto& [wd, dir] : dirs) {
+        if (!under(dir.path, oldPath)) continue;
+        dir.path = newPath + dir.path.substr(oldPath.size());
+        dir.root = to.id;
+    }
+}
+
+void LinuxEventSource::settleHalfMove() {
+    // 没有等到 IN_MOVED_TO：移到了监视范围之外
+    if (!haveHalfMove) return;
+    haveHalfMove = false;
+    renamed(halfMove.path, {}, halfMove.dir);
+}
+
+void LinuxEventSource::readInotify() {
+    ssize_t len = read(inoFd, buffer.data(), BUFFER_SIZE);
+    if (len <= 0) {
+        if (len < 0 && errno != EAGAIN && errno != EINTR) LOG_WARN("inotify 读取失败: " << errno);
+        return;
+    }
+
+    const char* base = reinterpret_cast<const char*>(buffer.data());
+    auto at = [&](ssize_t offset) { return reinterpret_cast<const inotify_event*>(base + offset); };
+    auto pathOf = [&](const inotify_event* event) -> std::string {
+        auto it = dirs.find(event->wd);
+        if (it == dirs.end() || event->len == 0) return {};
+        return join(it->second.path, event->name);
+    };
+
+    for (ssize_t offset = 0; offset < len;) {
+        const inotify_event* event = at(offset);
+        offset += sizeof(inotify_event) + event->len;
+
+        // 上次读取末尾的 IN_MOVED_FROM 与这次开头的 IN_MOVED_TO 是同一次移动
+        if (haveHalfMove) {
+            if ((event->mask & IN_MOVED_TO) && event->cookie == halfMove.cookie) {
+                haveHalfMove = false;
+                renamed(halfMove.path, pathOf(event), halfMove.dir);
+                continue;
+            }
+            settleHalfMove();
+        }
+
+        if (event->mask & IN_Q_OVERFLOW) {
+            overflow(false);
+            continue;
+        }
+        if (event->mask & IN_IGNORED) {
+            dirs.erase(event->wd);
+            continue;
+        }
+
+        std::string path = pathOf(event);
+        if (path.empty()) continue;
+        const bool isDir = event->mask & IN_ISDIR;
+
+        if (event->mask & IN_MOVED_FROM) {
+            // 同一次移动的 IN_MOVED_TO 紧跟在后面
+            if (offset < len && (at(offset)->mask & IN_MOVED_TO) && at(offset)->cookie == event->cookie) {
+                const inotify_event* next = at(offset);
+                offset += sizeof(inotify_event) + next->len;
+                renamed(path, pathOf(next), isDir);
+            } else if (offset >= len) {
+                halfMove = {std::move(path), event->cookie, isDir};
+                haveHalfMove = true;
+            } else {
+                renamed(path, {}, isDir);
+            }
+            continue;
+        }
+
+        const Root* root = rootOf(path);
+        if (!root) continue;
+        if (event->mask & IN_MOVED_TO) {
+            renamed({}, path, isDir);
+        } else if (event->mask & IN_CREATE) {
+            emit(*root, SourceEvent::Added, path);
+            if (isDir) watchTree(*root, path, true);
+        } else if (event->mask & IN_DELETE) {
+            emit(*root, SourceEvent::Removed, path);
+        } else if ((event->mask & IN_MODIFY) && !isDir) {
+            emit(*root, SourceEvent::Modified, path);
+        }
+    }
+}
+
+void LinuxEventSource::run(const Deliver& fn) {
+    if (wakeFd < 0 || (fanFd < 0 && inoFd < 0)) {
+        LOG_ERROR("事件源未能初始化");
+        return;
+    }
+
+    isRunning = true;
+    deliver = &fn;
+    nextSequence = 0;
+    rules = exclusionRules();
+    takeRootRequests();
+    flush();
+
+    pollfd fds[3] = {
+        {wakeFd, POLLIN, 0},
+        {fanFd, POLLIN, 0},
+        {inoFd, POLLIN, 0},
+    };
+    while (!stopRequested) {
+        int ready = poll(fds, 3, haveHalfMove ? MOVE_PAIR_MS : -1);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR("poll 失败，错误码: " << errno);
+            break;
+        }
+
+        // 每轮使用当时的排除规则，替换后新读到的变更即按新规则过滤
+        rules = exclusionRules();
+        if (ready == 0) settleHalfMove();
+        if (fds[0].revents & POLLIN) {
+            uint64_t count;
+            [[maybe_unused]] ssize_t n = read(wakeFd, &count, sizeof(count));
+            takeRootRequests();
+        }
+        if (fds[1].revents & POLLIN) readFanotify();
+        if (fds[2].revents & POLLIN) readInotify();
+        flush();
+    }
+    stopRequested = false;
+    isRunning = false;
+
+    // 释放全部根目录；run 返回后不再交付
+    settleHalfMove();
+    flush();
+    takeRootRequests();
+    std::vector<Root> remaining;
+    remaining.swap(roots);
+    for (const auto& root : remaining) releaseRoot(root);
+    {
+        std::lock_guard<std::mutex> lock(rootsMtx);
+        rootPaths.clear();
+    }
+    deliver = nullptr;
+}
+#endif
@@ -0,0 +1,250 @@
+#include "../include/live_query.h"
+#include "../include/parallel.h"
+#include "../include/query_index.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+// 同一节点先后两次变化合并后的净效果；返回 0 表示抵消
+uint8_t combine(LiveChange::Kind earlier, LiveChange::Kind later) {
+    if (earlier == LiveChange::Added) {
+        return later == LiveChange::Removed ? 0 : LiveChange::Added;
+    }
+    if (earlier == LiveChange::Removed) {
+        return later == LiveChange::Removed ? LiveChange::Removed : LiveChange::Updated;
+    }
+    return later;
+}
+
+} // namespace
+
+LiveQueries::LiveQueries(std::shared_ptr<FileIndex> fileIndex, std::shared_ptr<QueryIndexes> queryIndexes)
+    : indexOwner(std::move(fileIndex)), indexesOwner(std::move(queryIndexes)), index(*indexOwner),
+      indexes(*indexesOwner), seenVersion(index.getVersion()) {
+    worker = std::thread(&LiveQueries::run, this);
+}
+
+LiveQueries::~LiveQueries() {
+    stop();
+}
+
+void LiveQueries::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (worker.joinable() && worker.get_id() != std::this_thread::get_id()) worker.join();
+}
+
+uint32_t LiveQueries::subscribe(const std::string& text, Deliver deliver, std::string* error) {
+    auto sub = std::make_shared<Subscription>();
+    std::string parseError;
+    if (!Query::parse(text, sub->query, parseError)) {
+        if (error) *error = parseError;
+        return 0;
+    }
+    for (const auto& term : sub->query.getTerms()) {
+        if (term.kind == TermKind::Scope || term.kind == TermKind::Path) sub->pathDependent = true;
+    }
+    sub->deliver = std::move(deliver);
+
+    if (sub->query.scoped()) index.buildTour();
+    {
+        auto lock = index.lockShared();
+        sub->query.bind(index);
+        std::vector<FileId> matches;
+        evaluate(sub->query, matches);
+        for (FileId id : matches) sub->members.add(id);
+        sub->mark = index.changeMark();
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    const uint32_t id = nextId++;
+    subscriptions.emplace(id, std::move(sub));
+    return id;
+}
+
+bool LiveQueries::unsubscribe(uint32_t id) {
+    std::shared_ptr<Subscription> sub;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = subscriptions.find(id);
+        if (it == subscriptions.end()) return false;
+        sub = std::move(it->second);
+        subscriptions.erase(it);
+    }
+    sub->active = false;
+    if (std::this_thread::get_id() != worker.get_id()) {
+        std::lock_guard<std::mutex> wait(deliverMtx);
+    }
+    return true;
+}
+
+bool LiveQueries::poll(uint32_t id, const std::function<bool(const LiveChange&)>& take, bool& reset) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = subscriptions.find(id);
+    if (it == subscriptions.end()) return false;
+    Subscription& sub = *it->second;
+
+    reset = sub.reset;
+    sub.reset = false;
+    for (auto change = sub.pending.begin(); change != sub.pending.end();) {
+        if (!take(LiveChange{change->first, change->second})) break;
+        change = sub.pending.erase(change);
+    }
+    return true;
+}
+
+void LiveQueries::run() {
+    std::unique_lock<std::mutex> lock(mtx);
+    while (!stopping) {
+        wake.wait_for(lock, INTERVAL, [this] { return stopping; });
+        if (stopping) break;
+
+        // 一个间隔内的全部写入合成一轮
+        const uint64_t version = index.getVersion();
+        if (version == seenVersion || subscriptions.empty()) continue;
+        seenVersion = version;
+        std::vector<std::pair<uint32_t, std::shared_ptr<Subscription>>> current(subscriptions.begin(),
+                                                                                subscriptions.end());
+        lock.unlock();
+
+        for (auto& [id, sub] : current) {
+            std::vector<LiveChange> changes;
+            bool reset = false;
+            refresh(*sub, changes, reset);
+            if (!changes.empty() || reset) publish(id, *sub, std::move(changes), reset);
+        }
+        lock.lock();
+    }
+}
+
+void LiveQueries::evaluate(const Query& query, std::vector<FileId>& out) {
+    out.clear();
+    std::vector<FileId> candidates;
+    bool planned = false;
+    if (!query.empty()) {
+        QueryPlan plan = planQuery(query, index, indexes);
+        planned = collectCandidates(plan, index, indexes, candidates);
+    }
+
+    const size_t total = planned ? candidates.size() : index.nodeCount();
+    const size_t chunks = chunkCount(total, 1 << 15);
+    std::vector<std::vector<FileId>> partial(chunks);
+    parallelFor(total, chunks, [&](size_t chunk, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            FileId id = planned ? candidates[i] : static_cast<FileId>(i);
+            if (index.isListed(id) && query.matches(index, id)) partial[chunk].push_back(id);
+        }
+    });
+    for (const auto& p : partial) out.insert(out.end(), p.begin(), p.end());
+}
+
+void LiveQueries::underChanged(const std::vector<FileId>& changed, const std::vector<FileId>& members,
+                               std::vector<FileId>& out) {
+    // 沿上级链查到状态已知的节点为止，整链记下结果，每个节点只走一次
+    constexpr uint8_t UNKNOWN = 0, CHANGED = 1, CLEAN = 2;
+    ancestry.assign(index.nodeCount(), UNKNOWN);
+    for (FileId id : changed) {
+        if (id < ancestry.size()) ancestry[id] = CHANGED;
+    }
+
+    std::vector<FileId> chain;
+    for (FileId id : members) {
+        chain.clear();
+        FileId cur = id;
+        while (cur != INVALID_FILE_ID && ancestry[cur] == UNKNOWN) {
+            chain.push_back(cur);
+            cur = index.parentOf(cur);
+        }
+        const uint8_t state = cur == INVALID_FILE_ID ? CLEAN : ancestry[cur];
+        for (FileId c : chain) ancestry[c] = state;
+        if (state == CHANGED) out.push_back(id);
+    }
+}
+
+void LiveQueries::refresh(Subscription& sub, std::vector<LiveChange>& out, bool& reset) {
+    if (sub.query.scoped()) index.buildTour();
+    auto lock = index.lockShared();
+
+    std::vector<FileId> changed;
+    const uint64_t mark = index.changeMark();
+    // 索引被清空时日志同样作废
+    const bool logged = index.changedSince(sub.mark, changed);
+    sub.mark = mark;
+    if (logged && changed.empty()) return;
+
+    std::vector<FileId> before;
+    sub.members.appendTo(before);
+
+    std::vector<FileId> now;
+    if (!logged || sub.pathDependent) {
+        sub.query.bind(index);
+        evaluate(sub.query, now);
+
+        std::vector<FileId> added;
+        std::vector<FileId> removed;
+        std::set_difference(now.begin(), now.end(), before.begin(), before.end(), std::back_inserter(added));
+        std::set_difference(before.begin(), before.end(), now.begin(), now.end(), std::back_inserter(removed));
+        for (FileId id : added) out.push_back({id, LiveChange::Added});
+        for (FileId id : removed) out.push_back({id, LiveChange::Removed});
+
+        sub.members.clear();
+        for (FileId id : now) sub.members.add(id);
+        if (!logged) {
+            reset = true;
+            return;
+        }
+    } else {
+        for (FileId id : changed) {
+            const bool was = sub.members.contains(id);
+            const bool is = id < index.nodeCount() && index.isListed(id) && sub.query.matches(index, id);
+            if (is && !was) {
+                sub.members.add(id);
+                out.push_back({id, LiveChange::Added});
+            } else if (!is && was) {
+                sub.members.remove(id);
+                out.push_back({id, LiveChange::Removed});
+            }
+        }
+    }
+
+    // 前后都匹配的项中，自身或某个上级目录变化过的按更新报告
+    std::vector<FileId> touched;
+    underChanged(changed, before, touched);
+    for (FileId id : touched) {
+        if (sub.members.contains(id)) out.push_back({id, LiveChange::Updated});
+    }
+}
+
+void LiveQueries::publish(uint32_t id, Subscription& sub, std::vector<LiveChange>&& changes, bool reset) {
+    if (changes.size() > MAX_PENDING) {
+        changes.clear();
+        reset = true;
+    }
+
+    if (sub.deliver) {
+        std::lock_guard<std::mutex> guard(deliverMtx);
+        if (sub.active) sub.deliver(id, std::move(changes), reset);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    sub.reset = sub.reset || reset;
+    for (const auto& change : changes) {
+        auto [it, inserted] = sub.pending.try_emplace(change.id, change.kind);
+        if (inserted) continue;
+        if (uint8_t kind = combine(it->second, change.kind)) {
+            it->second = static_cast<LiveChange::Kind>(kind);
+        } else {
+            sub.pending.erase(it);
+        }
+    }
+    if (sub.pending.size() > MAX_PENDING) {
+        sub.pending.clear();
+        sub.reset = true;
+    }
+}
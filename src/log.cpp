@@ -0,0 +1,205 @@
+#include "../include/log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t RING_SIZE = 256;
+constexpr std::chrono::milliseconds FLUSH_INTERVAL{20};
+constexpr std::chrono::seconds RATE_WINDOW{1};
+
+std::atomic<LogLevel> minLevel{LogLevel::Info};
+std::atomic<LogSite*> sites{nullptr};
+
+struct Entry {
+    Clock::time_point time;
+    LogLevel level = LogLevel::Info;
+    std::string text;
+};
+
+// 所属线程写入，后台线程读取
+struct Ring {
+    Entry slots[RING_SIZE];
+    std::atomic<size_t> head{0};   // 仅生产者修改
+    std::atomic<size_t> tail{0};   // 仅消费者修改
+    std::atomic<uint32_t> dropped{0};
+    std::atomic<bool> closed{false};   // 所属线程已退出
+
+    void push(Entry&& entry) {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == RING_SIZE) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        slots[h % RING_SIZE] = std::move(entry);
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    void drain(std::vector<Entry>& out) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        const size_t h = head.load(std::memory_order_acquire);
+        for (; t != h; ++t) out.push_back(std::move(slots[t % RING_SIZE]));
+        tail.store(t, std::memory_order_release);
+    }
+};
+
+const char* levelTag(LogLevel level) {
+    switch (level) {
+    case LogLevel::Debug: return "[DEBUG] ";
+    case LogLevel::Info: return "[INFO] ";
+    case LogLevel::Warn: return "[WARN] ";
+    default: return "[ERROR] ";
+    }
+}
+
+const char* baseName(const char* path) {
+    const char* slash = std::max(std::strrchr(path, '/'), std::strrchr(path, '\\'));
+    return slash ? slash + 1 : path;
+}
+
+class Logger {
+private:
+    std::mutex mtx;
+    std::condition_variable wake;
+    std::condition_variable flushed;
+    std::vector<std::shared_ptr<Ring>> rings;
+    uint64_t requested = 0;   // logFlush 的请求号
+    uint64_t completed = 0;
+
+    void collect(std::vector<std::shared_ptr<Ring>>& active, std::vector<Entry>& batch,
+                 Clock::time_point& windowStart) {
+        const Clock::time_point now = Clock::now();
+        for (auto& ring : active) {
+            ring->drain(batch);
+            if (uint32_t lost = ring->dropped.exchange(0, std::memory_order_relaxed)) {
+                batch.push_back({now, LogLevel::Warn, "日志缓冲区已满，丢弃 " + std::to_string(lost) + " 条。"});
+            }
+        }
+
+        if (now - windowStart < RATE_WINDOW) return;
+        windowStart = now;
+        for (LogSite* site = sites.load(std::memory_order_acquire); site; site = site->next) {
+            uint32_t skipped = site->suppressed.exchange(0, std::memory_order_relaxed);
+            site->count.store(0, std::memory_order_relaxed);
+            if (skipped) {
+                batch.push_back({now, site->level,
+                                 "（" + std::string(baseName(site->file)) + ":" + std::to_string(site->line) +
+                                     " 在 1 秒内另有 " + std::to_string(skipped) + " 条日志被省略）"});
+            }
+        }
+    }
+
+    void run() {
+        std::vector<Entry> batch;
+        Clock::time_point windowStart = Clock::now();
+        for (;;) {
+            std::vector<std::shared_ptr<Ring>> active;
+            uint64_t target;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                wake.wait_for(lock, FLUSH_INTERVAL, [this] { return requested != completed; });
+                target = requested;
+                active = rings;
+            }
+
+            // 先读 closed 再收集：线程退出前写入的内容这一轮一定能收到
+            std::vector<bool> closed(active.size());
+            for (size_t i = 0; i < active.size(); ++i) closed[i] = active[i]->closed.load(std::memory_order_acquire);
+
+            batch.clear();
+            collect(active, batch, windowStart);
+            std::stable_sort(batch.begin(), batch.end(),
+                             [](const Entry& a, const Entry& b) { return a.time < b.time; });
+            for (const auto& entry : batch) {
+                std::ostream& os = entry.level >= LogLevel::Warn ? std::cerr : std::cout;
+                os << levelTag(entry.level) << entry.text << '\n';
+            }
+            if (!batch.empty()) {
+                std::cout.flush();
+                std::cerr.flush();
+            }
+
+            std::lock_guard<std::mutex> lock(mtx);
+            for (size_t i = 0; i < active.size(); ++i) {
+                if (closed[i]) rings.erase(std::find(rings.begin(), rings.end(), active[i]));
+            }
+            completed = target;
+            flushed.notify_all();
+        }
+    }
+
+public:
+    // 后台线程不会退出：在静态析构（DLL 卸载）时等待线程结束会死锁
+    Logger() { std::thread(&Logger::run, this).detach(); }
+
+    void attach(std::shared_ptr<Ring> ring) {
+        std::lock_guard<std::mutex> lock(mtx);
+        rings.push_back(std::move(ring));
+    }
+
+    void urge() { wake.notify_one(); }
+
+    void flush() {
+        std::unique_lock<std::mutex> lock(mtx);
+        const uint64_t ticket = ++requested;
+        wake.notify_one();
+        flushed.wait(lock, [&] { return completed >= ticket; });
+    }
+};
+
+// 有意不释放，见 Logger 的构造函数
+Logger& logger() {
+    static Logger* instance = new Logger();
+    return *instance;
+}
+
+struct RingHolder {
+    std::shared_ptr<Ring> ring;
+    ~RingHolder() {
+        if (ring) ring->closed.store(true, std::memory_order_release);
+    }
+};
+
+Ring& localRing() {
+    thread_local RingHolder holder;
+    if (!holder.ring) {
+        holder.ring = std::make_shared<Ring>();
+        logger().attach(holder.ring);
+    }
+    return *holder.ring;
+}
+
+} // namespace
+
+LogSite::LogSite(LogLevel lvl, const char* f, int l) : level(lvl), file(f), line(l) {
+    next = sites.load(std::memory_order_relaxed);
+    while (!sites.compare_exchange_weak(next, this, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+}
+
+void logSetLevel(LogLevel level) {
+    minLevel.store(level, std::memory_order_relaxed);
+}
+
+bool logEnabled(LogLevel level) {
+    return level >= minLevel.load(std::memory_order_relaxed);
+}
+
+void logWrite(LogLevel level, std::string&& message) {
+    localRing().push({Clock::now(), level, std::move(message)});
+    if (level == LogLevel::Error) logger().urge();
+}
+
+void logFlush() {
+    logger().flush();
+}
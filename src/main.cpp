@@ -1,30 +1,42 @@
-#include <iostream>
+#include <cstdlib>
 #include <vector>
 #include <thread>
 
+#ifdef _WIN32
 #include "../include/volume.h"
 #include "../include/util.h"
+#else
+#include "../include/tree_walker.h"
+#endif
 #include "../include/database.h"
+#include "../include/exclude.h"
 #include "../include/monitor.h"
+#include "../include/log.h"
 
-int main() {
+int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv) {
+#ifdef _WIN32
     SetConsoleOutputCP(CP_UTF8);
     SetConsoleCP(CP_UTF8);
+#endif
+
+    // 日志由后台线程输出，退出前写完
+    std::atexit(logFlush);
 
     // 初始化数据库
     Database db("file_index.db");
     if (!db.open()) {
-        std::cerr << "[ERROR] 无法打开数据库" << std::endl;
+        LOG_ERROR("无法打开数据库");
         return 1;
     }
 
     if (!db.createTable()) {
-        std::cerr << "[ERROR] 创建数据库表失败" << std::endl;
+        LOG_ERROR("创建数据库表失败");
         return 1;
     }
 
-    std::cout << "[INFO] 数据库表已准备好。" << std::endl;
+    LOG_INFO("数据库表已准备好。");
 
+#ifdef _WIN32
     Volume vol('D');  // 要扫描的盘符
 
     if (!vol.getHandle()) return 1;
@@ -32,8 +44,9 @@ int main() {
     vol.createUSN();  // 即使失败也继续尝试（可能日志已存在）
     if (!vol.getUSNInfo()) return 1;
     if (!vol.getUSNJournal()) return 1;
+    vol.applyExclusions(*exclusionRules());
 
-    std::cout << "\n[INFO] 开始处理文件路径并保存到数据库:\n" << std::endl;
+    LOG_INFO("开始处理文件路径并保存到数据库...");
 
     // 收集所有路径用于批量插入
     std::vector<FileRecord> records;
@@ -52,25 +65,43 @@ int main() {
             fileInfo.ftCreationTime,
             fileInfo.ftLastAccessTime,
             fileInfo.ftLastWriteTime,
+            frn,
         };
 
         records.push_back(record);
         count++;
     }
+#else
+    // Linux 没有 MFT 可读，由 TreeWalker 全量扫描根目录（默认为 /，可由参数指定）
+    const std::string root = argc > 1 ? argv[1] : "/";
+    LOG_INFO("开始扫描 " << root << " 并保存到数据库...");
+
+    TreeWalker walker;
+    std::vector<WalkEntry> entries;
+    if (!walker.walk(root, entries)) return 1;
+
+    std::vector<FileRecord> records;
+    TreeWalker::toRecords(entries, records);
+    entries.clear();
+    entries.shrink_to_fit();
+    const size_t count = records.size();
+#endif
 
     // 批量插入到数据库
-    std::cout << "\n[INFO] 正在批量插入 " << count << " 条记录到数据库..." << std::endl;
+    LOG_INFO("正在批量插入 " << count << " 条记录到数据库...");
     if (db.addRecordsBatch(records)) {
-        std::cout << "[INFO] 成功插入 " << count << " 条记录。" << std::endl;
-        std::cout << "[INFO] 数据库中共有 " << db.getRecordCount() << " 条记录。" << std::endl;
+        LOG_INFO("成功插入 " << count << " 条记录。");
+        LOG_INFO("数据库中共有 " << db.getRecordCount() << " 条记录。");
     } else {
-        std::cerr << "[ERROR] 批量插入失败" << std::endl;
+        LOG_ERROR("批量插入失败");
     }
 
+#ifdef _WIN32
     vol.deleteUSN();
     vol.closeHandle();
+#endif
     db.close();
 
-    std::cout << "\n[INFO] 数据库扫描完毕，退出。" << std::endl;
+    LOG_INFO("数据库扫描完毕，退出。");
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,304 @@
+#include "../include/metrics.h"
+#include "../include/log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t METRICS = static_cast<size_t>(Metric::COUNT);
+constexpr size_t GAUGES = static_cast<size_t>(Gauge::COUNT);
+constexpr size_t LATENCIES = static_cast<size_t>(Latency::COUNT);
+
+const char* const METRIC_NAMES[METRICS] = {
+    "events.received",
+    "events.coalesced",
+    "events.dropped",
+    "changes.written",
+};
+const char* const GAUGE_NAMES[GAUGES] = {
+    "queue.depth",
+};
+const char* const LATENCY_NAMES[LATENCIES] = {
+    "db.commit",
+    "stat",
+    "search",
+};
+
+// 直方图分桶：小于 SUB 的值各占一桶，之后每个 2 的幂区间分 SUB 桶；超过 2^MAX_BITS 微秒
+// （约 12 天）的值计入最后一桶
+constexpr unsigned SUB_BITS = 4;
+constexpr uint64_t SUB = uint64_t{1} << SUB_BITS;
+constexpr unsigned MAX_BITS = 40;
+constexpr size_t BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB;
+
+unsigned highestBit(uint64_t v) {
+    unsigned bit = 0;
+    while (v >>= 1) ++bit;
+    return bit;
+}
+
+size_t bucketOf(uint64_t value) {
+    value = std::min(value, (uint64_t{1} << MAX_BITS) - 1);
+    if (value < SUB) return static_cast<size_t>(value);
+    const unsigned shift = highestBit(value) - SUB_BITS;
+    return static_cast<size_t>((shift + 1) * SUB + ((value >> shift) & (SUB - 1)));
+}
+
+// 桶内的最大值，报告分位数时取它，不会低估
+uint64_t bucketHigh(size_t bucket) {
+    if (bucket < SUB) return bucket;
+    const unsigned shift = static_cast<unsigned>(bucket / SUB - 1);
+    return ((SUB + bucket % SUB) << shift) + (uint64_t{1} << shift) - 1;
+}
+
+// 只有所属线程写入，递增不需要原子的读改写
+void bump(std::atomic<uint64_t>& cell, uint64_t n) {
+    cell.store(cell.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+struct Histogram {
+    std::atomic<uint64_t> buckets[BUCKETS];
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> max;
+};
+
+// 一个线程的计数；用值初始化（new Shard()）保证全部为 0
+struct Shard {
+    std::atomic<uint64_t> metrics[METRICS];
+    Histogram latencies[LATENCIES];
+};
+
+class Registry {
+private:
+    std::mutex mtx;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::vector<Shard*> idle;   // 所属线程已退出，可以交给新线程
+    std::map<std::string, std::function<uint64_t()>> probes;
+    const Clock::time_point started = Clock::now();
+
+    std::atomic<int64_t> gauges[GAUGES] = {};
+    std::atomic<int64_t> peaks[GAUGES] = {};
+
+    // 定期写出
+    std::condition_variable dumpWake;
+    std::string dumpPath;
+    std::chrono::seconds dumpInterval{0};
+    uint64_t dumpGeneration = 0;
+    bool dumpStarted = false;
+
+    void dumpLoop() {
+        std::unique_lock<std::mutex> lock(mtx);
+        for (;;) {
+            const uint64_t generation = dumpGeneration;
+            if (dumpInterval.count() == 0) {
+                dumpWake.wait(lock, [&] { return dumpGeneration != generation; });
+                continue;
+            }
+            if (dumpWake.wait_for(lock, dumpInterval, [&] { return dumpGeneration != generation; })) continue;
+
+            const std::string path = dumpPath;
+            lock.unlock();
+            writeDump(path, metricsJson());
+            lock.lock();
+        }
+    }
+
+    static void writeDump(const std::string& path, const std::string& json) {
+        const std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            out << json << '\n';
+            if (!out) {
+                LOG_WARN("写入运行指标失败: " << tmp);
+                return;
+            }
+        }
+#ifdef _WIN32
+        if (!MoveFileExA(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+            LOG_WARN("替换运行指标文件失败，错误码: " << GetLastError());
+        }
+#else
+        if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+            LOG_WARN("替换运行指标文件失败: " << path);
+        }
+#endif
+    }
+
+public:
+    Shard* acquire() {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!idle.empty()) {
+            Shard* shard = idle.back();
+            idle.pop_back();
+            return shard;
+        }
+        shards.push_back(std::unique_ptr<Shard>(new Shard()));
+        return shards.back().get();
+    }
+
+    void release(Shard* shard) {
+        std::lock_guard<std::mutex> lock(mtx);
+        idle.push_back(shard);
+    }
+
+    void adjust(Gauge gauge, int64_t delta) {
+        const size_t i = static_cast<size_t>(gauge);
+        const int64_t now = gauges[i].fetch_add(delta, std::memory_order_relaxed) + delta;
+        int64_t peak = peaks[i].load(std::memory_order_relaxed);
+        while (now > peak && !peaks[i].compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
+        }
+    }
+
+    void setProbe(const std::string& name, std::function<uint64_t()> probe) {
+        std::lock_guard<std::mutex> lock(mtx);
+        probes[name] = std::move(probe);
+    }
+
+    std::string json() {
+        uint64_t totals[METRICS] = {};
+        std::vector<std::vector<uint64_t>> buckets(LATENCIES, std::vector<uint64_t>(BUCKETS));
+        uint64_t sums[LATENCIES] = {};
+        uint64_t maxima[LATENCIES] = {};
+        std::map<std::string, std::function<uint64_t()>> probeCopy;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            for (const auto& shard : shards) {
+                for (size_t m = 0; m < METRICS; ++m) totals[m] += shard->metrics[m].load(std::memory_order_relaxed);
+                for (size_t l = 0; l < LATENCIES; ++l) {
+                    const Histogram& h = shard->latencies[l];
+                    for (size_t b = 0; b < BUCKETS; ++b) buckets[l][b] += h.buckets[b].load(std::memory_order_relaxed);
+                    sums[l] += h.sum.load(std::memory_order_relaxed);
+                    maxima[l] = std::max(maxima[l], h.max.load(std::memory_order_relaxed));
+                }
+            }
+            probeCopy = probes;
+        }
+
+        std::ostringstream os;
+        os << "{\"uptimeSeconds\":"
+           << std::chrono::duration_cast<std::chrono::seconds>(Clock::now() - started).count();
+
+        os << ",\"counters\":{";
+        for (size_t m = 0; m < METRICS; ++m) {
+            os << (m ? "," : "") << '"' << METRIC_NAMES[m] << "\":" << totals[m];
+        }
+
+        os << "},\"gauges\":{";
+        for (size_t g = 0; g < GAUGES; ++g) {
+            os << (g ? "," : "") << '"' << GAUGE_NAMES[g] << "\":{\"value\":"
+               << gauges[g].load(std::memory_order_relaxed) << ",\"max\":"
+               << peaks[g].load(std::memory_order_relaxed) << '}';
+        }
+
+        os << "},\"latencyMicros\":{";
+        static const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+        static const char* const QUANTILE_NAMES[] = {"p50", "p90", "p99", "p999"};
+        for (size_t l = 0; l < LATENCIES; ++l) {
+            uint64_t count = 0;
+            for (uint64_t c : buckets[l]) count += c;
+            os << (l ? "," : "") << '"' << LATENCY_NAMES[l] << "\":{\"count\":" << count
+               << ",\"mean\":" << (count ? sums[l] / count : 0);
+
+            // 各分位数在累计计数越过 q * count 的桶处取值
+            size_t bucket = 0;
+            uint64_t seen = 0;
+            for (size_t q = 0; q < 4; ++q) {
+                const uint64_t rank = static_cast<uint64_t>(QUANTILES[q] * static_cast<double>(count) + 0.5);
+                while (bucket < BUCKETS && (seen + buckets[l][bucket] < std::max<uint64_t>(rank, 1))) {
+                    seen += buckets[l][bucket++];
+                }
+                const uint64_t value = count && bucket < BUCKETS ? std::min(bucketHigh(bucket), maxima[l]) : 0;
+                os << ",\"" << QUANTILE_NAMES[q] << "\":" << value;
+            }
+            os << ",\"max\":" << maxima[l] << '}';
+        }
+
+        os << "},\"probes\":{";
+        bool first = true;
+        for (const auto& [name, probe] : probeCopy) {
+            os << (first ? "" : ",") << '"' << name << "\":" << probe();
+            first = false;
+        }
+        os << "}}";
+        return os.str();
+    }
+
+    void dump(const std::string& path, std::chrono::seconds interval) {
+        std::lock_guard<std::mutex> lock(mtx);
+        dumpPath = path;
+        dumpInterval = path.empty() ? std::chrono::seconds(0) : interval;
+        ++dumpGeneration;
+        dumpWake.notify_all();
+        // 后台线程不会退出，理由同日志线程
+        if (!dumpStarted && dumpInterval.count() > 0) {
+            dumpStarted = true;
+            std::thread(&Registry::dumpLoop, this).detach();
+        }
+    }
+};
+
+// 有意不释放：线程的分片在静态析构之后仍可能交还
+Registry& registry() {
+    static Registry* instance = new Registry();
+    return *instance;
+}
+
+struct ShardHolder {
+    Shard* shard = nullptr;
+    ~ShardHolder() {
+        if (shard) registry().release(shard);
+    }
+};
+
+Shard& localShard() {
+    thread_local ShardHolder holder;
+    if (!holder.shard) holder.shard = registry().acquire();
+    return *holder.shard;
+}
+
+} // namespace
+
+void metricsAdd(Metric metric, uint64_t n) {
+    bump(localShard().metrics[static_cast<size_t>(metric)], n);
+}
+
+void metricsAdjust(Gauge gauge, int64_t delta) {
+    registry().adjust(gauge, delta);
+}
+
+void metricsRecord(Latency latency, std::chrono::steady_clock::duration elapsed) {
+    const int64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    const uint64_t value = micros > 0 ? static_cast<uint64_t>(micros) : 0;
+
+    Histogram& h = localShard().latencies[static_cast<size_t>(latency)];
+    bump(h.buckets[bucketOf(value)], 1);
+    bump(h.sum, value);
+    if (value > h.max.load(std::memory_order_relaxed)) h.max.store(value, std::memory_order_relaxed);
+}
+
+void metricsSetProbe(const std::string& name, std::function<uint64_t()> probe) {
+    registry().setProbe(name, std::move(probe));
+}
+
+std::string metricsJson() {
+    return registry().json();
+}
+
+void metricsDump(const std::string& path, std::chrono::seconds interval) {
+    registry().dump(path, interval);
+}
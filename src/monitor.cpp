@@ -1,152 +1,343 @@
 #include "../include/monitor.h"
 #include "../include/database.h"
-#include "../include/util.h"
-#include <iostream>
-#include <cstring>
+#include "../include/file_index.h"
+#include "../include/log.h"
+#include "../include/metrics.h"
+#ifdef _WIN32
+#include "../include/win32_source.h"
+#else
+#include "../include/linux_source.h"
+#endif
+#include <algorithm>
+#include <thread>
+#include <unordered_map>
 
-DirectoryMonitor::DirectoryMonitor(const std::string& path, Database* database)
-    : dirHandle(INVALID_HANDLE_VALUE), monitorPath(path), db(database) {}
+namespace {
+
+bool isListed(const FileIndex& index, const std::string& path) {
+    auto lock = index.lockShared();
+    FileId id = index.find(path);
+    return id != INVALID_FILE_ID && index.isListed(id);
+}
+
+} // namespace
+
+std::unique_ptr<EventSource> EventSource::create() {
+#ifdef _WIN32
+    return std::make_unique<Win32EventSource>();
+#else
+    return std::make_unique<LinuxEventSource>();
+#endif
+}
+
+DirectoryMonitor::DirectoryMonitor(Database* database, FileIndex* fileIndex)
+    : source(EventSource::create()), db(database), index(fileIndex) {}
 
 DirectoryMonitor::~DirectoryMonitor() {
     stop();
-    if (dirHandle != INVALID_HANDLE_VALUE) {
-        CloseHandle(dirHandle);
+}
+
+void DirectoryMonitor::stop() {
+    isRunning = false;
+    source->stop();
+}
+
+bool DirectoryMonitor::addRoot(const std::string& path) {
+    return source->addRoot(path);
+}
+
+bool DirectoryMonitor::removeRoot(const std::string& path) {
+    return source->removeRoot(path);
+}
+
+void DirectoryMonitor::writeLoop() {
+    // 各根目录的变更之间可能夹着其他根目录的变更
+    std::unordered_map<uint32_t, RootState> roots;
+    ChangeCoalescer coalescer;
+    std::vector<NetChange> changes;
+
+    for (uint64_t next = 0;;) {
+        SourceBatch batch;
+        bool haveBatch = false;
+        bool done = false;
+        std::vector<RescanResult> rescans;
+        std::vector<FileRecord> fills;
+        {
+            std::unique_lock<std::mutex> lock(resultMtx);
+            auto ready = [&] {
+                return decoded.count(next) || !rescanned.empty() || !filled.empty() || sourceDone;
+            };
+            if (coalescer.empty()) {
+                resultReady.wait(lock, ready);
+            } else {
+                resultReady.wait_until(lock, coalescer.nextTick(), ready);
+            }
+            rescans.swap(rescanned);
+            fills.swap(filled);
+            auto it = decoded.find(next);
+            if (it != decoded.end()) {
+                batch = std::move(it->second);
+                decoded.erase(it);
+                haveBatch = true;
+                metricsAdjust(Gauge::QueueDepth, -1);
+                ++next;
+            } else if (sourceDone && rescans.empty() && fills.empty()) {
+                // 事件源返回后每个已分配的序号都已交付，缺的就是全部写完了
+                done = true;
+            }
+        }
+
+        for (const auto& result : rescans) {
+            applyRescan(result);
+        }
+        applyFill(fills);
+
+        changes.clear();
+        if (done) {
+            coalescer.flush(changes);
+            apply(changes);
+            return;
+        }
+        if (haveBatch) {
+            RootState& state = roots[batch.root];
+            if (batch.overflow) {
+                metricsAdd(Metric::EventsDropped);
+                scheduleRescan(batch, state);
+            } else {
+                if (batch.rootAdded && rescanner) {
+                    LOG_INFO("重扫新监控的根目录: " << batch.rootPath);
+                    rescanner->schedule(batch.rootPath, SubtreeRescanner::LOW);
+                }
+                metricsAdd(Metric::EventsReceived, batch.events.size());
+                updateRecentDirs(batch, state);
+                for (const auto& event : batch.events) {
+                    feed(event, state, coalescer, changes);
+                }
+            }
+        }
+        coalescer.expire(ChangeCoalescer::Clock::now(), changes);
+        apply(changes);
     }
 }
 
-void DirectoryMonitor::start() {
-    std::wstring wpath = string_to_wstring(monitorPath);
-
-    dirHandle = CreateFileW(
-        wpath.c_str(),
-        FILE_LIST_DIRECTORY,
-        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
-        nullptr,
-        OPEN_EXISTING,
-        FILE_FLAG_BACKUP_SEMANTICS,
-        nullptr
-    );
-
-    if (dirHandle == INVALID_HANDLE_VALUE) {
-        std::cerr << "[ERROR] 无法打开目录: " << monitorPath
-                  << " 错误码: " << GetLastError() << std::endl;
-        return;
+void DirectoryMonitor::updateRecentDirs(const SourceBatch& batch, RootState& state) {
+    // 记下变更所在的目录，最近的排在最前
+    for (const auto& event : batch.events) {
+        size_t sep = event.path.find_last_of(PATH_SEP);
+        if (sep == std::string::npos) continue;
+        std::string dir = event.path.substr(0, sep);
+        auto it = std::find(state.recentDirs.begin(), state.recentDirs.end(), dir);
+        if (it != state.recentDirs.end()) state.recentDirs.erase(it);
+        else if (state.recentDirs.size() >= RECENT_DIRS) state.recentDirs.pop_back();
+        state.recentDirs.insert(state.recentDirs.begin(), std::move(dir));
     }
+}
 
-    std::cout << "[INFO] 开始监控目录: " << monitorPath << std::endl;
-    isRunning = true;
+void DirectoryMonitor::scheduleRescan(const SourceBatch& batch, RootState& state) {
+    LOG_WARN("监控缓冲区溢出，计划重扫: " << batch.rootPath);
+
+    // 溢出前正在变化的目录最可能丢了变更，先单独重扫它们；整个根目录随后以低优先级补齐。
+    // 重命名的旧路径也随溢出一起作废
+    state.lastOldPath.clear();
+    state.lastOldFile = {};
+    state.lastOldExcluded = false;
+    if (!rescanner) return;
+    for (const auto& dir : state.recentDirs) {
+        rescanner->schedule(dir, SubtreeRescanner::HIGH);
+    }
+    state.recentDirs.clear();
+    rescanner->schedule(batch.rootPath, SubtreeRescanner::LOW);
+}
 
-    constexpr DWORD BUFFER_SIZE = 16 * 1024;
-    BYTE notifyBuffer[BUFFER_SIZE];
-    DWORD bytesReturned;
-
-    std::string lastOldPath;
-
-    while (isRunning) {
-        memset(notifyBuffer, 0, BUFFER_SIZE);
-
-        BOOL ok = ReadDirectoryChangesW(
-            dirHandle,
-            notifyBuffer,
-            BUFFER_SIZE,
-            TRUE,
-            FILE_NOTIFY_CHANGE_FILE_NAME |
-            FILE_NOTIFY_CHANGE_DIR_NAME |
-            FILE_NOTIFY_CHANGE_SIZE,
-            &bytesReturned,
-            nullptr,
-            nullptr
-        );
-
-        if (!ok) {
-            DWORD err = GetLastError();
-
-            if (err != ERROR_IO_PENDING) {
-                std::cerr << "[WARN] ReadDirectoryChangesW 失败: "
-                          << err << "，继续监控..." << std::endl;
+void DirectoryMonitor::applyRescan(const RescanResult& result) {
+    LOG_INFO("重扫完成: " << result.root << "，新增或更新 " << result.upserts.size()
+             << " 项，删除 " << result.removals.size() << " 项。");
+
+    if (db && db->isConnected()) {
+        if (!result.removals.empty()) db->deleteRecordsBatch(result.removals);
+        // 重扫得到的是最新信息，已有的行也要改写大小和时间
+        if (!result.upserts.empty()) db->addRecordsBatch(result.upserts, true);
+    }
+    if (index) {
+        for (const auto& path : result.removals) index->remove(path);
+        for (const auto& record : result.upserts) index->upsert(record);
+    }
+}
+
+void DirectoryMonitor::applyFill(const std::vector<FileRecord>& records) {
+    if (records.empty()) return;
+
+    // 补全期间被删除或改名的路径在数据库与索引中都已不存在，更新不会把它们加回来
+    if (db && db->isConnected()) db->updateMetadataBatch(records);
+    if (index) {
+        for (const auto& record : records) index->update(record);
+    }
+}
+
+void DirectoryMonitor::feed(const SourceEvent& event, RootState& state, ChangeCoalescer& coalescer,
+                            std::vector<NetChange>& out) {
+    const auto now = ChangeCoalescer::Clock::now();
+    const FileKey file{event.volume, event.fileId};
+
+    switch (event.action) {
+
+    case SourceEvent::Added:
+        coalescer.push(ChangeCoalescer::Added, event.path, file, now, out);
+        break;
+
+    case SourceEvent::Modified:
+        coalescer.push(ChangeCoalescer::Modified, event.path, file, now, out);
+        break;
+
+    case SourceEvent::Removed:
+        coalescer.push(ChangeCoalescer::Removed, event.path, file, now, out);
+        break;
+
+    case SourceEvent::RenamedOld:
+        state.lastOldPath = event.path;
+        state.lastOldFile = file;
+        state.lastOldExcluded = event.excluded;
+        break;
+
+    case SourceEvent::RenamedNew:
+        if (state.lastOldPath.empty() ||
+            (state.lastOldFile.frn && event.fileId && state.lastOldFile.frn != event.fileId)) {
+            // 配不上的两条通知（旧名称随溢出丢失，或 FRN 不同）分别按删除与添加处理
+            if (!state.lastOldPath.empty() && !state.lastOldExcluded) {
+                coalescer.push(ChangeCoalescer::Removed, state.lastOldPath, state.lastOldFile, now, out);
             }
-            continue;// 继续运行
+            if (!event.excluded) coalescer.push(ChangeCoalescer::Added, event.path, file, now, out);
+        } else if (!state.lastOldExcluded && !event.excluded) {
+            coalescer.rename(state.lastOldPath, event.path, event.fileId, now, out);
+        } else if (!state.lastOldExcluded) {
+            // 移入排除的目录，重扫原位置以清掉其下已索引的内容
+            coalescer.push(ChangeCoalescer::Removed, state.lastOldPath, state.lastOldFile, now, out);
+            if (rescanner) rescanner->schedule(state.lastOldPath, SubtreeRescanner::HIGH);
+        } else if (!event.excluded) {
+            // 从排除的目录移入，其下的内容从未索引过
+            coalescer.push(ChangeCoalescer::Added, event.path, file, now, out);
+            if (rescanner) rescanner->schedule(event.path, SubtreeRescanner::HIGH);
         }
+        state.lastOldPath.clear();
+        state.lastOldFile = {};
+        break;
+    }
+}
 
-        BYTE* base = notifyBuffer;
+void DirectoryMonitor::apply(const std::vector<NetChange>& changes) {
+    // 相邻的添加与删除合成一批写入，遇到重命名先写完前面的。添加与修改只写路径，
+    // 文件信息交给补全线程；索引中已有的项在补全之前保留原来的信息
+    if (!changes.empty()) metricsAdd(Metric::ChangesWritten, changes.size());
+    std::vector<FileRecord> upserts;
+    std::vector<std::string> removals;
+    auto flush = [&] {
+        if (db && db->isConnected()) {
+            if (!removals.empty()) db->deleteRecordsBatch(removals);
+            if (!upserts.empty()) db->addPendingRecords(upserts);
+        }
+        if (index) {
+            for (const auto& path : removals) index->remove(path);
+            for (const auto& record : upserts) {
+                if (!isListed(*index, record.fullpath)) index->upsert(record);
+            }
+        }
+        if (filler) {
+            for (const auto& record : upserts) filler->enqueue(record.fullpath);
+        }
+        removals.clear();
+        upserts.clear();
+    };
+    auto pending = [&](const std::string& path, uint64_t frn) {
+        FileRecord record{};
+        record.fullpath = path;
+        record.frn = frn;
+        upserts.push_back(std::move(record));
+    };
 
-        for (DWORD offset = 0; offset < bytesReturned;) {
+    for (const auto& change : changes) {
+        switch (change.kind) {
+        case NetChange::Upsert:
+            LOG_INFO("文件变更: " << change.path);
+            pending(change.path, change.frn);
+            break;
 
-            auto* pNotify =
-                reinterpret_cast<PFILE_NOTIFY_INFORMATION>(base + offset);
+        case NetChange::Remove:
+            LOG_INFO("文件删除: " << change.path);
+            removals.push_back(change.path);
+            break;
 
-            std::wstring wname(pNotify->FileName,
-                               pNotify->FileNameLength / sizeof(WCHAR));
-            std::string fileNameA = wide_to_utf8(wname);
+        case NetChange::Rename: {
+            flush();
+            LOG_INFO("文件重命名: " << change.path << " -> " << change.newPath);
 
-            // 拼接完整路径
-            std::string fullPath = monitorPath;
-            if (!fullPath.empty() &&
-                fullPath.back() != '\\' &&
-                fullPath.back() != '/') {
-                fullPath += "\\";
-            }
-            fullPath += fileNameA;
-
-            // 过滤掉一些文件，防止无意义的事件被捕获
-            if (fullPath.find("$RECYCLE.BIN") == std::string::npos &&
-                fullPath.find("file_index.db-journal") == std::string::npos) {
-                switch (pNotify->Action) {
-
-                case FILE_ACTION_ADDED:
-                    std::cout << "[MONITOR] 文件添加: " << fullPath << std::endl;
-                    if (db && db->isConnected()) db->addRecord(makeRecord(fullPath));
-                    break;
-
-                case FILE_ACTION_MODIFIED:
-                    std::cout << "[MONITOR] 文件修改: " << fullPath << std::endl;
-                    if (db && db->isConnected()) {
-                        if (!db->recordExists(fullPath))
-                            db->addRecord(makeRecord(fullPath));
-                    }
-                    break;
-
-                case FILE_ACTION_REMOVED:
-                    std::cout << "[MONITOR] 文件删除: " << fullPath << std::endl;
-                    if (db && db->isConnected()) db->deleteRecord(fullPath);
-                    break;
-
-                case FILE_ACTION_RENAMED_OLD_NAME:
-                    lastOldPath = fullPath;
-                    break;
-
-                case FILE_ACTION_RENAMED_NEW_NAME:
-                    if (!lastOldPath.empty()) {
-                        std::cout << "[MONITOR] 文件重命名: "
-                                << lastOldPath << " -> " << fullPath << std::endl;
-
-                        if (db && db->isConnected()) {
-                            db->updatePathsOnDirectoryRename(lastOldPath, fullPath);
-                            db->deleteRecord(lastOldPath);
-                            db->addRecord(makeRecord(fullPath));
-                        }
-
-                        lastOldPath.clear();
-                    }
-                    break;
-
-
-                default:
-                    std::cout << "[MONITOR] 未知操作: "
-                            << pNotify->Action << std::endl;
-                    break;
-                }
+            // 只改路径；数据库或索引中原本没有这一项时按新路径添加
+            const bool connected = db && db->isConnected();
+            const int renamed = connected ? db->renameRecord(change.frn, change.path, change.newPath) : 1;
+            const bool moved = !index || index->rename(change.path, change.newPath);
+            if (filler) filler->rename(change.path, change.newPath);
+            if (renamed != 1 || !moved) {
+                pending(change.newPath, change.frn);
+                flush();
             }
-            
-            if (pNotify->NextEntryOffset == 0)
-                break;
+            break;
+        }
+        }
+    }
+    flush();
+}
 
-            offset += pNotify->NextEntryOffset;
+void DirectoryMonitor::start() {
+    isRunning = true;
+    metricsAdjust(Gauge::QueueDepth, -static_cast<int64_t>(decoded.size()));
+    decoded.clear();
+    sourceDone = false;
+    filled.clear();
+
+    // 重扫的差异、补全的文件信息与监控到的变更由同一个写入线程写入
+    rescanner = std::make_unique<SubtreeRescanner>(index, [this](RescanResult&& result) {
+        {
+            std::lock_guard<std::mutex> lock(resultMtx);
+            rescanned.push_back(std::move(result));
+        }
+        resultReady.notify_one();
+    });
+    filler = std::make_unique<MetadataFiller>([this](std::vector<FileRecord>&& records) {
+        {
+            std::lock_guard<std::mutex> lock(resultMtx);
+            filled.insert(filled.end(), std::make_move_iterator(records.begin()),
+                          std::make_move_iterator(records.end()));
         }
+        resultReady.notify_one();
+    });
+
+    // 上次退出时还没补全的记录
+    std::vector<FileRecord> unfilled;
+    if (db && db->isConnected() && db->loadPending(unfilled)) {
+        for (const auto& record : unfilled) filler->enqueue(record.fullpath);
     }
 
-    CloseHandle(dirHandle);
-    dirHandle = INVALID_HANDLE_VALUE;
+    std::thread writer(&DirectoryMonitor::writeLoop, this);
+
+    source->run([this](uint64_t sequence, SourceBatch&& batch) {
+        {
+            std::lock_guard<std::mutex> lock(resultMtx);
+            decoded.emplace(sequence, std::move(batch));
+        }
+        metricsAdjust(Gauge::QueueDepth, 1);
+        resultReady.notify_one();
+    });
+    isRunning = false;
 
-    std::cout << "[INFO] 停止监控目录: " << monitorPath << std::endl;
+    // 先停下重扫与补全，写入线程在退出前写完已经交来的结果；没来得及补全的记录仍标记为待补全，
+    // 下次启动时继续
+    rescanner->stop();
+    filler->stop();
+    {
+        std::lock_guard<std::mutex> lock(resultMtx);
+        sourceDone = true;
+    }
+    resultReady.notify_all();
+    writer.join();
+    rescanner.reset();
+    filler.reset();
 }
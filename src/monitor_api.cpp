@@ -1,36 +1,218 @@
 #include "../include/monitor_api.h"
 #include "../include/monitor.h"
 #include "../include/database.h"
+#include "../include/duplicates.h"
+#include "../include/exclude.h"
+#include "../include/file_index.h"
+#include "../include/journal.h"
+#include "../include/live_query.h"
+#include "../include/log.h"
+#include "../include/metrics.h"
+#include "../include/search.h"
+#include "../include/snapshot.h"
+#include "../include/treemap.h"
 #include "../include/util.h"
+#include <algorithm>
+#include <chrono>
 #include <thread>
 #include <atomic>
 #include <memory>
-#include <io.h>
-#include <fcntl.h>
+#include <mutex>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
 
-static std::unique_ptr<Database> g_db;
-static std::unique_ptr<DirectoryMonitor> g_monitor;
-static std::thread g_monitorThread;
-static std::atomic<bool> g_running{false};
+// Java 端 NativeResults 按固定的 48 字节行宽解码
+static_assert(sizeof(SearchResultRow) == 48, "SearchResultRow layout changed");
 
-int __stdcall StartFileMonitor(const char* monitorPath, const char* dbPath) {
-    if (g_running.load()) {
-        return 1;
+// 一个索引实例：数据库、内存索引与监控它的线程。实例之间不共享状态，一个进程可以同时持有多个
+// （例如每个卷或每个用户一个）；只有排除规则与日志是进程级的
+struct MonitorContext {
+    std::string dbPath;
+    std::string snapshotPath;   // 快照与数据库放在一起，停止监控时写入，下次启动优先从它恢复
+    std::string monitorPath;
+    std::unique_ptr<Database> db;
+
+    std::mutex lifecycleMtx;   // 串行化 AttachMonitor 与 DestroyFileIndex
+    std::mutex monitorMtx;     // 保护 monitor 的创建与释放，增减根目录可来自任意线程
+    std::unique_ptr<DirectoryMonitor> monitor;
+    std::thread monitorThread;
+    std::atomic<bool> running{false};
+    std::atomic<bool> stopRequested{false};
+
+    // 搜索可能来自任意线程，索引与引擎用 shared_ptr 保证停止监控时不被提前释放
+    std::mutex searchMtx;
+    std::shared_ptr<FileIndex> index;
+    std::shared_ptr<SearchEngine> search;
+    std::atomic<bool> indexReady{false};
+    std::shared_ptr<LiveQueries> live;   // 第一次订阅时创建，DestroyFileIndex 先停止它再释放索引
+
+    // 进行中的重复文件检测，供 IndexCancelFindDuplicates 中止
+    std::mutex duplicatesMtx;
+    std::shared_ptr<DuplicateFinder> duplicates;
+};
+
+// 句柄只在登记表中查找，已销毁或伪造的句柄得到空指针；调用期间持有的 shared_ptr 让并发的
+// DestroyFileIndex 不会释放正在使用的实例
+static std::mutex g_contextsMtx;
+static std::unordered_map<MonitorContext*, std::shared_ptr<MonitorContext>> g_contexts;
+static MonitorContext* g_default = nullptr;   // StartFileMonitor 等旧接口使用的实例
+
+static std::shared_ptr<MonitorContext> acquireContext(MonitorHandle handle) {
+    std::lock_guard<std::mutex> lock(g_contextsMtx);
+    auto it = g_contexts.find(handle);
+    return it == g_contexts.end() ? nullptr : it->second;
+}
+
+static MonitorHandle defaultHandle() {
+    std::lock_guard<std::mutex> lock(g_contextsMtx);
+    return g_default;
+}
+
+// 全部实例的内存索引占用，读取指标时才计算
+static uint64_t indexMemory() {
+    std::vector<std::shared_ptr<FileIndex>> indexes;
+    {
+        std::lock_guard<std::mutex> lock(g_contextsMtx);
+        for (const auto& entry : g_contexts) {
+            std::lock_guard<std::mutex> searchLock(entry.second->searchMtx);
+            if (entry.second->index) indexes.push_back(entry.second->index);
+        }
+    }
+    uint64_t bytes = 0;
+    for (const auto& index : indexes) {
+        auto lock = index->lockShared();
+        bytes += index->memoryUsage();
+    }
+    return bytes;
+}
+
+// 从数据库载入内存索引，之后的变更由监控线程同步写入
+static void loadIndex(MonitorContext& ctx, FileIndex& index) {
+    size_t count = 0;
+    const auto rules = exclusionRules();
+    ctx.db->forEachRecord([&](const FileRecord& record) {
+        if (rules->excluded(record.fullpath)) return;
+        index.upsert(record);
+        ++count;
+    });
+    LOG_INFO("内存索引已载入 " << count << " 条记录。");
+}
+
+// 优先映射快照并按 USN 日志追赶；快照缺失、损坏或无法追赶时从数据库全量载入
+static void restoreIndex(MonitorContext& ctx, FileIndex& index, SearchEngine& engine) {
+    SnapshotInfo info;
+    if (IndexSnapshot::load(ctx.snapshotPath, index, &engine.getQueryIndexes(), info)) {
+        ctx.indexReady = true;   // 快照内容立即可搜，查找表与日志追赶在其后完成
+        index.buildLookup();
+        if (catchUpJournal(info, ctx.monitorPath, index, ctx.db.get())) {
+            return;
+        }
+
+        // 此时可能有搜索已经取得结果、尚未编码，编码时用 stillListed 跳过清空后失效的编号
+        LOG_WARN("快照之后的变更无法追赶，改为从数据库载入。");
+        ctx.indexReady = false;
+        index.clear();
+    }
+
+    loadIndex(ctx, index);
+    ctx.indexReady = true;
+}
+
+static void saveSnapshot(MonitorContext& ctx) {
+    std::shared_ptr<FileIndex> index;
+    std::shared_ptr<SearchEngine> engine;
+    {
+        std::lock_guard<std::mutex> lock(ctx.searchMtx);
+        index = ctx.index;
+        engine = ctx.search;
+    }
+    if (!index || !engine || !ctx.indexReady.load() || ctx.monitorPath.empty()) {
+        return;
+    }
+
+    // 读不到日志位置（例如没有管理员权限）时仍然写入，下次启动会因无法追赶而回退到数据库
+    SnapshotInfo info;
+    currentJournalPosition(ctx.monitorPath, info);
+    IndexSnapshot::save(ctx.snapshotPath, *index, &engine->getQueryIndexes(), info);
+}
+
+int __stdcall CreateFileIndex(const char* dbPath, MonitorHandle* handle) {
+    if (!dbPath || !handle) {
+        return -1;
     }
+    *handle = nullptr;
+
+    static std::once_flag probeOnce;
+    std::call_once(probeOnce, [] { metricsSetProbe("index.memoryBytes", indexMemory); });
 
     try {
-        g_db = std::make_unique<Database>(dbPath);
-        if (!g_db->open() || !g_db->createTable()) {
+        auto ctx = std::make_shared<MonitorContext>();
+        ctx->dbPath = dbPath;
+        ctx->snapshotPath = ctx->dbPath + ".snapshot";
+        {
+            // 同一个数据库只能属于一个实例，否则两个监控会交错写入
+            std::lock_guard<std::mutex> lock(g_contextsMtx);
+            for (const auto& entry : g_contexts) {
+                if (entry.second->dbPath == ctx->dbPath) return 1;
+            }
+            g_contexts.emplace(ctx.get(), ctx);
+        }
+
+        ctx->db = std::make_unique<Database>(ctx->dbPath);
+        if (!ctx->db->open() || !ctx->db->createTable()) {
+            std::lock_guard<std::mutex> lock(g_contextsMtx);
+            g_contexts.erase(ctx.get());
             return 2;
         }
 
-        std::string path(monitorPath);
-        g_monitor = std::make_unique<DirectoryMonitor>(path, g_db.get());
+        ctx->index = std::make_shared<FileIndex>();
+        ctx->search = std::make_shared<SearchEngine>(*ctx->index);
+        *handle = ctx.get();
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int __stdcall AttachMonitor(MonitorHandle handle, const char* monitorPath) {
+    auto ctx = acquireContext(handle);
+    if (!ctx || !monitorPath) {
+        return -4;
+    }
+
+    try {
+        std::lock_guard<std::mutex> lifecycle(ctx->lifecycleMtx);
+        if (!ctx->db || ctx->monitor) {
+            return 1;
+        }
+
+        std::shared_ptr<FileIndex> index;
+        std::shared_ptr<SearchEngine> engine;
+        {
+            std::lock_guard<std::mutex> lock(ctx->searchMtx);
+            index = ctx->index;
+            engine = ctx->search;
+        }
+
+        ctx->monitorPath = monitorPath;
+        {
+            std::lock_guard<std::mutex> lock(ctx->monitorMtx);
+            ctx->monitor = std::make_unique<DirectoryMonitor>(ctx->db.get(), index.get());
+            ctx->monitor->addRoot(ctx->monitorPath);
+        }
+
+        ctx->running = true;
+        ctx->stopRequested = false;
+        // 线程只用裸指针：DestroyFileIndex 在释放实例之前等待它结束
+        MonitorContext* self = ctx.get();
+        ctx->monitorThread = std::thread([self, index, engine]() {
+            restoreIndex(*self, *index, *engine);
 
-        g_running = true;
-        g_monitorThread = std::thread([]() {
-            g_monitor->start();   // 阻塞在内部循环
-            g_running = false;
+            if (!self->stopRequested.load()) {
+                self->monitor->start();   // 阻塞在内部循环
+            }
+            self->running = false;
         });
         return 0;
     } catch (...) {
@@ -38,21 +220,596 @@ int __stdcall StartFileMonitor(const char* monitorPath, const char* dbPath) {
     }
 }
 
-void __stdcall StopFileMonitor() {
-    if (!g_running.load())
-        return;
+void __stdcall DestroyFileIndex(MonitorHandle handle) {
+    std::shared_ptr<MonitorContext> ctx;
+    {
+        std::lock_guard<std::mutex> lock(g_contextsMtx);
+        auto it = g_contexts.find(handle);
+        if (it == g_contexts.end()) return;
+        ctx = std::move(it->second);
+        g_contexts.erase(it);
+        if (g_default == handle) g_default = nullptr;
+    }
+
+    std::lock_guard<std::mutex> lifecycle(ctx->lifecycleMtx);
+    ctx->stopRequested = true;
+    if (ctx->monitor) {
+        ctx->monitor->stop();
+    }
+    if (ctx->monitorThread.joinable()) {
+        ctx->monitorThread.join();
+    }
+    saveSnapshot(*ctx);
+    if (ctx->db) {
+        ctx->db->close();
+    }
+
+    ctx->indexReady = false;
+    std::shared_ptr<LiveQueries> live;
+    {
+        std::lock_guard<std::mutex> lock(ctx->searchMtx);
+        if (ctx->search) ctx->search->cancel();
+        live = std::move(ctx->live);
+    }
+    // 先等后台线程结束，之后不再有回调；LiveQueries 自己也持有索引，仍在使用它的调用不受影响
+    if (live) live->stop();
+    {
+        std::lock_guard<std::mutex> lock(ctx->searchMtx);
+        ctx->search.reset();
+        ctx->index.reset();
+    }
+    {
+        std::lock_guard<std::mutex> lock(ctx->duplicatesMtx);
+        if (ctx->duplicates) ctx->duplicates->cancel();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(ctx->monitorMtx);
+        ctx->monitor.reset();
+    }
+    ctx->db.reset();
+    ctx->running = false;
+    logFlush();
+}
+
+int __stdcall IndexAddRoot(MonitorHandle handle, const char* path) {
+    auto ctx = acquireContext(handle);
+    if (!ctx || !path || !ctx->running.load()) {
+        return 1;
+    }
+    std::lock_guard<std::mutex> lock(ctx->monitorMtx);
+    if (!ctx->monitor) {
+        return 1;
+    }
+    return ctx->monitor->addRoot(path) ? 0 : 2;
+}
+
+int __stdcall IndexRemoveRoot(MonitorHandle handle, const char* path) {
+    auto ctx = acquireContext(handle);
+    if (!ctx || !path || !ctx->running.load()) {
+        return 1;
+    }
+    std::lock_guard<std::mutex> lock(ctx->monitorMtx);
+    if (!ctx->monitor) {
+        return 1;
+    }
+    return ctx->monitor->removeRoot(path) ? 0 : 2;
+}
+
+// 取得实例当前的索引与引擎，索引未就绪时返回 false
+static bool acquireSearch(MonitorContext& ctx, std::shared_ptr<FileIndex>& index, std::shared_ptr<SearchEngine>& engine) {
+    {
+        std::lock_guard<std::mutex> lock(ctx.searchMtx);
+        index = ctx.index;
+        engine = ctx.search;
+    }
+    return engine && ctx.indexReady.load();
+}
+
+// 执行搜索，返回 0 表示成功，否则为导出函数约定的负值
+static int runSearch(SearchEngine& engine, const char* query, int sortBy, int maxResults,
+                     std::vector<FileId>& ids) {
+    SearchOptions options;
+    options.maxResults = maxResults > 0 ? static_cast<size_t>(maxResults) : SIZE_MAX;
+    switch (sortBy) {
+    case 1: options.sortKey = SortKey::Size;          options.descending = true;  break;
+    case 2: options.sortKey = SortKey::Size;          options.descending = false; break;
+    case 3: options.sortKey = SortKey::LastWriteTime; options.descending = true;  break;
+    case 4: options.sortKey = SortKey::LastWriteTime; options.descending = false; break;
+    default: break;
+    }
+
+    LatencyTimer timer(Latency::Search);
+    SearchStatus status = engine.search(query ? query : "", options, ids);
+    if (status == SearchStatus::Cancelled) {
+        return -1;
+    }
+    if (status == SearchStatus::InvalidQuery) {
+        return -3;
+    }
+    return 0;
+}
+
+// 搜索在返回结果后释放索引的锁，编码时重新取锁；其间索引可能被清空重新载入（快照无法追赶时），
+// 结果中的编号需要再确认一次。要求持有索引的共享锁
+static bool stillListed(const FileIndex& index, FileId id) {
+    return id < index.nodeCount() && index.isListed(id);
+}
+
+// 按 SearchFilesBinary 的布局追加一行：行表向后增长，路径从 buffer 末尾向前增长，两者相遇时返回 false。
+// 要求持有索引的共享锁；移出结果的项只有编号，路径为空、大小与时间为 0；已失效的编号不写入，返回 true
+static bool appendRow(const FileIndex& index, FileId id, uint32_t change, char* base, size_t& rowEnd,
+                      size_t& pathBegin, int32_t& written) {
+    FileRecord r;
+    if (change != LiveChange::Removed) {
+        if (!stillListed(index, id)) return true;
+        r = index.record(id);
+    }
+    const std::string& path = r.fullpath;
+    if (rowEnd + sizeof(SearchResultRow) + path.size() > pathBegin) return false;
+
+    pathBegin -= path.size();
+    memcpy(base + pathBegin, path.data(), path.size());
+
+    auto* row = reinterpret_cast<SearchResultRow*>(base + rowEnd);
+    row->pathOffset = static_cast<uint32_t>(pathBegin);
+    row->pathLength = static_cast<uint32_t>(path.size());
+    row->fileSize = static_cast<int64_t>(r.fileSize);
+    row->creationTime = fileTimeToEpochMillis(r.creationTime);
+    row->lastAccessTime = fileTimeToEpochMillis(r.lastAccessTime);
+    row->lastWriteTime = fileTimeToEpochMillis(r.lastWriteTime);
+    row->fileId = id;
+    row->change = change;
+
+    rowEnd += sizeof(SearchResultRow);
+    ++written;
+    return true;
+}
+
+int __stdcall IndexSearch(MonitorHandle handle, const char* query, int sortBy, char* buffer, int bufferSize,
+                          int maxResults) {
+    auto ctx = acquireContext(handle);
+    if (!ctx) {
+        return -4;
+    }
+    std::shared_ptr<FileIndex> index;
+    std::shared_ptr<SearchEngine> engine;
+    if (!acquireSearch(*ctx, index, engine)) {
+        return -2;
+    }
+    if (!buffer || bufferSize <= 0) {
+        return 0;
+    }
+
+    try {
+        std::vector<FileId> ids;
+        int rc = runSearch(*engine, query, sortBy, maxResults, ids);
+        if (rc != 0) {
+            return rc;
+        }
+
+        // 留出结尾的 '\0'
+        const size_t capacity = static_cast<size_t>(bufferSize) - 1;
+        size_t used = 0;
+        int written = 0;
+
+        auto lock = index->lockShared();
+        for (FileId id : ids) {
+            if (!stillListed(*index, id)) continue;
+            FileRecord r = index->record(id);
+            std::string line = r.fullpath + '\t' +
+                std::to_string(r.fileSize) + '\t' +
+                std::to_string(fileTimeToUInt64(r.creationTime)) + '\t' +
+                std::to_string(fileTimeToUInt64(r.lastAccessTime)) + '\t' +
+                std::to_string(fileTimeToUInt64(r.lastWriteTime)) + '\n';
+
+            if (used + line.size() > capacity) break;
+            memcpy(buffer + used, line.data(), line.size());
+            used += line.size();
+            ++written;
+        }
+        buffer[used] = '\0';
+        return written;
+    } catch (...) {
+        return -2;
+    }
+}
+
+int __stdcall IndexSearchBinary(MonitorHandle handle, const char* query, int sortBy, void* buffer, int bufferSize,
+                                int maxResults) {
+    auto ctx = acquireContext(handle);
+    if (!ctx) {
+        return -4;
+    }
+    std::shared_ptr<FileIndex> index;
+    std::shared_ptr<SearchEngine> engine;
+    if (!acquireSearch(*ctx, index, engine)) {
+        return -2;
+    }
+    if (!buffer || bufferSize < SEARCH_RESULT_HEADER_SIZE) {
+        return 0;
+    }
+
+    try {
+        std::vector<FileId> ids;
+        int rc = runSearch(*engine, query, sortBy, maxResults, ids);
+        if (rc != 0) {
+            return rc;
+        }
+
+        char* base = static_cast<char*>(buffer);
+        size_t rowEnd = SEARCH_RESULT_HEADER_SIZE;
+        size_t pathBegin = static_cast<size_t>(bufferSize);
+        int32_t written = 0;
+
+        auto lock = index->lockShared();
+        for (FileId id : ids) {
+            if (!appendRow(*index, id, 0, base, rowEnd, pathBegin, written)) break;
+        }
+
+        int32_t header[2] = {written, 0};
+        memcpy(base, header, sizeof(header));
+        return written;
+    } catch (...) {
+        return -2;
+    }
+}
+
+int __stdcall IndexFindDuplicates(MonitorHandle handle, const char* query, long long minSize, char* buffer,
+                                  int bufferSize, int maxGroups) {
+    auto ctx = acquireContext(handle);
+    if (!ctx) {
+        return -4;
+    }
+    std::shared_ptr<FileIndex> index;
+    std::shared_ptr<SearchEngine> engine;
+    if (!acquireSearch(*ctx, index, engine)) {
+        return -2;
+    }
+
+    try {
+        // hash 缓存使用独立的连接，不与监控线程共用事务
+        Database cache(ctx->dbPath);
+        bool cacheOpen = cache.open() && cache.createTable();
+        auto finder = std::make_shared<DuplicateFinder>(*index, cacheOpen ? &cache : nullptr);
+        {
+            std::lock_guard<std::mutex> lock(ctx->duplicatesMtx);
+            if (ctx->duplicates) ctx->duplicates->cancel();
+            ctx->duplicates = finder;
+        }
+
+        std::vector<DuplicateGroup> groups;
+        SearchStatus status = finder->find(query ? query : "", minSize > 0 ? static_cast<ULONGLONG>(minSize) : 0, groups);
+        {
+            std::lock_guard<std::mutex> lock(ctx->duplicatesMtx);
+            if (ctx->duplicates == finder) ctx->duplicates.reset();
+        }
+        if (status == SearchStatus::Cancelled) {
+            return -1;
+        }
+        if (status == SearchStatus::InvalidQuery) {
+            return -3;
+        }
+        if (!buffer || bufferSize <= 0) {
+            return 0;
+        }
+
+        const size_t capacity = static_cast<size_t>(bufferSize) - 1;
+        size_t used = 0;
+        int written = 0;
+        for (const auto& group : groups) {
+            if (maxGroups > 0 && written >= maxGroups) break;
+
+            std::string line = std::to_string(group.wastedBytes()) + '\t' +
+                std::to_string(group.fileSize) + '\t' +
+                std::to_string(group.paths.size());
+            for (const auto& path : group.paths) line += '\t' + path;
+            line += '\n';
+
+            if (used + line.size() > capacity) break;
+            memcpy(buffer + used, line.data(), line.size());
+            used += line.size();
+            ++written;
+        }
+        buffer[used] = '\0';
+        return written;
+    } catch (...) {
+        return -2;
+    }
+}
+
+void __stdcall IndexCancelFindDuplicates(MonitorHandle handle) {
+    auto ctx = acquireContext(handle);
+    if (!ctx) return;
+    std::lock_guard<std::mutex> lock(ctx->duplicatesMtx);
+    if (ctx->duplicates) ctx->duplicates->cancel();
+}
+
+int __stdcall IndexGetDiskUsage(MonitorHandle handle, const char* root, int depth, int topN, char* buffer,
+                                int bufferSize) {
+    auto ctx = acquireContext(handle);
+    if (!ctx) {
+        return -4;
+    }
+    std::shared_ptr<FileIndex> index;
+    std::shared_ptr<SearchEngine> engine;
+    if (!acquireSearch(*ctx, index, engine)) {
+        return -2;
+    }
+    if (!buffer || bufferSize <= 0) {
+        return 0;
+    }
+
+    try {
+        std::vector<TreemapEntry> entries;
+        if (!buildTreemap(*index, root ? root : "", depth > 0 ? static_cast<uint32_t>(depth) : 0,
+                          topN > 0 ? static_cast<size_t>(topN) : SIZE_MAX, entries)) {
+            return -3;
+        }
+
+        const size_t capacity = static_cast<size_t>(bufferSize) - 1;
+        size_t used = 0;
+        int written = 0;
+        for (const auto& entry : entries) {
+            std::string line = std::to_string(entry.depth) + '\t' +
+                std::to_string(entry.size) + '\t' +
+                std::to_string(entry.items) + '\t' +
+                std::to_string(entry.folded) + '\t' +
+                entry.path + '\n';
+
+            if (used + line.size() > capacity) break;
+            memcpy(buffer + used, line.data(), line.size());
+            used += line.size();
+            ++written;
+        }
+        buffer[used] = '\0';
+        return written;
+    } catch (...) {
+        return -2;
+    }
+}
+
+// 取得实例的实时查询，没有时创建；索引未就绪时返回空
+static std::shared_ptr<LiveQueries> acquireLive(MonitorContext& ctx, std::shared_ptr<FileIndex>& index) {
+    std::lock_guard<std::mutex> lock(ctx.searchMtx);
+    index = ctx.index;
+    if (!index || !ctx.search || !ctx.indexReady.load()) return nullptr;
+    if (!ctx.live) {
+        // 查询索引属于引擎，用别名指针让 LiveQueries 同时持有引擎
+        std::shared_ptr<QueryIndexes> indexes(ctx.search, &ctx.search->getQueryIndexes());
+        ctx.live = std::make_shared<LiveQueries>(index, std::move(indexes));
+    }
+    return ctx.live;
+}
+
+int __stdcall IndexSubscribe(MonitorHandle handle, const char* query, IndexChangeCallback callback, void* context) {
+    auto ctx = acquireContext(handle);
+    if (!ctx) {
+        return -4;
+    }
+
+    try {
+        std::shared_ptr<FileIndex> index;
+        auto live = acquireLive(*ctx, index);
+        if (!live) {
+            return -2;
+        }
+
+        LiveQueries::Deliver deliver;
+        if (callback) {
+            // 在后台线程上编码整批变化，回调返回后缓冲区即失效；回调存放在 LiveQueries 中，而它持有索引，裸指针总是有效
+            const FileIndex* source = index.get();
+            deliver = [source, callback, context](uint32_t id, std::vector<LiveChange>&& changes, bool reset) {
+                auto lock = source->lockShared();
+                size_t size = SEARCH_RESULT_HEADER_SIZE + changes.size() * sizeof(SearchResultRow);
+                for (const auto& change : changes) {
+                    if (change.kind != LiveChange::Removed && stillListed(*source, change.id)) {
+                        size += source->fullPath(change.id).size();
+                    }
+                }
+                std::vector<uint64_t> storage((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+                char* base = reinterpret_cast<char*>(storage.data());
+                size_t rowEnd = SEARCH_RESULT_HEADER_SIZE;
+                size_t pathBegin = size;
+                int32_t written = 0;
+                for (const auto& change : changes) {
+                    appendRow(*source, change.id, change.kind, base, rowEnd, pathBegin, written);
+                }
+                int32_t header[2] = {written, reset ? CHANGE_DELTA_RESET : 0};
+                memcpy(base, header, sizeof(header));
+                lock.unlock();
+                callback(static_cast<int>(id), base, static_cast<int>(size), context);
+            };
+        }
+
+        std::string error;
+        const uint32_t id = live->subscribe(query ? query : "", std::move(deliver), &error);
+        if (id == 0) {
+            LOG_WARN("无法解析订阅的查询: " << error);
+            return -3;
+        }
+        return static_cast<int>(id);
+    } catch (...) {
+        return -2;
+    }
+}
+
+int __stdcall IndexPollChanges(MonitorHandle handle, int subscription, void* buffer, int bufferSize) {
+    auto ctx = acquireContext(handle);
+    if (!ctx) {
+        return -4;
+    }
+    std::shared_ptr<FileIndex> index;
+    std::shared_ptr<LiveQueries> live;
+    {
+        std::lock_guard<std::mutex> lock(ctx->searchMtx);
+        index = ctx->index;
+        live = ctx->live;
+    }
+    if (!index || !live) {
+        return -5;
+    }
+    if (!buffer || bufferSize < SEARCH_RESULT_HEADER_SIZE) {
+        return 0;
+    }
+
+    try {
+        char* base = static_cast<char*>(buffer);
+        size_t rowEnd = SEARCH_RESULT_HEADER_SIZE;
+        size_t pathBegin = static_cast<size_t>(bufferSize);
+        int32_t written = 0;
+        bool reset = false;
+
+        // 先取索引的锁再取订阅的锁，与后台线程的顺序一致
+        auto lock = index->lockShared();
+        const bool found = live->poll(static_cast<uint32_t>(subscription), [&](const LiveChange& change) {
+            return appendRow(*index, change.id, change.kind, base, rowEnd, pathBegin, written);
+        }, reset);
+        if (!found) {
+            return -5;
+        }
+
+        int32_t header[2] = {written, reset ? CHANGE_DELTA_RESET : 0};
+        memcpy(base, header, sizeof(header));
+        return written;
+    } catch (...) {
+        return -2;
+    }
+}
 
-    if (g_monitor) {
-        g_monitor->stop();
+int __stdcall IndexUnsubscribe(MonitorHandle handle, int subscription) {
+    auto ctx = acquireContext(handle);
+    if (!ctx) {
+        return -4;
+    }
+    std::shared_ptr<LiveQueries> live;
+    {
+        std::lock_guard<std::mutex> lock(ctx->searchMtx);
+        live = ctx->live;
     }
-    if (g_monitorThread.joinable()) {
-        g_monitorThread.join();
+    return live && live->unsubscribe(static_cast<uint32_t>(subscription)) ? 0 : -5;
+}
+
+// 以下旧接口作用于一个默认实例，行为与句柄接口出现之前相同
+
+static std::mutex g_defaultMtx;   // 串行化默认实例的启动与停止
+
+// 没有默认实例时旧接口报告索引未就绪
+static int legacyResult(int rc) {
+    return rc == -4 ? -2 : rc;
+}
+
+int __stdcall StartFileMonitor(const char* monitorPath, const char* dbPath) {
+    if (!monitorPath || !dbPath) {
+        return -1;
     }
-    if (g_db) {
-        g_db->close();
+    std::lock_guard<std::mutex> lock(g_defaultMtx);
+    if (auto ctx = acquireContext(defaultHandle())) {
+        if (ctx->running.load()) {
+            return 1;
+        }
+        DestroyFileIndex(ctx.get());   // 监控线程已自行结束，回收后重新开始
     }
 
-    g_monitor.reset();
-    g_db.reset();
-    g_running = false;
-}
\ No newline at end of file
+    MonitorHandle handle = nullptr;
+    int rc = CreateFileIndex(dbPath, &handle);
+    if (rc != 0) {
+        // 数据库已被句柄接口创建的实例使用时，旧接口没有对应的返回值，按其它错误报告
+        return rc == 1 ? -1 : rc;
+    }
+    if (AttachMonitor(handle, monitorPath) != 0) {
+        DestroyFileIndex(handle);
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> contexts(g_contextsMtx);
+    g_default = handle;
+    return 0;
+}
+
+void __stdcall StopFileMonitor() {
+    std::lock_guard<std::mutex> lock(g_defaultMtx);
+    DestroyFileIndex(defaultHandle());
+}
+
+int __stdcall AddMonitorRoot(const char* path) {
+    return IndexAddRoot(defaultHandle(), path);
+}
+
+int __stdcall RemoveMonitorRoot(const char* path) {
+    return IndexRemoveRoot(defaultHandle(), path);
+}
+
+int __stdcall SearchFiles(const char* query, char* buffer, int bufferSize, int maxResults) {
+    return legacyResult(IndexSearch(defaultHandle(), query, 0, buffer, bufferSize, maxResults));
+}
+
+int __stdcall SearchFilesSorted(const char* query, int sortBy, char* buffer, int bufferSize, int maxResults) {
+    return legacyResult(IndexSearch(defaultHandle(), query, sortBy, buffer, bufferSize, maxResults));
+}
+
+int __stdcall SearchFilesBinary(const char* query, int sortBy, void* buffer, int bufferSize, int maxResults) {
+    return legacyResult(IndexSearchBinary(defaultHandle(), query, sortBy, buffer, bufferSize, maxResults));
+}
+
+int __stdcall FindDuplicates(const char* query, long long minSize, char* buffer, int bufferSize, int maxGroups) {
+    return legacyResult(IndexFindDuplicates(defaultHandle(), query, minSize, buffer, bufferSize, maxGroups));
+}
+
+void __stdcall CancelFindDuplicates() {
+    IndexCancelFindDuplicates(defaultHandle());
+}
+
+int __stdcall GetDiskUsage(const char* root, int depth, int topN, char* buffer, int bufferSize) {
+    return legacyResult(IndexGetDiskUsage(defaultHandle(), root, depth, topN, buffer, bufferSize));
+}
+
+int __stdcall SubscribeChanges(const char* query, IndexChangeCallback callback, void* context) {
+    return legacyResult(IndexSubscribe(defaultHandle(), query, callback, context));
+}
+
+int __stdcall PollChanges(int subscription, void* buffer, int bufferSize) {
+    return legacyResult(IndexPollChanges(defaultHandle(), subscription, buffer, bufferSize));
+}
+
+int __stdcall UnsubscribeChanges(int subscription) {
+    return legacyResult(IndexUnsubscribe(defaultHandle(), subscription));
+}
+
+int __stdcall GetMonitorStats(char* buffer, int bufferSize) {
+    try {
+        const std::string json = metricsJson();
+        if (!buffer || bufferSize <= 0 || json.size() >= static_cast<size_t>(bufferSize)) {
+            return -static_cast<int>(json.size() + 1);
+        }
+        memcpy(buffer, json.data(), json.size());
+        buffer[json.size()] = '\0';
+        return static_cast<int>(json.size());
+    } catch (...) {
+        return 0;
+    }
+}
+
+void __stdcall SetMonitorStatsDump(const char* path, int intervalSeconds) {
+    try {
+        metricsDump(path && intervalSeconds > 0 ? path : "", std::chrono::seconds(std::max(intervalSeconds, 0)));
+    } catch (...) {
+    }
+}
+
+int __stdcall SetExclusionRules(const char* rules) {
+    try {
+        auto parsed = std::make_shared<ExclusionRules>();
+        const std::string text = std::string(ExclusionRules::DEFAULT_RULES) + (rules ? rules : "");
+        std::string error;
+        if (!ExclusionRules::parse(text, *parsed, error)) {
+            LOG_WARN("无法解析排除规则: " << error);
+            return -3;
+        }
+        const int count = static_cast<int>(parsed->size());
+        setExclusionRules(std::move(parsed));
+        return count;
+    } catch (...) {
+        return -2;
+    }
+}
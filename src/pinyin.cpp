@@ -0,0 +1,258 @@
+#include "../include/pinyin.h"
+#include "../include/fuzzy.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+// 常见多音字的其他读音（首选读音在 PINYIN_READINGS 中），按码点升序，供二分查找
+// 只收录文件名里常见的字与姓氏，读音之间以空格分隔
+struct Polyphone {
+    uint32_t codePoint;
+    const char* readings;
+};
+
+const Polyphone POLYPHONES[] = {
+    {0x4E07, "mo"},   // 万 wan
+    {0x4E50, "yue"},   // 乐 le
+    {0x4E58, "sheng"},   // 乘 cheng
+    {0x4E86, "liao"},   // 了 le
+    {0x4EB2, "qing"},   // 亲 qin
+    {0x4EC0, "shi"},   // 什 shen
+    {0x4EC7, "qiu"},   // 仇 chou
+    {0x4ED4, "zai"},   // 仔 zi
+    {0x4F1A, "kuai"},   // 会 hui
+    {0x4F20, "zhuan"},   // 传 chuan
+    {0x4F2F, "bai"},   // 伯 bo
+    {0x4F3C, "si"},   // 似 shi
+    {0x4F5B, "fo"},   // 佛 fu
+    {0x4FBF, "pian"},   // 便 bian
+    {0x4FE9, "liang"},   // 俩 lia
+    {0x5228, "bao"},   // 刨 pao
+    {0x524A, "xiao"},   // 削 xue
+    {0x5265, "bao"},   // 剥 bo
+    {0x52B2, "jing"},   // 劲 jin
+    {0x52D2, "le"},   // 勒 lei
+    {0x5319, "chi"},   // 匙 shi
+    {0x533A, "ou"},   // 区 qu
+    {0x5355, "shan chan"},   // 单 dan
+    {0x535C, "bu"},   // 卜 bo
+    {0x5361, "qia"},   // 卡 ka
+    {0x5382, "an"},   // 厂 chang
+    {0x53A6, "xia"},   // 厦 sha
+    {0x53C2, "shen cen"},   // 参 can
+    {0x53E5, "gou"},   // 句 ju
+    {0x53EC, "shao"},   // 召 zhao
+    {0x53F6, "xie"},   // 叶 ye
+    {0x5401, "yu"},   // 吁 xu
+    {0x5413, "he"},   // 吓 xia
+    {0x5426, "pi"},   // 否 fou
+    {0x5458, "yun"},   // 员 yuan
+    {0x5462, "ni"},   // 呢 ne
+    {0x548C, "huo hu"},   // 和 he
+    {0x5496, "ga"},   // 咖 ka
+    {0x54BD, "ye"},   // 咽 yan
+    {0x54EA, "nei"},   // 哪 na
+    {0x56BC, "jiao"},   // 嚼 jue
+    {0x56E4, "tun"},   // 囤 dun
+    {0x5708, "juan"},   // 圈 quan
+    {0x5730, "di"},   // 地 de
+    {0x57CB, "man"},   // 埋 mai
+    {0x585E, "se"},   // 塞 sai
+    {0x58F3, "qiao"},   // 壳 ke
+    {0x5927, "dai"},   // 大 da
+    {0x5947, "ji"},   // 奇 qi
+    {0x5A1C, "nuo"},   // 娜 na
+    {0x5BBF, "xiu"},   // 宿 su
+    {0x5C06, "qiang"},   // 将 jiang
+    {0x5C09, "yu"},   // 尉 wei
+    {0x5C3E, "yi"},   // 尾 wei
+    {0x5C3F, "sui"},   // 尿 niao
+    {0x5C4F, "bing"},   // 屏 ping
+    {0x5C5E, "zhu"},   // 属 shu
+    {0x5DEE, "chai ci"},   // 差 cha
+    {0x5DF7, "hang"},   // 巷 xiang
+    {0x5E7F, "an"},   // 广 guang
+    {0x5EA6, "duo"},   // 度 du
+    {0x5F04, "long"},   // 弄 nong
+    {0x5F39, "tan"},   // 弹 dan
+    {0x5F3A, "jiang"},   // 强 qiang
+    {0x5F97, "dei"},   // 得 de
+    {0x6076, "wu"},   // 恶 e
+    {0x624E, "za"},   // 扎 zha
+    {0x6298, "she"},   // 折 zhe
+    {0x62B9, "ma"},   // 抹 mo
+    {0x62D7, "niu"},   // 拗 ao
+    {0x62E9, "zhai"},   // 择 ze
+    {0x63D0, "di"},   // 提 ti
+    {0x6469, "ma"},   // 摩 mo
+    {0x6570, "shuo"},   // 数 shu
+    {0x66DD, "bao"},   // 曝 pu
+    {0x66FE, "zeng"},   // 曾 ceng
+    {0x671D, "zhao"},   // 朝 chao
+    {0x671F, "ji"},   // 期 qi
+    {0x6734, "po piao"},   // 朴 pu
+    {0x67CF, "bo"},   // 柏 bai
+    {0x67E5, "zha"},   // 查 cha
+    {0x6821, "jiao"},   // 校 xiao
+    {0x68F1, "ling"},   // 棱 leng
+    {0x6A21, "mu"},   // 模 mo
+    {0x6B96, "shi"},   // 殖 zhi
+    {0x6BB7, "yan"},   // 殷 yin
+    {0x6C0F, "zhi"},   // 氏 shi
+    {0x6C64, "shang"},   // 汤 tang
+    {0x6C88, "chen"},   // 沈 shen
+    {0x6CA1, "mo"},   // 没 mei
+    {0x6CCA, "bo"},   // 泊 po
+    {0x6CCC, "bi"},   // 泌 mi
+    {0x6F84, "deng"},   // 澄 cheng
+    {0x7011, "bao"},   // 瀑 pu
+    {0x70AE, "bao"},   // 炮 pao
+    {0x70D9, "luo"},   // 烙 lao
+    {0x71A8, "yu"},   // 熨 yun
+    {0x722A, "zhua"},   // 爪 zhao
+    {0x7387, "shuai"},   // 率 lv
+    {0x755C, "xu"},   // 畜 chu
+    {0x756A, "pan"},   // 番 fan
+    {0x759F, "yao"},   // 疟 nve
+    {0x7684, "di"},   // 的 de
+    {0x76D6, "ge"},   // 盖 gai
+    {0x76DB, "cheng"},   // 盛 sheng
+    {0x7701, "xing"},   // 省 sheng
+    {0x7740, "zhao zhuo"},   // 着 zhe
+    {0x77F3, "dan"},   // 石 shi
+    {0x79CD, "chong"},   // 种 zhong
+    {0x79D8, "bi"},   // 秘 mi
+    {0x79F0, "chen"},   // 称 cheng
+    {0x7C98, "nian"},   // 粘 zhan
+    {0x7CFB, "ji"},   // 系 xi
+    {0x7ED9, "ji"},   // 给 gei
+    {0x7EFF, "lu"},   // 绿 lv
+    {0x7F2A, "miao miu"},   // 缪 mou
+    {0x7FDF, "zhai"},   // 翟 di
+    {0x81C2, "bei"},   // 臂 bi
+    {0x81ED, "xiu"},   // 臭 chou
+    {0x8272, "shai"},   // 色 se
+    {0x82A5, "gai"},   // 芥 jie
+    {0x838E, "suo"},   // 莎 sha
+    {0x843D, "la lao"},   // 落 luo
+    {0x8513, "wan"},   // 蔓 man
+    {0x8584, "bo"},   // 薄 bao
+    {0x85CF, "zang"},   // 藏 cang
+    {0x8840, "xie"},   // 血 xue
+    {0x884C, "hang"},   // 行 xing
+    {0x89C9, "jiao"},   // 觉 jue
+    {0x89D2, "jue"},   // 角 jiao
+    {0x89E3, "xie"},   // 解 jie
+    {0x8BC6, "zhi"},   // 识 shi
+    {0x8BF4, "shui"},   // 说 shuo
+    {0x8BFB, "dou"},   // 读 du
+    {0x8C01, "shui"},   // 谁 shei
+    {0x8C03, "tiao"},   // 调 diao
+    {0x8C37, "yu"},   // 谷 gu
+    {0x8D3E, "gu"},   // 贾 jia
+    {0x8F66, "ju"},   // 车 che
+    {0x8F9F, "bi"},   // 辟 pi
+    {0x8FD8, "huan"},   // 还 hai
+    {0x9002, "kuo"},   // 适 shi
+    {0x9057, "wei"},   // 遗 yi
+    {0x90FD, "du"},   // 都 dou
+    {0x91CD, "chong"},   // 重 zhong
+    {0x957F, "chang"},   // 长 zhang
+    {0x9646, "liu"},   // 陆 lu
+    {0x964D, "xiang"},   // 降 jiang
+    {0x9732, "lou"},   // 露 lu
+    {0x9A91, "ji"},   // 骑 qi
+};
+
+const char* extraReadings(uint32_t cp) {
+    auto it = std::lower_bound(std::begin(POLYPHONES), std::end(POLYPHONES), cp,
+                               [](const Polyphone& p, uint32_t v) { return p.codePoint < v; });
+    return it != std::end(POLYPHONES) && it->codePoint == cp ? it->readings : nullptr;
+}
+
+// 名称中的一段：汉字对应其全部读音，连续的非汉字字符原样作为唯一的"读音"
+struct Segment {
+    std::vector<std::string_view> readings;
+    bool literal = false;
+};
+
+// 各段读音的笛卡尔积，按首选读音优先的顺序截断到 PINYIN_MAX_KEYS 个
+void expand(const std::vector<Segment>& segments, bool initials, std::vector<std::string>& keys) {
+    keys.assign(1, std::string());
+    std::vector<std::string> next;
+
+    for (const auto& seg : segments) {
+        next.clear();
+        for (const auto& prefix : keys) {
+            for (std::string_view r : seg.readings) {
+                if (next.size() == PINYIN_MAX_KEYS) break;
+                std::string key = prefix;
+                key.append(initials && !seg.literal ? r.substr(0, 1) : r);
+                if (std::find(next.begin(), next.end(), key) == next.end()) next.push_back(std::move(key));
+            }
+        }
+        keys.swap(next);
+    }
+}
+
+} // namespace
+
+size_t appendPinyinKeys(std::string_view foldedName, std::string& out) {
+    // 基本区汉字的 UTF-8 首字节在 0xE4..0xE9 之间，不含这些字节的名称无需解码
+    bool maybeHan = std::any_of(foldedName.begin(), foldedName.end(), [](char c) {
+        unsigned char b = static_cast<unsigned char>(c);
+        return b >= 0xE4 && b <= 0xE9;
+    });
+    if (!maybeHan) return 0;
+
+    std::vector<Segment> segments;
+    bool hasHan = false;
+    size_t pos = 0;
+    while (pos < foldedName.size()) {
+        size_t start = pos;
+        uint32_t cp = nextCodePoint(foldedName, pos);
+
+        uint16_t reading = cp >= PINYIN_FIRST && cp <= PINYIN_LAST ? PINYIN_READINGS[cp - PINYIN_FIRST] : 0;
+        if (reading == 0) {
+            if (!segments.empty() && segments.back().literal) {
+                auto& last = segments.back().readings[0];
+                last = std::string_view(last.data(), pos - (last.data() - foldedName.data()));
+            } else {
+                segments.push_back({{foldedName.substr(start, pos - start)}, true});
+            }
+            continue;
+        }
+
+        hasHan = true;
+        Segment seg;
+        seg.readings.push_back(PINYIN_SYLLABLES[reading - 1]);
+        if (const char* extra = extraReadings(cp)) {
+            std::string_view rest(extra);
+            while (!rest.empty()) {
+                size_t space = rest.find(' ');
+                seg.readings.push_back(rest.substr(0, space));
+                rest = space == std::string_view::npos ? std::string_view() : rest.substr(space + 1);
+            }
+        }
+        segments.push_back(std::move(seg));
+    }
+    if (!hasHan) return 0;
+
+    std::vector<std::string> full, initials;
+    expand(segments, false, full);
+    expand(segments, true, initials);
+
+    size_t count = 0;
+    for (const auto* keys : {&full, &initials}) {
+        for (const auto& key : *keys) {
+            // 单字母音节（如"阿"）的全拼与首字母相同
+            if (keys == &initials && std::find(full.begin(), full.end(), key) != full.end()) continue;
+            if (count > 0) out.push_back('\0');
+            out.append(key);
+            ++count;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,824 @@
+#include "../include/query.h"
+#include "../include/event_source.h"
+#include "../include/query_index.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <ctime>
+#include <iterator>
+
+// ---------------------------------------------------------------
+// 通配符匹配：'*' 匹配任意串，'?' 匹配一个 UTF-8 字符
+// ---------------------------------------------------------------
+static size_t utf8Len(unsigned char c) {
+    if ((c & 0x80) == 0) return 1;
+    if ((c & 0xE0) == 0xC0) return 2;
+    if ((c & 0xF0) == 0xE0) return 3;
+    if ((c & 0xF8) == 0xF0) return 4;
+    return 1;
+}
+
+static bool globMatch(std::string_view pattern, std::string_view text) {
+    size_t p = 0, t = 0;
+    size_t star = std::string_view::npos, resume = 0;
+
+    while (t < text.size()) {
+        if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            resume = t;
+        } else if (p < pattern.size() && pattern[p] == '?') {
+            ++p;
+            t = std::min(text.size(), t + utf8Len(text[t]));
+        } else if (p < pattern.size() && pattern[p] == text[t]) {
+            ++p;
+            ++t;
+        } else if (star != std::string_view::npos) {
+            p = star + 1;
+            resume = std::min(text.size(), resume + utf8Len(text[resume]));
+            t = resume;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') ++p;
+    return p == pattern.size();
+}
+
+static bool hasWildcard(std::string_view s) {
+    return s.find_first_of("*?") != std::string_view::npos;
+}
+
+static bool hasSeparator(std::string_view s) {
+    return s.find_first_of("\\/") != std::string_view::npos;
+}
+
+// 拼音影子键只由 ASCII 组成，含非 ASCII 字符或不含字母的关键字不必再查一遍
+static bool mayMatchPinyin(std::string_view s) {
+    bool letter = false;
+    for (char c : s) {
+        if (static_cast<unsigned char>(c) >= 0x80) return false;
+        if (c >= 'a' && c <= 'z') letter = true;
+    }
+    return letter;
+}
+
+static bool globMatchAnyKey(std::string_view pattern, std::string_view keys) {
+    size_t pos = 0;
+    while (pos < keys.size()) {
+        size_t end = keys.find('\0', pos);
+        if (end == std::string_view::npos) end = keys.size();
+        if (globMatch(pattern, keys.substr(pos, end - pos))) return true;
+        pos = end + 1;
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------
+// 条件求值
+// ---------------------------------------------------------------
+bool QueryTerm::matches(const FileIndex& index, FileId id) const {
+    switch (kind) {
+    case TermKind::Size: {
+        ULONGLONG v = index.fileSize(id);
+        return v >= low && v <= high;
+    }
+    case TermKind::DateModified: {
+        ULONGLONG v = index.lastWriteTimeValue(id);
+        return v >= low && v <= high;
+    }
+    case TermKind::DateCreated: {
+        ULONGLONG v = index.creationTimeValue(id);
+        return v >= low && v <= high;
+    }
+    case TermKind::Extension: {
+        std::string_view e = index.foldedExtension(id);
+        for (const auto& x : extensions) {
+            if (e == x) return true;
+        }
+        return false;
+    }
+    case TermKind::Type: {
+        FileType t;
+        return classifyExtension(index.foldedExtension(id), t) &&
+               std::find(types.begin(), types.end(), t) != types.end();
+    }
+    case TermKind::Scope: {
+        if (bound) {
+            ULONGLONG v = index.tourLabel(id);
+            return v >= low && v <= high;
+        }
+        // 目录本身不算在范围内（卷根的完整路径带有结尾分隔符）
+        std::string full = FileIndex::fold(index.fullPath(id));
+        return full.size() > text.size() + 1 && full.compare(0, text.size(), text) == 0 &&
+               full[text.size()] == PATH_SEP;
+    }
+    case TermKind::Name:
+        if (index.foldedName(id).find(text) != std::string_view::npos) return true;
+        return pinyin && index.pinyin(id).find(text) != std::string_view::npos;
+    case TermKind::Wildcard:
+        if (globMatch(text, index.foldedName(id))) return true;
+        return pinyin && globMatchAnyKey(text, index.pinyin(id));
+    case TermKind::Fuzzy:
+        return fuzzy->distance(index.foldedName(id)) <= fuzzy->getMaxDistance();
+    case TermKind::Path: {
+        std::string full = FileIndex::fold(index.fullPath(id));
+        return glob ? globMatch(text, full) : full.find(text) != std::string::npos;
+    }
+    case TermKind::Regex: {
+        std::string_view name = index.foldedName(id);
+        return std::regex_search(name.begin(), name.end(), *regex);
+    }
+    }
+    return false;
+}
+
+bool QueryTerm::implies(const QueryTerm& other) const {
+    if (kind != other.kind) return false;
+
+    switch (kind) {
+    case TermKind::Size:
+    case TermKind::DateModified:
+    case TermKind::DateCreated:
+        return low >= other.low && high <= other.high;
+    case TermKind::Extension:
+        return std::all_of(extensions.begin(), extensions.end(), [&](const std::string& e) {
+            return std::find(other.extensions.begin(), other.extensions.end(), e) != other.extensions.end();
+        });
+    case TermKind::Type:
+        return std::all_of(types.begin(), types.end(), [&](FileType t) {
+            return std::find(other.types.begin(), other.types.end(), t) != other.types.end();
+        });
+    case TermKind::Name:
+        return text.find(other.text) != std::string::npos;
+    case TermKind::Scope:
+        return text.compare(0, other.text.size(), other.text) == 0 &&
+               (text.size() == other.text.size() || text[other.text.size()] == PATH_SEP);
+    case TermKind::Path:
+        if (glob || other.glob) return text == other.text && glob == other.glob;
+        return text.find(other.text) != std::string::npos;
+    default:
+        return source == other.source;
+    }
+}
+
+bool Query::matches(const FileIndex& index, FileId id) const {
+    for (const auto& term : terms) {
+        if (!term.matches(index, id)) return false;
+    }
+    return true;
+}
+
+bool Query::scoped() const {
+    return std::any_of(terms.begin(), terms.end(),
+                       [](const QueryTerm& t) { return t.kind == TermKind::Scope; });
+}
+
+void Query::bind(const FileIndex& index) {
+    for (auto& term : terms) {
+        if (term.kind == TermKind::Scope) term.bound = index.scopeOf(term.text, term.low, term.high);
+    }
+}
+
+bool Query::ranked() const {
+    return std::any_of(terms.begin(), terms.end(),
+                       [](const QueryTerm& t) { return t.kind == TermKind::Fuzzy; });
+}
+
+int Query::score(const FileIndex& index, FileId id) const {
+    int total = 0;
+    for (const auto& term : terms) {
+        if (term.kind == TermKind::Fuzzy) total += term.fuzzy->distance(index.foldedName(id));
+    }
+    return total;
+}
+
+bool Query::refines(const Query& older) const {
+    for (const auto& old : older.terms) {
+        bool covered = std::any_of(terms.begin(), terms.end(),
+                                   [&](const QueryTerm& t) { return t.implies(old); });
+        if (!covered) return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------
+// 解析
+// ---------------------------------------------------------------
+static std::vector<std::string> tokenize(const std::string& text) {
+    std::vector<std::string> tokens;
+    std::string current;
+    bool quoted = false;
+
+    for (char c : text) {
+        if (c == '"') {
+            quoted = !quoted;
+        } else if (!quoted && (c == ' ' || c == '\t')) {
+            if (!current.empty()) tokens.push_back(std::move(current));
+            current.clear();
+        } else {
+            current += c;
+        }
+    }
+    if (!current.empty()) tokens.push_back(std::move(current));
+    return tokens;
+}
+
+// 一个值对应的闭区间，例如 "10mb" 是 [10MB, 10MB]，"today" 是今天 0 点到 24 点
+struct Period {
+    ULONGLONG first = 0;
+    ULONGLONG last = 0;
+};
+
+static bool parseSize(const std::string& value, Period& out) {
+    static const struct { const char* name; ULONGLONG first, last; } keywords[] = {
+        {"empty",    0,                    0},
+        {"tiny",     1,                    10ULL << 10},
+        {"small",    (10ULL << 10) + 1,    100ULL << 10},
+        {"medium",   (100ULL << 10) + 1,   1ULL << 20},
+        {"large",    (1ULL << 20) + 1,     16ULL << 20},
+        {"huge",     (16ULL << 20) + 1,    128ULL << 20},
+        {"gigantic", (128ULL << 20) + 1,   ~0ULL},
+    };
+    for (const auto& k : keywords) {
+        if (value == k.name) {
+            out = {k.first, k.last};
+            return true;
+        }
+    }
+
+    char* end = nullptr;
+    double number = std::strtod(value.c_str(), &end);
+    if (end == value.c_str() || number < 0) return false;
+
+    std::string unit(end);
+    double scale;
+    if (unit.empty() || unit == "b") scale = 1;
+    else if (unit == "k" || unit == "kb") scale = 1024.0;
+    else if (unit == "m" || unit == "mb") scale = 1024.0 * 1024;
+    else if (unit == "g" || unit == "gb") scale = 1024.0 * 1024 * 1024;
+    else if (unit == "t" || unit == "tb") scale = 1024.0 * 1024 * 1024 * 1024;
+    else return false;
+
+    ULONGLONG bytes = static_cast<ULONGLONG>(number * scale);
+    out = {bytes, bytes};
+    return true;
+}
+
+static std::tm localNow() {
+    std::time_t now = std::time(nullptr);
+    std::tm tm{};
+#ifdef _WIN32
+    localtime_s(&tm, &now);
+#else
+    localtime_r(&now, &tm);
+#endif
+    return tm;
+}
+
+// 本地时间某天 0 点对应的 FILETIME 数值；mktime 会规范化越界的月、日
+static ULONGLONG localMidnight(int year, int month, int day) {
+    std::tm tm{};
+    tm.tm_year = year - 1900;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = day;
+    tm.tm_isdst = -1;
+    std::time_t t = std::mktime(&tm);
+    if (t < 0) return 0;
+    return (static_cast<ULONGLONG>(t) + 11644473600ULL) * 10000000ULL;
+}
+
+static bool parseDate(const std::string& value, Period& out) {
+    std::tm now = localNow();
+    int y = now.tm_year + 1900, m = now.tm_mon + 1, d = now.tm_mday;
+    int weekday = (now.tm_wday + 6) % 7;   // 周一为一周的第一天
+
+    auto span = [&](ULONGLONG from, ULONGLONG to) {
+        out = {from, to - 1};
+        return true;
+    };
+
+    if (value == "today")     return span(localMidnight(y, m, d), localMidnight(y, m, d + 1));
+    if (value == "yesterday") return span(localMidnight(y, m, d - 1), localMidnight(y, m, d));
+    if (value == "thisweek")  return span(localMidnight(y, m, d - weekday), localMidnight(y, m, d - weekday + 7));
+    if (value == "lastweek")  return span(localMidnight(y, m, d - weekday - 7), localMidnight(y, m, d - weekday));
+    if (value == "thismonth") return span(localMidnight(y, m, 1), localMidnight(y, m + 1, 1));
+    if (value == "lastmonth") return span(localMidnight(y, m - 1, 1), localMidnight(y, m, 1));
+    if (value == "thisyear")  return span(localMidnight(y, 1, 1), localMidnight(y + 1, 1, 1));
+    if (value == "lastyear")  return span(localMidnight(y - 1, 1, 1), localMidnight(y, 1, 1));
+
+    // YYYY、YYYY-MM、YYYY-MM-DD（也接受 '/' 与 '.' 分隔）
+    int parts[3] = {0, 0, 0};
+    int count = 0;
+    size_t pos = 0;
+    while (pos < value.size() && count < 3) {
+        size_t end = value.find_first_of("-/.", pos);
+        if (end == std::string::npos) end = value.size();
+        std::string field = value.substr(pos, end - pos);
+        if (field.empty() || !std::all_of(field.begin(), field.end(),
+                                          [](unsigned char c) { return std::isdigit(c); })) {
+            return false;
+        }
+        parts[count++] = std::atoi(field.c_str());
+        pos = end + 1;
+    }
+    if (count == 0 || pos < value.size()) return false;
+    if (parts[0] < 1601 || (count > 1 && (parts[1] < 1 || parts[1] > 12)) ||
+        (count > 2 && (parts[2] < 1 || parts[2] > 31))) {
+        return false;
+    }
+
+    if (count == 1) return span(localMidnight(parts[0], 1, 1), localMidnight(parts[0] + 1, 1, 1));
+    if (count == 2) return span(localMidnight(parts[0], parts[1], 1), localMidnight(parts[0], parts[1] + 1, 1));
+    return span(localMidnight(parts[0], parts[1], parts[2]), localMidnight(parts[0], parts[1], parts[2] + 1));
+}
+
+// 比较运算与区间：>x  >=x  <x  <=x  =x  x  a..b
+template <typename ParseFn>
+static bool parseRange(const std::string& value, ParseFn parseValue, QueryTerm& term) {
+    size_t dots = value.find("..");
+    if (dots != std::string::npos) {
+        Period a, b;
+        if (!parseValue(value.substr(0, dots), a) || !parseValue(value.substr(dots + 2), b)) return false;
+        term.low = a.first;
+        term.high = b.last;
+        return term.low <= term.high;
+    }
+
+    std::string op;
+    size_t i = 0;
+    while (i < value.size() && (value[i] == '>' || value[i] == '<' || value[i] == '=')) op += value[i++];
+
+    Period p;
+    if (!parseValue(value.substr(i), p)) return false;
+
+    if (op.empty() || op == "=") {
+        term.low = p.first;
+        term.high = p.last;
+    } else if (op == ">") {
+        if (p.last == ~0ULL) return false;
+        term.low = p.last + 1;
+    } else if (op == ">=") {
+        term.low = p.first;
+    } else if (op == "<") {
+        if (p.first == 0) return false;
+        term.high = p.first - 1;
+    } else if (op == "<=") {
+        term.high = p.last;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool parseTerm(const std::string& token, QueryTerm& term, std::string& error) {
+    term.source = token;
+
+    size_t colon = token.find(':');
+    std::string prefix = colon == std::string::npos ? "" : FileIndex::fold(token.substr(0, colon));
+    std::string value = colon == std::string::npos ? "" : token.substr(colon + 1);
+    std::string folded = FileIndex::fold(value);
+
+    if (prefix == "ext") {
+        term.kind = TermKind::Extension;
+        size_t pos = 0;
+        while (pos <= folded.size()) {
+            size_t end = folded.find_first_of(";,", pos);
+            if (end == std::string::npos) end = folded.size();
+            std::string e = folded.substr(pos, end - pos);
+            if (!e.empty() && e[0] == '.') e.erase(0, 1);
+            if (!e.empty()) term.extensions.push_back(e);
+            pos = end + 1;
+        }
+        if (term.extensions.empty()) {
+            error = "ext: 缺少扩展名";
+            return false;
+        }
+        return true;
+    }
+
+    if (prefix == "type") {
+        term.kind = TermKind::Type;
+        size_t pos = 0;
+        while (pos <= folded.size()) {
+            size_t end = folded.find_first_of(";,", pos);
+            if (end == std::string::npos) end = folded.size();
+            FileType t;
+            if (end > pos) {
+                if (!parseFileType(std::string_view(folded).substr(pos, end - pos), t)) {
+                    error = "无法识别的文件类型: " + folded.substr(pos, end - pos);
+                    return false;
+                }
+                term.types.push_back(t);
+            }
+            pos = end + 1;
+        }
+        if (term.types.empty()) {
+            error = "type: 缺少类型名";
+            return false;
+        }
+        return true;
+    }
+
+    if (prefix == "size") {
+        term.kind = TermKind::Size;
+        if (!parseRange(folded, parseSize, term)) {
+            error = "无法识别的大小条件: " + token;
+            return false;
+        }
+        return true;
+    }
+
+    if (prefix == "dm" || prefix == "datemodified" || prefix == "dc" || prefix == "datecreated") {
+        term.kind = (prefix == "dm" || prefix == "datemodified") ? TermKind::DateModified : TermKind::DateCreated;
+        if (!parseRange(folded, parseDate, term)) {
+            error = "无法识别的日期条件: " + token;
+            return false;
+        }
+        return true;
+    }
+
+    if (prefix == "path") {
+        term.kind = TermKind::Path;
+        term.text = folded;
+        term.glob = hasWildcard(folded);
+        if (term.text.empty()) {
+            error = "path: 缺少路径";
+            return false;
+        }
+        return true;
+    }
+
+    if (prefix == "in") {
+        term.kind = TermKind::Scope;
+        term.text = folded;
+#ifdef _WIN32
+        std::replace(term.text.begin(), term.text.end(), '/', '\\');
+#endif
+        while (!term.text.empty() && term.text.back() == PATH_SEP) term.text.pop_back();
+        if (term.text.empty()) {
+            error = "in: 缺少目录";
+            return false;
+        }
+        return true;
+    }
+
+    if (prefix == "fuzzy") {
+        // fuzzy:pattern 或 fuzzy:k:pattern（文件名中不会出现 ':'，不会有歧义）
+        term.kind = TermKind::Fuzzy;
+        int maxDistance = -1;
+        size_t sep = folded.find(':');
+        if (sep != std::string::npos && sep > 0 &&
+            std::all_of(folded.begin(), folded.begin() + sep, [](unsigned char c) { return std::isdigit(c); })) {
+            maxDistance = std::atoi(folded.substr(0, sep).c_str());
+            folded.erase(0, sep + 1);
+        }
+        term.text = folded;
+        auto pattern = std::make_shared<FuzzyPattern>();
+        if (!pattern->compile(folded, maxDistance)) {
+            error = "近似匹配模式为空或超过 64 个字符: " + token;
+            return false;
+        }
+        term.fuzzy = std::move(pattern);
+        return true;
+    }
+
+    if (prefix == "regex") {
+        term.kind = TermKind::Regex;
+        try {
+            term.regex = std::make_shared<const std::regex>(
+                value, std::regex::ECMAScript | std::regex::icase | std::regex::optimize);
+        } catch (const std::regex_error& e) {
+            error = std::string("正则表达式错误: ") + e.what();
+            return false;
+        }
+        return true;
+    }
+
+    // 普通关键字（包括 "D:\build" 这种带盘符的写法）
+    term.text = FileIndex::fold(token);
+    term.glob = hasWildcard(term.text);
+    if (hasSeparator(term.text)) {
+        term.kind = TermKind::Path;
+    } else {
+        term.kind = term.glob ? TermKind::Wildcard : TermKind::Name;
+        term.pinyin = mayMatchPinyin(term.text);
+    }
+    return true;
+}
+
+bool Query::parse(const std::string& text, Query& out, std::string& error) {
+    out.terms.clear();
+
+    for (const auto& token : tokenize(text)) {
+        QueryTerm term;
+        if (!parseTerm(token, term, error)) return false;
+        out.terms.push_back(std::move(term));
+    }
+
+    std::stable_sort(out.terms.begin(), out.terms.end(), [](const QueryTerm& a, const QueryTerm& b) {
+        return static_cast<int>(a.kind) < static_cast<int>(b.kind);
+    });
+    return true;
+}
+
+// ---------------------------------------------------------------
+// 规划
+// ---------------------------------------------------------------
+
+// 名称条件中可用于三元组过滤的字面量片段
+static std::vector<std::string> literalsOf(const QueryTerm& term) {
+    std::vector<std::string> literals;
+    if (term.kind == TermKind::Name) {
+        literals.push_back(term.text);
+    } else if (term.kind == TermKind::Wildcard) {
+        size_t pos = 0;
+        while (pos <= term.text.size()) {
+            size_t end = term.text.find_first_of("*?", pos);
+            if (end == std::string::npos) end = term.text.size();
+            if (end > pos) literals.push_back(term.text.substr(pos, end - pos));
+            pos = end + 1;
+        }
+    }
+    return literals;
+}
+
+static std::vector<uint32_t> trigramKeysOf(const QueryTerm& term) {
+    std::vector<uint32_t> all, keys;
+    for (const auto& literal : literalsOf(term)) {
+        TrigramPostings::keysOf(literal, keys);
+        all.insert(all.end(), keys.begin(), keys.end());
+    }
+    std::sort(all.begin(), all.end());
+    all.erase(std::unique(all.begin(), all.end()), all.end());
+    return all;
+}
+
+// q-gram 引理：模式在 k 次编辑内出现时，至少与模式共享 threshold 个不同的三元组
+// 每次编辑最多破坏 (最宽字符的字节数 + 2) 个字节三元组；模式自身重复的三元组、
+// 以及因过于常见而未保存的三元组都要从阈值中扣除。阈值不大于 0 时无法过滤。
+static int fuzzyThreshold(const QueryTerm& term, const TrigramPostings& part,
+                          std::vector<uint32_t>& storedKeys) {
+    const std::string& pattern = term.text;
+    if (pattern.size() < 3) return 0;
+
+    int widest = 1;
+    for (size_t pos = 0; pos < pattern.size();) {
+        size_t before = pos;
+        nextCodePoint(pattern, pos);
+        widest = std::max(widest, static_cast<int>(pos - before));
+    }
+
+    std::vector<uint32_t> keys;
+    TrigramPostings::keysOf(pattern, keys);
+    int positions = static_cast<int>(pattern.size()) - 2;
+    int threshold = positions - term.fuzzy->getMaxDistance() * (widest + 2) -
+                    (positions - static_cast<int>(keys.size()));
+
+    storedKeys.clear();
+    for (uint32_t k : keys) {
+        if (part.isStored(k)) storedKeys.push_back(k);
+        else --threshold;
+    }
+    return threshold;
+}
+
+// 鸽巢原理：把模式切成 k+1 段，k 次编辑内的出现至少让其中一段原样出现
+// 每段都需要至少一个已保存的三元组，否则无法过滤
+static bool pigeonholePieces(const QueryTerm& term, const TrigramPostings& part,
+                             std::vector<std::vector<uint32_t>>& pieces) {
+    const std::string& pattern = term.text;
+    const int segments = term.fuzzy->getMaxDistance() + 1;
+    const int length = term.fuzzy->getLength();
+
+    pieces.clear();
+    size_t pos = 0;
+    for (int s = 0; s < segments; ++s) {
+        // 按码点均分，保证不在多字节字符中间切开
+        int count = length / segments + (s < length % segments ? 1 : 0);
+        size_t begin = pos;
+        for (int i = 0; i < count; ++i) nextCodePoint(pattern, pos);
+
+        std::vector<uint32_t> keys;
+        TrigramPostings::keysOf(std::string_view(pattern).substr(begin, pos - begin), keys);
+        keys.erase(std::remove_if(keys.begin(), keys.end(),
+                                  [&](uint32_t k) { return !part.isStored(k); }),
+                   keys.end());
+        if (keys.empty()) return false;
+        pieces.push_back(std::move(keys));
+    }
+    return true;
+}
+
+static size_t estimateTerm(const QueryTerm& term, QueryIndexes& indexes) {
+    switch (term.kind) {
+    case TermKind::Size:
+        return indexes.sizes()->countInRange(term.low, term.high);
+    case TermKind::DateModified:
+        return indexes.writeTimes()->countInRange(term.low, term.high);
+    case TermKind::Scope:
+        return term.bound ? indexes.tourLabels()->countInRange(term.low, term.high) : SIZE_MAX;
+    case TermKind::Name:
+    case TermKind::Wildcard: {
+        std::vector<uint32_t> keys = trigramKeysOf(term);
+        if (keys.empty()) return SIZE_MAX;
+
+        auto part = indexes.trigrams();
+        size_t best = SIZE_MAX;
+        for (uint32_t k : keys) {
+            if (part->isStored(k)) best = std::min(best, part->postingSize(k));
+        }
+        return best;
+    }
+    case TermKind::Fuzzy: {
+        auto part = indexes.trigrams();
+        std::vector<uint32_t> keys;
+        int threshold = fuzzyThreshold(term, *part, keys);
+        if (threshold > 0) {
+            size_t total = 0;
+            for (uint32_t k : keys) total += part->postingSize(k);
+            return total / threshold;
+        }
+
+        std::vector<std::vector<uint32_t>> pieces;
+        if (!pigeonholePieces(term, *part, pieces)) return SIZE_MAX;
+        size_t total = 0;
+        for (const auto& piece : pieces) {
+            size_t best = SIZE_MAX;
+            for (uint32_t k : piece) best = std::min(best, part->postingSize(k));
+            total += best;
+        }
+        return total;
+    }
+    default:
+        return SIZE_MAX;   // 没有索引，只能逐条过滤
+    }
+}
+
+// 扩展名 / 类型条件的位图：条件内各值取并集，条件之间取交集
+static std::shared_ptr<const RoaringBitmap> typeFilter(const Query& query, const FileIndex& index) {
+    std::shared_ptr<RoaringBitmap> filter;
+    for (const auto& term : query.getTerms()) {
+        if (term.kind != TermKind::Extension && term.kind != TermKind::Type) continue;
+
+        RoaringBitmap any;
+        if (term.kind == TermKind::Extension) {
+            for (const auto& e : term.extensions) {
+                if (const RoaringBitmap* b = index.extensionBitmap(e)) any.orWith(*b);
+            }
+        } else {
+            for (FileType t : term.types) any.orWith(index.typeBitmap(t));
+        }
+
+        if (!filter) filter = std::make_shared<RoaringBitmap>(std::move(any));
+        else filter->andWith(any);
+    }
+    return filter;
+}
+
+QueryPlan planQuery(const Query& query, const FileIndex& index, QueryIndexes& indexes) {
+    QueryPlan plan;
+    plan.estimate = index.nodeCount();
+
+    plan.filter = typeFilter(query, index);
+    if (plan.filter && plan.filter->cardinality() < plan.estimate) {
+        plan.estimate = plan.filter->cardinality();
+        plan.filterDrives = true;
+    }
+
+    for (const auto& term : query.getTerms()) {
+        size_t estimate = estimateTerm(term, indexes);
+        if (estimate < plan.estimate) {
+            plan.estimate = estimate;
+            plan.driver = &term;
+            plan.filterDrives = false;
+        }
+    }
+
+    // 候选集太大时，随机访问不如顺序扫描
+    if ((plan.driver || plan.filterDrives) && plan.estimate > index.nodeCount() / 4) {
+        plan.driver = nullptr;
+        plan.filterDrives = false;
+        plan.estimate = index.nodeCount();
+    }
+    return plan;
+}
+
+static void intersectInto(std::vector<FileId>& acc, const FileId* begin, const FileId* end) {
+    std::vector<FileId> merged;
+    merged.reserve(std::min<size_t>(acc.size(), end - begin));
+    std::set_intersection(acc.begin(), acc.end(), begin, end, std::back_inserter(merged));
+    acc.swap(merged);
+}
+
+bool collectCandidates(const QueryPlan& plan, const FileIndex& index, QueryIndexes& indexes,
+                       std::vector<FileId>& out) {
+    out.clear();
+    if (plan.filterDrives) {
+        // 位图随写操作即时维护，不需要补充变更日志
+        plan.filter->appendTo(out);
+        return true;
+    }
+    if (!plan.driver) return false;
+
+    const QueryTerm& term = *plan.driver;
+    uint64_t mark = 0;
+
+    switch (term.kind) {
+    case TermKind::Size: {
+        auto part = indexes.sizes();
+        mark = part->mark;
+        part->collectRange(term.low, term.high, out);
+        break;
+    }
+    case TermKind::DateModified: {
+        auto part = indexes.writeTimes();
+        mark = part->mark;
+        part->collectRange(term.low, term.high, out);
+        break;
+    }
+    case TermKind::Scope: {
+        if (!term.bound) return false;
+        auto part = indexes.tourLabels();
+        mark = part->mark;
+        part->collectRange(term.low, term.high, out);
+        break;
+    }
+    case TermKind::Name:
+    case TermKind::Wildcard: {
+        auto part = indexes.trigrams();
+        mark = part->mark;
+
+        // 从最短的倒排表开始求交集
+        std::vector<uint32_t> keys = trigramKeysOf(term);
+        keys.erase(std::remove_if(keys.begin(), keys.end(),
+                                  [&](uint32_t k) { return !part->isStored(k); }),
+                   keys.end());
+        if (keys.empty()) return false;
+        std::sort(keys.begin(), keys.end(), [&](uint32_t a, uint32_t b) {
+            return part->postingSize(a) < part->postingSize(b);
+        });
+
+        out.assign(part->postingBegin(keys[0]), part->postingBegin(keys[0]) + part->postingSize(keys[0]));
+        for (size_t i = 1; i < keys.size() && !out.empty(); ++i) {
+            intersectInto(out, part->postingBegin(keys[i]), part->postingBegin(keys[i]) + part->postingSize(keys[i]));
+        }
+        break;
+    }
+    case TermKind::Fuzzy: {
+        auto part = indexes.trigrams();
+        mark = part->mark;
+
+        std::vector<uint32_t> keys;
+        int threshold = fuzzyThreshold(term, *part, keys);
+        if (threshold > 0) {
+            // 计数过滤：命中的三元组数达到阈值的名称才进入位并行验证
+            std::vector<uint8_t> hits(index.nodeCount(), 0);
+            for (uint32_t k : keys) {
+                const FileId* it = part->postingBegin(k);
+                const FileId* end = it + part->postingSize(k);
+                for (; it != end; ++it) {
+                    if (++hits[*it] == threshold) out.push_back(*it);
+                }
+            }
+            std::sort(out.begin(), out.end());
+            break;
+        }
+
+        // 短模式退回鸽巢过滤：各段三元组求交，再取并集
+        std::vector<std::vector<uint32_t>> pieces;
+        if (!pigeonholePieces(term, *part, pieces)) return false;
+        for (const auto& piece : pieces) {
+            std::vector<FileId> hits(part->postingBegin(piece[0]),
+                                     part->postingBegin(piece[0]) + part->postingSize(piece[0]));
+            for (size_t i = 1; i < piece.size() && !hits.empty(); ++i) {
+                intersectInto(hits, part->postingBegin(piece[i]), part->postingBegin(piece[i]) + part->postingSize(piece[i]));
+            }
+            std::vector<FileId> merged;
+            merged.reserve(out.size() + hits.size());
+            std::set_union(out.begin(), out.end(), hits.begin(), hits.end(), std::back_inserter(merged));
+            out.swap(merged);
+        }
+        break;
+    }
+    default:
+        return false;
+    }
+
+    // 索引构建之后改动过的节点一并作为候选，由过滤阶段确认
+    std::vector<FileId> changed;
+    if (!index.changedSince(mark, changed)) return false;
+    if (!changed.empty()) {
+        std::vector<FileId> merged;
+        merged.reserve(out.size() + changed.size());
+        std::set_union(out.begin(), out.end(), changed.begin(), changed.end(), std::back_inserter(merged));
+        out.swap(merged);
+    }
+
+    // 字符串匹配之前先用扩展名 / 类型位图剔除
+    if (plan.filter) {
+        out.erase(std::remove_if(out.begin(), out.end(), [&](FileId id) { return !plan.filter->contains(id); }),
+                  out.end());
+    }
+    return true;
+}
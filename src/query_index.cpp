@@ -0,0 +1,170 @@
+#include "../include/query_index.h"
+
+#include <algorithm>
+
+size_t SortedColumn::countInRange(ULONGLONG low, ULONGLONG high) const {
+    auto first = std::lower_bound(keys.begin(), keys.end(), low);
+    auto last = std::upper_bound(first, keys.end(), high);
+    return static_cast<size_t>(last - first);
+}
+
+void SortedColumn::collectRange(ULONGLONG low, ULONGLONG high, std::vector<FileId>& out) const {
+    auto first = std::lower_bound(keys.begin(), keys.end(), low);
+    auto last = std::upper_bound(first, keys.end(), high);
+    out.assign(ids.begin() + (first - keys.begin()), ids.begin() + (last - keys.begin()));
+    std::sort(out.begin(), out.end());
+}
+
+uint32_t TrigramPostings::symbol(unsigned char c) {
+    if (c >= 'a' && c <= 'z') return c - 'a';
+    if (c >= '0' && c <= '9') return 26 + (c - '0');
+    switch (c) {
+    case '.': return 36;
+    case '_': return 37;
+    case '-': return 38;
+    case ' ': return 39;
+    default: break;
+    }
+    return c < 0x80 ? 40 + (c & 7) : 48 + (c & 15);
+}
+
+void TrigramPostings::keysOf(std::string_view foldedText, std::vector<uint32_t>& out) {
+    out.clear();
+    if (foldedText.size() < 3) return;
+
+    for (size_t i = 0; i + 3 <= foldedText.size(); ++i) {
+        out.push_back((symbol(foldedText[i]) << 12) |
+                      (symbol(foldedText[i + 1]) << 6) |
+                      symbol(foldedText[i + 2]));
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+// 节点名称与拼音影子键的三元组合集，使名称条件经三元组过滤后仍能命中拼音匹配
+static void nodeTrigrams(const FileIndex& index, FileId id, std::vector<uint32_t>& out,
+                         std::vector<uint32_t>& scratch) {
+    TrigramPostings::keysOf(index.foldedName(id), out);
+
+    std::string_view keys = index.pinyin(id);
+    if (keys.empty()) return;
+
+    size_t pos = 0;
+    while (pos < keys.size()) {
+        size_t end = keys.find('\0', pos);
+        if (end == std::string_view::npos) end = keys.size();
+        TrigramPostings::keysOf(keys.substr(pos, end - pos), scratch);
+        out.insert(out.end(), scratch.begin(), scratch.end());
+        pos = end + 1;
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+template <typename KeyFn>
+static std::shared_ptr<SortedColumn> buildSorted(const FileIndex& index, KeyFn key) {
+    auto part = std::make_shared<SortedColumn>();
+    part->mark = index.changeMark();
+
+    std::vector<std::pair<ULONGLONG, FileId>> pairs;
+    pairs.reserve(index.nodeCount());
+    for (FileId id = 0; id < index.nodeCount(); ++id) {
+        if (index.isListed(id)) pairs.emplace_back(key(id), id);
+    }
+    std::sort(pairs.begin(), pairs.end());
+
+    part->keys.reserve(pairs.size());
+    part->ids.reserve(pairs.size());
+    for (const auto& [k, id] : pairs) {
+        part->keys.push_back(k);
+        part->ids.push_back(id);
+    }
+    return part;
+}
+
+static std::shared_ptr<const TrigramPostings> buildTrigrams(const FileIndex& index) {
+    auto part = std::make_shared<TrigramPostings>();
+    part->mark = index.changeMark();
+    part->counts.assign(TrigramPostings::KEY_SPACE, 0);
+
+    std::vector<uint32_t> keys, scratch;
+    size_t listed = 0;
+    for (FileId id = 0; id < index.nodeCount(); ++id) {
+        if (!index.isListed(id)) continue;
+        ++listed;
+        nodeTrigrams(index, id, keys, scratch);
+        for (uint32_t k : keys) part->counts[k]++;
+    }
+
+    // 过于常见的三元组几乎不能缩小候选集，却占去大部分空间
+    part->commonThreshold = std::max<size_t>(1024, listed / 8);
+
+    part->offsets.assign(TrigramPostings::KEY_SPACE + 1, 0);
+    for (uint32_t k = 0; k < TrigramPostings::KEY_SPACE; ++k) {
+        uint32_t stored = part->isStored(k) ? part->counts[k] : 0;
+        part->offsets[k + 1] = part->offsets[k] + stored;
+    }
+    part->ids.resize(part->offsets.back());
+
+    std::vector<uint32_t> cursor(part->offsets.begin(), part->offsets.end() - 1);
+    for (FileId id = 0; id < index.nodeCount(); ++id) {
+        if (!index.isListed(id)) continue;
+        nodeTrigrams(index, id, keys, scratch);
+        for (uint32_t k : keys) {
+            if (part->isStored(k)) part->ids[cursor[k]++] = id;
+        }
+    }
+    return part;
+}
+
+bool QueryIndexes::isFresh(uint64_t mark) const {
+    if (!index.changeLogCovers(mark)) return false;
+    uint64_t pending = index.changeMark() - mark;
+    return pending <= std::max<uint64_t>(1 << 16, index.nodeCount() / 16);
+}
+
+std::shared_ptr<const SortedColumn> QueryIndexes::sizes() {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!sizePart || !isFresh(sizePart->mark)) {
+        sizePart = buildSorted(index, [this](FileId id) { return index.fileSize(id); });
+    }
+    return sizePart;
+}
+
+std::shared_ptr<const SortedColumn> QueryIndexes::writeTimes() {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!writeTimePart || !isFresh(writeTimePart->mark)) {
+        writeTimePart = buildSorted(index, [this](FileId id) { return index.lastWriteTimeValue(id); });
+    }
+    return writeTimePart;
+}
+
+std::shared_ptr<const TrigramPostings> QueryIndexes::trigrams() {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!trigramPart || !isFresh(trigramPart->mark)) {
+        trigramPart = buildTrigrams(index);
+    }
+    return trigramPart;
+}
+
+std::shared_ptr<const SortedColumn> QueryIndexes::tourLabels() {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!tourPart || tourPart->epoch != index.getTourEpoch() || !isFresh(tourPart->mark)) {
+        auto part = buildSorted(index, [this](FileId id) { return index.tourLabel(id); });
+        part->epoch = index.getTourEpoch();
+        tourPart = std::move(part);
+    }
+    return tourPart;
+}
+
+void QueryIndexes::settle() {
+    std::lock_guard<std::mutex> lock(mtx);
+    const uint64_t mark = index.changeMark();
+    if (sizePart && sizePart->mark != mark) {
+        sizePart = buildSorted(index, [this](FileId id) { return index.fileSize(id); });
+    }
+    if (writeTimePart && writeTimePart->mark != mark) {
+        writeTimePart = buildSorted(index, [this](FileId id) { return index.lastWriteTimeValue(id); });
+    }
+    if (trigramPart && trigramPart->mark != mark) trigramPart = buildTrigrams(index);
+}
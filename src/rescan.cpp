@@ -0,0 +1,260 @@
+#include "../include/rescan.h"
+#include "../include/event_source.h"
+#include "../include/exclude.h"
+#include "../include/file_index.h"
+#include "../include/log.h"
+#include "../include/util.h"
+
+#ifndef _WIN32
+#include "../include/tree_walker.h"
+
+#include <sys/stat.h>
+#include <cerrno>
+#endif
+
+#include <algorithm>
+
+namespace {
+
+// path 等于 prefix 或位于其下（两者都已折叠且不以分隔符结尾）
+bool under(const std::string& path, const std::string& prefix) {
+    return path.compare(0, prefix.size(), prefix) == 0 &&
+           (path.size() == prefix.size() || path[prefix.size()] == PATH_SEP);
+}
+
+std::string trimmed(const std::string& path) {
+    std::string out = path;
+#ifdef _WIN32
+    for (char& c : out) {
+        if (c == '/') c = '\\';
+    }
+    while (!out.empty() && out.back() == '\\') out.pop_back();
+#else
+    while (out.size() > 1 && out.back() == '/') out.pop_back();
+#endif
+    return out;
+}
+
+} // namespace
+
+SubtreeRescanner::SubtreeRescanner(FileIndex* fileIndex, Deliver fn)
+    : index(fileIndex), deliver(std::move(fn)) {
+    worker = std::thread(&SubtreeRescanner::run, this);
+}
+
+SubtreeRescanner::~SubtreeRescanner() {
+    stop();
+}
+
+void SubtreeRescanner::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+        pending.clear();
+#ifndef _WIN32
+        if (walking) walking->cancel();
+#endif
+    }
+    wake.notify_all();
+    if (worker.joinable()) worker.join();
+}
+
+void SubtreeRescanner::schedule(const std::string& path, Priority priority) {
+    const std::string root = trimmed(path);
+    const std::string key = FileIndex::fold(root);
+    const Clock::time_point now = Clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (stopping) return;
+
+        Clock::time_point notBefore = now + QUIET_PERIOD;
+        auto last = lastRun.find(key);
+        if (last != lastRun.end()) notBefore = std::max(notBefore, last->second + MIN_INTERVAL);
+
+        // 已在排队的请求推迟到这次溢出平息之后
+        auto it = std::find_if(pending.begin(), pending.end(), [&](const Request& r) { return r.key == key; });
+        if (it != pending.end()) {
+            it->priority = std::max(it->priority, priority);
+            it->notBefore = notBefore;
+        } else {
+            pending.push_back({root, key, priority, notBefore});
+        }
+    }
+    wake.notify_all();
+}
+
+void SubtreeRescanner::run() {
+    std::unique_lock<std::mutex> lock(mtx);
+    while (!stopping) {
+        if (pending.empty()) {
+            wake.wait(lock);
+            continue;
+        }
+
+        // 已到时间的请求中取优先级最高、最早到期的一个；都没到时间就等最早的那个
+        const Clock::time_point now = Clock::now();
+        auto ready = pending.end();
+        auto earliest = pending.begin();
+        for (auto it = pending.begin(); it != pending.end(); ++it) {
+            if (it->notBefore < earliest->notBefore) earliest = it;
+            if (it->notBefore > now) continue;
+            if (ready == pending.end() || it->priority > ready->priority ||
+                (it->priority == ready->priority && it->notBefore < ready->notBefore)) {
+                ready = it;
+            }
+        }
+        if (ready == pending.end()) {
+            wake.wait_until(lock, earliest->notBefore);
+            continue;
+        }
+
+        Request request = std::move(*ready);
+        pending.erase(ready);
+        for (auto it = lastRun.begin(); it != lastRun.end();) {
+            it = now - it->second > MIN_INTERVAL ? lastRun.erase(it) : std::next(it);
+        }
+        lastRun[request.key] = now;
+
+        lock.unlock();
+        RescanResult result;
+        bool ok = scan(request.path, result);
+        lock.lock();
+        if (ok && !stopping) {
+            // 在锁外交付会与 stop 竞争，deliver 只做入队，持锁调用即可
+            deliver(std::move(result));
+        }
+    }
+}
+
+bool SubtreeRescanner::scan(const std::string& root, RescanResult& out) {
+    out.root = root;
+
+    // 先枚举磁盘上的现状，键为折叠后的完整路径
+    std::unordered_map<std::string, FileRecord> disk;
+    std::vector<std::string> unreadable;   // 无法列出的目录，索引中它们下面的项不能判为已删除
+    // 被排除的目录不进入，索引中已有的这些项随之判为删除
+    const auto rules = exclusionRules();
+    ExclusionRules::Cursor rootCursor;
+#ifdef _WIN32
+    std::vector<std::pair<std::string, ExclusionRules::Cursor>> dirs;
+    if (!rules->walk(rootCursor, root)) dirs.emplace_back(root, rootCursor);
+    size_t visited = 0;
+    while (!dirs.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (stopping) return false;
+        }
+        if (++visited % DIRS_PER_PAUSE == 0) std::this_thread::sleep_for(PAUSE);
+
+        std::string dir = std::move(dirs.back().first);
+        const ExclusionRules::Cursor dirCursor = dirs.back().second;
+        dirs.pop_back();
+
+        WIN32_FIND_DATAW data;
+        HANDLE find = FindFirstFileExW(utf8_to_wide(dir + "\\*").c_str(), FindExInfoBasic, &data,
+                                       FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+        if (find == INVALID_HANDLE_VALUE) {
+            DWORD err = GetLastError();
+            if (err != ERROR_FILE_NOT_FOUND && err != ERROR_PATH_NOT_FOUND) {
+                unreadable.push_back(FileIndex::fold(dir));
+            }
+            continue;
+        }
+
+        do {
+            std::string name = wide_to_utf8(data.cFileName);
+            if (name == "." || name == "..") continue;
+
+            ExclusionRules::Cursor cursor = dirCursor;
+            if (rules->step(cursor, name)) continue;
+
+            FileRecord record{};
+            record.fullpath = dir + "\\" + name;
+            record.fileSize = (static_cast<ULONGLONG>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+            record.creationTime = data.ftCreationTime;
+            record.lastAccessTime = data.ftLastAccessTime;
+            record.lastWriteTime = data.ftLastWriteTime;
+
+            // 不跟随目录联接，避免重复枚举或跳出子树
+            if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
+                !(data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
+                dirs.emplace_back(record.fullpath, cursor);
+            }
+            disk.emplace(FileIndex::fold(record.fullpath), std::move(record));
+        } while (FindNextFileW(find, &data));
+        FindClose(find);
+    }
+#else
+    // 与全量载入一样由 TreeWalker 枚举并批量取文件信息；只用少量线程，不与前台争抢磁盘
+    if (!rules->walk(rootCursor, root)) {
+        TreeWalker walker;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (stopping) return false;
+            walking = &walker;
+        }
+        std::vector<WalkEntry> entries;
+        const bool walked = walker.walk(root, entries, WALK_THREADS);
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            walking = nullptr;
+            if (stopping) return false;
+        }
+
+        if (walked) {
+            std::vector<FileRecord> records;
+            TreeWalker::toRecords(entries, records);
+            for (auto& record : records) disk.emplace(FileIndex::fold(record.fullpath), std::move(record));
+            for (const auto& dir : walker.unreadable()) unreadable.push_back(FileIndex::fold(dir));
+        } else {
+            // 子树本身已不存在时其下的项都判为删除，否则一项都不能删
+            struct stat st;
+            if (lstat(root.c_str(), &st) == 0 || !isNotFound(errno)) unreadable.push_back(FileIndex::fold(root));
+        }
+    }
+#endif
+
+    // 与索引中该子树的现有内容对比，只留下差异
+    if (index) {
+        bool compared = false;
+        for (int attempt = 0; attempt < 3 && !compared; ++attempt) {
+            index->buildLookup();
+            index->buildTour();
+
+            auto lock = index->lockShared();
+            ULONGLONG low, high;
+            if (!index->scopeOf(root, low, high)) continue;   // 期间有目录被移动，编号又失效了
+
+            for (FileId id = 0; id < index->nodeCount(); ++id) {
+                if (!index->isListed(id)) continue;
+                const uint64_t label = index->tourLabel(id);
+                if (label < low || label > high) continue;
+
+                FileRecord current = index->record(id);
+                const std::string key = FileIndex::fold(current.fullpath);
+                auto it = disk.find(key);
+                if (it == disk.end()) {
+                    bool hidden = std::any_of(unreadable.begin(), unreadable.end(),
+                                              [&](const std::string& dir) { return under(key, dir); });
+                    if (!hidden) out.removals.push_back(current.fullpath);
+                } else if (it->second.fileSize == current.fileSize &&
+                           fileTimeToUInt64(it->second.lastWriteTime) == fileTimeToUInt64(current.lastWriteTime)) {
+                    disk.erase(it);
+                }
+            }
+            compared = true;
+        }
+        if (!compared) {
+            LOG_WARN("重扫时无法定位索引中的子树: " << root);
+            return false;
+        }
+    }
+
+    out.upserts.reserve(disk.size());
+    for (auto& entry : disk) out.upserts.push_back(std::move(entry.second));
+    // 上级目录先于其中的项写入
+    std::sort(out.upserts.begin(), out.upserts.end(), [](const FileRecord& a, const FileRecord& b) {
+        return a.fullpath < b.fullpath;
+    });
+    return true;
+}
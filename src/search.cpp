@@ -0,0 +1,162 @@
+#include "../include/search.h"
+#include "../include/parallel.h"
+
+#include <algorithm>
+
+namespace {
+
+struct RankedEntry {
+    ULONGLONG key;
+    FileId id;
+};
+
+// 有界堆：堆顶是已保留条目中排名最靠后的一条，新条目更靠前时替换它
+class TopK {
+private:
+    size_t limit;
+    bool descending;
+    std::vector<RankedEntry> heap;
+
+public:
+    TopK(size_t k, bool desc) : limit(k), descending(desc) {}
+
+    // a 是否排在 b 前面；键相同时按 FileId 升序，保证结果稳定
+    bool before(const RankedEntry& a, const RankedEntry& b) const {
+        if (a.key != b.key) return descending ? a.key > b.key : a.key < b.key;
+        return a.id < b.id;
+    }
+
+    void offer(ULONGLONG key, FileId id) {
+        if (limit == 0) return;
+        RankedEntry e{key, id};
+        auto cmp = [this](const RankedEntry& a, const RankedEntry& b) { return before(a, b); };
+
+        if (heap.size() < limit) {
+            heap.push_back(e);
+            std::push_heap(heap.begin(), heap.end(), cmp);
+        } else if (before(e, heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), cmp);
+            heap.back() = e;
+            std::push_heap(heap.begin(), heap.end(), cmp);
+        }
+    }
+
+    const std::vector<RankedEntry>& entries() const { return heap; }
+};
+
+} // namespace
+
+SearchStatus SearchEngine::search(const std::string& text, const SearchOptions& options, std::vector<FileId>& out,
+                                  std::string* error) {
+    const uint64_t ticket = latestTicket.fetch_add(1, std::memory_order_relaxed) + 1;
+    auto stale = [&]() { return latestTicket.load(std::memory_order_relaxed) != ticket; };
+
+    out.clear();
+
+    auto query = std::make_shared<Query>();
+    std::string parseError;
+    if (!Query::parse(text, *query, parseError)) {
+        if (error) *error = parseError;
+        return SearchStatus::InvalidQuery;
+    }
+
+    // 目录范围条件依赖欧拉序编号，编号作废后先在共享锁下重建
+    if (query->scoped()) index.buildTour();
+
+    auto lock = index.lockShared();
+    if (stale()) return SearchStatus::Cancelled;
+    query->bind(index);
+
+    uint64_t version = index.getVersion();
+
+    // 新查询收窄了上一次的查询时，新结果必然是旧结果的子集
+    std::shared_ptr<const std::vector<FileId>> candidates;
+    {
+        std::lock_guard<std::mutex> guard(cacheMtx);
+        if (cachedMatches && cachedVersion == version && query->refines(*cachedQuery)) {
+            candidates = cachedMatches;
+        }
+    }
+
+    // 否则由规划器挑选最具选择性的索引条件生成候选集
+    if (!candidates && !query->empty()) {
+        QueryPlan plan = planQuery(*query, index, queryIndexes);
+        auto planned = std::make_shared<std::vector<FileId>>();
+        if (collectCandidates(plan, index, queryIndexes, *planned)) {
+            candidates = std::move(planned);
+        }
+        if (stale()) return SearchStatus::Cancelled;
+    }
+
+    const bool sorted = options.sortKey != SortKey::None;
+    auto sortValue = [&](FileId id) {
+        return options.sortKey == SortKey::Size ? index.fileSize(id) : index.lastWriteTimeValue(id);
+    };
+
+    const size_t total = candidates ? candidates->size() : index.nodeCount();
+    const size_t chunks = chunkCount(total, 1 << 15);
+    std::vector<std::vector<FileId>> partial(sorted ? 0 : chunks);
+    std::vector<TopK> heaps(sorted ? chunks : 0, TopK(options.maxResults, options.descending));
+    std::atomic<bool> cancelled{false};
+
+    parallelFor(total, chunks, [&](size_t chunk, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            if (((i - begin) & 0xFFF) == 0 && (cancelled.load(std::memory_order_relaxed) || stale())) {
+                cancelled = true;
+                return;
+            }
+
+            FileId id = candidates ? (*candidates)[i] : static_cast<FileId>(i);
+            if (!index.isListed(id) || !query->matches(index, id)) continue;
+
+            if (sorted) heaps[chunk].offer(sortValue(id), id);
+            else partial[chunk].push_back(id);
+        }
+    });
+
+    if (cancelled) return SearchStatus::Cancelled;
+
+    if (sorted) {
+        // 归并各线程的堆，只有 线程数 × maxResults 条参与最终排序
+        const TopK order(options.maxResults, options.descending);
+        std::vector<RankedEntry> all;
+        for (const auto& h : heaps) all.insert(all.end(), h.entries().begin(), h.entries().end());
+
+        const size_t keep = std::min(options.maxResults, all.size());
+        std::partial_sort(all.begin(), all.begin() + keep, all.end(),
+                          [&](const RankedEntry& a, const RankedEntry& b) { return order.before(a, b); });
+
+        out.reserve(keep);
+        for (size_t i = 0; i < keep; ++i) out.push_back(all[i].id);
+        return SearchStatus::Ok;   // 没有完整的匹配集，不更新收窄缓存
+    }
+
+    auto matches = std::make_shared<std::vector<FileId>>();
+    size_t matchCount = 0;
+    for (const auto& p : partial) matchCount += p.size();
+    matches->reserve(matchCount);
+    for (const auto& p : partial) matches->insert(matches->end(), p.begin(), p.end());
+
+    const size_t keep = std::min(options.maxResults, matches->size());
+    if (query->ranked()) {
+        // 近似匹配按编辑距离排序，距离相同时保持 FileId 顺序
+        std::vector<std::pair<int, FileId>> scored;
+        scored.reserve(matches->size());
+        for (FileId id : *matches) scored.emplace_back(query->score(index, id), id);
+        std::partial_sort(scored.begin(), scored.begin() + keep, scored.end());
+
+        out.reserve(keep);
+        for (size_t i = 0; i < keep; ++i) out.push_back(scored[i].second);
+    } else {
+        out.assign(matches->begin(), matches->begin() + keep);
+    }
+
+    // 空查询匹配全部记录，缓存它没有收益
+    if (!query->empty()) {
+        std::lock_guard<std::mutex> guard(cacheMtx);
+        cachedQuery = std::move(query);
+        cachedVersion = version;
+        cachedMatches = std::move(matches);
+    }
+    return SearchStatus::Ok;
+}
@@ -0,0 +1,530 @@
+#include "../include/snapshot.h"
+#include "../include/hash.h"
+#include "../include/log.h"
+#include "../include/util.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char MAGIC[8] = {'F', 'M', 'S', 'N', 'A', 'P', 'S', 'H'};
+constexpr uint64_t ALIGNMENT = 64;
+
+enum SectionId : uint32_t {
+    SEC_PARENTS = 1,
+    SEC_NAME_OFFSETS,
+    SEC_NAME_LENS,
+    SEC_FLAGS,
+    SEC_SIZES,
+    SEC_CREATION_TIMES,
+    SEC_LAST_ACCESS_TIMES,
+    SEC_LAST_WRITE_TIMES,
+    SEC_NAMES,
+    SEC_FOLDED_NAMES,
+    SEC_PINYIN_OFFSETS,
+    SEC_PINYIN_LENS,
+    SEC_PINYIN_KEYS,
+    SEC_EXTENSION_BITMAPS,
+    // 以下为可选的二级索引
+    SEC_SIZE_KEYS,
+    SEC_SIZE_IDS,
+    SEC_WRITE_TIME_KEYS,
+    SEC_WRITE_TIME_IDS,
+    SEC_TRIGRAM_COUNTS,
+    SEC_TRIGRAM_OFFSETS,
+    SEC_TRIGRAM_IDS,
+};
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t sectionCount;
+    uint64_t fileSize;
+    uint64_t tableOffset;
+    uint64_t checksum;           // 头部之后全部字节的 hash64
+    uint64_t nodeCount;
+    uint64_t journalId;
+    int64_t nextUsn;
+    uint64_t trigramThreshold;
+    char volume;
+    char reserved[55];
+};
+static_assert(sizeof(Header) == 128, "snapshot header layout changed");
+
+struct SectionEntry {
+    uint32_t id;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+};
+
+// ---------------------------------------------------------------
+// 写入：顺序写出各段并同时计算校验和，最后回填头部
+// ---------------------------------------------------------------
+class Writer {
+public:
+    std::ofstream out;
+    Hash64 hash;
+    uint64_t pos = sizeof(Header);
+    std::vector<SectionEntry> table;
+
+    bool open(const std::string& path) {
+        out.open(path, std::ios::binary | std::ios::trunc);
+        Header blank{};
+        out.write(reinterpret_cast<const char*>(&blank), sizeof(blank));
+        return static_cast<bool>(out);
+    }
+
+    void write(const void* data, size_t size) {
+        if (size == 0) return;
+        out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        hash.update(data, size);
+        pos += size;
+    }
+
+    void align() {
+        static const char zeros[ALIGNMENT] = {};
+        size_t pad = static_cast<size_t>((ALIGNMENT - pos % ALIGNMENT) % ALIGNMENT);
+        write(zeros, pad);
+    }
+
+    template <typename T>
+    void section(uint32_t id, const T* data, size_t count) {
+        align();
+        table.push_back({id, 0, pos, count * sizeof(T)});
+        write(data, count * sizeof(T));
+    }
+
+    template <typename T>
+    void section(uint32_t id, const std::vector<T>& v) { section(id, v.data(), v.size()); }
+    void section(uint32_t id, const std::string& s) { section(id, s.data(), s.size()); }
+};
+
+template <typename T>
+void appendRaw(std::string& blob, const T& value) {
+    blob.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// 扩展名位图序列化为：条目数，之后每条为 {名称长度, 名称, 位图}
+std::string encodeBitmaps(const std::unordered_map<std::string, RoaringBitmap>& bitmaps) {
+    std::string blob;
+    appendRaw(blob, static_cast<uint32_t>(bitmaps.size()));
+    for (const auto& [ext, bitmap] : bitmaps) {
+        appendRaw(blob, static_cast<uint32_t>(ext.size()));
+        blob.append(ext);
+        bitmap.serialize(blob);
+    }
+    return blob;
+}
+
+// ---------------------------------------------------------------
+// 读取
+// ---------------------------------------------------------------
+#ifdef _WIN32
+class MappedFile {
+private:
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+    const char* view = nullptr;
+    uint64_t size = 0;
+
+public:
+    ~MappedFile() {
+        if (view) UnmapViewOfFile(view);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+    }
+
+    bool open(const std::string& path) {
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                           OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+
+        LARGE_INTEGER li;
+        if (!GetFileSizeEx(file, &li) || li.QuadPart < static_cast<LONGLONG>(sizeof(Header))) return false;
+        size = static_cast<uint64_t>(li.QuadPart);
+
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) return false;
+        view = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        return view != nullptr;
+    }
+
+    const char* data() const { return view; }
+    uint64_t getSize() const { return size; }
+};
+#else
+class MappedFile {
+private:
+    const char* view = nullptr;
+    uint64_t size = 0;
+
+public:
+    ~MappedFile() {
+        if (view) munmap(const_cast<char*>(view), size);
+    }
+
+    bool open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(Header))) {
+            close(fd);
+            return false;
+        }
+        size = static_cast<uint64_t>(st.st_size);
+
+        // 映射在关闭描述符后仍然有效
+        void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) return false;
+        madvise(p, size, MADV_SEQUENTIAL);
+        view = static_cast<const char*>(p);
+        return true;
+    }
+
+    const char* data() const { return view; }
+    uint64_t getSize() const { return size; }
+};
+#endif
+
+class Sections {
+private:
+    std::unordered_map<uint32_t, std::pair<const char*, uint64_t>> map;
+
+public:
+    bool parse(const MappedFile& file, const Header& header) {
+        if (header.tableOffset > file.getSize() ||
+            header.sectionCount > (file.getSize() - header.tableOffset) / sizeof(SectionEntry)) {
+            return false;
+        }
+        for (uint32_t i = 0; i < header.sectionCount; ++i) {
+            SectionEntry e;
+            memcpy(&e, file.data() + header.tableOffset + i * sizeof(SectionEntry), sizeof(e));
+            if (e.offset > header.tableOffset || e.size > header.tableOffset - e.offset) return false;
+            map[e.id] = {file.data() + e.offset, e.size};
+        }
+        return true;
+    }
+
+    bool has(uint32_t id) const { return map.count(id) != 0; }
+
+    // expected 为 SIZE_MAX 时不检查元素个数
+    template <typename T>
+    bool read(uint32_t id, std::vector<T>& out, size_t expected = SIZE_MAX) const {
+        auto it = map.find(id);
+        if (it == map.end() || it->second.second % sizeof(T) != 0) return false;
+        size_t count = static_cast<size_t>(it->second.second / sizeof(T));
+        if (expected != SIZE_MAX && count != expected) return false;
+        // 各段按 64 字节对齐，映射视图按页对齐，可以直接按元素类型整块复制
+        const T* first = reinterpret_cast<const T*>(it->second.first);
+        out.assign(first, first + count);
+        return true;
+    }
+
+    bool read(uint32_t id, std::string& out) const {
+        auto it = map.find(id);
+        if (it == map.end()) return false;
+        out.assign(it->second.first, static_cast<size_t>(it->second.second));
+        return true;
+    }
+};
+
+// 位图中的节点必须存在且可见
+bool decodeBitmaps(const std::string& blob, std::unordered_map<std::string, RoaringBitmap>& bitmaps,
+                   const std::vector<uint8_t>& flags, uint8_t listedFlag) {
+    size_t pos = 0;
+    uint32_t entries;
+    if (blob.size() < sizeof(entries)) return false;
+    memcpy(&entries, blob.data(), sizeof(entries));
+    pos += sizeof(entries);
+
+    std::vector<FileId> ids;
+    size_t listed = 0;
+    for (uint32_t i = 0; i < entries; ++i) {
+        uint32_t len;
+        if (blob.size() - pos < sizeof(len)) return false;
+        memcpy(&len, blob.data() + pos, sizeof(len));
+        pos += sizeof(len);
+        if (blob.size() - pos < len) return false;
+        std::string ext = blob.substr(pos, len);
+        pos += len;
+
+        size_t used;
+        RoaringBitmap& bitmap = bitmaps[ext];
+        if (!bitmap.deserialize(blob.data() + pos, blob.size() - pos, used)) return false;
+        pos += used;
+
+        ids.clear();
+        bitmap.appendTo(ids);
+        for (FileId id : ids) {
+            if (id >= flags.size() || !(flags[id] & listedFlag)) return false;
+        }
+        listed += ids.size();
+    }
+
+    // 每个可见节点恰好属于一个扩展名
+    size_t expected = std::count_if(flags.begin(), flags.end(), [&](uint8_t f) { return f & listedFlag; });
+    return pos == blob.size() && bitmaps.size() == entries && listed == expected;
+}
+
+template <typename Len>
+bool spansValid(const std::vector<uint32_t>& offsets, const std::vector<Len>& lens, size_t poolSize) {
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        if (static_cast<size_t>(offsets[i]) + lens[i] > poolSize) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool IndexSnapshot::save(const std::string& path, const FileIndex& index, QueryIndexes* derived,
+                         const SnapshotInfo& info) {
+    const std::string tmp = path + ".tmp";
+    Writer w;
+    if (!w.open(tmp)) {
+        LOG_ERROR("无法创建快照文件: " << tmp);
+        return false;
+    }
+
+    Header header{};
+    {
+        auto lock = index.lockShared();
+        if (derived) derived->settle();
+
+        // 重命名留下的旧名称不写入快照，各名称池按 FileId 顺序重新紧凑排列
+        const size_t n = index.nodeCount();
+        std::vector<uint32_t> nameOffsets(n), pinyinOffsets(n);
+        std::string names, foldedNames, pinyinKeys;
+        for (FileId id = 0; id < n; ++id) {
+            nameOffsets[id] = static_cast<uint32_t>(names.size());
+            names.append(index.names, index.nameOffsets[id], index.nameLens[id]);
+            foldedNames.append(index.foldedName(id));
+            pinyinOffsets[id] = static_cast<uint32_t>(pinyinKeys.size());
+            pinyinKeys.append(index.pinyin(id));
+        }
+
+        w.section(SEC_PARENTS, index.parents);
+        w.section(SEC_NAME_OFFSETS, nameOffsets);
+        w.section(SEC_NAME_LENS, index.nameLens);
+        w.section(SEC_FLAGS, index.flags);
+        w.section(SEC_SIZES, index.sizes);
+        w.section(SEC_CREATION_TIMES, index.creationTimes);
+        w.section(SEC_LAST_ACCESS_TIMES, index.lastAccessTimes);
+        w.section(SEC_LAST_WRITE_TIMES, index.lastWriteTimes);
+        w.section(SEC_NAMES, names);
+        w.section(SEC_FOLDED_NAMES, foldedNames);
+        w.section(SEC_PINYIN_OFFSETS, pinyinOffsets);
+        w.section(SEC_PINYIN_LENS, index.pinyinLens);
+        w.section(SEC_PINYIN_KEYS, pinyinKeys);
+        w.section(SEC_EXTENSION_BITMAPS, encodeBitmaps(index.extensionBitmaps));
+
+        // 只保存与当前内容完全一致的二级索引
+        if (derived) {
+            std::shared_ptr<const SortedColumn> bySize, byWriteTime;
+            std::shared_ptr<const TrigramPostings> trigrams;
+            {
+                std::lock_guard<std::mutex> guard(derived->mtx);
+                bySize = derived->sizePart;
+                byWriteTime = derived->writeTimePart;
+                trigrams = derived->trigramPart;
+            }
+
+            const uint64_t mark = index.changeMark();
+            if (bySize && bySize->mark == mark) {
+                w.section(SEC_SIZE_KEYS, bySize->keys);
+                w.section(SEC_SIZE_IDS, bySize->ids);
+            }
+            if (byWriteTime && byWriteTime->mark == mark) {
+                w.section(SEC_WRITE_TIME_KEYS, byWriteTime->keys);
+                w.section(SEC_WRITE_TIME_IDS, byWriteTime->ids);
+            }
+            if (trigrams && trigrams->mark == mark) {
+                w.section(SEC_TRIGRAM_COUNTS, trigrams->counts);
+                w.section(SEC_TRIGRAM_OFFSETS, trigrams->offsets);
+                w.section(SEC_TRIGRAM_IDS, trigrams->ids);
+                header.trigramThreshold = trigrams->commonThreshold;
+            }
+        }
+        header.nodeCount = n;
+    }
+
+    w.align();
+    header.tableOffset = w.pos;
+    header.sectionCount = static_cast<uint32_t>(w.table.size());
+    w.write(w.table.data(), w.table.size() * sizeof(SectionEntry));
+
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.fileSize = w.pos;
+    header.checksum = w.hash.digest();
+    header.journalId = info.journalId;
+    header.nextUsn = info.nextUsn;
+    header.volume = info.volume;
+
+    w.out.seekp(0);
+    w.out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    w.out.close();
+    if (!w.out) {
+        LOG_ERROR("写入快照失败: " << tmp);
+        return false;
+    }
+
+#ifdef _WIN32
+    if (!MoveFileExA(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+#else
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+#endif
+        LOG_ERROR("替换快照文件失败，错误码: " << lastError());
+        return false;
+    }
+    LOG_INFO("已保存索引快照: " << header.nodeCount << " 个节点, " << header.fileSize << " 字节。");
+    return true;
+}
+
+bool IndexSnapshot::load(const std::string& path, FileIndex& index, QueryIndexes* derived, SnapshotInfo& info) {
+    MappedFile file;
+    if (!file.open(path)) return false;
+
+    Header header;
+    memcpy(&header, file.data(), sizeof(header));
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+        header.fileSize != file.getSize()) {
+        LOG_WARN("快照版本不符，忽略: " << path);
+        return false;
+    }
+    if (hash64(file.data() + sizeof(Header), file.getSize() - sizeof(Header)) != header.checksum) {
+        LOG_WARN("快照校验和不符，忽略: " << path);
+        return false;
+    }
+
+    Sections sections;
+    if (!sections.parse(file, header)) return false;
+
+    // 先整块复制到局部变量并检查一致性，全部通过后才替换索引内容
+    const size_t n = static_cast<size_t>(header.nodeCount);
+    std::vector<FileId> parents;
+    std::vector<uint32_t> nameOffsets, pinyinOffsets;
+    std::vector<uint16_t> nameLens, pinyinLens;
+    std::vector<uint8_t> flags;
+    std::vector<ULONGLONG> sizes;
+    std::vector<FILETIME> creationTimes, lastAccessTimes, lastWriteTimes;
+    std::string names, foldedNames, pinyinKeys;
+
+    bool ok = sections.read(SEC_PARENTS, parents, n) &&
+              sections.read(SEC_NAME_OFFSETS, nameOffsets, n) &&
+              sections.read(SEC_NAME_LENS, nameLens, n) &&
+              sections.read(SEC_FLAGS, flags, n) &&
+              sections.read(SEC_SIZES, sizes, n) &&
+              sections.read(SEC_CREATION_TIMES, creationTimes, n) &&
+              sections.read(SEC_LAST_ACCESS_TIMES, lastAccessTimes, n) &&
+              sections.read(SEC_LAST_WRITE_TIMES, lastWriteTimes, n) &&
+              sections.read(SEC_NAMES, names) &&
+              sections.read(SEC_FOLDED_NAMES, foldedNames) &&
+              sections.read(SEC_PINYIN_OFFSETS, pinyinOffsets, n) &&
+              sections.read(SEC_PINYIN_LENS, pinyinLens, n) &&
+              sections.read(SEC_PINYIN_KEYS, pinyinKeys) &&
+              names.size() == foldedNames.size() &&
+              spansValid(nameOffsets, nameLens, names.size()) &&
+              spansValid(pinyinOffsets, pinyinLens, pinyinKeys.size());
+    for (size_t i = 0; ok && i < n; ++i) {
+        ok = parents[i] == INVALID_FILE_ID || parents[i] < n;
+    }
+    if (!ok) {
+        LOG_WARN("快照内容不完整，忽略: " << path);
+        return false;
+    }
+
+    // 扩展名位图不一致时在载入后按名称重建
+    std::unordered_map<std::string, RoaringBitmap> bitmaps;
+    std::string bitmapBlob;
+    const bool bitmapsValid = sections.read(SEC_EXTENSION_BITMAPS, bitmapBlob) &&
+                              decodeBitmaps(bitmapBlob, bitmaps, flags, FileIndex::FLAG_LISTED);
+
+    // 二级索引缺失或不完整时只是不载入，之后按需重建
+    std::shared_ptr<SortedColumn> bySize, byWriteTime;
+    std::shared_ptr<TrigramPostings> trigrams;
+    if (derived) {
+        auto readSorted = [&](uint32_t keysId, uint32_t idsId) {
+            auto part = std::make_shared<SortedColumn>();
+            if (!sections.read(keysId, part->keys) || !sections.read(idsId, part->ids, part->keys.size())) {
+                return std::shared_ptr<SortedColumn>();
+            }
+            return part;
+        };
+        if (sections.has(SEC_SIZE_KEYS)) bySize = readSorted(SEC_SIZE_KEYS, SEC_SIZE_IDS);
+        if (sections.has(SEC_WRITE_TIME_KEYS)) byWriteTime = readSorted(SEC_WRITE_TIME_KEYS, SEC_WRITE_TIME_IDS);
+
+        if (sections.has(SEC_TRIGRAM_COUNTS)) {
+            trigrams = std::make_shared<TrigramPostings>();
+            trigrams->commonThreshold = static_cast<size_t>(header.trigramThreshold);
+            bool valid = sections.read(SEC_TRIGRAM_COUNTS, trigrams->counts, TrigramPostings::KEY_SPACE) &&
+                         sections.read(SEC_TRIGRAM_OFFSETS, trigrams->offsets, TrigramPostings::KEY_SPACE + 1) &&
+                         sections.read(SEC_TRIGRAM_IDS, trigrams->ids) &&
+                         trigrams->offsets.back() == trigrams->ids.size();
+            if (!valid) trigrams.reset();
+        }
+    }
+
+    {
+        std::unique_lock<std::shared_mutex> lock(index.mtx);
+
+        index.parents.swap(parents);
+        index.nameOffsets.swap(nameOffsets);
+        index.nameLens.swap(nameLens);
+        index.flags.swap(flags);
+        index.sizes.swap(sizes);
+        index.creationTimes.swap(creationTimes);
+        index.lastAccessTimes.swap(lastAccessTimes);
+        index.lastWriteTimes.swap(lastWriteTimes);
+        index.names.swap(names);
+        index.foldedNames.swap(foldedNames);
+        index.pinyinOffsets.swap(pinyinOffsets);
+        index.pinyinLens.swap(pinyinLens);
+        index.pinyinKeys.swap(pinyinKeys);
+        index.children.clear();
+        index.lookupReady = false;
+        index.dropTour();
+        index.dropTotals();
+        index.changeLogBase += index.changeLog.size() + 1;
+        index.changeLog.clear();
+        index.extensionBitmaps.swap(bitmaps);
+        if (bitmapsValid) {
+            index.rebuildTypeBitmaps();
+        } else {
+            LOG_WARN("快照中的扩展名位图无效，按名称重建。");
+            index.rebuildBitmaps();
+        }
+
+        if (derived) {
+            const uint64_t mark = index.changeMark();
+            std::lock_guard<std::mutex> guard(derived->mtx);
+            if (bySize) bySize->mark = mark;
+            if (byWriteTime) byWriteTime->mark = mark;
+            if (trigrams) trigrams->mark = mark;
+            derived->sizePart = bySize;
+            derived->writeTimePart = byWriteTime;
+            derived->trigramPart = trigrams;
+        }
+
+        index.version.fetch_add(1, std::memory_order_release);
+    }
+
+    info.volume = header.volume;
+    info.journalId = header.journalId;
+    info.nextUsn = header.nextUsn;
+    LOG_INFO("已从快照载入 " << n << " 个节点。");
+    return true;
+}
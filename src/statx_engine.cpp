@@ -0,0 +1,337 @@
+#ifdef __linux__
+#include "../include/statx_engine.h"
+#include "../include/log.h"
+#include "../include/parallel.h"
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+constexpr unsigned STATX_FIELDS = STATX_TYPE | STATX_SIZE | STATX_ATIME | STATX_MTIME | STATX_BTIME;
+constexpr int STATX_FLAGS = AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT | AT_STATX_DONT_SYNC;
+
+// Unix 时间转为 FILETIME 计数
+uint64_t toFileTime(const statx_timestamp& ts) {
+    return (static_cast<uint64_t>(ts.tv_sec) + 11644473600ULL) * 10000000ULL + ts.tv_nsec / 100;
+}
+
+// 一个线程独占的 io_uring，直接用系统调用，不依赖 liburing
+class UringStatx : public StatxEngine {
+private:
+    int ringFd = -1;
+    void* sqRing = MAP_FAILED;
+    void* cqRing = MAP_FAILED;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqesSize = 0;
+
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    std::vector<struct statx> buffers;   // 每个在途请求一个
+    std::vector<size_t> slotEntry;       // 在途请求对应的项
+    std::vector<unsigned> freeSlots;
+    bool broken = false;                 // io_uring_enter 出错后不再使用，剩余的项逐个 statx
+
+    bool setup(unsigned depth);
+
+public:
+    static std::unique_ptr<UringStatx> open(unsigned depth);
+    ~UringStatx() override;
+
+    void fill(int dirFd, WalkEntry* entries, size_t count, bool typeOnly, std::vector<int>& status) override;
+    Kind kind() const override { return Kind::Uring; }
+};
+
+bool UringStatx::setup(unsigned depth) {
+    io_uring_params params{};
+    ringFd = static_cast<int>(syscall(__NR_io_uring_setup, depth, &params));
+    if (ringFd < 0) return false;
+
+    // 5.6 之前没有 IORING_OP_STATX，也没有 IORING_REGISTER_PROBE
+    constexpr unsigned PROBE_OPS = 256;
+    std::vector<char> probeBuffer(sizeof(io_uring_probe) + PROBE_OPS * sizeof(io_uring_probe_op));
+    auto* probe = reinterpret_cast<io_uring_probe*>(probeBuffer.data());
+    if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PROBE, probe, PROBE_OPS) < 0 ||
+        probe->last_op < IORING_OP_STATX || !(probe->ops[IORING_OP_STATX].flags & IO_URING_OP_SUPPORTED)) {
+        errno = EOPNOTSUPP;
+        return false;
+    }
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) return false;
+    cqRing = single ? sqRing
+                    : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+                           IORING_OFF_CQ_RING);
+    if (cqRing == MAP_FAILED) return false;
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe*>(
+        mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+    if (sqes == MAP_FAILED) return false;
+
+    char* sq = static_cast<char*>(sqRing);
+    char* cq = static_cast<char*>(cqRing);
+    sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    // 在途数不超过提交队列长度，完成队列默认是它的两倍，不会溢出
+    const unsigned slots = std::min(depth, params.sq_entries);
+    buffers.resize(slots);
+    slotEntry.resize(slots);
+    for (unsigned i = slots; i > 0; --i) freeSlots.push_back(i - 1);
+    return true;
+}
+
+std::unique_ptr<UringStatx> UringStatx::open(unsigned depth) {
+    std::unique_ptr<UringStatx> engine(new UringStatx());
+    if (!engine->setup(depth)) {
+        // 每个线程各建一个环，只报告一次
+        static std::atomic<bool> reported{false};
+        if (!reported.exchange(true)) LOG_INFO("io_uring 不可用，改用线程池取文件信息，错误码: " << errno);
+        return nullptr;
+    }
+    return engine;
+}
+
+UringStatx::~UringStatx() {
+    if (sqes != MAP_FAILED) munmap(sqes, sqesSize);
+    if (cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+    if (sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+    if (ringFd >= 0) close(ringFd);
+}
+
+void UringStatx::fill(int dirFd, WalkEntry* entries, size_t count, bool typeOnly, std::vector<int>& status) {
+    status.assign(count, 0);
+    const unsigned mask = typeOnly ? STATX_TYPE : STATX_FIELDS;
+
+    size_t next = 0;
+    size_t inFlight = 0;
+    while (!broken && (next < count || inFlight > 0)) {
+        // 空闲的缓冲区都用来提交，整批一次进入内核
+        unsigned tail = *sqTail;
+        unsigned queued = 0;
+        while (next < count && !freeSlots.empty()) {
+            const unsigned slot = freeSlots.back();
+            freeSlots.pop_back();
+            slotEntry[slot] = next;
+
+            const unsigned index = tail & sqMask;
+            io_uring_sqe& sqe = sqes[index];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = IORING_OP_STATX;
+            sqe.fd = dirFd;
+            sqe.addr = reinterpret_cast<uint64_t>(entries[next].name.c_str());
+            sqe.len = mask;
+            sqe.off = reinterpret_cast<uint64_t>(&buffers[slot]);
+            sqe.statx_flags = STATX_FLAGS;
+            sqe.user_data = slot;
+            sqArray[index] = index;
+            ++tail;
+            ++queued;
+            ++next;
+        }
+        __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+        inFlight += queued;
+
+        const unsigned toSubmit = tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+        if (syscall(__NR_io_uring_enter, ringFd, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 &&
+            errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            LOG_ERROR("io_uring_enter 失败，改为逐个取文件信息，错误码: " << errno);
+            broken = true;
+        }
+
+        unsigned head = *cqHead;
+        const unsigned ready = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        for (; head != ready; ++head) {
+            const io_uring_cqe& cqe = cqes[head & cqMask];
+            const unsigned slot = static_cast<unsigned>(cqe.user_data);
+            const size_t i = slotEntry[slot];
+            if (cqe.res < 0) {
+                status[i] = -cqe.res;
+            } else {
+                applyStatx(entries[i], buffers[slot], typeOnly);
+            }
+            freeSlots.push_back(slot);
+            --inFlight;
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    }
+
+    if (broken) {
+        // 已提交而未完成的项不知道结果，连同未提交的一起重新取；在途请求的缓冲区不再复用
+        for (size_t i = 0; i < count; ++i) {
+            struct statx sx;
+            if (statx(dirFd, entries[i].name.c_str(), STATX_FLAGS, mask, &sx) == 0) {
+                applyStatx(entries[i], sx, typeOnly);
+                status[i] = 0;
+            } else {
+                status[i] = errno;
+            }
+        }
+    }
+}
+
+// 进程内共享的线程池：一批按块切分，调用线程与池中线程一起取块
+class StatxPool {
+private:
+    static constexpr size_t CHUNK = 64;
+
+    struct Job {
+        int dirFd;
+        WalkEntry* entries;
+        size_t count;
+        bool typeOnly;
+        int* status;
+        size_t chunks;
+        std::atomic<size_t> nextChunk{0};
+        std::atomic<size_t> doneChunks{0};
+        std::mutex mtx;
+        std::condition_variable finished;
+    };
+
+    std::mutex mtx;
+    std::condition_variable wake;
+    std::deque<std::shared_ptr<Job>> jobs;
+    bool stopping = false;
+    std::vector<std::thread> threads;
+
+    // 取一块并处理，没有剩余的块时返回 false
+    static bool runChunk(Job& job) {
+        const size_t chunk = job.nextChunk.fetch_add(1, std::memory_order_relaxed);
+        if (chunk >= job.chunks) return false;
+
+        const unsigned mask = job.typeOnly ? STATX_TYPE : STATX_FIELDS;
+        const size_t end = std::min(job.count, (chunk + 1) * CHUNK);
+        for (size_t i = chunk * CHUNK; i < end; ++i) {
+            struct statx sx;
+            if (statx(job.dirFd, job.entries[i].name.c_str(), STATX_FLAGS, mask, &sx) == 0) {
+                applyStatx(job.entries[i], sx, job.typeOnly);
+            } else {
+                job.status[i] = errno;
+            }
+        }
+        if (job.doneChunks.fetch_add(1, std::memory_order_acq_rel) + 1 == job.chunks) {
+            std::lock_guard<std::mutex> lock(job.mtx);
+            job.finished.notify_all();
+        }
+        return true;
+    }
+
+    void loop() {
+        for (;;) {
+            std::shared_ptr<Job> job;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (stopping) return;
+                job = jobs.front();
+                // 块已分完的批次移出队列，其余线程不再看到它
+                if (job->nextChunk.load(std::memory_order_relaxed) + 1 >= job->chunks) jobs.pop_front();
+            }
+            runChunk(*job);
+        }
+    }
+
+public:
+    StatxPool() {
+        // 元数据读取受延迟限制，线程数多于核数
+        const size_t count = workerCount() * 2;
+        for (size_t i = 0; i < count; ++i) threads.emplace_back(&StatxPool::loop, this);
+    }
+
+    ~StatxPool() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& t : threads) t.join();
+    }
+
+    static StatxPool& instance() {
+        static StatxPool pool;
+        return pool;
+    }
+
+    void fill(int dirFd, WalkEntry* entries, size_t count, bool typeOnly, std::vector<int>& status) {
+        status.assign(count, 0);
+        if (count == 0) return;
+
+        auto job = std::make_shared<Job>();
+        job->dirFd = dirFd;
+        job->entries = entries;
+        job->count = count;
+        job->typeOnly = typeOnly;
+        job->status = status.data();
+        job->chunks = (count + CHUNK - 1) / CHUNK;
+        if (job->chunks > 1) {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                jobs.push_back(job);
+            }
+            wake.notify_all();
+        }
+
+        while (runChunk(*job)) {}
+        std::unique_lock<std::mutex> lock(job->mtx);
+        job->finished.wait(lock, [&] { return job->doneChunks.load(std::memory_order_acquire) == job->chunks; });
+    }
+};
+
+class PooledStatx : public StatxEngine {
+public:
+    void fill(int dirFd, WalkEntry* entries, size_t count, bool typeOnly, std::vector<int>& status) override {
+        StatxPool::instance().fill(dirFd, entries, count, typeOnly, status);
+    }
+    Kind kind() const override { return Kind::Pool; }
+};
+
+} // namespace
+
+void applyStatx(WalkEntry& entry, const struct statx& sx, bool typeOnly) {
+    entry.directory = S_ISDIR(sx.stx_mode);
+    if (typeOnly) return;
+    entry.size = entry.directory ? 0 : sx.stx_size;
+    entry.lastAccessTime = toFileTime(sx.stx_atime);
+    entry.lastWriteTime = toFileTime(sx.stx_mtime);
+    if (sx.stx_mask & STATX_BTIME) entry.creationTime = toFileTime(sx.stx_btime);
+}
+
+std::unique_ptr<StatxEngine> StatxEngine::create(Kind prefer) {
+    if (prefer == Kind::Uring) {
+        if (auto engine = UringStatx::open(DEPTH)) return engine;
+    }
+    return std::make_unique<PooledStatx>();
+}
+#endif
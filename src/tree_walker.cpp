@@ -0,0 +1,335 @@
+#ifdef __linux__
+#include "../include/tree_walker.h"
+#include "../include/log.h"
+#include "../include/parallel.h"
+#include "../include/statx_engine.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+// 条目编号：高位为线程，低位为该线程结果中的下标，合并时换算为全局下标
+constexpr int LOCAL_BITS = 40;
+constexpr uint64_t LOCAL_MASK = (uint64_t{1} << LOCAL_BITS) - 1;
+
+uint64_t packId(size_t worker, size_t local) {
+    return (static_cast<uint64_t>(worker) << LOCAL_BITS) | local;
+}
+
+FILETIME toFileTime(uint64_t value) {
+    FILETIME ft;
+    ft.dwLowDateTime = static_cast<DWORD>(value & 0xFFFFFFFF);
+    ft.dwHighDateTime = static_cast<DWORD>(value >> 32);
+    return ft;
+}
+
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+} // namespace
+
+struct TreeWalker::DirHandle {
+    int fd;
+    explicit DirHandle(int f) : fd(f) {}
+    ~DirHandle() { close(fd); }
+};
+
+TreeWalker::Worker::~Worker() = default;
+
+TreeWalker::TreeWalker(bool withMetadata, bool pool) : metadata(withMetadata), preferPool(pool) {}
+
+void TreeWalker::push(size_t self, Task&& task) {
+    outstanding.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(workers[self]->mtx);
+        workers[self]->tasks.push_back(std::move(task));
+    }
+    if (sleepers.load(std::memory_order_relaxed)) idleWake.notify_one();
+}
+
+bool TreeWalker::take(size_t self, Task& task) {
+    {
+        Worker& own = *workers[self];
+        std::lock_guard<std::mutex> lock(own.mtx);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < workers.size(); ++i) {
+        Worker& victim = *workers[(self + i) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mtx);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void TreeWalker::work(size_t self) {
+    Task task;
+    for (;;) {
+        if (take(self, task)) {
+            scan(self, task);
+            task = {};
+            if (outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                idleWake.notify_all();
+                return;
+            }
+            continue;
+        }
+        if (outstanding.load(std::memory_order_acquire) == 0) return;
+
+        // 入队时只在有线程睡眠时才唤醒，可能错过，所以只睡很短的时间
+        std::unique_lock<std::mutex> lock(idleMtx);
+        sleepers.fetch_add(1, std::memory_order_relaxed);
+        idleWake.wait_for(lock, std::chrono::milliseconds(1));
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+void TreeWalker::scan(size_t self, Task& task) {
+    // 取消后剩余的目录只出队，不再打开
+    if (cancelled.load(std::memory_order_relaxed)) return;
+    Worker& worker = *workers[self];
+    constexpr int OPEN_FLAGS = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+
+    int fd;
+    if (task.parent) {
+        fd = openat(task.parent->fd, task.path.c_str() + task.path.rfind('/') + 1, OPEN_FLAGS);
+        // 打开的句柄过多时按完整路径打开
+        if (fd < 0 && (errno == EMFILE || errno == ENFILE)) fd = open(task.path.c_str(), OPEN_FLAGS);
+    } else {
+        fd = open(task.path.c_str(), OPEN_FLAGS);
+    }
+    task.parent.reset();
+    if (fd < 0) {
+        if (errno != ENOENT) {
+            worker.stats.errors++;
+            worker.unreadable.push_back(task.path);
+            LOG_WARN("无法打开目录: " << task.path << " 错误码: " << errno);
+        }
+        return;
+    }
+    auto handle = std::make_shared<DirHandle>(fd);
+
+    // 不跨越挂载点
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_dev != rootDevice) return;
+
+    // 先读完整个目录，再一次取全部项的文件信息
+    const size_t first = worker.out.size();
+    bool unknownTypes = false;
+    std::vector<ExclusionRules::Cursor> cursors;
+    for (;;) {
+        long bytes = syscall(SYS_getdents64, fd, worker.dents.data(), DENTS_BUFFER);
+        if (bytes <= 0) {
+            if (bytes < 0) {
+                worker.stats.errors++;
+                worker.unreadable.push_back(task.path);
+                LOG_WARN("读取目录失败: " << task.path << " 错误码: " << errno);
+            }
+            break;
+        }
+
+        const char* base = reinterpret_cast<const char*>(worker.dents.data());
+        for (long offset = 0; offset < bytes;) {
+            auto* dent = reinterpret_cast<const linux_dirent64*>(base + offset);
+            offset += dent->d_reclen;
+
+            const char* name = dent->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+
+            ExclusionRules::Cursor cursor = task.cursor;
+            if (rules->step(cursor, std::string_view(name))) continue;
+
+            WalkEntry entry;
+            entry.parent = task.id;
+            entry.ino = dent->d_ino;
+            entry.name = name;
+            entry.directory = dent->d_type == DT_DIR;
+            unknownTypes = unknownTypes || dent->d_type == DT_UNKNOWN;
+            worker.out.push_back(std::move(entry));
+            cursors.push_back(cursor);
+        }
+    }
+
+    // 只要名称时，有类型未知的项（部分文件系统不填 d_type）才需要 statx
+    const size_t count = worker.out.size() - first;
+    if (count > 0 && (metadata || unknownTypes)) {
+        worker.statx->fill(fd, worker.out.data() + first, count, !metadata, worker.status);
+    } else {
+        worker.status.assign(count, 0);
+    }
+
+    // 扫描期间被删除的项去掉，其余的目录入队
+    size_t kept = first;
+    for (size_t i = 0; i < count; ++i) {
+        const int err = worker.status[i];
+        if (err == ENOENT) continue;
+        if (err) worker.stats.errors++;
+
+        const size_t local = kept++;
+        if (local != first + i) worker.out[local] = std::move(worker.out[first + i]);
+        WalkEntry& entry = worker.out[local];
+        if (entry.directory) {
+            worker.stats.directories++;
+            std::string childPath = task.path;
+            if (childPath.back() != '/') childPath += '/';
+            childPath += entry.name;
+            push(self, Task{handle, std::move(childPath), packId(self, local), cursors[i]});
+        } else {
+            worker.stats.files++;
+        }
+    }
+    worker.out.resize(kept);
+}
+
+bool TreeWalker::walk(const std::string& root, std::vector<WalkEntry>& out, size_t threads) {
+    total = {};
+    failedDirs.clear();
+    out.clear();
+    rules = exclusionRules();
+
+    std::string rootPath = root;
+    while (rootPath.size() > 1 && rootPath.back() == '/') rootPath.pop_back();
+
+    struct statx sx;
+    if (statx(AT_FDCWD, rootPath.c_str(), AT_NO_AUTOMOUNT, STATX_BASIC_STATS | STATX_BTIME, &sx) != 0 ||
+        !S_ISDIR(sx.stx_mode)) {
+        LOG_ERROR("无法扫描目录: " << root << " 错误码: " << errno);
+        return false;
+    }
+    rootDevice = makedev(sx.stx_dev_major, sx.stx_dev_minor);
+
+    const size_t count = threads ? threads : workerCount();
+    workers.clear();
+    for (size_t i = 0; i < count; ++i) {
+        auto worker = std::make_unique<Worker>();
+        worker->dents.resize(DENTS_BUFFER / sizeof(uint64_t));
+        worker->statx = StatxEngine::create(preferPool ? StatxEngine::Kind::Pool : StatxEngine::Kind::Uring);
+        workers.push_back(std::move(worker));
+    }
+
+    WalkEntry rootEntry;
+    rootEntry.parent = packId(0, 0);
+    rootEntry.ino = sx.stx_ino;
+    rootEntry.name = rootPath;
+    rootEntry.directory = true;
+    applyStatx(rootEntry, sx, !metadata);
+    workers[0]->out.push_back(std::move(rootEntry));
+    workers[0]->stats.directories++;
+
+    Task first;
+    first.path = rootPath;
+    first.id = packId(0, 0);
+    rules->walk(first.cursor, rootPath);
+    push(0, std::move(first));
+
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < count; ++i) pool.emplace_back(&TreeWalker::work, this, i);
+    work(0);
+    for (auto& t : pool) t.join();
+
+    // 各线程的结果依次拼接，上级编号换算为拼接后的下标
+    std::vector<uint64_t> offsets(count);
+    size_t size = 0;
+    for (size_t i = 0; i < count; ++i) {
+        offsets[i] = size;
+        size += workers[i]->out.size();
+    }
+    out.reserve(size);
+    for (auto& worker : workers) {
+        for (auto& entry : worker->out) {
+            entry.parent = offsets[entry.parent >> LOCAL_BITS] + (entry.parent & LOCAL_MASK);
+            out.push_back(std::move(entry));
+        }
+        total.directories += worker->stats.directories;
+        total.files += worker->stats.files;
+        total.errors += worker->stats.errors;
+        failedDirs.insert(failedDirs.end(), worker->unreadable.begin(), worker->unreadable.end());
+    }
+    workers.clear();
+    if (cancelled) {
+        out.clear();
+        return false;
+    }
+
+    LOG_INFO("扫描完毕: " << rootPath << "，目录 " << total.directories << " 个，文件 " << total.files
+             << " 个，错误 " << total.errors << " 个。");
+    return true;
+}
+
+std::string TreeWalker::path(const std::vector<WalkEntry>& entries, uint64_t i) {
+    std::vector<uint64_t> chain;
+    for (;; i = entries[i].parent) {
+        chain.push_back(i);
+        if (entries[i].parent == i) break;
+    }
+
+    std::string out;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        if (!out.empty() && out.back() != '/') out += '/';
+        out += entries[*it].name;
+    }
+    return out;
+}
+
+FileRecord TreeWalker::toRecord(const WalkEntry& entry, std::string fullPath) {
+    FileRecord record{};
+    record.fullpath = std::move(fullPath);
+    record.fileSize = entry.size;
+    record.creationTime = toFileTime(entry.creationTime);
+    record.lastAccessTime = toFileTime(entry.lastAccessTime);
+    record.lastWriteTime = toFileTime(entry.lastWriteTime);
+    record.frn = entry.ino;
+    return record;
+}
+
+void TreeWalker::toRecords(const std::vector<WalkEntry>& entries, std::vector<FileRecord>& out) {
+    if (entries.empty()) return;
+    // 各线程的结果拼接而成，上级不一定排在前面；目录的路径按需沿上级链补齐
+    std::vector<std::string> dirPaths(entries.size());
+    dirPaths[0] = entries[0].name;
+    std::vector<uint64_t> chain;
+    auto dirPath = [&](uint64_t dir) -> const std::string& {
+        chain.clear();
+        for (uint64_t i = dir; dirPaths[i].empty(); i = entries[i].parent) chain.push_back(i);
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+            const std::string& parent = dirPaths[entries[*it].parent];
+            dirPaths[*it] = parent.back() == '/' ? parent + entries[*it].name : parent + '/' + entries[*it].name;
+        }
+        return dirPaths[dir];
+    };
+
+    out.reserve(out.size() + entries.size() - 1);
+    for (uint64_t i = 1; i < entries.size(); ++i) {
+        const WalkEntry& entry = entries[i];
+        if (entry.directory) {
+            out.push_back(toRecord(entry, dirPath(i)));
+        } else {
+            const std::string& parent = dirPath(entry.parent);
+            out.push_back(toRecord(entry, parent.back() == '/' ? parent + entry.name : parent + '/' + entry.name));
+        }
+    }
+}
+#endif
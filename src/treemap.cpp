@@ -0,0 +1,119 @@
+#include "../include/treemap.h"
+#include "../include/parallel.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+
+struct Node {
+    FileId id;
+    std::vector<size_t> children;   // 展开后保留的子项，按大小降序
+    ULONGLONG foldedSize = 0;
+    uint32_t foldedItems = 0;
+    uint32_t folded = 0;
+
+    explicit Node(FileId node) : id(node) {}
+};
+
+void emit(const FileIndex& index, const std::vector<Node>& nodes, size_t at, uint32_t depth,
+          std::vector<TreemapEntry>& out) {
+    const Node& node = nodes[at];
+    TreemapEntry entry;
+    entry.path = index.fullPath(node.id);
+    entry.size = index.subtreeSize(node.id);
+    entry.items = index.subtreeCount(node.id);
+    entry.depth = depth;
+    out.push_back(entry);
+
+    for (size_t child : node.children) emit(index, nodes, child, depth + 1, out);
+    if (node.folded > 0) {
+        entry.size = node.foldedSize;
+        entry.items = node.foldedItems;
+        entry.depth = depth + 1;
+        entry.folded = node.folded;
+        out.push_back(std::move(entry));
+    }
+}
+
+} // namespace
+
+bool buildTreemap(FileIndex& index, const std::string& root, uint32_t depth, size_t topN,
+                  std::vector<TreemapEntry>& out) {
+    out.clear();
+    if (!root.empty()) index.buildLookup();
+    index.buildTotals();
+
+    auto lock = index.lockShared();
+    if (!index.hasTotals()) return false;   // 期间索引被清空或重新载入
+    const size_t n = index.nodeCount();
+
+    std::vector<Node> nodes;
+    if (root.empty()) {
+        for (FileId id = 0; id < n; ++id) {
+            if (index.parentOf(id) == INVALID_FILE_ID && index.subtreeCount(id) > 0) nodes.emplace_back(id);
+        }
+        std::sort(nodes.begin(), nodes.end(), [&](const Node& a, const Node& b) {
+            return index.subtreeSize(a.id) > index.subtreeSize(b.id);
+        });
+    } else {
+        FileId id = index.find(root);
+        if (id == INVALID_FILE_ID) return false;
+        nodes.emplace_back(id);
+    }
+    const size_t roots = nodes.size();
+
+    std::vector<uint64_t> expanding((n + 63) / 64, 0);
+    std::unordered_map<FileId, size_t> slots;
+    size_t levelBegin = 0;
+    for (uint32_t level = 0; level < depth && levelBegin < nodes.size(); ++level) {
+        const size_t levelEnd = nodes.size();
+        std::fill(expanding.begin(), expanding.end(), 0);
+        slots.clear();
+        for (size_t i = levelBegin; i < levelEnd; ++i) {
+            FileId id = nodes[i].id;
+            expanding[id >> 6] |= 1ULL << (id & 63);
+            slots[id] = i;
+        }
+
+        // 子节点没有单独的索引，按块并行扫描父节点数组
+        const size_t chunks = chunkCount(n, 1 << 16);
+        std::vector<std::vector<std::pair<FileId, FileId>>> found(chunks);
+        parallelFor(n, chunks, [&](size_t chunk, size_t begin, size_t end) {
+            for (FileId id = static_cast<FileId>(begin); id < end; ++id) {
+                FileId p = index.parentOf(id);
+                if (p == INVALID_FILE_ID || !(expanding[p >> 6] & (1ULL << (p & 63)))) continue;
+                if (index.subtreeCount(id) > 0) found[chunk].emplace_back(p, id);
+            }
+        });
+
+        std::vector<std::pair<FileId, FileId>> pairs;
+        for (auto& part : found) pairs.insert(pairs.end(), part.begin(), part.end());
+        std::sort(pairs.begin(), pairs.end(), [&](const auto& a, const auto& b) {
+            if (a.first != b.first) return a.first < b.first;
+            return index.subtreeSize(a.second) > index.subtreeSize(b.second);
+        });
+
+        for (size_t begin = 0; begin < pairs.size();) {
+            size_t end = begin + 1;
+            while (end < pairs.size() && pairs[end].first == pairs[begin].first) ++end;
+
+            const size_t parent = slots[pairs[begin].first];
+            const size_t kept = std::min(end - begin, topN);
+            for (size_t i = begin; i < begin + kept; ++i) {
+                nodes[parent].children.push_back(nodes.size());
+                nodes.emplace_back(pairs[i].second);
+            }
+            for (size_t i = begin + kept; i < end; ++i) {
+                nodes[parent].foldedSize += index.subtreeSize(pairs[i].second);
+                nodes[parent].foldedItems += index.subtreeCount(pairs[i].second);
+                nodes[parent].folded++;
+            }
+            begin = end;
+        }
+        levelBegin = levelEnd;
+    }
+
+    for (size_t i = 0; i < roots; ++i) emit(index, nodes, i, 0, out);
+    return true;
+}
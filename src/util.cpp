@@ -1,5 +1,13 @@
 #include "../include/util.h"
+#include "../include/metrics.h"
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <cerrno>
+#endif
+
+#ifdef _WIN32
 std::string wide_to_utf8(const std::wstring& wstr) {
     if (wstr.empty()) return {};
     int size = WideCharToMultiByte(CP_UTF8, 0, wstr.c_str(), -1, nullptr, 0, nullptr, nullptr);
@@ -16,29 +24,95 @@ std::wstring string_to_wstring(const std::string& str) {
     return result;
 }
 
+std::wstring utf8_to_wide(const std::string& str) {
+    if (str.empty()) return {};
+    int size = MultiByteToWideChar(CP_UTF8, 0, str.c_str(), -1, nullptr, 0);
+    if (size <= 0) return {};
+    std::wstring result(size - 1, 0);
+    MultiByteToWideChar(CP_UTF8, 0, str.c_str(), -1, result.data(), size - 1);
+    return result;
+}
+#endif
+
 FileRecord makeRecord(const std::string& fullPath)
 {
     FileRecord r {};
     r.fullpath = fullPath;
-
-    WIN32_FILE_ATTRIBUTE_DATA data;
-    if (GetFileAttributesExA(fullPath.c_str(), GetFileExInfoStandard, &data))
-    {
-        LARGE_INTEGER fileSize;
-        fileSize.HighPart = data.nFileSizeHigh;
-        fileSize.LowPart  = data.nFileSizeLow;
-        r.fileSize = fileSize.QuadPart;
-
-        r.creationTime   = data.ftCreationTime;
-        r.lastAccessTime = data.ftLastAccessTime;
-        r.lastWriteTime  = data.ftLastWriteTime;
-    }
-    else {
+    if (!fillRecord(r)) {
         r.fileSize = 0;
         r.creationTime = {};
         r.lastAccessTime = {};
         r.lastWriteTime = {};
     }
-
     return r;
-}
\ No newline at end of file
+}
+
+bool fillRecord(FileRecord& record)
+{
+    LatencyTimer timer(Latency::Stat);
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(utf8_to_wide(record.fullpath).c_str(), GetFileExInfoStandard, &data)) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    fileSize.HighPart = data.nFileSizeHigh;
+    fileSize.LowPart  = data.nFileSizeLow;
+    record.fileSize = fileSize.QuadPart;
+
+    record.creationTime   = data.ftCreationTime;
+    record.lastAccessTime = data.ftLastAccessTime;
+    record.lastWriteTime  = data.ftLastWriteTime;
+#else
+    // 与 GetFileAttributesEx 一致：不跟随符号链接，目录的大小记为 0；文件系统不提供创建时间时为 0
+    struct statx sx;
+    if (statx(AT_FDCWD, record.fullpath.c_str(), AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT,
+              STATX_TYPE | STATX_SIZE | STATX_ATIME | STATX_MTIME | STATX_BTIME | STATX_INO, &sx) != 0) {
+        return false;
+    }
+
+    record.fileSize = S_ISDIR(sx.stx_mode) ? 0 : sx.stx_size;
+    record.creationTime   = (sx.stx_mask & STATX_BTIME) ? unixToFileTime(sx.stx_btime.tv_sec, sx.stx_btime.tv_nsec)
+                                                         : FILETIME{};
+    record.lastAccessTime = unixToFileTime(sx.stx_atime.tv_sec, sx.stx_atime.tv_nsec);
+    record.lastWriteTime  = unixToFileTime(sx.stx_mtime.tv_sec, sx.stx_mtime.tv_nsec);
+    if (!record.frn) record.frn = sx.stx_ino;
+#endif
+    return true;
+}
+
+long lastError() {
+#ifdef _WIN32
+    return static_cast<long>(GetLastError());
+#else
+    return errno;
+#endif
+}
+
+bool isNotFound(long err) {
+#ifdef _WIN32
+    return err == ERROR_FILE_NOT_FOUND || err == ERROR_PATH_NOT_FOUND;
+#else
+    return err == ENOENT || err == ENOTDIR;
+#endif
+}
+
+ULONGLONG fileTimeToUInt64(const FILETIME& ft) {
+    return (static_cast<ULONGLONG>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+}
+
+long long fileTimeToEpochMillis(const FILETIME& ft) {
+    ULONGLONG value = fileTimeToUInt64(ft);
+    if (value == 0) return 0;
+    // FILETIME 以 1601-01-01 起的 100ns 计数
+    return static_cast<long long>(value / 10000) - 11644473600000LL;
+}
+
+FILETIME unixToFileTime(long long seconds, unsigned nanoseconds) {
+    const ULONGLONG value = (static_cast<ULONGLONG>(seconds + 11644473600LL)) * 10000000ULL + nanoseconds / 100;
+    FILETIME ft;
+    ft.dwLowDateTime = static_cast<DWORD>(value & 0xFFFFFFFF);
+    ft.dwHighDateTime = static_cast<DWORD>(value >> 32);
+    return ft;
+}
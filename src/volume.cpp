@@ -1,7 +1,8 @@
 #include "../include/volume.h"
+#include "../include/exclude.h"
+#include "../include/log.h"
 #include <fcntl.h>
 #include <io.h>
-#include <iostream>
 #include "../include/util.h"   // 需要 wide_to_utf8()
 
 bool Volume::getHandle() {
@@ -19,12 +20,12 @@ bool Volume::getHandle() {
     );
 
     if (hVol != INVALID_HANDLE_VALUE) {
-        std::cout << "[INFO] 成功打开卷: " << wide_to_utf8(path) << std::endl;
+        LOG_INFO("成功打开卷: " << wide_to_utf8(path));
         return true;
     }
 
     DWORD errCode = GetLastError();
-    std::cerr << "[ERROR] 打开卷失败, 错误码: " << errCode << std::endl;
+    LOG_ERROR("打开卷失败, 错误码: " << errCode);
     return false;
 }
 
@@ -46,11 +47,10 @@ bool Volume::createUSN() {
     );
 
     if (success) {
-        std::cout << "[INFO] 成功创建 USN 日志。" << std::endl;
+        LOG_INFO("成功创建 USN 日志。");
         return true;
     } else {
-        std::cerr << "[ERROR] 创建 USN 日志失败，错误码: "
-                  << GetLastError() << std::endl;
+        LOG_ERROR("创建 USN 日志失败，错误码: " << GetLastError());
         return false;
     }
 }
@@ -70,11 +70,10 @@ bool Volume::getUSNInfo() {
     );
 
     if (success) {
-        std::cout << "[INFO] 获取 USN 日志信息成功。" << std::endl;
+        LOG_INFO("获取 USN 日志信息成功。");
         return true;
     } else {
-        std::cerr << "[ERROR] 获取 USN 信息失败，错误码: "
-                  << GetLastError() << std::endl;
+        LOG_ERROR("获取 USN 信息失败，错误码: " << GetLastError());
         return false;
     }
 }
@@ -88,12 +87,11 @@ bool Volume::deleteUSN() {
 
     if (DeviceIoControl(hVol, FSCTL_DELETE_USN_JOURNAL,
         &dujd, sizeof(dujd), nullptr, 0, &br, nullptr)) {
-        std::cout << "[INFO] 删除 USN 日志信息成功。" << std::endl;
+        LOG_INFO("删除 USN 日志信息成功。");
         return true;
     }
 
-    std::cerr << "[ERROR] 删除 USN 信息失败，错误码: "
-              << GetLastError() << std::endl;
+    LOG_ERROR("删除 USN 信息失败，错误码: " << GetLastError());
     return false;
 }
 
@@ -136,7 +134,127 @@ bool Volume::getUSNJournal() {
         }
         med.StartFileReferenceNumber = *reinterpret_cast<USN*>(buffer);
     }
-    std::cout << "[INFO] USN 日志读取完毕。" << std::endl;
+    LOG_INFO("USN 日志读取完毕。");
+    return true;
+}
+
+size_t Volume::applyExclusions(const ExclusionRules& rules) {
+    if (rules.empty()) return 0;
+
+    // MFT 按 FRN 顺序枚举，上级目录可能在子项之后，只能在全部读完后从根向下判断。
+    // 每个 FRN 记下它在前缀规则中的位置或已被排除，每一级名称只判断一次
+    constexpr uint32_t EXCLUDED = ExclusionRules::NO_PREFIX - 1;
+    ExclusionRules::Cursor volumeCursor;
+    const std::wstring drive{static_cast<wchar_t>(volLetter), L':'};
+    const uint32_t rootState = rules.step(volumeCursor, drive) ? EXCLUDED : volumeCursor.node;
+
+    std::unordered_map<DWORDLONG, uint32_t> states;
+    states.reserve(frnMap.size());
+    std::vector<DWORDLONG> chain;
+    for (const auto& entry : frnMap) {
+        if (states.count(entry.first)) continue;
+
+        // 向上找到已判断过的祖先或卷根
+        chain.clear();
+        uint32_t state = rootState;
+        for (DWORDLONG frn = entry.first;;) {
+            auto known = states.find(frn);
+            if (known != states.end()) {
+                state = known->second;
+                break;
+            }
+            auto it = frnMap.find(frn);
+            if (it == frnMap.end()) break;
+            chain.push_back(frn);
+            if (it->second.pfrn == frn) break;
+            frn = it->second.pfrn;
+        }
+
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+            if (state != EXCLUDED) {
+                ExclusionRules::Cursor cursor{state};
+                state = rules.step(cursor, frnMap[*it].filename) ? EXCLUDED : cursor.node;
+            }
+            states.emplace(*it, state);
+        }
+    }
+
+    size_t removed = 0;
+    for (auto it = frnMap.begin(); it != frnMap.end();) {
+        if (states[it->first] == EXCLUDED) {
+            it = frnMap.erase(it);
+            ++removed;
+        } else {
+            ++it;
+        }
+    }
+    LOG_INFO("排除规则去掉了 " << removed << " 项。");
+    return removed;
+}
+
+bool Volume::readJournal(USN startUsn, std::vector<UsnChange>& changes) {
+    if (startUsn < ujd.FirstUsn) {
+        LOG_WARN("USN 日志已被截断，无法从 " << startUsn << " 继续读取。");
+        return false;
+    }
+
+    READ_USN_JOURNAL_DATA_V0 rujd{};
+    rujd.StartUsn = startUsn;
+    rujd.ReasonMask = 0xFFFFFFFF;
+    rujd.ReturnOnlyOnClose = FALSE;
+    rujd.UsnJournalID = ujd.UsnJournalID;
+
+    constexpr DWORD BUF_LEN = 0x10000;
+    std::vector<BYTE> buffer(BUF_LEN);
+    DWORD bytesReturned;
+
+    while (rujd.StartUsn < ujd.NextUsn) {
+        if (!DeviceIoControl(hVol, FSCTL_READ_USN_JOURNAL, &rujd, sizeof(rujd),
+                             buffer.data(), BUF_LEN, &bytesReturned, nullptr)) {
+            LOG_ERROR("读取 USN 日志失败，错误码: " << GetLastError());
+            return false;
+        }
+        if (bytesReturned <= sizeof(USN)) break;
+
+        DWORD offset = sizeof(USN);
+        while (offset < bytesReturned) {
+            auto usnRecord = reinterpret_cast<PUSN_RECORD>(buffer.data() + offset);
+            // 只处理 64 位 FRN 的 V2 记录（NTFS）
+            if (usnRecord->MajorVersion == 2) {
+                UsnChange change;
+                change.frn = usnRecord->FileReferenceNumber;
+                change.pfrn = usnRecord->ParentFileReferenceNumber;
+                change.reason = usnRecord->Reason;
+                change.attributes = usnRecord->FileAttributes;
+                change.filename.assign(usnRecord->FileName, usnRecord->FileNameLength / sizeof(WCHAR));
+                changes.push_back(std::move(change));
+            }
+            offset += usnRecord->RecordLength;
+        }
+        rujd.StartUsn = *reinterpret_cast<USN*>(buffer.data());
+    }
+    return true;
+}
+
+bool Volume::getPathById(DWORDLONG frn, std::wstring& path) {
+    FILE_ID_DESCRIPTOR fid{};
+    fid.dwSize = sizeof(fid);
+    fid.Type = FileIdType;
+    fid.FileId.QuadPart = static_cast<LONGLONG>(frn);
+
+    HANDLE h = OpenFileById(hVol, &fid, FILE_READ_ATTRIBUTES,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            nullptr, FILE_FLAG_BACKUP_SEMANTICS);
+    if (h == INVALID_HANDLE_VALUE) return false;
+
+    WCHAR buf[1024];
+    DWORD len = GetFinalPathNameByHandleW(h, buf, 1024, FILE_NAME_NORMALIZED | VOLUME_NAME_DOS);
+    CloseHandle(h);
+    if (len == 0 || len >= 1024) return false;
+
+    // 去掉 "\\?\" 前缀
+    path.assign(buf, len);
+    if (path.compare(0, 4, L"\\\\?\\") == 0) path.erase(0, 4);
     return true;
 }
 
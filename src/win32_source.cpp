@@ -0,0 +1,426 @@
+#include "../include/win32_source.h"
+#include "../include/exclude.h"
+#include "../include/file_index.h"
+#include "../include/log.h"
+#include "../include/util.h"
+#include <algorithm>
+#include <thread>
+
+namespace {
+
+// 完成端口上的消息类型
+enum : ULONG_PTR {
+    KEY_DIRECTORY = 1,   // 目录读取完成
+    KEY_REARM,           // 解码线程归还了缓冲区
+    KEY_ROOTS,           // 有根目录被添加或移除
+    KEY_STOP,
+};
+
+constexpr DWORD NOTIFY_FILTER = FILE_NOTIFY_CHANGE_FILE_NAME |
+                                FILE_NOTIFY_CHANGE_DIR_NAME |
+                                FILE_NOTIFY_CHANGE_SIZE;
+
+// 有根目录没有读取挂起时（例如上次挂起失败）隔多久重试
+constexpr DWORD RETRY_INTERVAL_MS = 1000;
+
+// 目录所在的系统或文件系统不提供扩展通知信息
+bool extendedUnsupported(DWORD err) {
+    return err == ERROR_INVALID_FUNCTION || err == ERROR_INVALID_PARAMETER || err == ERROR_NOT_SUPPORTED;
+}
+
+// 用于比较的根目录：小写，统一分隔符，去掉末尾的分隔符
+std::string rootKey(const std::string& path) {
+    std::string key = FileIndex::fold(path);
+    for (char& c : key) {
+        if (c == '/') c = '\\';
+    }
+    while (!key.empty() && key.back() == '\\') key.pop_back();
+    return key;
+}
+
+// a 与 b 相同或一个在另一个之下
+bool overlaps(const std::string& a, const std::string& b) {
+    const std::string& shorter = a.size() <= b.size() ? a : b;
+    const std::string& longer = a.size() <= b.size() ? b : a;
+    return longer.compare(0, shorter.size(), shorter) == 0 &&
+           (longer.size() == shorter.size() || longer[shorter.size()] == '\\');
+}
+
+SourceEvent::Action toAction(DWORD action, bool& known) {
+    known = true;
+    switch (action) {
+    case FILE_ACTION_ADDED:            return SourceEvent::Added;
+    case FILE_ACTION_REMOVED:          return SourceEvent::Removed;
+    case FILE_ACTION_MODIFIED:         return SourceEvent::Modified;
+    case FILE_ACTION_RENAMED_OLD_NAME: return SourceEvent::RenamedOld;
+    case FILE_ACTION_RENAMED_NEW_NAME: return SourceEvent::RenamedNew;
+    }
+    known = false;
+    return SourceEvent::Modified;
+}
+
+} // namespace
+
+Win32EventSource::Win32EventSource() {
+    port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+}
+
+Win32EventSource::~Win32EventSource() {
+    stop();
+    // run 返回时所有根目录都已释放，这里只剩从未开始监控的
+    for (auto& watch : addedRoots) {
+        CloseHandle(watch->handle);
+    }
+    if (port) {
+        CloseHandle(port);
+    }
+}
+
+void Win32EventSource::stop() {
+    isRunning = false;
+    if (port) {
+        PostQueuedCompletionStatus(port, 0, KEY_STOP, nullptr);
+    }
+}
+
+bool Win32EventSource::addRoot(const std::string& path) {
+    if (!port) {
+        LOG_ERROR("无法创建完成端口，错误码: " << GetLastError());
+        return false;
+    }
+
+    const std::string key = rootKey(path);
+    {
+        std::lock_guard<std::mutex> lock(rootsMtx);
+        for (const auto& existing : rootPaths) {
+            if (overlaps(key, existing)) {
+                LOG_WARN("与已监控的目录重叠，忽略: " << path);
+                return false;
+            }
+        }
+    }
+
+    auto watch = std::make_unique<Watch>();
+    watch->path = path;
+    watch->handle = CreateFileW(
+        string_to_wstring(path).c_str(),
+        FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+        nullptr
+    );
+
+    if (watch->handle == INVALID_HANDLE_VALUE) {
+        LOG_ERROR("无法打开目录: " << path << " 错误码: " << GetLastError());
+        return false;
+    }
+
+    DWORD serial = 0;
+    if (GetVolumeInformationByHandleW(watch->handle, nullptr, 0, &serial, nullptr, nullptr, nullptr, 0)) {
+        watch->volume = serial;
+    }
+
+    if (!CreateIoCompletionPort(watch->handle, port, KEY_DIRECTORY, 0)) {
+        LOG_ERROR("无法关联完成端口: " << path << " 错误码: " << GetLastError());
+        CloseHandle(watch->handle);
+        return false;
+    }
+
+    for (size_t i = 0; i < BUFFER_COUNT; ++i) {
+        auto buffer = std::make_unique<WatchBuffer>();
+        buffer->watch = watch.get();
+        buffer->data.resize(BUFFER_SIZE / sizeof(DWORD));
+        watch->freeBuffers.push_back(buffer.get());
+        watch->buffers.push_back(std::move(buffer));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(rootsMtx);
+        // 打开目录期间可能有另一个线程添加了重叠的根目录
+        for (const auto& existing : rootPaths) {
+            if (overlaps(key, existing)) {
+                LOG_WARN("与已监控的目录重叠，忽略: " << path);
+                CloseHandle(watch->handle);
+                return false;
+            }
+        }
+        watch->id = nextRootId++;
+        rootPaths.push_back(key);
+        addedRoots.push_back(std::move(watch));
+    }
+    PostQueuedCompletionStatus(port, 0, KEY_ROOTS, nullptr);
+    LOG_INFO("开始监控目录: " << path);
+    return true;
+}
+
+bool Win32EventSource::removeRoot(const std::string& path) {
+    const std::string key = rootKey(path);
+    {
+        std::lock_guard<std::mutex> lock(rootsMtx);
+        auto it = std::find(rootPaths.begin(), rootPaths.end(), key);
+        if (it == rootPaths.end()) return false;
+        rootPaths.erase(it);
+        removedRoots.push_back(key);
+    }
+    if (port) {
+        PostQueuedCompletionStatus(port, 0, KEY_ROOTS, nullptr);
+    }
+    return true;
+}
+
+void Win32EventSource::takeRootRequests() {
+    std::vector<std::unique_ptr<Watch>> added;
+    std::vector<std::string> removed;
+    {
+        std::lock_guard<std::mutex> lock(rootsMtx);
+        added.swap(addedRoots);
+        removed.swap(removedRoots);
+    }
+
+    for (auto& watch : added) {
+        arm(*watch);
+        watches.push_back(std::move(watch));
+    }
+    for (const auto& key : removed) {
+        for (auto& watch : watches) {
+            if (watch->removing || rootKey(watch->path) != key) continue;
+            watch->removing = true;
+            CancelIoEx(watch->handle, nullptr);
+            releaseIfIdle(*watch);
+            break;
+        }
+    }
+}
+
+void Win32EventSource::arm(Watch& watch) {
+    if (!isRunning || watch.removing) return;
+    while (watch.inFlight < READS_IN_FLIGHT && issueRead(watch)) ++watch.inFlight;
+}
+
+bool Win32EventSource::issueRead(Watch& watch) {
+    if (watch.freeBuffers.empty()) return false;
+    WatchBuffer* buffer = watch.freeBuffers.back();
+
+    // 缓冲区不清零，解码只读取内核写入的 bytes 字节
+    buffer->ov = {};
+    buffer->extended = watch.extended;
+    BOOL ok = buffer->extended
+        ? ReadDirectoryChangesExW(watch.handle, buffer->data.data(), BUFFER_SIZE, TRUE, NOTIFY_FILTER, nullptr,
+                                  &buffer->ov, nullptr, ReadDirectoryNotifyExtendedInformation)
+        : ReadDirectoryChangesW(watch.handle, buffer->data.data(), BUFFER_SIZE, TRUE, NOTIFY_FILTER, nullptr,
+                                &buffer->ov, nullptr);
+    if (!ok && buffer->extended && extendedUnsupported(GetLastError())) {
+        LOG_INFO("目录不支持扩展变更信息，改用普通通知: " << watch.path);
+        watch.extended = buffer->extended = false;
+        ok = ReadDirectoryChangesW(watch.handle, buffer->data.data(), BUFFER_SIZE, TRUE, NOTIFY_FILTER, nullptr,
+                                   &buffer->ov, nullptr);
+    }
+    if (!ok) {
+        LOG_WARN("ReadDirectoryChangesW 失败: " << watch.path << " " << GetLastError() << "，继续监控...");
+        return false;
+    }
+    watch.freeBuffers.pop_back();
+    return true;
+}
+
+void Win32EventSource::releaseIfIdle(Watch& watch) {
+    if (!watch.removing || watch.inFlight > 0 || watch.decoding > 0) return;
+
+    CloseHandle(watch.handle);
+    LOG_INFO("停止监控目录: " << watch.path);
+    watches.erase(std::find_if(watches.begin(), watches.end(),
+                               [&](const std::unique_ptr<Watch>& w) { return w.get() == &watch; }));
+}
+
+void Win32EventSource::submit(WatchBuffer* buffer) {
+    {
+        std::lock_guard<std::mutex> lock(queueMtx);
+        decodeQueue.push_back(buffer);
+    }
+    queueReady.notify_one();
+}
+
+void Win32EventSource::decode(const WatchBuffer& buffer, std::vector<SourceEvent>& out) const {
+    const BYTE* base = reinterpret_cast<const BYTE*>(buffer.data.data());
+
+    // 根目录各级只判断一次，每条通知从根目录的位置继续判断相对路径
+    const auto rules = exclusionRules();
+    ExclusionRules::Cursor rootCursor;
+    rules->walk(rootCursor, buffer.watch->path);
+
+    for (DWORD offset = 0; offset < buffer.bytes;) {
+
+        DWORD action, nextOffset;
+        DWORDLONG frn = 0;
+        std::wstring wname;
+        if (buffer.extended) {
+            auto* pNotify = reinterpret_cast<const FILE_NOTIFY_EXTENDED_INFORMATION*>(base + offset);
+            action = pNotify->Action;
+            nextOffset = pNotify->NextEntryOffset;
+            frn = static_cast<DWORDLONG>(pNotify->FileId.QuadPart);
+            wname.assign(pNotify->FileName, pNotify->FileNameLength / sizeof(WCHAR));
+        } else {
+            auto* pNotify = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(base + offset);
+            action = pNotify->Action;
+            nextOffset = pNotify->NextEntryOffset;
+            wname.assign(pNotify->FileName, pNotify->FileNameLength / sizeof(WCHAR));
+        }
+        std::string fileNameA = wide_to_utf8(wname);
+
+        // 拼接完整路径
+        std::string fullPath = buffer.watch->path;
+        if (!fullPath.empty() &&
+            fullPath.back() != '\\' &&
+            fullPath.back() != '/') {
+            fullPath += "\\";
+        }
+        fullPath += fileNameA;
+
+        bool known;
+        const SourceEvent::Action kind = toAction(action, known);
+        if (!known) {
+            LOG_WARN("未知操作: " << action);
+        } else {
+            // 被排除的路径只保留重命名通知，移入或移出排除范围时要当作删除或添加
+            ExclusionRules::Cursor cursor = rootCursor;
+            const bool excluded = rules->walk(cursor, fileNameA);
+            if (!excluded || kind == SourceEvent::RenamedOld || kind == SourceEvent::RenamedNew) {
+                SourceEvent event;
+                event.action = kind;
+                event.path = fullPath;
+                event.fileId = frn;
+                event.volume = frn ? buffer.watch->volume : 0;
+                event.excluded = excluded;
+                out.push_back(std::move(event));
+            }
+        }
+
+        if (nextOffset == 0)
+            break;
+
+        offset += nextOffset;
+    }
+}
+
+void Win32EventSource::decodeLoop(const Deliver& deliver) {
+    for (;;) {
+        WatchBuffer* buffer;
+        {
+            std::unique_lock<std::mutex> lock(queueMtx);
+            queueReady.wait(lock, [this] { return !decodeQueue.empty() || decodersStopping; });
+            if (decodeQueue.empty()) return;
+            buffer = decodeQueue.front();
+            decodeQueue.pop_front();
+        }
+
+        SourceBatch batch;
+        batch.root = buffer->watch->id;
+        batch.rootPath = buffer->watch->path;
+        batch.overflow = buffer->overflow;
+        decode(*buffer, batch.events);
+        const uint64_t sequence = buffer->sequence;
+
+        // 缓冲区由事件线程收回，之后不能再访问 buffer 与它所属的根目录
+        PostQueuedCompletionStatus(port, 0, KEY_REARM, &buffer->ov);
+
+        deliver(sequence, std::move(batch));
+    }
+}
+
+void Win32EventSource::run(const Deliver& deliver) {
+    if (!port) {
+        LOG_ERROR("无法创建完成端口，错误码: " << GetLastError());
+        return;
+    }
+
+    isRunning = true;
+    decodeQueue.clear();
+    decodersStopping = false;
+    nextSequence = 0;
+
+    std::vector<std::thread> decoders;
+    for (size_t i = 0; i < DECODE_THREADS; ++i) {
+        decoders.emplace_back(&Win32EventSource::decodeLoop, this, std::cref(deliver));
+    }
+
+    auto dispatch = [&](ULONG_PTR key, OVERLAPPED* ov, BOOL ok, DWORD bytes, DWORD err) {
+        if (key == KEY_ROOTS) {
+            takeRootRequests();
+            return;
+        }
+        if (!ov) {
+            // 超时：补上之前挂起失败的读取
+            for (auto& watch : watches) arm(*watch);
+            return;
+        }
+
+        auto* buffer = reinterpret_cast<WatchBuffer*>(ov);
+        Watch& watch = *buffer->watch;
+        if (key == KEY_REARM) {
+            watch.decoding--;
+            watch.freeBuffers.push_back(buffer);
+            arm(watch);
+            releaseIfIdle(watch);
+            return;
+        }
+
+        watch.inFlight--;
+        buffer->bytes = ok ? bytes : 0;
+        // 溢出时读取照常成功但没有内容，也可能以 ERROR_NOTIFY_ENUM_DIR 失败
+        buffer->overflow = !watch.removing && (ok ? bytes == 0 : err == ERROR_NOTIFY_ENUM_DIR);
+        if (!ok && buffer->extended && extendedUnsupported(err)) {
+            // 有的文件系统接受了扩展读取，完成时才报告不支持
+            LOG_INFO("目录不支持扩展变更信息，改用普通通知: " << watch.path);
+            watch.extended = false;
+        } else if (!ok && err != ERROR_OPERATION_ABORTED && err != ERROR_NOTIFY_ENUM_DIR) {
+            LOG_WARN("目录变更读取失败: " << watch.path << " " << err << "，继续监控...");
+        }
+
+        // 先补上挂起的读取，再把已完成的缓冲区交给解码线程；序号按完成顺序分配，
+        // 空闲的根目录不会让写入线程等待
+        arm(watch);
+        buffer->sequence = nextSequence++;
+        watch.decoding++;
+        submit(buffer);
+    };
+    auto next = [&](DWORD timeout) {
+        DWORD bytes = 0;
+        ULONG_PTR key = 0;
+        OVERLAPPED* ov = nullptr;
+        BOOL ok = GetQueuedCompletionStatus(port, &bytes, &key, &ov, timeout);
+        DWORD err = ok ? 0 : GetLastError();
+        if (key != KEY_STOP) dispatch(key, ov, ok, bytes, err);
+        return key;
+    };
+
+    takeRootRequests();
+    while (isRunning) {
+        bool idle = std::any_of(watches.begin(), watches.end(), [](const std::unique_ptr<Watch>& w) {
+            return w->inFlight == 0 && !w->removing;
+        });
+        if (next(idle ? RETRY_INTERVAL_MS : INFINITE) == KEY_STOP) break;
+    }
+    isRunning = false;
+
+    // 取消全部挂起的读取，等读取完成、缓冲区也都从解码线程收回后各根目录才能释放
+    takeRootRequests();
+    std::vector<Watch*> remaining;
+    for (auto& watch : watches) remaining.push_back(watch.get());
+    for (Watch* watch : remaining) {
+        watch->removing = true;
+        CancelIoEx(watch->handle, nullptr);
+        releaseIfIdle(*watch);
+    }
+    while (!watches.empty()) {
+        next(INFINITE);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queueMtx);
+        decodersStopping = true;
+    }
+    queueReady.notify_all();
+    for (auto& t : decoders) t.join();
+}
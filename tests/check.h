@@ -0,0 +1,33 @@
+#pragma once
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+// 各测试程序共用的断言：失败时打印位置并继续，main 以 checkResult() 作为返回值
+inline int& checkFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(cond)                                                                 \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            std::fprintf(stderr, "%s:%d: 检查失败: %s\n", __FILE__, __LINE__, #cond); \
+            ++checkFailures();                                                      \
+        }                                                                           \
+    } while (0)
+
+inline int checkResult() {
+    if (checkFailures()) std::fprintf(stderr, "%d 项检查失败\n", checkFailures());
+    return checkFailures() ? 1 : 0;
+}
+
+// 测试中的路径以 / 书写，换成本平台的形式（Windows 上放在 C: 盘下）
+inline std::string nativePath(std::string path) {
+#ifdef _WIN32
+    std::replace(path.begin(), path.end(), '/', '\\');
+    return "C:" + path;
+#else
+    return path;
+#endif
+}
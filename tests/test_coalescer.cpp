@@ -0,0 +1,126 @@
+#include "check.h"
+#include "../include/coalescer.h"
+
+namespace {
+
+using Clock = ChangeCoalescer::Clock;
+
+bool has(const std::vector<NetChange>& changes, NetChange::Kind kind, const std::string& path,
+         const std::string& newPath = {}) {
+    for (const auto& change : changes) {
+        if (change.kind == kind && change.path == nativePath(path) &&
+            (newPath.empty() || change.newPath == nativePath(newPath))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+int main() {
+    const Clock::time_point t0 = Clock::now();
+    const FileKey unknown;
+
+    // 窗口内新建又删除：什么也不输出
+    {
+        ChangeCoalescer c;
+        std::vector<NetChange> out;
+        c.push(ChangeCoalescer::Added, nativePath("/r/tmp.txt"), unknown, t0, out);
+        c.push(ChangeCoalescer::Removed, nativePath("/r/tmp.txt"), unknown, t0, out);
+        c.expire(t0 + ChangeCoalescer::MAX_DELAY * 2, out);
+        CHECK(out.empty());
+        CHECK(c.empty());
+    }
+
+    // 多次修改合成一次 Upsert，到期前不输出
+    {
+        ChangeCoalescer c;
+        std::vector<NetChange> out;
+        c.push(ChangeCoalescer::Modified, nativePath("/r/a.txt"), unknown, t0, out);
+        c.push(ChangeCoalescer::Modified, nativePath("/r/a.txt"), unknown, t0 + std::chrono::milliseconds(5), out);
+        c.expire(t0 + std::chrono::milliseconds(20), out);
+        CHECK(out.empty());
+        c.expire(t0 + ChangeCoalescer::MAX_DELAY * 2, out);
+        CHECK(out.size() == 1);
+        CHECK(has(out, NetChange::Upsert, "/r/a.txt"));
+    }
+
+    // 已存在的项被删除
+    {
+        ChangeCoalescer c;
+        std::vector<NetChange> out;
+        c.push(ChangeCoalescer::Removed, nativePath("/r/old.txt"), unknown, t0, out);
+        c.flush(out);
+        CHECK(out.size() == 1 && has(out, NetChange::Remove, "/r/old.txt"));
+    }
+
+    // 同一卷上文件标识相同的删除与添加配成移动
+    {
+        ChangeCoalescer c;
+        std::vector<NetChange> out;
+        c.push(ChangeCoalescer::Removed, nativePath("/r/a/f.txt"), FileKey{1, 42}, t0, out);
+        c.push(ChangeCoalescer::Added, nativePath("/r/b/f.txt"), FileKey{1, 42}, t0, out);
+        CHECK(has(out, NetChange::Rename, "/r/a/f.txt", "/r/b/f.txt"));
+        c.flush(out);
+        CHECK(out.size() == 1);
+    }
+
+    // 先添加后删除（两个根目录的通知先后不定）同样配对
+    {
+        ChangeCoalescer c;
+        std::vector<NetChange> out;
+        c.push(ChangeCoalescer::Added, nativePath("/s/f.txt"), FileKey{1, 7}, t0, out);
+        c.push(ChangeCoalescer::Removed, nativePath("/r/f.txt"), FileKey{1, 7}, t0, out);
+        CHECK(has(out, NetChange::Rename, "/r/f.txt", "/s/f.txt"));
+        c.flush(out);
+        CHECK(out.size() == 1);
+    }
+
+    // 不同卷上标识相同只是巧合，不配对
+    {
+        ChangeCoalescer c;
+        std::vector<NetChange> out;
+        c.push(ChangeCoalescer::Removed, nativePath("/r/f.txt"), FileKey{1, 42}, t0, out);
+        c.push(ChangeCoalescer::Added, nativePath("/s/f.txt"), FileKey{2, 42}, t0, out);
+        c.flush(out);
+        CHECK(out.size() == 2);
+        CHECK(has(out, NetChange::Remove, "/r/f.txt"));
+        CHECK(has(out, NetChange::Upsert, "/s/f.txt"));
+    }
+
+    // 重命名立即输出，挂起在旧目录下的项换到新路径
+    {
+        ChangeCoalescer c;
+        std::vector<NetChange> out;
+        c.push(ChangeCoalescer::Modified, nativePath("/r/dir/x.txt"), unknown, t0, out);
+        c.rename(nativePath("/r/dir"), nativePath("/r/moved"), 9, t0, out);
+        CHECK(out.size() == 1 && has(out, NetChange::Rename, "/r/dir", "/r/moved"));
+        c.flush(out);
+        CHECK(has(out, NetChange::Upsert, "/r/moved/x.txt"));
+        CHECK(!has(out, NetChange::Upsert, "/r/dir/x.txt"));
+    }
+
+    // 窗口内新建后改名：只按新路径添加
+    {
+        ChangeCoalescer c;
+        std::vector<NetChange> out;
+        c.push(ChangeCoalescer::Added, nativePath("/r/new.tmp"), unknown, t0, out);
+        c.rename(nativePath("/r/new.tmp"), nativePath("/r/new.txt"), 0, t0, out);
+        CHECK(out.empty());
+        c.flush(out);
+        CHECK(out.size() == 1 && has(out, NetChange::Upsert, "/r/new.txt"));
+    }
+
+    // 目录被删除时其下挂起的添加随之消失
+    {
+        ChangeCoalescer c;
+        std::vector<NetChange> out;
+        c.push(ChangeCoalescer::Added, nativePath("/r/d/a.txt"), unknown, t0, out);
+        c.push(ChangeCoalescer::Removed, nativePath("/r/d"), unknown, t0, out);
+        c.flush(out);
+        CHECK(out.size() == 1 && has(out, NetChange::Remove, "/r/d"));
+    }
+
+    return checkResult();
+}
@@ -0,0 +1,93 @@
+#include "check.h"
+#include "../include/database.h"
+
+#include <filesystem>
+#include <map>
+
+namespace {
+
+FileRecord makeFile(const std::string& path, ULONGLONG size, DWORDLONG frn) {
+    FileRecord record;
+    record.fullpath = nativePath(path);
+    record.fileSize = size;
+    record.frn = frn;
+    return record;
+}
+
+std::map<std::string, FileRecord> contents(Database& db) {
+    std::map<std::string, FileRecord> out;
+    db.forEachRecord([&](const FileRecord& record) { out[record.fullpath] = record; });
+    return out;
+}
+
+} // namespace
+
+int main() {
+    const std::filesystem::path file = std::filesystem::temp_directory_path() / "monitor_test_database.db";
+    std::filesystem::remove(file);
+
+    {
+        Database db(file.string());
+        CHECK(db.open() && db.createTable());
+
+        CHECK(db.addRecordsBatch({
+            makeFile("/data/docs", 0, 10),
+            makeFile("/data/docs/a.txt", 1, 11),
+            makeFile("/data/docs/sub", 0, 12),
+            makeFile("/data/docs/sub/b.txt", 2, 13),
+            makeFile("/data/docs2/c.txt", 3, 14),    // 名称以 docs 开头但不在其下
+            makeFile("/data/docs-x.txt", 4, 15),
+        }));
+        CHECK(db.getRecordCount() == 6);
+
+        // 目录改名时其下各项随之改路径，前缀相同的兄弟不受影响
+        CHECK(db.renameRecord(10, nativePath("/data/docs"), nativePath("/data/papers")) == 1);
+        auto rows = contents(db);
+        CHECK(rows.size() == 6);
+        CHECK(rows.count(nativePath("/data/papers")));
+        CHECK(rows.count(nativePath("/data/papers/a.txt")));
+        CHECK(rows.count(nativePath("/data/papers/sub")));
+        CHECK(rows.count(nativePath("/data/papers/sub/b.txt")));
+        CHECK(rows.count(nativePath("/data/docs2/c.txt")));
+        CHECK(rows.count(nativePath("/data/docs-x.txt")));
+        CHECK(!rows.count(nativePath("/data/docs/a.txt")));
+        CHECK(rows[nativePath("/data/papers/sub/b.txt")].frn == 13);
+
+        // 旧路径没有记录时按 FRN 找到
+        CHECK(db.renameRecord(12, nativePath("/data/wrong"), nativePath("/data/papers/inner")) == 1);
+        rows = contents(db);
+        CHECK(rows.count(nativePath("/data/papers/inner/b.txt")));
+        CHECK(!rows.count(nativePath("/data/papers/sub/b.txt")));
+
+        // 不存在的项
+        CHECK(db.renameRecord(0, nativePath("/data/none"), nativePath("/data/none2")) == 0);
+
+        // 目标路径上已有的记录被替换
+        CHECK(db.renameRecord(15, nativePath("/data/docs-x.txt"), nativePath("/data/papers/a.txt")) == 1);
+        rows = contents(db);
+        CHECK(rows.size() == 5);
+        CHECK(rows[nativePath("/data/papers/a.txt")].frn == 15);
+
+        // 默认跳过已有的路径，replaceExisting 时改写文件信息
+        CHECK(db.addRecordsBatch({makeFile("/data/docs2/c.txt", 300, 14)}));
+        CHECK(contents(db)[nativePath("/data/docs2/c.txt")].fileSize == 3);
+        CHECK(db.addRecordsBatch({makeFile("/data/docs2/c.txt", 300, 14), makeFile("/data/new.txt", 5, 16)}, true));
+        rows = contents(db);
+        CHECK(rows[nativePath("/data/docs2/c.txt")].fileSize == 300);
+        CHECK(rows.count(nativePath("/data/new.txt")));
+
+        // 待补全的记录补上文件信息后不再列出
+        CHECK(db.addPendingRecords({makeFile("/data/pending.txt", 0, 17)}));
+        std::vector<FileRecord> pending;
+        CHECK(db.loadPending(pending) && pending.size() == 1);
+        CHECK(db.updateMetadataBatch({makeFile("/data/pending.txt", 77, 17)}));
+        pending.clear();
+        CHECK(db.loadPending(pending) && pending.empty());
+        CHECK(contents(db)[nativePath("/data/pending.txt")].fileSize == 77);
+
+        db.close();
+    }
+
+    std::filesystem::remove(file);
+    return checkResult();
+}
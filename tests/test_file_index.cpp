@@ -0,0 +1,102 @@
+#include "check.h"
+#include "../include/file_index.h"
+
+namespace {
+
+FileRecord makeFile(const std::string& path, ULONGLONG size) {
+    FileRecord record;
+    record.fullpath = nativePath(path);
+    record.fileSize = size;
+    record.lastWriteTime.dwLowDateTime = static_cast<DWORD>(size);
+    return record;
+}
+
+bool listed(const FileIndex& index, const std::string& path) {
+    auto lock = index.lockShared();
+    FileId id = index.find(nativePath(path));
+    return id != INVALID_FILE_ID && index.isListed(id);
+}
+
+} // namespace
+
+int main() {
+    FileIndex index;
+    index.upsert(makeFile("/data/docs", 0));
+    index.upsert(makeFile("/data/docs/report.txt", 100));
+    index.upsert(makeFile("/data/docs/sub", 0));
+    index.upsert(makeFile("/data/docs/sub/notes.log", 200));
+    index.upsert(makeFile("/data/other.bin", 300));
+
+    // 路径还原与隐式创建的上级目录
+    {
+        auto lock = index.lockShared();
+        FileId id = index.find(nativePath("/data/docs/sub/notes.log"));
+        CHECK(id != INVALID_FILE_ID);
+        CHECK(index.fullPath(id) == nativePath("/data/docs/sub/notes.log"));
+        CHECK(index.record(id).fileSize == 200);
+
+        FileId parent = index.find(nativePath("/data"));
+        CHECK(parent != INVALID_FILE_ID);
+        CHECK(!index.isListed(parent));
+        CHECK(index.foldedExtension(id) == "log");
+    }
+
+    // 只更新已可见的节点
+    FileRecord bigger = makeFile("/data/docs/report.txt", 150);
+    CHECK(index.update(bigger));
+    CHECK(!index.update(makeFile("/data/missing.txt", 1)));
+    {
+        auto lock = index.lockShared();
+        CHECK(index.fileSize(index.find(nativePath("/data/docs/report.txt"))) == 150);
+    }
+
+    // 目录改名后子孙节点随之移动
+    CHECK(index.rename(nativePath("/data/docs"), nativePath("/data/papers")));
+    CHECK(!listed(index, "/data/docs/report.txt"));
+    CHECK(listed(index, "/data/papers/report.txt"));
+    CHECK(listed(index, "/data/papers/sub/notes.log"));
+    {
+        auto lock = index.lockShared();
+        FileId id = index.find(nativePath("/data/papers/sub/notes.log"));
+        CHECK(id != INVALID_FILE_ID && index.fullPath(id) == nativePath("/data/papers/sub/notes.log"));
+    }
+
+    // 目录范围：子孙节点的编号落在区间内，其他节点不在
+    index.buildTour();
+    {
+        auto lock = index.lockShared();
+        ULONGLONG low = 0, high = 0;
+        CHECK(index.scopeOf(nativePath("/data/papers"), low, high));
+        auto inScope = [&](const std::string& path) {
+            const uint64_t label = index.tourLabel(index.find(nativePath(path)));
+            return label >= low && label <= high;
+        };
+        CHECK(inScope("/data/papers/report.txt"));
+        CHECK(inScope("/data/papers/sub/notes.log"));
+        CHECK(!inScope("/data/other.bin"));
+    }
+
+    // 子树大小随删除增量修正
+    index.buildTotals();
+    {
+        auto lock = index.lockShared();
+        CHECK(index.subtreeSize(index.find(nativePath("/data"))) == 650);
+    }
+    CHECK(index.remove(nativePath("/data/other.bin")));
+    CHECK(!index.remove(nativePath("/data/other.bin")));
+    CHECK(!listed(index, "/data/other.bin"));
+    {
+        auto lock = index.lockShared();
+        CHECK(index.subtreeSize(index.find(nativePath("/data"))) == 350);
+        const RoaringBitmap* bin = index.extensionBitmap("bin");
+        CHECK(!bin || bin->cardinality() == 0);
+    }
+
+    // 清空后重新载入
+    index.clear();
+    CHECK(!listed(index, "/data/papers/report.txt"));
+    index.upsert(makeFile("/data/again.txt", 1));
+    CHECK(listed(index, "/data/again.txt"));
+
+    return checkResult();
+}
@@ -0,0 +1,57 @@
+#include "check.h"
+#include "../include/fuzzy.h"
+#include "../include/pinyin.h"
+
+namespace {
+
+int distance(const std::string& pattern, int maxDistance, const std::string& text) {
+    FuzzyPattern fuzzy;
+    if (!fuzzy.compile(pattern, maxDistance)) return -1;
+    return fuzzy.distance(text);
+}
+
+std::string keysOf(const std::string& name) {
+    std::string keys;
+    appendPinyinKeys(name, keys);
+    return keys;
+}
+
+} // namespace
+
+int main() {
+    // 模式与名称中任一子串之间的编辑距离
+    CHECK(distance("report", 2, "my_report_final.docx") == 0);
+    CHECK(distance("reprot", 2, "report.docx") == 2);
+    CHECK(distance("raport", 2, "report.docx") == 1);
+    CHECK(distance("report", 1, "summary.txt") == 2);   // 超过上限时为上限加一
+
+    // 以码点为单位，一个汉字算一处编辑
+    CHECK(distance("报告", 1, "年度报表.docx") == 1);
+    CHECK(distance("报告", 0, "年度报告.docx") == 0);
+
+    // 长度自动选择上限，空模式与超长模式编译失败
+    FuzzyPattern fuzzy;
+    CHECK(fuzzy.compile("abcdefgh", -1) && fuzzy.getMaxDistance() > 0);
+    CHECK(!fuzzy.compile("", 1));
+    CHECK(!fuzzy.compile(std::string(FuzzyPattern::MAX_LENGTH + 1, 'a'), 1));
+
+    // 码点解码
+    const std::string text = "a报";
+    size_t pos = 0;
+    CHECK(nextCodePoint(text, pos) == 'a' && pos == 1);
+    CHECK(nextCodePoint(text, pos) == 0x62A5 && pos == text.size());
+
+    // 拼音影子键：全拼与首字母，各键以 '\0' 分隔，非汉字部分原样保留
+    const std::string keys = keysOf("报告备份.docx");
+    CHECK(keys.find("baogaobeifen.docx") != std::string::npos);
+    CHECK(keys.find("bgbf.docx") != std::string::npos);
+    CHECK(keys.find('\0') != std::string::npos);
+    CHECK(keysOf("report.docx").empty());
+
+    // 多音字展开多个读音组合（"重" 读 zhong 或 chong）
+    const std::string multi = keysOf("重要");
+    CHECK(multi.find("zhongyao") != std::string::npos);
+    CHECK(multi.find("chongyao") != std::string::npos);
+
+    return checkResult();
+}
@@ -0,0 +1,90 @@
+#include "check.h"
+#include "../include/monitor_api.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// 文本格式的搜索结果
+std::string search(MonitorHandle handle, const std::string& query) {
+    std::string buffer(1 << 16, '\0');
+    int rc = IndexSearch(handle, query.c_str(), 0, &buffer[0], static_cast<int>(buffer.size()), 0);
+    return rc >= 0 ? std::string(buffer.c_str()) : std::string();
+}
+
+// 监控在后台线程上写入，等到条件成立或超时
+template <typename Pred>
+bool eventually(Pred pred) {
+    for (int i = 0; i < 200; ++i) {
+        if (pred()) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    return false;
+}
+
+void touch(const fs::path& path, size_t size) {
+    std::ofstream out(path, std::ios::binary);
+    out << std::string(size, 'x');
+}
+
+} // namespace
+
+int main() {
+    const fs::path dir = fs::temp_directory_path() / "monitor_test_api";
+    fs::remove_all(dir);
+    fs::create_directories(dir / "tree" / "sub");
+    touch(dir / "tree" / "existing_alpha.txt", 10);
+    touch(dir / "tree" / "sub" / "existing_beta.log", 20);
+    const std::string root = (dir / "tree").string();
+    const std::string db = (dir / "index.db").string();
+
+    MonitorHandle handle = nullptr;
+    CHECK(CreateFileIndex(db.c_str(), &handle) == 0 && handle);
+    MonitorHandle second = nullptr;
+    CHECK(CreateFileIndex(db.c_str(), &second) == 1);   // 同一个数据库只能属于一个实例
+    CHECK(StartFileMonitor(root.c_str(), db.c_str()) == -1);
+    CHECK(IndexSearch(nullptr, "x", 0, nullptr, 0, 0) == -4);
+
+    CHECK(AttachMonitor(handle, root.c_str()) == 0);
+    CHECK(AttachMonitor(handle, root.c_str()) == 1);
+
+    // 开始监控时已有的文件由根目录重扫（Linux）或数据库载入后进入索引
+    CHECK(eventually([&] { return search(handle, "existing_beta").find("existing_beta.log") != std::string::npos; }));
+    CHECK(search(handle, "ext:txt").find("existing_alpha.txt") != std::string::npos);
+
+    // 新建、改名与删除
+    touch(dir / "tree" / "created_gamma.txt", 30);
+    CHECK(eventually([&] { return search(handle, "created_gamma").find("created_gamma.txt\t30\t") != std::string::npos; }));
+
+    fs::rename(dir / "tree" / "sub", dir / "tree" / "renamed");
+    CHECK(eventually([&] {
+        const std::string found = search(handle, "existing_beta");
+        return found.find("renamed") != std::string::npos && found.find("sub") == std::string::npos;
+    }));
+
+    fs::remove(dir / "tree" / "existing_alpha.txt");
+    CHECK(eventually([&] { return search(handle, "existing_alpha").empty(); }));
+
+    std::string buffer(256, '\0');
+    CHECK(IndexSearch(handle, "size:>abc", 0, &buffer[0], static_cast<int>(buffer.size()), 0) == -3);
+
+    DestroyFileIndex(handle);
+    CHECK(IndexSearch(handle, "x", 0, &buffer[0], static_cast<int>(buffer.size()), 0) == -4);
+
+    // 再次打开同一个数据库：从快照恢复，停止期间的变化由重扫补上
+    touch(dir / "tree" / "offline_delta.txt", 40);
+    CHECK(CreateFileIndex(db.c_str(), &handle) == 0);
+    CHECK(AttachMonitor(handle, root.c_str()) == 0);
+    CHECK(eventually([&] { return search(handle, "offline_delta").find("offline_delta.txt") != std::string::npos; }));
+    CHECK(search(handle, "created_gamma").find("created_gamma.txt") != std::string::npos);
+    DestroyFileIndex(handle);
+
+    fs::remove_all(dir);
+    return checkResult();
+}
@@ -0,0 +1,156 @@
+#include "check.h"
+#include "../include/query.h"
+#include "../include/query_index.h"
+#include "../include/search.h"
+
+#include <algorithm>
+
+namespace {
+
+FileRecord makeFile(const std::string& path, ULONGLONG size) {
+    FileRecord record;
+    record.fullpath = nativePath(path);
+    record.fileSize = size;
+    return record;
+}
+
+bool parses(const std::string& text) {
+    Query query;
+    std::string error;
+    return Query::parse(text, query, error);
+}
+
+// 与计划无关的逐个求值，作为搜索结果的对照
+std::vector<FileId> bruteForce(FileIndex& index, const std::string& text) {
+    Query query;
+    std::string error;
+    std::vector<FileId> out;
+    if (!Query::parse(text, query, error)) return out;
+    auto lock = index.lockShared();
+    query.bind(index);
+    for (FileId id = 0; id < index.nodeCount(); ++id) {
+        if (index.isListed(id) && query.matches(index, id)) out.push_back(id);
+    }
+    return out;
+}
+
+std::vector<FileId> searched(SearchEngine& engine, const std::string& text) {
+    std::vector<FileId> out;
+    CHECK(engine.search(text, SearchOptions(), out) == SearchStatus::Ok);
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+} // namespace
+
+int main() {
+    // 解析：条件按代价排序，非法的值报错，未知前缀按关键字处理
+    {
+        Query query;
+        std::string error;
+        CHECK(Query::parse("report ext:txt size:>1kb", query, error));
+        const auto& terms = query.getTerms();
+        CHECK(terms.size() == 3);
+        CHECK(terms[0].kind == TermKind::Size);
+        CHECK(terms[0].low == 1025);
+        CHECK(terms[1].kind == TermKind::Extension);
+        CHECK(terms[2].kind == TermKind::Name && terms[2].text == "report");
+        CHECK(!query.scoped());
+    }
+    CHECK(parses("*.obj"));
+    CHECK(parses("size:10kb..1mb"));
+    CHECK(parses("size:huge"));
+    CHECK(parses("dm:lastweek"));
+    CHECK(parses("dc:2024-01"));
+    CHECK(parses("type:video;image"));
+    CHECK(parses("fuzzy:1:reprot"));
+    CHECK(parses("foo:bar"));
+    CHECK(!parses("size:>abc"));
+    CHECK(!parses("dm:someday"));
+    CHECK(!parses("regex:("));
+    CHECK(!parses("type:nothing"));
+
+    // 收窄：加条件后的结果是原结果的子集
+    {
+        Query older, narrower, other;
+        std::string error;
+        CHECK(Query::parse("report", older, error));
+        CHECK(Query::parse("report ext:txt", narrower, error));
+        CHECK(Query::parse("summary", other, error));
+        CHECK(narrower.refines(older));
+        CHECK(!other.refines(older));
+    }
+
+    FileIndex index;
+    for (int i = 0; i < 400; ++i) {
+        index.upsert(makeFile("/data/src/file" + std::to_string(i) + ".cpp", 100 + i));
+    }
+    for (int i = 0; i < 5; ++i) {
+        index.upsert(makeFile("/data/logs/run" + std::to_string(i) + ".log", 10 << 20));
+    }
+    index.upsert(makeFile("/data/docs/report_2024.docx", 5000));
+    index.upsert(makeFile("/data/docs/报告备份.docx", 6000));
+    index.buildTour();
+
+    // 计划：选择性高的扩展名条件由位图驱动，大小条件由排序列驱动，覆盖大半节点的条件顺序扫描
+    {
+        QueryIndexes indexes(index);
+        auto lock = index.lockShared();
+        Query query;
+        std::string error;
+
+        CHECK(Query::parse("ext:log", query, error));
+        QueryPlan plan = planQuery(query, index, indexes);
+        CHECK(plan.filterDrives && plan.estimate == 5);
+        std::vector<FileId> candidates;
+        CHECK(collectCandidates(plan, index, indexes, candidates));
+        CHECK(candidates.size() == 5);
+
+        CHECK(Query::parse("size:>1mb", query, error));
+        plan = planQuery(query, index, indexes);
+        CHECK(plan.driver && plan.driver->kind == TermKind::Size);
+        CHECK(collectCandidates(plan, index, indexes, candidates));
+        CHECK(candidates.size() == 5);
+
+        CHECK(Query::parse("file", query, error));
+        plan = planQuery(query, index, indexes);
+        CHECK(!plan.driver && !plan.filterDrives);
+        CHECK(!collectCandidates(plan, index, indexes, candidates));
+    }
+
+    // 搜索结果与逐个求值一致
+    SearchEngine engine(index);
+    const char* queries[] = {
+        "ext:log", "size:>1mb", "file1", "*.docx", "report", "regex:^run[0-2]\\.log$",
+        "file ext:cpp size:<200", "in:/data/docs", "fuzzy:raport", "bgbf", "baogao",
+    };
+    for (const char* text : queries) {
+        std::string query = text;
+#ifdef _WIN32
+        if (query.rfind("in:", 0) == 0) query = "in:" + nativePath(query.substr(3));
+#endif
+        const auto expected = bruteForce(index, query);
+        CHECK(searched(engine, query) == expected);
+    }
+    CHECK(searched(engine, "ext:log").size() == 5);
+    CHECK(searched(engine, "in:" + nativePath("/data/docs")).size() == 2);
+    CHECK(searched(engine, "bgbf").size() == 1);
+    CHECK(searched(engine, "fuzzy:raport").size() == 1);
+
+    std::vector<FileId> out;
+    CHECK(engine.search("size:>abc", SearchOptions(), out) == SearchStatus::InvalidQuery);
+
+    // 按大小取前几条
+    SearchOptions top;
+    top.maxResults = 3;
+    top.sortKey = SortKey::Size;
+    top.descending = false;
+    CHECK(engine.search("ext:cpp", top, out) == SearchStatus::Ok);
+    CHECK(out.size() == 3);
+    {
+        auto lock = index.lockShared();
+        CHECK(out.size() == 3 && index.fileSize(out[0]) == 100 && index.fileSize(out[2]) == 102);
+    }
+
+    return checkResult();
+}